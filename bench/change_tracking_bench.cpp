@@ -0,0 +1,122 @@
+// Benchmark for the per-frame collider sync and UI movement with and without change tracking.
+// The world is restart-sized: mostly static colliders, a few moving mobs and camera-relative UI.
+#include <chrono>
+#include <cstdio>
+
+#include "tiny_ecs_registry.hpp"
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// 196x196 static entities with colliders (the size terrain tiles had as entities), 80 moving mobs and 40 UI entities
+static void populate(ECSRegistry& ecs)
+{
+	std::vector<Entity> tiles = Entity::create_range(196 * 196);
+	for (unsigned int i = 0; i < tiles.size(); i++) {
+		ecs.motions.emplace(tiles[i]).position = vec2(i % 196, i / 196);
+		ecs.colliders.emplace(tiles[i]);
+	}
+
+	for (int i = 0; i < 80; i++) {
+		Entity mob;
+		ecs.motions.emplace(mob).velocity = vec2(1.f, 0.5f);
+		ecs.mobs.emplace(mob);
+		ecs.colliders.emplace(mob);
+	}
+
+	for (int i = 0; i < 40; i++) {
+		Entity ui;
+		ecs.motions.emplace(ui);
+		ecs.screenUI.insert(ui, vec2((float)i, 0.f));
+	}
+}
+
+// Integrates positions and marks the moved entities, as PhysicsSystem::step does
+static void integrate(ECSRegistry& ecs, float step_seconds, bool mark)
+{
+	for (unsigned int i = 0; i < ecs.motions.size(); i++) {
+		MotionRef motion = ecs.motions.components[i];
+		motion.position += motion.velocity * step_seconds;
+		if (mark && (motion.velocity.x != 0.f || motion.velocity.y != 0.f))
+			ecs.motions.mark_changed(ecs.motions.entities[i]);
+	}
+}
+
+static void move_ui(ECSRegistry& ecs, Entity e, vec2 camera_position)
+{
+	if (ecs.motions.has(e))
+		ecs.motions.get(e).position = ecs.screenUI.get(e) + camera_position;
+}
+
+int main()
+{
+	const int frames = 1000;
+	const vec2 camera_position = vec2(98.f, 98.f);
+	double full_colliders_ms = 0, changed_colliders_ms = 0;
+	double full_ui_ms = 0, changed_ui_ms = 0;
+	float checksum_full = 0, checksum_changed = 0;
+
+	// Every frame: sync every collider and move every UI entity
+	{
+		std::unique_ptr<ECSRegistry> ecs(new ECSRegistry());
+		populate(*ecs);
+		for (int frame = 0; frame < frames; frame++) {
+			integrate(*ecs, 0.016f, false);
+
+			auto start = bench_clock::now();
+			ecs->view<Motion, Collider>().each([](Entity, MotionRef motion, ColliderRef collider) {
+				collider.position = motion.position;
+			});
+			full_colliders_ms += elapsed_ms(start);
+
+			start = bench_clock::now();
+			for (Entity e : ecs->screenUI.entities)
+				move_ui(*ecs, e, camera_position);
+			full_ui_ms += elapsed_ms(start);
+		}
+		for (Entity e : ecs->mobs.entities)
+			checksum_full += ecs->colliders.get(e).position.x;
+		ecs->clear_all_components();
+	}
+
+	// Only what changed: the moving mobs, and the UI once after it was added since the camera stands still
+	{
+		std::unique_ptr<ECSRegistry> ecs(new ECSRegistry());
+		populate(*ecs);
+		for (int frame = 0; frame < frames; frame++) {
+			integrate(*ecs, 0.016f, true);
+
+			auto start = bench_clock::now();
+			ecs->motions.each_changed([&](Entity entity) {
+				if (ecs->colliders.has(entity))
+					ecs->colliders.get(entity).position = ecs->motions.get(entity).position;
+			});
+			changed_colliders_ms += elapsed_ms(start);
+
+			start = bench_clock::now();
+			ecs->screenUI.each_changed([&](Entity e) { move_ui(*ecs, e, camera_position); });
+			changed_ui_ms += elapsed_ms(start);
+
+			ecs->clear_changes();
+		}
+		for (Entity e : ecs->mobs.entities)
+			checksum_changed += ecs->colliders.get(e).position.x;
+		ecs->clear_all_components();
+	}
+
+	if (checksum_full != checksum_changed) {
+		printf("checksum mismatch: %f vs %f\n", checksum_full, checksum_changed);
+		return 1;
+	}
+
+	printf("Per-frame sync of %d motion entities, total over %d frames\n", 196 * 196 + 120, frames);
+	printf("%-16s %14s %14s\n", "", "colliders (ms)", "UI (ms)");
+	printf("%-16s %14.3f %14.3f\n", "every entity", full_colliders_ms, full_ui_ms);
+	printf("%-16s %14.3f %14.3f\n", "changed only", changed_colliders_ms, changed_ui_ms);
+	printf("%-16s %13.2fx %13.2fx\n", "speedup", full_colliders_ms / changed_colliders_ms, full_ui_ms / changed_ui_ms);
+	return 0;
+}
@@ -0,0 +1,121 @@
+// Micro-benchmark for ComponentContainer lookups and inserts.
+// Compares the paged sparse-set index against the previous unordered_map index
+// on a registry the size of the 196x196 terrain.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+
+#include "tiny_ecs.hpp"
+
+// Component with the same footprint as TerrainCell
+struct BenchCell
+{
+	uint16_t terrain_type = 0;
+	uint16_t flag = 0;
+};
+
+// The old ComponentContainer index, kept here only as a baseline
+template <typename Component>
+class HashedComponentContainer
+{
+	std::unordered_map<unsigned int, unsigned int> map_entity_componentID;
+public:
+	std::vector<Component> components;
+	std::vector<Entity> entities;
+
+	Component& insert(Entity e, Component c)
+	{
+		map_entity_componentID[e] = (unsigned int)components.size();
+		components.push_back(std::move(c));
+		entities.push_back(e);
+		return components.back();
+	}
+
+	Component& get(Entity e) { return components[map_entity_componentID[e]]; }
+
+	bool has(Entity e) { return map_entity_componentID.count(e) > 0; }
+
+	void remove(Entity e)
+	{
+		if (!has(e))
+			return;
+		unsigned int cID = map_entity_componentID[e];
+		components[cID] = std::move(components.back());
+		entities[cID] = entities.back();
+		map_entity_componentID[entities.back()] = cID;
+		map_entity_componentID.erase(e);
+		components.pop_back();
+		entities.pop_back();
+	}
+};
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+struct BenchResult
+{
+	double insert_ms = 0;
+	double lookup_ms = 0;
+	double remove_ms = 0;
+	unsigned int checksum = 0;
+};
+
+// Inserts every entity, then does `lookup_rounds` random-order has()+get() passes, then removes everything
+template <typename Container>
+BenchResult run(const std::vector<Entity>& entities, const std::vector<Entity>& lookup_order, int lookup_rounds)
+{
+	BenchResult result;
+	Container container;
+
+	auto start = bench_clock::now();
+	for (Entity e : entities)
+		container.insert(e, BenchCell{ (uint16_t)(e & 0xF), 0 });
+	result.insert_ms = elapsed_ms(start);
+
+	start = bench_clock::now();
+	for (int round = 0; round < lookup_rounds; round++) {
+		for (Entity e : lookup_order) {
+			if (container.has(e))
+				result.checksum += container.get(e).terrain_type;
+		}
+	}
+	result.lookup_ms = elapsed_ms(start);
+
+	start = bench_clock::now();
+	for (Entity e : lookup_order)
+		container.remove(e);
+	result.remove_ms = elapsed_ms(start);
+
+	return result;
+}
+
+int main()
+{
+	const int num_entities = 196 * 196;
+	const int lookup_rounds = 20;
+
+	std::vector<Entity> entities(num_entities);
+	std::vector<Entity> lookup_order = entities;
+	std::shuffle(lookup_order.begin(), lookup_order.end(), std::mt19937(42));
+
+	BenchResult hashed = run<HashedComponentContainer<BenchCell>>(entities, lookup_order, lookup_rounds);
+	BenchResult sparse = run<ComponentContainer<BenchCell>>(entities, lookup_order, lookup_rounds);
+
+	if (hashed.checksum != sparse.checksum) {
+		printf("checksum mismatch: %u vs %u\n", hashed.checksum, sparse.checksum);
+		return 1;
+	}
+
+	printf("ComponentContainer, %d entities, %d lookup rounds\n", num_entities, lookup_rounds);
+	printf("%-14s %12s %12s %12s\n", "", "insert (ms)", "lookup (ms)", "remove (ms)");
+	printf("%-14s %12.3f %12.3f %12.3f\n", "unordered_map", hashed.insert_ms, hashed.lookup_ms, hashed.remove_ms);
+	printf("%-14s %12.3f %12.3f %12.3f\n", "sparse set", sparse.insert_ms, sparse.lookup_ms, sparse.remove_ms);
+	printf("%-14s %11.2fx %11.2fx %11.2fx\n", "speedup",
+		hashed.insert_ms / sparse.insert_ms, hashed.lookup_ms / sparse.lookup_ms, hashed.remove_ms / sparse.remove_ms);
+	return 0;
+}
@@ -0,0 +1,76 @@
+// Benchmark for JobSystem::parallel_for on the Motion integration of PhysicsSystem::step.
+// Runs the same frames with 1, 2, 4 and one thread per core and checks that every thread count gives the same positions.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "tiny_ecs_registry.hpp"
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// The 196x196 terrain plus a few thousand moving entities
+static void populate(ECSRegistry& ecs)
+{
+	for (int i = 0; i < 196 * 196; i++)
+		ecs.motions.emplace(Entity()).position = vec2(i % 196, i / 196);
+	for (int i = 0; i < 4000; i++) {
+		MotionRef motion = ecs.motions.emplace(Entity());
+		motion.position = vec2(i % 196, (i * 7) % 196);
+		motion.velocity = vec2((float)(i % 13) - 6.f, (float)(i % 5) - 2.f);
+	}
+}
+
+// Integrates positions as PhysicsSystem::step does
+static void integrate(ECSRegistry& ecs, float step_seconds)
+{
+	float* positions = &ecs.motions.components.field<SoALayout<Motion>::POSITION>()[0].x;
+	const float* velocities = &ecs.motions.components.field<SoALayout<Motion>::VELOCITY>()[0].x;
+	ecs.motions.parallel_for(*ecs.jobs, [=](size_t begin, size_t end) {
+		for (size_t i = 2 * begin; i < 2 * end; i++)
+			positions[i] += velocities[i] * step_seconds;
+	});
+}
+
+int main()
+{
+	const int frames = 1000;
+	unsigned int thread_counts[] = { 1, 2, 4, std::max(1u, std::thread::hardware_concurrency()) };
+	std::vector<vec2> reference;
+	double single_thread_ms = 0;
+
+	printf("Motion integration of %d entities, total over %d frames\n", 196 * 196 + 4000, frames);
+	printf("%-10s %12s %10s\n", "threads", "time (ms)", "speedup");
+	for (unsigned int threads : thread_counts) {
+		JobSystem jobs(threads);
+		std::unique_ptr<ECSRegistry> ecs(new ECSRegistry());
+		ecs->jobs = &jobs;
+		populate(*ecs);
+
+		auto start = bench_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+			integrate(*ecs, 0.016f);
+		double ms = elapsed_ms(start);
+		if (threads == 1)
+			single_thread_ms = ms;
+
+		std::vector<vec2> positions;
+		for (unsigned int i = 0; i < ecs->motions.size(); i++)
+			positions.push_back(ecs->motions.components[i].position);
+		if (reference.empty())
+			reference = positions;
+		else if (memcmp(reference.data(), positions.data(), positions.size() * sizeof(vec2)) != 0) {
+			printf("positions with %u threads differ from the ones with 1 thread\n", threads);
+			return 1;
+		}
+		ecs->clear_all_components();
+
+		printf("%-10u %12.3f %9.2fx\n", threads, ms, single_thread_ms / ms);
+	}
+	return 0;
+}
@@ -0,0 +1,142 @@
+// Benchmark for the chunk encodings of .smap files (see map_file.hpp) on generated 1k, 4k and 8k maps.
+// Compares the file size of RAW and compressed chunks, and times encoding and decoding every chunk on one thread and
+// on one thread per core. Every decoded chunk is checked against the generator.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "components.hpp"
+#include "job_system.hpp"
+#include "map_file.hpp"
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+static uint32_t hash(uint32_t x, uint32_t y)
+{
+	uint32_t h = x * 0x8DA6B343u ^ y * 0xD8163841u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+
+// Random heights on a lattice every scale cells, interpolated in between
+static float noise(int x, int y, int scale)
+{
+	int lx = x / scale, ly = y / scale;
+	float fx = (float)(x % scale) / scale, fy = (float)(y % scale) / scale;
+	auto height = [](int x, int y) { return (hash(x, y) >> 8) * (1.f / 16777216.f); };
+	float top = height(lx, ly) + (height(lx + 1, ly) - height(lx, ly)) * fx;
+	float bottom = height(lx, ly + 1) + (height(lx + 1, ly + 1) - height(lx, ly + 1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+// Lakes, beaches, meadows with scattered rocks and mud flats, rock around the edges
+static uint32_t generated_cell(int x, int y, int size)
+{
+	if (x == 0 || y == 0 || x == size - 1 || y == size - 1)
+		return ((uint32_t)TERRAIN_TYPE::ROCK << 16) | TERRAIN_FLAGS::COLLIDABLE;
+
+	float height = 0.7f * noise(x, y, 64) + 0.3f * noise(x, y, 16);
+	if (height < 0.3f)
+		return ((uint32_t)TERRAIN_TYPE::DEEP_WATER << 16) | TERRAIN_FLAGS::COLLIDABLE | TERRAIN_FLAGS::DISABLE_PATHFIND;
+	if (height < 0.36f)
+		return ((uint32_t)TERRAIN_TYPE::SHALLOW_WATER << 16);
+	if (height < 0.42f)
+		return ((uint32_t)TERRAIN_TYPE::SAND << 16) | TERRAIN_FLAGS::ALLOW_SPAWNS;
+	if (height > 0.72f)
+		return ((uint32_t)TERRAIN_TYPE::MUD << 16) | TERRAIN_FLAGS::ALLOW_SPAWNS;
+	if (hash(x, y) % 50 == 0)
+		return ((uint32_t)TERRAIN_TYPE::ROCK << 16) | TERRAIN_FLAGS::COLLIDABLE;
+	return ((uint32_t)TERRAIN_TYPE::GRASS << 16) | TERRAIN_FLAGS::ALLOW_SPAWNS;
+}
+
+static void generate_chunk(int index, int size, int chunks_x, uint32_t cells[TERRAIN_CHUNK_CELLS])
+{
+	const int x0 = (index % chunks_x) * TERRAIN_CHUNK_SIZE;
+	const int y0 = (index / chunks_x) * TERRAIN_CHUNK_SIZE;
+	memset(cells, 0, sizeof(uint32_t) * TERRAIN_CHUNK_CELLS);
+	for (int row = 0; row < TERRAIN_CHUNK_SIZE && y0 + row < size; row++) {
+		for (int column = 0; column < TERRAIN_CHUNK_SIZE && x0 + column < size; column++)
+			cells[row * TERRAIN_CHUNK_SIZE + column] = generated_cell(x0 + column, y0 + row, size);
+	}
+}
+
+static void run(int size, JobSystem& jobs)
+{
+	const int chunks_x = (size + TERRAIN_CHUNK_SIZE - 1) / TERRAIN_CHUNK_SIZE;
+	const int chunk_count = chunks_x * chunks_x;
+	const size_t chunk_bytes = sizeof(uint32_t) * TERRAIN_CHUNK_CELLS;
+	const uint64_t table_end = sizeof(SmapHeader) + sizeof(SmapChunkEntry) * (uint64_t)chunk_count;
+
+	// Encoded back to back, as save_grid writes them
+	std::vector<uint8_t> file;
+	std::vector<SmapChunkEntry> table(chunk_count);
+	std::vector<uint8_t> encoded;
+	uint32_t cells[TERRAIN_CHUNK_CELLS];
+	int encodings[3] = {};
+	double encode_ms = 0.0;
+	for (int index = 0; index < chunk_count; index++) {
+		generate_chunk(index, size, chunks_x, cells);
+		auto start = bench_clock::now();
+		table[index].encoding = encode_smap_chunk(cells, TERRAIN_CHUNK_CELLS, encoded);
+		encode_ms += elapsed_ms(start);
+		table[index].offset = file.size();
+		table[index].size = (uint32_t)encoded.size();
+		file.insert(file.end(), encoded.begin(), encoded.end());
+		encodings[table[index].encoding]++;
+	}
+
+	// Every chunk on its own page, as the RAW maps that are used in place
+	const uint64_t raw_size = (table_end + SMAP_ALIGNMENT - 1) / SMAP_ALIGNMENT * SMAP_ALIGNMENT + chunk_bytes * chunk_count;
+	const uint64_t compressed_size = table_end + file.size();
+
+	std::vector<uint32_t> decoded((size_t)chunk_count * TERRAIN_CHUNK_CELLS);
+	auto decode = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const SmapChunkEntry& entry = table[i];
+			decode_smap_chunk(file.data() + entry.offset, entry.size, entry.encoding, &decoded[i * TERRAIN_CHUNK_CELLS], TERRAIN_CHUNK_CELLS);
+		}
+	};
+
+	auto start = bench_clock::now();
+	decode(0, chunk_count);
+	double serial_ms = elapsed_ms(start);
+
+	start = bench_clock::now();
+	jobs.parallel_for(chunk_count, 64, decode);
+	double parallel_ms = elapsed_ms(start);
+
+	int mismatches = 0;
+	for (int index = 0; index < chunk_count; index++) {
+		generate_chunk(index, size, chunks_x, cells);
+		mismatches += memcmp(cells, &decoded[(size_t)index * TERRAIN_CHUNK_CELLS], chunk_bytes) != 0;
+	}
+
+	const double cell_mb = chunk_bytes * (double)chunk_count / (1024.0 * 1024.0);
+	printf("%d x %d, %d chunks (%d RAW, %d PALETTE, %d PALETTE_RLE)\n", size, size, chunk_count,
+		encodings[SMAP_ENCODING::RAW], encodings[SMAP_ENCODING::PALETTE], encodings[SMAP_ENCODING::PALETTE_RLE]);
+	printf("  RAW file:           %10.2f MB\n", raw_size / (1024.0 * 1024.0));
+	printf("  compressed file:    %10.2f MB  (%.1fx smaller, %.2f bits per cell)\n", compressed_size / (1024.0 * 1024.0),
+		(double)raw_size / compressed_size, 8.0 * file.size() / ((double)chunk_count * TERRAIN_CHUNK_CELLS));
+	printf("  encode:             %10.2f ms  (%.0f MB/s of cells)\n", encode_ms, cell_mb / (encode_ms / 1000.0));
+	printf("  decode, 1 thread:   %10.2f ms  (%.0f MB/s of cells, %.2f us per chunk)\n", serial_ms,
+		cell_mb / (serial_ms / 1000.0), 1000.0 * serial_ms / chunk_count);
+	printf("  decode, %2u threads:%10.2f ms  (%.0f MB/s of cells)\n", jobs.thread_count(), parallel_ms,
+		cell_mb / (parallel_ms / 1000.0));
+	printf("  mismatched chunks:  %10d\n", mismatches);
+}
+
+int main()
+{
+	JobSystem jobs(0);
+	for (int size : { 1024, 4096, 8192 })
+		run(size, jobs);
+	return 0;
+}
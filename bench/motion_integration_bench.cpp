@@ -0,0 +1,84 @@
+// Benchmark for the position integration of PhysicsSystem::step.
+// Compares Motion stored as an array of structs (the previous layout) against the
+// struct-of-arrays layout from SoALayout<Motion> at 10k, 100k and 1M moving entities.
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "tiny_ecs_registry.hpp"
+
+// Same fields as Motion, but without a SoALayout specialization, so it is stored as an array of structs
+struct AoSMotion
+{
+	vec2 position = { 0.f, 0.f };
+	float angle = 0.f;
+	vec2 velocity = { 0.f, 0.f };
+	vec2 scale = { 1.f, 1.f };
+};
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+int main()
+{
+	const unsigned int sizes[] = { 10000, 100000, 1000000 };
+	const float step_seconds = 16.f / 1000.f;
+
+	printf("Position integration, ns per entity and step\n");
+	printf("%-10s %8s %16s %16s %9s\n", "entities", "steps", "array of structs", "struct of arrays", "speedup");
+
+	for (unsigned int n : sizes) {
+		// Keep the total work roughly constant
+		const int steps = (int)(100000000ull / n / 10);
+
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<float> velocity(-5.f, 5.f);
+		std::vector<Entity> entities = Entity::create_range(n);
+
+		ComponentContainer<AoSMotion> aos;
+		ComponentContainer<Motion> soa;
+		aos.reserve(n);
+		soa.reserve(n);
+		for (Entity e : entities) {
+			vec2 v = { velocity(rng), velocity(rng) };
+			aos.emplace(e).velocity = v;
+			soa.emplace(e).velocity = v;
+		}
+
+		auto start = bench_clock::now();
+		for (int step = 0; step < steps; step++) {
+			for (AoSMotion& motion : aos.components)
+				motion.position += motion.velocity * step_seconds;
+		}
+		double aos_ms = elapsed_ms(start);
+
+		// Same loop as PhysicsSystem::step
+		start = bench_clock::now();
+		for (int step = 0; step < steps; step++) {
+			float* positions = &soa.components.field<SoALayout<Motion>::POSITION>()[0].x;
+			const float* velocities = &soa.components.field<SoALayout<Motion>::VELOCITY>()[0].x;
+			for (size_t i = 0; i < 2 * (size_t)n; i++)
+				positions[i] += velocities[i] * step_seconds;
+		}
+		double soa_ms = elapsed_ms(start);
+
+		// Both layouts have to end up in the same place
+		for (unsigned int i = 0; i < n; i += n / 16) {
+			if (aos.components[i].position != soa.components[i].position) {
+				printf("position mismatch at %u\n", i);
+				return 1;
+			}
+		}
+
+		double to_ns = 1e6 / ((double)n * steps);
+		printf("%-10u %8d %16.3f %16.3f %8.2fx\n", n, steps, aos_ms * to_ns, soa_ms * to_ns, aos_ms / soa_ms);
+
+		for (Entity e : entities)
+			Entity::allocator().release(e);
+	}
+	return 0;
+}
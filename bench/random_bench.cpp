@@ -0,0 +1,66 @@
+// Benchmark for the random numbers of a particle burst.
+// Compares the previous pattern (a std::random_device and std::mt19937 constructed for every burst, one distribution
+// call per number) against a long-lived Rng stream, drawn one number at a time and as one batch.
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "random.hpp"
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+int main()
+{
+	const int bursts = 20000;
+	const size_t burst_size = 64;	// two offsets each for 32 particles
+	std::vector<float> values(burst_size);
+	float sink = 0.f;
+
+	auto start = bench_clock::now();
+	for (int b = 0; b < bursts; b++) {
+		std::random_device device;
+		std::mt19937 engine(device());
+		std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+		for (size_t i = 0; i < burst_size; i++)
+			values[i] = offset(engine);
+		sink += values[b % burst_size];
+	}
+	double per_burst_engine = elapsed_ms(start);
+
+	Rng rng(42);
+	start = bench_clock::now();
+	for (int b = 0; b < bursts; b++) {
+		for (size_t i = 0; i < burst_size; i++)
+			values[i] = rng.uniform(-0.1f, 0.1f);
+		sink += values[b % burst_size];
+	}
+	double stream_single = elapsed_ms(start);
+
+	start = bench_clock::now();
+	for (int b = 0; b < bursts; b++) {
+		rng.uniform(values.data(), burst_size, -0.1f, 0.1f);
+		sink += values[b % burst_size];
+	}
+	double stream_batched = elapsed_ms(start);
+
+	start = bench_clock::now();
+	for (int b = 0; b < bursts; b++) {
+		rng.normal(values.data(), burst_size, 0.f, 0.1f);
+		sink += values[b % burst_size];
+	}
+	double stream_normal = elapsed_ms(start);
+
+	printf("%d bursts of %zu numbers\n", bursts, burst_size);
+	printf("random_device + mt19937 per burst: %8.2f ms\n", per_burst_engine);
+	printf("Rng stream, one at a time:         %8.2f ms\n", stream_single);
+	printf("Rng stream, batched uniform:       %8.2f ms\n", stream_batched);
+	printf("Rng stream, batched normal:        %8.2f ms\n", stream_normal);
+	printf("(%f)\n", sink);
+	return 0;
+}
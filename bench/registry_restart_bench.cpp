@@ -0,0 +1,88 @@
+// Benchmark for ECSRegistry::remove_all_components_of on a restart-sized world.
+// Compares visiting every container (the old behaviour) against visiting only the
+// containers in each entity's component signature.
+#include <chrono>
+#include <cstdio>
+
+#include "tiny_ecs_registry.hpp"
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// Restart-sized: 196x196 static entities (as many as terrain tiles used to be), colliders on every 7th, mobs and UI
+static void populate(ECSRegistry& ecs)
+{
+	std::vector<Entity> tiles = Entity::create_range(196 * 196);
+	for (unsigned int i = 0; i < tiles.size(); i++) {
+		ecs.motions.emplace(tiles[i]);
+		if (i % 7 == 0)
+			ecs.colliders.emplace(tiles[i]);
+	}
+
+	for (int i = 0; i < 80; i++) {
+		Entity mob;
+		ecs.meshPtrs.emplace(mob, nullptr);
+		ecs.motions.emplace(mob);
+		ecs.paths.emplace(mob);
+		ecs.mobs.emplace(mob);
+		ecs.colliders.emplace(mob);
+		ecs.animations.emplace(mob);
+		ecs.renderRequests.insert(mob, {});
+
+		Entity health_bar;
+		ecs.meshPtrs.emplace(health_bar, nullptr);
+		ecs.motions.emplace(health_bar);
+		ecs.renderRequests.insert(health_bar, {});
+	}
+
+	for (int i = 0; i < 40; i++) {
+		Entity ui;
+		ecs.motions.emplace(ui);
+		ecs.screenUI.insert(ui, vec2(0.f));
+		ecs.colors.insert(ui, vec4(1.f));
+		ecs.renderRequests.insert(ui, {});
+	}
+}
+
+int main()
+{
+	const int runs = 5;
+	double all_containers_ms = 0;
+	double signature_ms = 0;
+
+	for (int run = 0; run < runs; run++) {
+		// Old behaviour: every container is asked to remove the entity
+		{
+			std::unique_ptr<ECSRegistry> ecs(new ECSRegistry());
+			populate(*ecs);
+			auto start = bench_clock::now();
+			while (ecs->motions.entities.size() > 0) {
+				Entity e = ecs->motions.entities.back();
+				ecs->for_each_container([&](ContainerInterface& container) { container.remove(e); });
+				Entity::allocator().release(e);
+			}
+			all_containers_ms += elapsed_ms(start);
+		}
+
+		// Signature-driven removal, as done by restart_game and load_game
+		{
+			std::unique_ptr<ECSRegistry> ecs(new ECSRegistry());
+			populate(*ecs);
+			auto start = bench_clock::now();
+			while (ecs->motions.entities.size() > 0)
+				ecs->remove_all_components_of(ecs->motions.entities.back());
+			signature_ms += elapsed_ms(start);
+		}
+	}
+
+	printf("Restart teardown of %d motion entities, average of %d runs\n", 196 * 196 + 200, runs);
+	printf("%-22s %10.3f ms\n", "all containers", all_containers_ms / runs);
+	printf("%-22s %10.3f ms\n", "component signature", signature_ms / runs);
+	printf("%-22s %9.2fx\n", "speedup", all_containers_ms / signature_ms);
+	printf("entity indices in use after %d restarts: %zu\n", runs * 2, Entity::allocator().capacity());
+	return 0;
+}
@@ -0,0 +1,118 @@
+// Benchmark for sorting the Motion container by the Morton code of position.
+// Compares the previous out-of-place sort (moving every component into a new array) against the in-place
+// permutation of ComponentContainer::sort with the same comparison, shows sort_by_key (one key per entity instead
+// of two per comparison), and measures the per-frame cost of sort_by_key_step.
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "tiny_ecs_registry.hpp"
+
+using bench_clock = std::chrono::high_resolution_clock;
+
+static double elapsed_ms(bench_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+}
+
+// The 196x196 terrain plus 200 entities spread over it, inserted in random order
+static void populate(ECSRegistry& ecs, std::mt19937& rng)
+{
+	std::vector<vec2> positions;
+	for (int i = 0; i < 196 * 196; i++)
+		positions.push_back(vec2(i % 196, i / 196));
+	std::uniform_real_distribution<float> coordinate(0.f, 196.f);
+	for (int i = 0; i < 200; i++)
+		positions.push_back(vec2(coordinate(rng), coordinate(rng)));
+	std::shuffle(positions.begin(), positions.end(), rng);
+
+	for (vec2 position : positions)
+		ecs.motions.emplace(Entity()).position = position;
+}
+
+// The previous ComponentContainer::sort: sort the entities, then move every component into a new array
+template <class Compare>
+static void sort_out_of_place(std::vector<Motion>& components, std::vector<Entity>& entities, std::vector<unsigned int>& sparse, Compare compare)
+{
+	std::sort(entities.begin(), entities.end(), compare);
+	std::vector<Motion> components_new;
+	components_new.reserve(components.size());
+	for (Entity e : entities)
+		components_new.push_back(std::move(components[sparse[e.index()]]));
+	components = std::move(components_new);
+	for (unsigned int i = 0; i < entities.size(); i++)
+		sparse[entities[i].index()] = i;
+}
+
+int main()
+{
+	const int runs = 5;
+	const int frames = 1000;
+	std::mt19937 rng(42);
+	double out_of_place_ms = 0, in_place_ms = 0, by_key_ms = 0, step_ms = 0;
+	bool sorted = true;
+
+	for (int run = 0; run < runs; run++) {
+		// Two registries with the same entities in the same order
+		std::mt19937 rng_copy = rng;
+		std::unique_ptr<ECSRegistry> ecs(new ECSRegistry());
+		std::unique_ptr<ECSRegistry> ecs_by_key(new ECSRegistry());
+		populate(*ecs, rng);
+		populate(*ecs_by_key, rng_copy);
+		auto key = [&](Entity e) { return ECSRegistry::morton_code(ecs->motions.get(e).position); };
+		auto compare = [&](Entity a, Entity b) { return key(a) < key(b); };
+
+		// Baseline on a plain copy of the same data, comparing with the same keys
+		std::vector<Motion> components;
+		std::vector<Entity> entities = ecs->motions.entities;
+		std::vector<unsigned int> sparse(Entity::allocator().capacity());
+		for (unsigned int i = 0; i < entities.size(); i++) {
+			components.push_back(ecs->motions.components[i]);
+			sparse[entities[i].index()] = i;
+		}
+		auto start = bench_clock::now();
+		sort_out_of_place(components, entities, sparse, compare);
+		out_of_place_ms += elapsed_ms(start);
+
+		start = bench_clock::now();
+		ecs->motions.sort(compare);
+		in_place_ms += elapsed_ms(start);
+
+		start = bench_clock::now();
+		ecs_by_key->motions.sort_by_key([&](Entity e) { return ECSRegistry::morton_code(ecs_by_key->motions.get(e).position); });
+		by_key_ms += elapsed_ms(start);
+		ecs_by_key->clear_all_components();
+
+		// Give the loose entities a velocity and keep the order with a bounded step per frame
+		std::vector<Entity> movers(ecs->motions.entities.end() - 200, ecs->motions.entities.end());
+		for (Entity e : movers)
+			ecs->motions.get(e).velocity = vec2(2.f, 1.f);
+		for (int frame = 0; frame < frames; frame++) {
+			for (Entity e : movers) {
+				MotionRef motion = ecs->motions.get(e);
+				motion.position += motion.velocity * 0.016f;
+			}
+			start = bench_clock::now();
+			ecs->motions.sort_by_key_step(key, ECSRegistry::SPATIAL_SORT_BUDGET);
+			step_ms += elapsed_ms(start);
+		}
+
+		// Finish the pass and check the order
+		while (!ecs->motions.sort_by_key_step(key, ECSRegistry::SPATIAL_SORT_BUDGET)) {}
+		for (unsigned int i = 1; i < ecs->motions.size(); i++)
+			sorted = sorted && !(key(ecs->motions.entities[i]) < key(ecs->motions.entities[i - 1]));
+		ecs->clear_all_components();
+	}
+
+	if (!sorted) {
+		printf("motions are not in Morton order after the incremental sort\n");
+		return 1;
+	}
+
+	printf("Morton sort of %d motions, average of %d runs\n", 196 * 196 + 200, runs);
+	printf("%-28s %10.3f ms\n", "out of place (previous)", out_of_place_ms / runs);
+	printf("%-28s %10.3f ms\n", "in place permutation", in_place_ms / runs);
+	printf("%-28s %10.3f ms\n", "in place, sort_by_key", by_key_ms / runs);
+	printf("%-28s %10.3f ms\n", "incremental step per frame", step_ms / (runs * frames));
+	return 0;
+}
@@ -42,4 +42,33 @@ void AudioSystem::init() {
 	Mix_PlayMusic(music[MUSIC], -1);
 	Mix_VolumeMusic(volumes[MUSIC]);
 	fprintf(stderr, "Loaded music\n");
-}
\ No newline at end of file
+}
+
+AudioSystem::~AudioSystem() {
+	for (auto& m : music) {
+		Mix_FreeMusic(m.second);
+	}
+
+	for (auto& m : chunks) {
+		Mix_FreeChunk(m.second);
+	}
+	Mix_CloseAudio();
+}
+
+int AudioSystem::next_random_channel() {
+	current_random_channel++;
+	if (current_random_channel >= NUM_CHANNELS)
+		current_random_channel = MOB_HIT_CHANNEL + 1;	// Skip the mob hurt channel
+	Mix_HaltChannel(current_random_channel);
+	return current_random_channel;
+}
+
+void AudioSystem::play_one_shot(AUDIO id) {
+	bool is_music = music_paths.count(id);
+	if (is_music)
+		Mix_PlayMusic(music[id], 0);
+	else {
+		int channel = id == MOB_HIT ? MOB_HIT_CHANNEL : next_random_channel();	// Divert MOB_HIT calls to dedicated channel
+		Mix_PlayChannel(channel, chunks[id], 0);
+	}
+}
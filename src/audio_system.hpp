@@ -109,42 +109,19 @@ private:
 	/// This ensures that sound effects do not prematurely end each other.
 	/// </summary>
 	/// <returns>Channel number</returns>
-	int next_random_channel() {
-		current_random_channel++;
-		if (current_random_channel >= NUM_CHANNELS)
-			current_random_channel = MOB_HIT_CHANNEL + 1;	// Skip the mob hurt channel
-		Mix_HaltChannel(current_random_channel);
-		return current_random_channel;
-	}
+	int next_random_channel();
 
 public: 
 
+	// Defined in audio_system.cpp, or as no-ops in the headless build (src/headless/), which plays no sound
 	void init();
 
-	~AudioSystem() {
-		for (auto& m : music) {
-			Mix_FreeMusic(m.second);
-		}
-
-		for (auto& m : chunks) {
-			Mix_FreeChunk(m.second);
-		}
-		Mix_CloseAudio();
-	}
+	~AudioSystem();
 
 	/// <summary>
 	/// Plays a given sound. Supports instantaneous playment of music, but not recommended.
 	/// </summary>
 	/// <param name="id">Audio ID of the sound</param>
-	void play_one_shot(AUDIO id) {
-		bool is_music = music_paths.count(id);
-		if (is_music)
-			Mix_PlayMusic(music[id], 0);
-		else {
-			int channel = id == MOB_HIT ? MOB_HIT_CHANNEL : next_random_channel();	// Divert MOB_HIT calls to dedicated channel
-			Mix_PlayChannel(channel, chunks[id], 0);
-		}
-			
-	};
+	void play_one_shot(AUDIO id);
 
 };
\ No newline at end of file
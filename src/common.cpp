@@ -24,43 +24,16 @@ void Transform::translate(vec2 offset)
 	mat = mat * T;
 }
 
-bool gl_has_errors()
+unsigned int FixedTimestep::advance(float elapsed_ms)
 {
-	// TODO: Uncomment for debugging. Find out how to not let this compile w/ CMake release builds.
-
-	
-	GLenum error = glGetError();
-
-	if (error == GL_NO_ERROR) return false;
-
-	while (error != GL_NO_ERROR)
-	{
-		const char* error_str = "";
-		switch (error)
-		{
-		case GL_INVALID_OPERATION:
-			error_str = "INVALID_OPERATION";
-			break;
-		case GL_INVALID_ENUM:
-			error_str = "INVALID_ENUM";
-			break;
-		case GL_INVALID_VALUE:
-			error_str = "INVALID_VALUE";
-			break;
-		case GL_OUT_OF_MEMORY:
-			error_str = "OUT_OF_MEMORY";
-			break;
-		case GL_INVALID_FRAMEBUFFER_OPERATION:
-			error_str = "INVALID_FRAMEBUFFER_OPERATION";
-			break;
-		}
-
-		fprintf(stderr, "OpenGL: %s", error_str);
-		error = glGetError();
-		assert(false);
+	accumulator_ms += elapsed_ms;
+	unsigned int ticks = (unsigned int)(accumulator_ms / tick_ms);
+	if (ticks > max_ticks_per_frame) {
+		ticks = max_ticks_per_frame;
+		accumulator_ms = fmodf(accumulator_ms, tick_ms);
 	}
-
-	return true;
-	
-	//return false;
-}
\ No newline at end of file
+	else {
+		accumulator_ms = std::max(0.f, accumulator_ms - ticks * tick_ms);
+	}
+	return ticks;
+}
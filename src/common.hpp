@@ -32,7 +32,7 @@ using namespace glm;
 
 const std::string map_ext = "smap";
 const std::string loaded_map_name = "test";
-const unsigned int savefile_version = 1;
+const unsigned int savefile_version = 3;		// see map_file.hpp
 
 inline std::string data_path() { return std::string(PROJECT_SOURCE_DIR) + "data"; };
 inline std::string shader_path(const std::string& name) {return std::string(PROJECT_SOURCE_DIR) + "/shaders/" + name;};
@@ -84,6 +84,21 @@ struct Transform {
 
 bool gl_has_errors();
 
+// Turns the variable time between frames into a whole number of fixed simulation ticks, so that the systems always
+// advance by tick_ms no matter the frame rate. What is left over carries into the next frame.
+struct FixedTimestep
+{
+	float tick_ms = 1000.f / 60.f;
+	unsigned int max_ticks_per_frame = 5;	// after a longer stall the extra time is dropped instead of caught up
+	float accumulator_ms = 0.f;
+
+	// Adds the time of a frame and returns the number of ticks to simulate for it
+	unsigned int advance(float elapsed_ms);
+
+	// How far the time left over is into the next tick, from 0 to 1, to interpolate what is drawn
+	float alpha() const { return accumulator_ms / tick_ms; }
+};
+
 template <typename T>
 void write_to_file(std::ofstream& file, T& data);
 
@@ -150,7 +150,7 @@ struct Spaceship {
 // The projectile
 struct Projectile {
 	int damage;
-	Entity weapon; // link the projectile to the weapon
+	Entity weapon = Entity::null(); // link the projectile to the weapon
 };
 
 enum class MOB_TYPE {
@@ -168,9 +168,9 @@ struct Mob {
 	int aggro_range;
 	int health;
 	float speed_ratio;
-	Entity curr_cell;
+	int curr_cell = -1;		// index of the terrain cell the mob is in, see TerrainSystem::get_cell
 	MOB_TYPE type;
-	Entity health_bar;
+	Entity health_bar = Entity::null();
 };
 
 // Slowing effect for mobs from weapons
@@ -184,7 +184,7 @@ struct MobSlowEffect {
 
 // Structure to store the path for a mob
 struct Path {
-	std::deque<Entity> path;
+	std::deque<int> path;	// terrain cell indices
 };
 
 struct Item {
@@ -199,6 +199,54 @@ struct Motion {
 	vec2 scale = { 1.f, 1.f };
 };
 
+// Motion is stored as a struct of arrays, so that PhysicsSystem::integrate moves positions with a straight loop over two arrays.
+// registry.motions.get(e) returns a MotionRef, which is used like a Motion&
+template <>
+struct SoALayout<Motion>
+{
+	static constexpr bool enabled = true;
+	enum { POSITION, ANGLE, VELOCITY, SCALE };
+	typedef std::tuple<vec2, float, vec2, vec2> fields;
+
+	struct reference
+	{
+		vec2& position;
+		float& angle;
+		vec2& velocity;
+		vec2& scale;
+
+		reference& operator=(const reference& m) {
+			position = m.position;
+			angle = m.angle;
+			velocity = m.velocity;
+			scale = m.scale;
+			return *this;
+		}
+
+		reference& operator=(const Motion& m) {
+			position = m.position;
+			angle = m.angle;
+			velocity = m.velocity;
+			scale = m.scale;
+			return *this;
+		}
+
+		operator Motion() const {
+			Motion m;
+			m.position = position;
+			m.angle = angle;
+			m.velocity = velocity;
+			m.scale = scale;
+			return m;
+		}
+	};
+
+	static fields split(Motion&& m) {
+		return fields(m.position, m.angle, m.velocity, m.scale);
+	}
+};
+typedef SoALayout<Motion>::reference MotionRef;
+
 // Stucture to store collision information
 struct Collision
 {
@@ -206,9 +254,16 @@ struct Collision
 	Entity other_entity; // the second object involved in the collision
 	vec2 MTV; // minimal translation vector for collision resolution
 	float overlap; // magnitude of collision depth
+	int terrain_cell = -1; // index of the terrain tile when the second object is the terrain, other_entity is Entity::null() then
+
+	Collision(Entity& other_entity, float overlap, vec2 MTV) : other_entity(other_entity) { 
+		this->overlap = overlap;
+		this->MTV = MTV;
+		};
 
-	Collision(Entity& other_entity, float overlap, vec2 MTV) { 
-		this->other_entity = other_entity;
+	// Collision with a terrain tile, tiles are not entities
+	Collision(int terrain_cell, float overlap, vec2 MTV) : other_entity(Entity::null()) {
+		this->terrain_cell = terrain_cell;
 		this->overlap = overlap;
 		this->MTV = MTV;
 		};
@@ -347,6 +402,19 @@ struct TerrainCell
 	}
 };
 
+/// <summary>
+/// World position of the cell with the given index in a size_x by size_y terrain grid, which is centred on the origin.
+/// Tiles are not entities, see TerrainSystem::get_cell_position.
+/// </summary>
+inline vec2 terrain_cell_position(int index, int size_x, int size_y) {
+	return { (index % size_x) - size_x / 2,
+			index / size_x - size_y / 2 };
+}
+
+// The terrain is stored, streamed and drawn in square chunks of this many cells per side, see TerrainSystem::stream
+const int TERRAIN_CHUNK_SIZE = 32;
+const int TERRAIN_CHUNK_CELLS = TERRAIN_CHUNK_SIZE * TERRAIN_CHUNK_SIZE;
+
 // component for entity that have collision, size is the width/height of bounding box
 struct Collider
 {
@@ -358,6 +426,76 @@ struct Collider
 	int flag;  // for filtering 
 };
 
+// Collider is stored as a struct of arrays, so the AABB tests of the BVH only touch position and scale and the
+// per-collider point and normal vectors live apart. registry.colliders.get(e) returns a ColliderRef, which is used like a Collider&
+template <>
+struct SoALayout<Collider>
+{
+	static constexpr bool enabled = true;
+	enum { POSITION, POINTS, NORMALS, ROTATION, SCALE, FLAG };
+	typedef std::tuple<vec2, std::vector<vec2>, std::vector<vec2>, mat2, vec2, int> fields;
+
+	struct reference
+	{
+		vec2& position;
+		std::vector<vec2>& points;
+		std::vector<vec2>& normals;
+		mat2& rotation;
+		vec2& scale;
+		int& flag;
+
+		// Copies the handle, not the collider (declared since the move assignment below would delete it)
+		reference(const reference&) = default;
+
+		reference& operator=(const reference& c) {
+			position = c.position;
+			points = c.points;
+			normals = c.normals;
+			rotation = c.rotation;
+			scale = c.scale;
+			flag = c.flag;
+			return *this;
+		}
+
+		// Moves the point and normal vectors, used when the container packs its arrays
+		reference& operator=(reference&& c) {
+			position = c.position;
+			points = std::move(c.points);
+			normals = std::move(c.normals);
+			rotation = c.rotation;
+			scale = c.scale;
+			flag = c.flag;
+			return *this;
+		}
+
+		reference& operator=(const Collider& c) {
+			position = c.position;
+			points = c.points;
+			normals = c.normals;
+			rotation = c.rotation;
+			scale = c.scale;
+			flag = c.flag;
+			return *this;
+		}
+
+		operator Collider() const {
+			Collider c;
+			c.position = position;
+			c.points = points;
+			c.normals = normals;
+			c.rotation = rotation;
+			c.scale = scale;
+			c.flag = flag;
+			return c;
+		}
+	};
+
+	static fields split(Collider&& c) {
+		return fields(c.position, std::move(c.points), std::move(c.normals), c.rotation, c.scale, c.flag);
+	}
+};
+typedef SoALayout<Collider>::reference ColliderRef;
+
 // component for entity using sprite sheet animation
 struct Animation {
 	int framex = 0; // row index on the sprite from sprite sheet
@@ -566,8 +704,7 @@ struct ParticleTemplate {
 
 struct PointingArrow {
 
-	PointingArrow(Entity target) {
-		this->target = target;
+	PointingArrow(Entity target) : target(target) {
 	}
 
 	Entity target;
@@ -0,0 +1,17 @@
+// internal
+#include "audio_system.hpp"
+
+// Stand-in for audio_system.cpp in the headless build. There is no audio device, so nothing is loaded or played and
+// SDL_mixer is never linked.
+
+void AudioSystem::init()
+{
+}
+
+AudioSystem::~AudioSystem()
+{
+}
+
+void AudioSystem::play_one_shot(AUDIO id)
+{
+}
@@ -0,0 +1,79 @@
+// stlib
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+// internal
+#include "world_batch.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
+
+// Runs the simulation of the game without a window, GL or audio, e.g. for profiling and soak runs on machines
+// without a GPU: "stranded_headless --ticks 3600 --worlds 1 --threads 1 --jobs 4 --seed 1 --tick-rate 60".
+// "--trace trace.json" saves what the profiler recorded at the end (needs -DENABLE_PROFILER=ON), and
+// "--metrics metrics.json" the metrics of all worlds (see MetricsReporter).
+// "--map-size 4096" plays on a generated map of that size instead of the loaded map.
+// A scripted player drives the worlds (see run_world_batch) and the result is reported in ticks per second.
+int main(int argc, char* argv[])
+{
+	WorldBatchConfig config;
+	config.worlds = 1;
+	config.frames = 3600;
+	unsigned int tick_rate = 60;
+	std::string trace_path;
+	std::string metrics_path;
+	Profiler::set_thread_name("main");
+
+	for (int i = 1; i + 1 < argc; i += 2) {
+		unsigned int value = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+		if (strcmp(argv[i], "--ticks") == 0)
+			config.frames = value;
+		else if (strcmp(argv[i], "--worlds") == 0)
+			config.worlds = std::max(1u, value);
+		else if (strcmp(argv[i], "--threads") == 0)
+			config.threads = value;
+		else if (strcmp(argv[i], "--jobs") == 0)
+			config.jobs = value;
+		else if (strcmp(argv[i], "--seed") == 0)
+			config.seed = value;
+		else if (strcmp(argv[i], "--tick-rate") == 0)
+			tick_rate = std::max(1u, value);
+		else if (strcmp(argv[i], "--trace") == 0)
+			trace_path = argv[i + 1];
+		else if (strcmp(argv[i], "--metrics") == 0)
+			metrics_path = argv[i + 1];
+		else if (strcmp(argv[i], "--map-size") == 0)
+			config.map_size = value;
+		else
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+	}
+	config.frame_ms = 1000.f / tick_rate;
+
+	// The rates of the counters are over the whole run
+	MetricsReporter metrics;
+	bool report_metrics = !metrics_path.empty() && metrics.open(metrics_path, 1000.f);
+
+	WorldBatchResult result = run_world_batch(config);
+	print_world_batch_result(config, result);
+
+	double simulation_ms = 0;
+	for (const WorldBatchWorldResult& world : result.worlds)
+		simulation_ms += world.simulation_ms;
+	printf("%u ticks of %.2f ms per world: %.0f ticks per second per world, %.0f in total\n",
+		config.frames, config.frame_ms,
+		simulation_ms > 0 ? (double)config.frames * config.worlds / (simulation_ms / 1000.0) : 0.0,
+		result.frames_per_second);
+
+	if (report_metrics)
+		metrics.report();
+	if (!trace_path.empty()) {
+		if (Profiler::compiled_in())
+			Profiler::write_chrome_trace(trace_path);
+		else
+			fprintf(stderr, "The profiler is not compiled in, build with -DENABLE_PROFILER=ON to write %s\n",
+				trace_path.c_str());
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+// internal
+#include "render_system.hpp"
+
+// Stand-in for the GL half of the render system (render_system.cpp, render_system_init.cpp) in the headless build.
+// The renderer only holds the meshes the colliders are made from (see render_system_shared.cpp) and the size of
+// the window the input is played in, so nothing is drawn and there are no GL resources to manage.
+
+bool gl_has_errors()
+{
+	return false;
+}
+
+bool RenderSystem::init(GLFWwindow* window_arg, const ivec2 window_size)
+{
+	this->window = window_arg;
+	window_resolution = window_size;
+	screen_to_window_correction = { 1, 1 };
+
+	// WorldSystem darkens the screen while the player dies, as it would with a window
+	registry.screenStates.emplace(screen_state_entity);
+
+	loadColliderMeshes();
+	return true;
+}
+
+RenderSystem::~RenderSystem()
+{
+	// remove all entities created by the render system
+	while (registry.renderRequests.entities.size() > 0)
+		registry.remove_all_components_of(registry.renderRequests.entities.back());
+}
+
+void RenderSystem::loadTerrainChunk(int chunk, const std::vector<TerrainTile>& tiles)
+{
+	// Nothing is drawn, the terrain only needs to know which chunks are active
+}
+
+void RenderSystem::unloadTerrainChunk(int chunk)
+{
+}
+
+void RenderSystem::changeTerrainData(int chunk, unsigned int i, vec2 position, TerrainCell& data, uint8_t frameValue)
+{
+}
+
+void RenderSystem::empty_terrain_buffer()
+{
+}
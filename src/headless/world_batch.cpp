@@ -0,0 +1,364 @@
+#include "world_batch.hpp"
+
+// stlib
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+// internal
+#include "world_system.hpp"
+#include "physics_system.hpp"
+#include "render_system.hpp"
+#include "terrain_system.hpp"
+#include "pathfinding_system.hpp"
+#include "weapons_system.hpp"
+#include "particle_system.hpp"
+#include "powerup_system.hpp"
+#include "mob_system.hpp"
+#include "audio_system.hpp"
+#include "spaceship_home_system.hpp"
+#include "quest_system.hpp"
+#include "tutorial_system.hpp"
+#include "system_scheduler.hpp"
+#include "input_log.hpp"
+#include "profiler.hpp"
+
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+	// Frames between two changes of direction, and between two shots, of the scripted player
+	const unsigned int WANDER_FRAMES = 90;
+	const unsigned int SHOOT_FRAMES = 20;
+
+	// Plenty of ammo, so the scripted player never runs out
+	const int BATCH_AMMO = 100000;
+
+	// Distance from the middle of the window, where the player is, at which the scripted player points the mouse
+	const float AIM_DISTANCE_PX = 100.f;
+
+	// One world of a batch: its own registry and all systems of the game, set up and scheduled as in main.cpp.
+	// The window, renderer and audio are the stubs in src/headless/, and a scripted player plays the game through
+	// WorldSystem's input.
+	class BatchWorld
+	{
+	public:
+		BatchWorld(unsigned int seed, JobSystem& jobs, unsigned int map_size);
+
+		// One frame: the input of the scripted player, then the systems as scheduled in the main loop
+		void step(float elapsed_ms);
+
+		uint64_t state_hash() { return hash_world_state(registry); }
+
+		WorldBatchWorldResult result;
+
+	private:
+		// Declared first, so it outlives the systems that clean up after themselves
+		ECSRegistry registry;
+
+		WorldSystem world;
+		RenderSystem renderer;
+		PhysicsSystem physics;
+		TerrainSystem terrain;
+		PathfindingSystem pathfinding;
+		WeaponsSystem weapons;
+		ParticleSystem particles;
+		MobSystem mobs;
+		AudioSystem audio;
+		SpaceshipHomeSystem spaceship_home;
+		QuestSystem quests;
+		TutorialSystem tutorial;
+		PowerupSystem powerups;
+		SystemScheduler scheduler;
+
+		// The game is paused while the player is in the spaceship home or the help dialog is open
+		bool paused = false;
+
+		// The numbers of the scripted player, apart from the world's, so that the world draws the same ones as a
+		// game with the same seed
+		Rng script_random;
+
+		// The player of the current game, restarting makes a new one
+		Entity player = Entity::null();
+		std::vector<int> held_keys;
+		unsigned int frame = 0;
+
+		// The scripted player: closes the help dialog, restarts after dying, and otherwise wanders around and
+		// shoots at the closest mob
+		void play();
+		void start_game();
+		void wander();
+		void shoot();
+
+		void press(int key);
+		void release(int key);
+		void tap(int key);
+		void click(vec2 position);
+	};
+
+	BatchWorld::BatchWorld(unsigned int seed, JobSystem& jobs, unsigned int map_size)
+		: world(registry)
+		, renderer(registry)
+		, physics(registry)
+		, terrain(registry)
+		, pathfinding(registry)
+		, weapons(registry)
+		, particles(registry)
+		, mobs(registry)
+		, spaceship_home(registry)
+		, quests(registry)
+		, tutorial(registry)
+		, powerups(registry)
+		, script_random(seed)
+	{
+		result.seed = seed;
+		registry.jobs = &jobs;
+		registry.random.set_seed(seed);
+
+		// Same order as in main.cpp, without the start screen
+		audio.init();
+		renderer.init(nullptr, target_resolution);
+		weapons.init(&renderer, &physics, &powerups);
+		powerups.init(&renderer, &particles);
+		particles.init(&renderer);
+		mobs.init(&renderer, &terrain, &physics);
+		quests.init(&renderer);
+		spaceship_home.init(&renderer, &weapons, &quests);
+		tutorial.init(&renderer);
+		world.set_map_size(map_size);
+		world.init(&renderer, &terrain, &weapons, &physics, &mobs, &audio, &spaceship_home, &quests, &tutorial,
+			&particles, &powerups);
+		pathfinding.init(&terrain, &powerups);
+
+		// Same declarations as in main.cpp
+		auto playing = [this]() { return !paused; };
+		scheduler.add("spaceship home", [this](float ms) { spaceship_home.step(ms); }).when([this]() { return paused; }).exclusive();
+		scheduler.add("world", [this](float ms) { world.step(ms); }).when(playing).exclusive();
+		scheduler.add("physics", [this](float ms) { physics.step(ms); }).when(playing).exclusive();
+		scheduler.add("terrain", [this](float ms) { terrain.step(ms); }).when(playing)
+			.reads<Player, Motion>()
+			.writes_state(&terrain);
+		scheduler.add("pathfinding", [this](float ms) { pathfinding.step(ms); }).when(playing)
+			.reads<Player>()
+			.writes<Mob, Path, Motion, MobSlowEffect, Animation>()
+			.reads_state(&terrain)
+			.reads_state(&powerups);
+		scheduler.add("weapons", [this](float ms) { weapons.step(ms); }).when(playing)
+			.writes<Weapon>()
+			.reads_state(&powerups);
+		scheduler.add("mobs", [this](float ms) { mobs.step(ms); }).when(playing)
+			.writes<Mob>()
+			.writes_state(&mobs);
+		scheduler.add("quests", [this](float ms) { quests.step(ms); }).when(playing)
+			.writes<QuestItemIndicator>()
+			.writes_state(&quests);
+		scheduler.add("collisions", [this](float) { world.handle_collisions(); }).when(playing).exclusive();
+		scheduler.add("particles", [this](float ms) { particles.step(ms); }).when(playing)
+			.writes<Particle, vec4, Motion>();
+		scheduler.add("powerups", [this](float ms) { powerups.step(ms); }).when(playing).exclusive();
+		scheduler.add("tutorial", [this](float ms) { tutorial.step(ms); }).exclusive();
+	}
+
+	void BatchWorld::step(float elapsed_ms)
+	{
+		PROFILE_SCOPE("tick");
+		play();
+
+		// Mobs only die in the collisions, and are only spawned when a game starts
+		size_t mobs_alive = registry.mobs.size();
+
+		paused = spaceship_home.isHome() || tutorial.isHelpDialogOpen();
+		scheduler.run(elapsed_ms, *registry.jobs);
+
+		registry.flush_commands();
+		registry.sort_spatially_step(ECSRegistry::SPATIAL_SORT_BUDGET);
+		registry.clear_changes();
+
+		if (registry.mobs.size() < mobs_alive)
+			result.mobs_killed += (unsigned int)(mobs_alive - registry.mobs.size());
+		frame++;
+	}
+
+	void BatchWorld::play()
+	{
+		if (registry.players.entities[0] != player)
+			start_game();
+
+		// The help dialog opens with every game and pauses it
+		if (tutorial.isHelpDialogOpen()) {
+			tap(GLFW_KEY_ESCAPE);
+			return;
+		}
+
+		// Restart once the death screen is up
+		if (registry.deathTimers.has(player)) {
+			if (registry.deathTimers.get(player).timer_ms < 0)
+				tap(GLFW_KEY_R);
+			return;
+		}
+
+		if (frame % WANDER_FRAMES == 0)
+			wander();
+		if (frame % SHOOT_FRAMES == 0)
+			shoot();
+	}
+
+	void BatchWorld::start_game()
+	{
+		player = registry.players.entities[0];
+		held_keys.clear();
+		result.games++;
+		result.mobs_spawned += (unsigned int)registry.mobs.size();
+
+		// A crossbow the scripted player starts with, instead of looking for weapons
+		weapons.setWeaponAttributes(ITEM_TYPE::WEAPON_CROSSBOW, true, BATCH_AMMO, 1);
+		tap(GLFW_KEY_2);
+	}
+
+	void BatchWorld::wander()
+	{
+		// One of A and D, one of W and S, or neither: eight directions or standing still
+		for (int key : held_keys)
+			release(key);
+		held_keys.clear();
+
+		const int horizontal[] = { 0, GLFW_KEY_A, GLFW_KEY_D };
+		const int vertical[] = { 0, GLFW_KEY_W, GLFW_KEY_S };
+		for (int key : { horizontal[script_random.uniform_int(0, 2)], vertical[script_random.uniform_int(0, 2)] }) {
+			if (key != 0) {
+				press(key);
+				held_keys.push_back(key);
+			}
+		}
+	}
+
+	void BatchWorld::shoot()
+	{
+		vec2 position = registry.motions.get(player).position;
+
+		// Aim at the closest mob, or anywhere if they are all dead
+		float angle = script_random.uniform(0.f, 2.f * M_PI);
+		float closest = INFINITY;
+		for (Entity mob : registry.mobs.entities) {
+			vec2 offset = registry.motions.get(mob).position - position;
+			float distance = dot(offset, offset);
+			if (distance < closest) {
+				closest = distance;
+				angle = atan2(offset.y, offset.x);
+			}
+		}
+
+		// The player is in the middle of the window
+		size_t projectiles = registry.projectiles.size();
+		click(vec2(renderer.window_resolution) / 2.f + AIM_DISTANCE_PX * vec2(cos(angle), sin(angle)));
+		result.shots_fired += (unsigned int)(registry.projectiles.size() - projectiles);
+	}
+
+	void BatchWorld::press(int key)
+	{
+		InputEvent event;
+		event.type = InputEvent::KEY;
+		event.key = key;
+		event.action = GLFW_PRESS;
+		world.play_input(event);
+	}
+
+	void BatchWorld::release(int key)
+	{
+		InputEvent event;
+		event.type = InputEvent::KEY;
+		event.key = key;
+		event.action = GLFW_RELEASE;
+		world.play_input(event);
+	}
+
+	void BatchWorld::tap(int key)
+	{
+		press(key);
+		release(key);
+	}
+
+	void BatchWorld::click(vec2 position)
+	{
+		InputEvent event;
+		event.type = InputEvent::MOUSE_MOVE;
+		event.position = position;
+		world.play_input(event);
+
+		event.type = InputEvent::MOUSE_CLICK;
+		event.key = GLFW_MOUSE_BUTTON_LEFT;
+		event.action = GLFW_PRESS;
+		world.play_input(event);
+		event.action = GLFW_RELEASE;
+		world.play_input(event);
+	}
+
+	// Builds, runs and tears down one world on the calling thread
+	WorldBatchWorldResult simulate_world(unsigned int seed, unsigned int frames, float frame_ms, unsigned int map_size, JobSystem& jobs)
+	{
+		// The entities of this world, including the ones the systems create in their constructors,
+		// get their ids from an allocator of its own
+		EntityAllocator entities;
+		EntityAllocator::Binding binding(entities);
+
+		std::unique_ptr<BatchWorld> world(new BatchWorld(seed, jobs, map_size));
+
+		auto start = Clock::now();
+		for (unsigned int frame = 0; frame < frames; frame++)
+			world->step(frame_ms);
+		world->result.simulation_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		world->result.state_hash = world->state_hash();
+
+		return world->result;
+	}
+}
+
+WorldBatchResult run_world_batch(const WorldBatchConfig& config)
+{
+	WorldBatchResult result;
+	result.worlds.resize(config.worlds);
+	result.threads = config.threads > 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+	result.threads = std::min(result.threads, std::max(1u, config.worlds));
+
+	// Every worker takes the next world that nobody is simulating yet.
+	// The worlds share one JobSystem, whose threads help whichever world splits a loop.
+	JobSystem jobs(config.jobs);
+	std::atomic<unsigned int> next_world(0);
+	auto work = [&]() {
+		for (unsigned int i = next_world++; i < config.worlds; i = next_world++)
+			result.worlds[i] = simulate_world(config.seed + i, config.frames, config.frame_ms, config.map_size, jobs);
+	};
+
+	auto start = Clock::now();
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < result.threads; i++) {
+		workers.emplace_back([&work, i]() {
+			Profiler::set_thread_name("world batch " + std::to_string(i));
+			work();
+		});
+	}
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+	result.wall_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	result.frames_per_second = (double)config.worlds * config.frames / (result.wall_ms / 1000.0);
+	return result;
+}
+
+void print_world_batch_result(const WorldBatchConfig& config, const WorldBatchResult& result)
+{
+	printf("%-8s %8s %8s %8s %8s %8s %12s %18s\n", "world", "seed", "games", "mobs", "killed", "shots", "frame (ms)", "state");
+	unsigned int killed = 0;
+	for (unsigned int i = 0; i < result.worlds.size(); i++) {
+		const WorldBatchWorldResult& world = result.worlds[i];
+		printf("%-8u %8u %8u %8u %8u %8u %12.3f   %016llx\n", i, world.seed, world.games, world.mobs_spawned, world.mobs_killed, world.shots_fired,
+			config.frames > 0 ? world.simulation_ms / config.frames : 0.0, (unsigned long long)world.state_hash);
+		killed += world.mobs_killed;
+	}
+
+	printf("%u worlds x %u frames on %u threads in %.1f ms, %u mobs killed\n",
+		config.worlds, config.frames, result.threads, result.wall_ms, killed);
+	printf("aggregate: %.0f simulated frames per second\n", result.frames_per_second);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Settings for run_world_batch
+struct WorldBatchConfig
+{
+	unsigned int worlds = 64;			// number of independent worlds
+	unsigned int frames = 600;			// frames simulated per world
+	unsigned int threads = 0;			// worker threads, 0 for one per hardware thread
+	unsigned int jobs = 1;				// threads of the JobSystem the worlds share for their hot loops, see ECSRegistry::jobs
+	unsigned int seed = 1;				// world i is seeded with seed + i
+	float frame_ms = 1000.f / 60.f;		// simulated time per frame
+	unsigned int map_size = 0;			// side of a generated map to play on, 0 for the map loaded_map_name
+};
+
+// How one world of a batch ended
+struct WorldBatchWorldResult
+{
+	unsigned int seed = 0;
+	unsigned int games = 0;				// the first one and every restart after the player died
+	unsigned int mobs_spawned = 0;
+	unsigned int mobs_killed = 0;
+	unsigned int shots_fired = 0;
+	double simulation_ms = 0;			// time spent in the frames, without building the world
+	uint64_t state_hash = 0;			// hash_world_state at the end, the same for the same seed
+};
+
+struct WorldBatchResult
+{
+	std::vector<WorldBatchWorldResult> worlds;
+	unsigned int threads = 0;
+	double wall_ms = 0;					// from the first world built to the last one torn down
+	double frames_per_second = 0;		// simulated frames of all worlds per second of wall time
+};
+
+// Simulates many worlds in one process, e.g. for balancing and soak runs: the whole game, WorldSystem included,
+// played by a scripted player through its input. The player wanders around, shoots at the closest mob and starts
+// a new game after dying. There is no window, GL or audio. Every world owns its registry, entity ids and systems
+// and is built, stepped and torn down on one worker thread, so nothing mutable is shared between worlds.
+WorldBatchResult run_world_batch(const WorldBatchConfig& config);
+
+// Prints the aggregate and per-world results of run_world_batch
+void print_world_batch_result(const WorldBatchConfig& config, const WorldBatchResult& result);
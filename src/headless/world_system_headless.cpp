@@ -0,0 +1,26 @@
+// internal
+#include "world_system.hpp"
+
+// Stand-in for the window half of WorldSystem (world_system_window.cpp) in the headless build. There is no window:
+// the input comes from WorldSystem::play_input, and the caller decides when the run is over.
+
+void WorldSystem::attach_window()
+{
+}
+
+void WorldSystem::destroy_window()
+{
+}
+
+bool WorldSystem::is_over() const
+{
+	return false;
+}
+
+void WorldSystem::close_window()
+{
+}
+
+void WorldSystem::set_hand_cursor(bool hand)
+{
+}
@@ -0,0 +1,173 @@
+// internal
+#include "input_log.hpp"
+
+// stlib
+#include <cstring>
+
+namespace {
+	const char INPUT_LOG_MAGIC[4] = { 'S', 'R', 'E', 'C' };
+	const uint16_t INPUT_LOG_VERSION = 1;
+
+	// FNV-1a over the bytes of a value
+	template <typename T>
+	void hash_value(uint64_t& hash, const T& value)
+	{
+		const unsigned char* bytes = (const unsigned char*)&value;
+		for (size_t i = 0; i < sizeof(T); i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ull;
+		}
+	}
+}
+
+bool InputLog::open_for_recording(const std::string& path, uint32_t seed, ivec2 window_size)
+{
+	out.open(path, std::ios::binary);
+	if (!out.good()) {
+		fprintf(stderr, "Failed to create input log %s\n", path.c_str());
+		return false;
+	}
+
+	world_seed = seed;
+	recorded_window_size = window_size;
+	uint16_t version = INPUT_LOG_VERSION;
+	out.write(INPUT_LOG_MAGIC, sizeof(INPUT_LOG_MAGIC));
+	write_to_file(out, version);
+	write_to_file(out, world_seed);
+	write_to_file(out, recorded_window_size);
+	return true;
+}
+
+bool InputLog::open_for_replay(const std::string& path)
+{
+	in.open(path, std::ios::binary);
+	char magic[4] = {};
+	uint16_t version = 0;
+	in.read(magic, sizeof(magic));
+	read_from_file(in, version);
+	read_from_file(in, world_seed);
+	read_from_file(in, recorded_window_size);
+
+	if (!in.good() || memcmp(magic, INPUT_LOG_MAGIC, sizeof(magic)) != 0 || version != INPUT_LOG_VERSION) {
+		fprintf(stderr, "%s is not an input log of this version\n", path.c_str());
+		in.close();
+		return false;
+	}
+	return true;
+}
+
+void InputLog::record_frame(float elapsed_ms)
+{
+	uint8_t type = InputEvent::FRAME;
+	write_to_file(out, type);
+	write_to_file(out, elapsed_ms);
+}
+
+void InputLog::record_key(int key, int scancode, int action, int mods)
+{
+	uint8_t type = InputEvent::KEY;
+	int16_t key_value = (int16_t)key;
+	int32_t scancode_value = scancode;
+	uint8_t action_value = (uint8_t)action;
+	uint8_t mods_value = (uint8_t)mods;
+	write_to_file(out, type);
+	write_to_file(out, key_value);
+	write_to_file(out, scancode_value);
+	write_to_file(out, action_value);
+	write_to_file(out, mods_value);
+}
+
+void InputLog::record_mouse_move(vec2 position)
+{
+	uint8_t type = InputEvent::MOUSE_MOVE;
+	write_to_file(out, type);
+	write_to_file(out, position);
+}
+
+void InputLog::record_mouse_click(int button, int action, int mods)
+{
+	uint8_t type = InputEvent::MOUSE_CLICK;
+	uint8_t button_value = (uint8_t)button;
+	uint8_t action_value = (uint8_t)action;
+	uint8_t mods_value = (uint8_t)mods;
+	write_to_file(out, type);
+	write_to_file(out, button_value);
+	write_to_file(out, action_value);
+	write_to_file(out, mods_value);
+}
+
+bool InputLog::read(InputEvent& event)
+{
+	uint8_t type = 0;
+	read_from_file(in, type);
+	if (!in.good())
+		return false;
+
+	event = InputEvent();
+	event.type = (InputEvent::TYPE)type;
+	switch (event.type) {
+	case InputEvent::FRAME:
+		read_from_file(in, event.elapsed_ms);
+		break;
+	case InputEvent::KEY: {
+		int16_t key_value;
+		int32_t scancode_value;
+		uint8_t action_value, mods_value;
+		read_from_file(in, key_value);
+		read_from_file(in, scancode_value);
+		read_from_file(in, action_value);
+		read_from_file(in, mods_value);
+		event.key = key_value;
+		event.scancode = scancode_value;
+		event.action = action_value;
+		event.mods = mods_value;
+		break;
+	}
+	case InputEvent::MOUSE_MOVE:
+		read_from_file(in, event.position);
+		break;
+	case InputEvent::MOUSE_CLICK: {
+		uint8_t button_value, action_value, mods_value;
+		read_from_file(in, button_value);
+		read_from_file(in, action_value);
+		read_from_file(in, mods_value);
+		event.key = button_value;
+		event.action = action_value;
+		event.mods = mods_value;
+		break;
+	}
+	default:
+		fprintf(stderr, "Corrupt input log, event type %d\n", type);
+		return false;
+	}
+	return in.good();
+}
+
+uint64_t hash_world_state(ECSRegistry& registry)
+{
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	hash_value(hash, registry.motions.size());
+	for (unsigned int i = 0; i < registry.motions.size(); i++) {
+		MotionRef motion = registry.motions.components[i];
+		hash_value(hash, motion.position);
+		hash_value(hash, motion.angle);
+		hash_value(hash, motion.velocity);
+		hash_value(hash, motion.scale);
+	}
+
+	for (const Player& player : registry.players.components) {
+		hash_value(hash, player.health);
+		hash_value(hash, player.food);
+		hash_value(hash, player.current_speed);
+	}
+
+	hash_value(hash, registry.mobs.size());
+	for (const Mob& mob : registry.mobs.components)
+		hash_value(hash, mob.health);
+
+	hash_value(hash, registry.projectiles.size());
+	hash_value(hash, registry.particles.size());
+	hash_value(hash, registry.items.size());
+	return hash;
+}
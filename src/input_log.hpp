@@ -0,0 +1,75 @@
+#pragma once
+
+// stlib
+#include <fstream>
+#include <string>
+// internal
+#include "common.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// One entry of an InputLog: the input WorldSystem received, or the end of a frame
+struct InputEvent
+{
+	enum TYPE : uint8_t {
+		FRAME,			// elapsed_ms, every event before it arrived in that frame
+		KEY,			// key, scancode, action, mods as passed to WorldSystem::on_key
+		MOUSE_MOVE,		// position as passed to WorldSystem::on_mouse_move
+		MOUSE_CLICK,	// button (in key), action, mods as passed to WorldSystem::on_mouse_click
+	};
+
+	TYPE type = FRAME;
+	int key = 0;
+	int scancode = 0;
+	int action = 0;
+	int mods = 0;
+	vec2 position = { 0.f, 0.f };
+	float elapsed_ms = 0.f;
+};
+
+// A recorded session of the game: the seed of its world and, frame by frame, the time the frame took and the
+// input that reached WorldSystem. Playing it back with the same build and map gives a bit-identical world (see
+// hash_world_state), so the same session can be timed before and after an optimization.
+// The file is a header followed by one type byte and a small payload per event.
+// Usage:
+//		InputLog log;
+//		log.open_for_recording("session.srec", registry.random.seed(), window_size);
+//		log.record_key(key, scancode, action, mods);
+//		log.record_frame(elapsed_ms);
+// and later:
+//		log.open_for_replay("session.srec");
+//		registry.random.set_seed(log.seed());
+//		while (log.read(event)) ...
+class InputLog
+{
+public:
+	// Creates the file and writes the header. Returns false if it can not be created.
+	bool open_for_recording(const std::string& path, uint32_t seed, ivec2 window_size);
+
+	// Opens a recorded file and reads its header. Returns false if it can not be read or is not an input log.
+	bool open_for_replay(const std::string& path);
+
+	bool recording() const { return out.is_open(); }
+	bool replaying() const { return in.is_open(); }
+
+	// Of the recorded session, valid once a file is open
+	uint32_t seed() const { return world_seed; }
+	ivec2 window_size() const { return recorded_window_size; }
+
+	void record_frame(float elapsed_ms);
+	void record_key(int key, int scancode, int action, int mods);
+	void record_mouse_move(vec2 position);
+	void record_mouse_click(int button, int action, int mods);
+
+	// Reads the next event of a replay. Returns false at the end of the log.
+	bool read(InputEvent& event);
+
+private:
+	std::ofstream out;
+	std::ifstream in;
+	uint32_t world_seed = 0;
+	ivec2 recorded_window_size = { 0, 0 };
+};
+
+// A hash of the state of the simulation (motions, players, mobs and the entity counts), to check that a replay
+// ended up in exactly the same world as the recording
+uint64_t hash_world_state(ECSRegistry& registry);
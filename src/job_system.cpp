@@ -0,0 +1,183 @@
+// internal
+#include "job_system.hpp"
+#include "profiler.hpp"
+
+// stlib
+#include <string>
+
+namespace {
+	// The system the calling thread is a worker of, and its queue there
+	thread_local const JobSystem* worker_system = nullptr;
+	thread_local unsigned int worker_queue = 0;
+}
+
+JobSystem::JobSystem(unsigned int threads_arg)
+	: threads(threads_arg > 0 ? threads_arg : std::max(1u, std::thread::hardware_concurrency()))
+{
+	for (unsigned int i = 0; i < threads; i++)
+		queues.emplace_back(new Queue());
+	for (unsigned int i = 1; i < threads; i++)
+		workers.emplace_back(&JobSystem::work, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+JobSystem& JobSystem::serial()
+{
+	static JobSystem system(1);
+	return system;
+}
+
+unsigned int JobSystem::own_queue() const
+{
+	return worker_system == this ? worker_queue : 0;
+}
+
+void JobSystem::work(unsigned int queue)
+{
+	worker_system = this;
+	worker_queue = queue;
+	Profiler::set_thread_name("job worker " + std::to_string(queue));
+
+	while (true) {
+		std::shared_ptr<JobState> job = pop();
+		if (job) {
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleep_mutex);
+		wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+		if (stopping)
+			return;
+	}
+}
+
+void JobSystem::push(std::shared_ptr<JobState> job)
+{
+	Queue& queue = *queues[own_queue()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+		queued++;
+	}
+	// Taking the lock orders the push before the check of a worker that is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	wake.notify_one();
+}
+
+std::shared_ptr<JobState> JobSystem::pop()
+{
+	std::shared_ptr<JobState> job;
+	unsigned int own = own_queue();
+
+	// Newest job of our own queue first, its data is most likely still in the cache
+	{
+		Queue& queue = *queues[own];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queued--;
+			return job;
+		}
+	}
+
+	// Otherwise steal the oldest job of another queue
+	for (unsigned int i = 1; i < threads; i++) {
+		Queue& queue = *queues[(own + i) % threads];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queued--;
+			return job;
+		}
+	}
+	return job;
+}
+
+void JobSystem::execute(const std::shared_ptr<JobState>& job)
+{
+	{
+		PROFILE_SCOPE("job");
+		job->work();
+	}
+	job->work = nullptr;
+
+	std::vector<std::shared_ptr<JobState>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		std::swap(continuations, job->continuations);
+	}
+	job->done.store(true, std::memory_order_release);
+
+	for (std::shared_ptr<JobState>& continuation : continuations) {
+		if (threads == 1)
+			execute(continuation);
+		else
+			push(std::move(continuation));
+	}
+}
+
+JobHandle JobSystem::run(std::function<void()> job)
+{
+	std::shared_ptr<JobState> state = std::make_shared<JobState>();
+	state->work = std::move(job);
+	if (threads == 1)
+		execute(state);
+	else
+		push(state);
+	return JobHandle(state);
+}
+
+JobHandle JobSystem::then(const JobHandle& before, std::function<void()> job)
+{
+	if (!before.state)
+		return run(std::move(job));
+
+	std::shared_ptr<JobState> state = std::make_shared<JobState>();
+	state->work = std::move(job);
+	{
+		std::lock_guard<std::mutex> lock(before.state->mutex);
+		if (!before.state->finished) {
+			before.state->continuations.push_back(state);
+			return JobHandle(state);
+		}
+	}
+
+	if (threads == 1)
+		execute(state);
+	else
+		push(state);
+	return JobHandle(state);
+}
+
+void JobSystem::wait(const JobHandle& job)
+{
+	while (!job.is_done()) {
+		if (!run_one())
+			std::this_thread::yield();
+	}
+}
+
+bool JobSystem::run_one()
+{
+	std::shared_ptr<JobState> job = pop();
+	if (!job)
+		return false;
+	execute(job);
+	return true;
+}
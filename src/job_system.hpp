@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <assert.h>
+
+// Bytes of components one chunk of a parallel loop covers, see ComponentContainer::parallel_for.
+// Small enough to stay in L2 while a worker runs it, large enough that scheduling does not show up.
+static constexpr size_t JOB_CHUNK_BYTES = 16 * 1024;
+
+// The state of one job, shared by the handles to it and its continuations
+struct JobState
+{
+	std::function<void()> work;
+	std::atomic<bool> done{ false };
+
+	// Guards finished and continuations, so a continuation is never added after the job ran them
+	std::mutex mutex;
+	bool finished = false;
+	std::vector<std::shared_ptr<JobState>> continuations;
+};
+
+// Handle to a job started with JobSystem::run or JobSystem::then
+class JobHandle
+{
+	friend class JobSystem;
+	std::shared_ptr<JobState> state;
+public:
+	JobHandle() = default;
+	explicit JobHandle(std::shared_ptr<JobState> job_state) : state(std::move(job_state)) {}
+
+	// Check if the job ran to its end. A default constructed handle counts as done.
+	bool is_done() const { return !state || state->done.load(std::memory_order_acquire); }
+};
+
+// A work-stealing thread pool.
+// Every thread owns a queue: it pushes and pops its own jobs at the back and, once it runs dry, steals from the
+// front of the others. Threads waiting for a job run other jobs meanwhile, so jobs may wait for jobs.
+// With one thread there are no workers and every job runs right away on the calling thread, exactly like a plain loop.
+// Usage:
+//		JobSystem jobs(4);
+//		JobHandle load = jobs.run([&]() { ... });
+//		JobHandle build = jobs.then(load, [&]() { ... });	// runs once load is done
+//		jobs.wait(build);
+//		jobs.parallel_for(n, 64, [&](size_t begin, size_t end) { ... });
+class JobSystem
+{
+	// One queue per thread, queue 0 is shared by the threads that are not workers of this system (e.g. the main loop)
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<std::shared_ptr<JobState>> jobs;
+	};
+
+	unsigned int threads;
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	// Idle workers sleep until a job is pushed or the system shuts down
+	std::mutex sleep_mutex;
+	std::condition_variable wake;
+	std::atomic<unsigned int> queued{ 0 };
+	std::atomic<bool> stopping{ false };
+
+	void work(unsigned int queue);
+	void push(std::shared_ptr<JobState> job);
+	std::shared_ptr<JobState> pop();
+	void execute(const std::shared_ptr<JobState>& job);
+
+	// The queue of the calling thread: its own if it is a worker of this system, 0 otherwise
+	unsigned int own_queue() const;
+public:
+	// threads counts the calling thread, so 1 starts no workers and 0 is one per hardware thread
+	explicit JobSystem(unsigned int threads);
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	unsigned int thread_count() const { return threads; }
+
+	// Starts a job. With one thread it has run when this returns.
+	JobHandle run(std::function<void()> job);
+
+	// Starts a job once 'before' is done, right away if it already is
+	JobHandle then(const JobHandle& before, std::function<void()> job);
+
+	// Returns once the job is done, running other jobs while waiting
+	void wait(const JobHandle& job);
+
+	// Runs one queued job on the calling thread. Returns false if there was none.
+	bool run_one();
+
+	// Calls f(begin, end) for consecutive ranges of [0, count) of at most 'grain' elements and returns once all of
+	// them are done. The ranges only depend on count and grain, never on the thread count, so a loop whose ranges
+	// only write their own elements gives the same result on any number of threads.
+	template <typename F>
+	void parallel_for(size_t count, size_t grain, F f)
+	{
+		assert(grain > 0);
+		size_t chunks = (count + grain - 1) / grain;
+		if (threads == 1 || chunks <= 1) {
+			for (size_t begin = 0; begin < count; begin += grain)
+				f(begin, std::min(begin + grain, count));
+			return;
+		}
+
+		// The caller runs the first range itself and then helps with the others
+		std::atomic<size_t> remaining(chunks - 1);
+		for (size_t chunk = 1; chunk < chunks; chunk++) {
+			size_t begin = chunk * grain;
+			run([&f, &remaining, begin, grain, count]() {
+				f(begin, std::min(begin + grain, count));
+				remaining.fetch_sub(1, std::memory_order_acq_rel);
+			});
+		}
+		f(0, grain);
+		while (remaining.load(std::memory_order_acquire) > 0) {
+			if (!run_one())
+				std::this_thread::yield();
+		}
+	}
+
+	// A system with one thread, for worlds that were not given one (e.g. the worlds of a batch)
+	static JobSystem& serial();
+};
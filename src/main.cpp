@@ -5,6 +5,7 @@
 
 // stlib
 #include <chrono>
+#include <cstring>
 #include <iostream>
 // internal
 #include "physics_system.hpp"
@@ -20,28 +21,102 @@
 #include "quest_system.hpp"
 #include "tutorial_system.hpp"
 #include "start_screen_system.hpp"
+#include "system_scheduler.hpp"
+#include "input_log.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
 #include "common.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
 
+// Options of the game
+struct GameOptions
+{
+	unsigned int job_threads = 0;			// threads the hot loops are split over, 0 for one per core
+	bool print_schedule = false;			// print the order of the systems once and their timings at exit
+	unsigned int tick_rate = 60;			// simulation ticks per second
+	unsigned int max_ticks_per_frame = 5;	// ticks caught up at most after a slow frame
+	unsigned int physics_substeps = 1;		// see PhysicsSystem::substeps
+	bool seeded = false;					// seed the world with seed instead of std::random_device
+	unsigned int seed = 0;
+	std::string record_path;				// record the session into this input log
+	std::string replay_path;				// replay the session of this input log instead of playing
+	std::string trace_path;					// write the profiler's trace here at exit, and on F9
+	std::string metrics_path;				// report the metrics here, see MetricsReporter
+	unsigned int metrics_interval_ms = 1000;
+	bool show_hud = false;					// start with the metrics HUD shown, F10 toggles it
+};
+
+// Reads the options of the game, e.g. "--jobs 1 --schedule 1 --tick-rate 120 --max-ticks 8 --substeps 4 --seed 7
+// --record session.srec" or "--replay session.srec", "--trace trace.json" or "--metrics metrics.csv --metrics-interval 500
+// --hud 1". Many worlds are simulated at once by stranded_headless instead, see run_world_batch.
+static void parse_options(int argc, char* argv[], GameOptions& options)
+{
+	for (int i = 1; i + 1 < argc; i += 2) {
+		unsigned int value = (unsigned int)std::strtoul(argv[i + 1], nullptr, 10);
+		if (strcmp(argv[i], "--seed") == 0) {
+			options.seed = value;
+			options.seeded = true;
+		}
+		else if (strcmp(argv[i], "--jobs") == 0)
+			options.job_threads = value;
+		else if (strcmp(argv[i], "--schedule") == 0)
+			options.print_schedule = value != 0;
+		else if (strcmp(argv[i], "--tick-rate") == 0)
+			options.tick_rate = std::max(1u, value);
+		else if (strcmp(argv[i], "--max-ticks") == 0)
+			options.max_ticks_per_frame = std::max(1u, value);
+		else if (strcmp(argv[i], "--substeps") == 0)
+			options.physics_substeps = std::max(1u, value);
+		else if (strcmp(argv[i], "--record") == 0)
+			options.record_path = argv[i + 1];
+		else if (strcmp(argv[i], "--replay") == 0)
+			options.replay_path = argv[i + 1];
+		else if (strcmp(argv[i], "--trace") == 0)
+			options.trace_path = argv[i + 1];
+		else if (strcmp(argv[i], "--metrics") == 0)
+			options.metrics_path = argv[i + 1];
+		else if (strcmp(argv[i], "--metrics-interval") == 0)
+			options.metrics_interval_ms = std::max(1u, value);
+		else if (strcmp(argv[i], "--hud") == 0)
+			options.show_hud = value != 0;
+		else
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+	}
+}
+
 // Entry point
-int main()
+int main(int argc, char* argv[])
 {
+	Profiler::set_thread_name("main");
+
+	GameOptions options;
+	parse_options(argc, argv, options);
+	if (!options.trace_path.empty() && !Profiler::compiled_in())
+		fprintf(stderr, "The profiler is not compiled in, build with -DENABLE_PROFILER=ON to write %s\n",
+			options.trace_path.c_str());
+
+	// The threads of the physics, particle and pathfinding loops, and the world of the game.
+	// Declared first so that they outlive the systems.
+	JobSystem jobs(options.job_threads);
+	ECSRegistry registry;
+	registry.jobs = &jobs;
+
 	// Global systems
-	WorldSystem world_system;
-	RenderSystem render_system;
-	PhysicsSystem physics_system;
-	TerrainSystem terrain_system;
-	PathfindingSystem pathfinding_system;
-	WeaponsSystem weapons_system;
-	ParticleSystem particle_system;
-	MobSystem mob_system;
+	WorldSystem world_system(registry);
+	RenderSystem render_system(registry);
+	PhysicsSystem physics_system(registry);
+	TerrainSystem terrain_system(registry);
+	PathfindingSystem pathfinding_system(registry);
+	WeaponsSystem weapons_system(registry);
+	ParticleSystem particle_system(registry);
+	MobSystem mob_system(registry);
 	AudioSystem audio_system;
-	SpaceshipHomeSystem spaceship_home_system;
-	StartScreenSystem start_screen_system;
-	QuestSystem quest_system;
-	TutorialSystem tutorial_system;
-	PowerupSystem powerup_system;
+	SpaceshipHomeSystem spaceship_home_system(registry);
+	StartScreenSystem start_screen_system(registry);
+	QuestSystem quest_system(registry);
+	TutorialSystem tutorial_system(registry);
+	PowerupSystem powerup_system(registry);
 
 	// Initializing window
 	ivec2 window_size = {};
@@ -54,15 +129,31 @@ int main()
 		return EXIT_FAILURE;
 	}
 
+	// Everything random in the world follows from one seed. A recorded session stores it, and its replay
+	// starts from it, see InputLog.
+	InputLog input_log;
+	if (options.seeded)
+		registry.random.set_seed(options.seed);
+	if (!options.replay_path.empty()) {
+		if (!input_log.open_for_replay(options.replay_path))
+			return EXIT_FAILURE;
+		registry.random.set_seed(input_log.seed());
+		if (input_log.window_size() != window_size)
+			fprintf(stderr, "The session was recorded in a %dx%d window, the replay may differ\n",
+				input_log.window_size().x, input_log.window_size().y);
+	}
+	else if (!options.record_path.empty()) {
+		if (!input_log.open_for_recording(options.record_path, registry.random.seed(), window_size))
+			return EXIT_FAILURE;
+	}
+	bool logging_input = input_log.recording() || input_log.replaying();
+
 	// Initialize systems needed to display the start screen
 	audio_system.init();		
 	render_system.init(window, window_size);
 	start_screen_system.init(window, &render_system, &terrain_system);
-
-	// Load terrain mesh into the GPU
-	std::unordered_map<unsigned int, RenderSystem::ORIENTATIONS> orientation_map;
-	terrain_system.generate_orientation_map(orientation_map);	// Gets all the tiles with directional textures
-	render_system.initializeTerrainBuffers(orientation_map);
+	if (logging_input)
+		start_screen_system.skip();
 
 	auto t = Clock::now();
 	float total_elapsed_time = 0.f;
@@ -75,8 +166,10 @@ int main()
 		t = now;
 		total_elapsed_time += elapsed_ms;
 		
+		PROFILE_SCOPE("start screen");
 		start_screen_system.step(elapsed_ms);
 		render_system.drawStartScreens();
+		registry.clear_changes();
 	}
 	// start_screen_system.~StartScreenSystem(); // destructor not working properly, segfaulting...
 
@@ -89,6 +182,10 @@ int main()
 	spaceship_home_system.init(&render_system, &weapons_system, &quest_system);
 	tutorial_system.init(&render_system);
 	
+	if (logging_input)
+		world_system.set_input_log(&input_log);
+	if (!options.trace_path.empty())
+		world_system.set_trace_path(options.trace_path);
 	world_system.init(
 		&render_system, 
 		&terrain_system, 
@@ -104,52 +201,120 @@ int main()
 	);
 	pathfinding_system.init(&terrain_system, &powerup_system);
 	
-	float fps_sum = 0.0f;
-	int fps_count = 0;
+	// The systems of a frame in their order and what they touch, so that independent ones overlap (see SystemScheduler).
+	// The game is paused while the player is in the spaceship home or the help dialog is open.
+	bool paused = false;
+	auto playing = [&]() { return !paused; };
+	SystemScheduler scheduler;
+	scheduler.add("spaceship home", [&](float ms) { spaceship_home_system.step(ms); }).when([&]() { return paused; }).exclusive();
+	scheduler.add("world", [&](float ms) { world_system.step(ms); }).when(playing).exclusive();
+	scheduler.add("physics", [&](float ms) { physics_system.step(ms); }).when(playing).exclusive();
+	scheduler.add("terrain", [&](float ms) { terrain_system.step(ms); }).when(playing)
+		.reads<Player, Motion>()
+		.writes_state(&terrain_system);
+	scheduler.add("pathfinding", [&](float ms) { pathfinding_system.step(ms); }).when(playing)
+		.reads<Player>()
+		.writes<Mob, Path, Motion, MobSlowEffect, Animation>()
+		.reads_state(&terrain_system)
+		.reads_state(&powerup_system);
+	scheduler.add("weapons", [&](float ms) { weapons_system.step(ms); }).when(playing)
+		.writes<Weapon>()
+		.reads_state(&powerup_system);
+	scheduler.add("mobs", [&](float ms) { mob_system.step(ms); }).when(playing)
+		.writes<Mob>()
+		.writes_state(&mob_system);
+	scheduler.add("quests", [&](float ms) { quest_system.step(ms); }).when(playing)
+		.writes<QuestItemIndicator>()
+		.writes_state(&quest_system);
+	scheduler.add("collisions", [&](float) { world_system.handle_collisions(); }).when(playing).exclusive();
+	scheduler.add("particles", [&](float ms) { particle_system.step(ms); }).when(playing)
+		.writes<Particle, vec4, Motion>();
+	scheduler.add("powerups", [&](float ms) { powerup_system.step(ms); }).when(playing).exclusive();
+	scheduler.add("tutorial", [&](float ms) { tutorial_system.step(ms); }).exclusive();
+	bool schedule_printed = false;
+
+	// Fixed timestep loop: the world advances in whole ticks, and every frame draws it between the last two ticks
+	FixedTimestep timestep;
+	timestep.tick_ms = 1000.f / options.tick_rate;
+	timestep.max_ticks_per_frame = options.max_ticks_per_frame;
+	physics_system.substeps = options.physics_substeps;
+
+	// Always-on metrics, reported every interval to the file of --metrics (if any) and the HUD
+	MetricsReporter metrics;
+	metrics.open(options.metrics_path, (float)options.metrics_interval_ms);
+	Histogram& frame_times = Metrics::histogram("frame_ms");
+	Histogram& tick_times = Metrics::histogram("tick_ms");
+	render_system.show_metrics_hud = options.show_hud;
 
-	// variable timestep loop
 	while (!world_system.is_over()) {
+		PROFILE_SCOPE("frame");
+
 		// Processes system messages, if this wasn't present the window would become unresponsive
 		glfwPollEvents();
 
-		// Calculating elapsed times in milliseconds from the previous iteration
+		// Calculating elapsed times in milliseconds from the previous iteration. A replay takes the recorded
+		// ones together with the input of the frame.
 		auto now = Clock::now();
 		float elapsed_ms =
 			(float)(std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
 		t = now;
-		
-		
-		// Pause game when player is in spaceship home or help dialog is open  
-		if (spaceship_home_system.isHome() || tutorial_system.isHelpDialogOpen()) {
-			spaceship_home_system.step(elapsed_ms);
-		} else {
-			world_system.step(elapsed_ms);
-			physics_system.step(elapsed_ms);
-			terrain_system.step(elapsed_ms);
-			pathfinding_system.step(elapsed_ms);
-			weapons_system.step(elapsed_ms);
-			mob_system.step(elapsed_ms);
-			quest_system.step(elapsed_ms);
-			world_system.handle_collisions();
-			particle_system.step(elapsed_ms);
-			powerup_system.step(elapsed_ms);
-			/* FOR FPS DISPLAY ON CONSOLE
-			fps_sum += 1000.0f / (elapsed_ms);
-			fps_count++;
-
-			if (fps_count == 10) {
-				std::cout << "FPS " << fps_sum / 10.0f << std::endl;
-
-				fps_count = 0;
-				fps_sum = 0;
+		if (input_log.replaying()) {
+			if (!world_system.replay_frame(elapsed_ms))
+				break;
+		}
+		else if (input_log.recording()) {
+			input_log.record_frame(elapsed_ms);
+		}
+		frame_times.record(elapsed_ms);
+
+		unsigned int ticks = timestep.advance(elapsed_ms);
+		for (unsigned int tick = 0; tick < ticks && !world_system.is_over(); tick++) {
+			PROFILE_SCOPE("tick");
+			auto tick_start = Clock::now();
+			render_system.snapshotMotions();
+
+			paused = spaceship_home_system.isHome() || tutorial_system.isHelpDialogOpen();
+			scheduler.run(timestep.tick_ms, jobs);
+
+			if (options.print_schedule && !schedule_printed && !paused) {
+				scheduler.print_schedule(stdout);
+				schedule_printed = true;
 			}
-			*/
 
+			// Sync point: apply the entity destroys and component changes the systems deferred
+			registry.flush_commands();
+
+			// Keep moving entities close to their neighbours in memory, a bounded amount of work per tick
+			registry.sort_spatially_step(ECSRegistry::SPATIAL_SORT_BUDGET);
+
+			// End of tick for the change tracking, see ComponentContainer::track_changes
+			registry.clear_changes();
+			tick_times.record(std::chrono::duration<double, std::milli>(Clock::now() - tick_start).count());
 		}
 
-		tutorial_system.step(elapsed_ms);
+		render_system.setInterpolation(timestep.alpha());
 		render_system.draw();
+
+		if (metrics.due()) {
+			registry.sample_metrics();
+			metrics.report();
+			render_system.setMetricsHud(metrics.hud_lines());
+		}
 	}
 
+	if (options.print_schedule)
+		scheduler.print_timings(stdout);
+
+	if (!options.trace_path.empty())
+		Profiler::write_chrome_trace(options.trace_path);
+	if (!options.metrics_path.empty()) {
+		registry.sample_metrics();
+		metrics.report();
+	}
+
+	// Compare this between a recording and its replays
+	if (logging_input)
+		printf("World state hash after the session: %016llx\n", (unsigned long long)hash_world_state(registry));
+
 	return EXIT_SUCCESS;
 }
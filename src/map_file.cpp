@@ -0,0 +1,304 @@
+// internal
+#include "map_file.hpp"
+
+// stlib
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	// Byte-at-a-time table of the reflected polynomial 0xEDB88320
+	struct Crc32Table
+	{
+		uint32_t entries[256];
+
+		Crc32Table()
+		{
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				entries[i] = c;
+			}
+		}
+	};
+
+	// Appends the run-length encoding of size bytes to out, see SmapPalette
+	void run_length_encode(const uint8_t* bytes, size_t size, std::vector<uint8_t>& out)
+	{
+		size_t i = 0;
+		while (i < size) {
+			size_t run = 1;
+			while (i + run < size && run < 130 && bytes[i + run] == bytes[i])
+				run++;
+			if (run >= 3) {
+				out.push_back((uint8_t)(run + 125));
+				out.push_back(bytes[i]);
+				i += run;
+				continue;
+			}
+
+			// The bytes as they are, up to where the next run starts
+			size_t end = i;
+			while (end < size && end - i < 128) {
+				if (end + 2 < size && bytes[end] == bytes[end + 1] && bytes[end] == bytes[end + 2])
+					break;
+				end++;
+			}
+			out.push_back((uint8_t)(end - i - 1));
+			out.insert(out.end(), bytes + i, bytes + end);
+			i = end;
+		}
+	}
+}
+
+uint32_t crc32(const void* data, size_t size, uint32_t crc)
+{
+	static const Crc32Table table;
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table.entries[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+const SmapHeader* validate_smap(const uint8_t* data, size_t size, uint32_t max_version)
+{
+	if (size < sizeof(SmapHeader) || memcmp(data, "smap", 4) != 0) {
+		fprintf(stderr, "Map file header does not match with expected file format.\n");
+		return nullptr;
+	}
+
+	SmapHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (header.version < 2 || header.version > max_version) {
+		fprintf(stderr, "Map file version %u can not be mapped, this build reads up to version %u\n", header.version, max_version);
+		return nullptr;
+	}
+
+	const uint64_t chunk_count = (uint64_t)header.chunks_x * header.chunks_y;
+	if (header.size_x <= 0 || header.size_y <= 0 || header.chunk_size == 0 ||
+		header.chunks_x != (header.size_x + header.chunk_size - 1) / header.chunk_size ||
+		header.chunks_y != (header.size_y + header.chunk_size - 1) / header.chunk_size ||
+		header.chunk_table_offset % alignof(SmapChunkEntry) != 0 ||
+		header.chunk_table_offset + chunk_count * sizeof(SmapChunkEntry) > size) {
+		fprintf(stderr, "Map file dimensions or chunk table are invalid\n");
+		return nullptr;
+	}
+
+	const SmapChunkEntry* table = reinterpret_cast<const SmapChunkEntry*>(data + header.chunk_table_offset);
+	const uint32_t expected_crc = header.crc;
+	header.crc = 0;
+	uint32_t crc = crc32(&header, sizeof(header));
+	crc = crc32(table, chunk_count * sizeof(SmapChunkEntry), crc);
+	if (crc != expected_crc) {
+		fprintf(stderr, "Map file header or chunk table is damaged (crc %08x, expected %08x)\n", crc, expected_crc);
+		return nullptr;
+	}
+
+	for (uint64_t i = 0; i < chunk_count; i++) {
+		if (table[i].offset > size || table[i].size > size - table[i].offset) {
+			fprintf(stderr, "Map file chunk %u is past the end of the file\n", (unsigned int)i);
+			return nullptr;
+		}
+	}
+
+	return reinterpret_cast<const SmapHeader*>(data);
+}
+
+SMAP_ENCODING encode_smap_chunk(const uint32_t* cells, size_t count, std::vector<uint8_t>& out)
+{
+	out.clear();
+	std::vector<uint32_t> palette(cells, cells + count);
+	std::sort(palette.begin(), palette.end());
+	palette.erase(std::unique(palette.begin(), palette.end()), palette.end());
+
+	if (palette.size() <= SMAP_MAX_PALETTE) {
+		SmapPalette head = {};
+		head.palette_size = (uint16_t)palette.size();
+		head.index_bits = palette.size() <= 1 ? 0 : palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : palette.size() <= 16 ? 4 : 8;
+
+		std::vector<uint8_t> indices((count * head.index_bits + 7) / 8, 0);
+		for (size_t i = 0; head.index_bits > 0 && i < count; i++) {
+			size_t index = std::lower_bound(palette.begin(), palette.end(), cells[i]) - palette.begin();
+			size_t bit = i * head.index_bits;
+			indices[bit / 8] |= (uint8_t)(index << (bit % 8));
+		}
+		std::vector<uint8_t> runs;
+		run_length_encode(indices.data(), indices.size(), runs);
+		const bool use_runs = runs.size() < indices.size();
+
+		out.resize(sizeof(head) + sizeof(uint32_t) * palette.size());
+		memcpy(out.data(), &head, sizeof(head));
+		memcpy(out.data() + sizeof(head), palette.data(), sizeof(uint32_t) * palette.size());
+		const std::vector<uint8_t>& payload = use_runs ? runs : indices;
+		out.insert(out.end(), payload.begin(), payload.end());
+		if (out.size() < sizeof(uint32_t) * count)
+			return use_runs ? SMAP_ENCODING::PALETTE_RLE : SMAP_ENCODING::PALETTE;
+	}
+
+	out.resize(sizeof(uint32_t) * count);
+	memcpy(out.data(), cells, out.size());
+	return SMAP_ENCODING::RAW;
+}
+
+bool decode_smap_chunk(const uint8_t* data, size_t size, uint32_t encoding, uint32_t* cells, size_t count)
+{
+	if (encoding == SMAP_ENCODING::RAW) {
+		if (size != sizeof(uint32_t) * count)
+			return false;
+		memcpy(cells, data, size);
+		return true;
+	}
+
+	SmapPalette head;
+	if ((encoding != SMAP_ENCODING::PALETTE && encoding != SMAP_ENCODING::PALETTE_RLE) || size < sizeof(head))
+		return false;
+	memcpy(&head, data, sizeof(head));
+	const uint32_t bits = head.index_bits;
+	if ((bits != 0 && bits != 1 && bits != 2 && bits != 4 && bits != 8) ||
+		head.palette_size == 0 || head.palette_size > (1u << bits) ||
+		size < sizeof(head) + sizeof(uint32_t) * head.palette_size)
+		return false;
+
+	uint32_t palette[SMAP_MAX_PALETTE];
+	memcpy(palette, data + sizeof(head), sizeof(uint32_t) * head.palette_size);
+	const uint8_t* bytes = data + sizeof(head) + sizeof(uint32_t) * head.palette_size;
+	const uint8_t* end = data + size;
+
+	if (bits == 0) {
+		std::fill(cells, cells + count, palette[0]);
+		return bytes == end;
+	}
+
+	// The indices are unpacked as the bytes come, so runs are never expanded into a buffer first
+	const uint32_t per_byte = 8 / bits;
+	const uint32_t mask = (1u << bits) - 1;
+	size_t cell = 0;
+	bool damaged = false;
+	auto unpack = [&](uint8_t byte) {
+		for (uint32_t k = 0; k < per_byte && cell < count; k++) {
+			uint32_t index = (byte >> (k * bits)) & mask;
+			damaged |= index >= head.palette_size;
+			cells[cell++] = palette[index];
+		}
+	};
+
+	if (encoding == SMAP_ENCODING::PALETTE) {
+		if ((size_t)(end - bytes) != (count * bits + 7) / 8)
+			return false;
+		while (bytes < end)
+			unpack(*bytes++);
+	}
+	else {
+		while (bytes < end) {
+			const uint8_t control = *bytes++;
+			if (control < 128) {
+				if ((size_t)(end - bytes) < (size_t)control + 1)
+					return false;
+				for (int i = 0; i <= control; i++)
+					unpack(*bytes++);
+			}
+			else {
+				if (bytes == end)
+					return false;
+				const uint8_t byte = *bytes++;
+				for (int i = 0; i < control - 125; i++)
+					unpack(byte);
+			}
+		}
+	}
+	return cell == count && !damaged;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	// FILE_SHARE_DELETE, so that TerrainSystem::save_grid can replace a map while it is mapped
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const void* view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr) {
+		if (mapping != nullptr)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	bytes = static_cast<const uint8_t*>(view);
+	length = (size_t)file_size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes != nullptr) {
+		UnmapViewOfFile(bytes);
+		CloseHandle(mapping_handle);
+		CloseHandle(file_handle);
+	}
+	bytes = nullptr;
+	length = 0;
+	file_handle = mapping_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// The mapping keeps the file alive, even once it is replaced or deleted
+	void* view = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	bytes = static_cast<const uint8_t*>(view);
+	length = (size_t)file_stat.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (bytes != nullptr)
+		munmap(const_cast<uint8_t*>(bytes), length);
+	bytes = nullptr;
+	length = 0;
+}
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+// stlib
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Layout of a .smap file since version 2, all fields little-endian:
+//		SmapHeader						at offset 0
+//		SmapChunkEntry[chunk count]		at header.chunk_table_offset, the chunks row by row
+//		the chunks						each at the offset of its entry
+// A chunk is chunk_size * chunk_size packed TerrainCells row by row (cells past the edge of the map are zero), in the
+// encoding of its entry. Every chunk can be found and decoded on its own, so any of them can be loaded first and
+// several can be decoded at once.
+// A RAW chunk starts on a SMAP_ALIGNMENT boundary, so that the pages of a mapped file can be used as the terrain in
+// place. Since version 3 chunks are compressed (see encode_smap_chunk) and follow each other without gaps.
+// Version 1 files are "smap", the version, size_x, size_y, SMAP_PADDING_BYTES of padding and then all
+// size_x * size_y cells row by row. TerrainSystem::load_grid still reads them.
+const uint32_t SMAP_ALIGNMENT = 4096;
+
+enum SMAP_ENCODING : uint32_t {
+	RAW = 0,				// the cells as they are
+	PALETTE = 1,			// SmapPalette, the palette and then the index into it of every cell, index_bits each
+	PALETTE_RLE = 2,		// the same, but the bytes of the indices are run-length encoded
+};
+
+// Start of a PALETTE or PALETTE_RLE chunk, followed by palette_size packed TerrainCells.
+// The indices are packed from the lowest bit of a byte up. An index_bits of 0 means that every cell is palette[0].
+// The run-length encoding of PALETTE_RLE is a control byte c followed by c + 1 bytes as they are if c < 128, or
+// by one byte that repeats c - 125 times otherwise.
+struct SmapPalette
+{
+	uint16_t palette_size;			// 1 to SMAP_MAX_PALETTE
+	uint8_t index_bits;				// 0, 1, 2, 4 or 8, so that no index straddles two bytes
+	uint8_t reserved;				// zero
+};
+static_assert(sizeof(SmapPalette) == 4, "The .smap chunk palette is part of the file format");
+
+// Chunks with more different cells than this are saved RAW
+const uint32_t SMAP_MAX_PALETTE = 256;
+
+struct SmapHeader
+{
+	char magic[4];					// "smap", see map_ext
+	uint32_t version;				// savefile_version when saved
+	int32_t size_x, size_y;
+	uint32_t chunk_size;			// TERRAIN_CHUNK_SIZE when saved
+	uint32_t chunks_x, chunks_y;
+	uint32_t chunk_table_offset;
+	uint32_t crc;					// crc32 of the chunk table and of this header with crc = 0
+	uint32_t reserved[7];			// zero
+};
+static_assert(sizeof(SmapHeader) == 64, "The .smap header is part of the file format");
+
+struct SmapChunkEntry
+{
+	uint64_t offset;				// from the start of the file
+	uint32_t size;					// bytes at offset
+	uint32_t encoding;				// SMAP_ENCODING
+	uint32_t crc;					// crc32 of the size bytes at offset
+	uint32_t reserved;				// zero
+};
+static_assert(sizeof(SmapChunkEntry) == 24, "The .smap chunk table is part of the file format");
+
+// CRC-32 (the one of zip and png) of size bytes, continuing from the crc of the bytes before them
+uint32_t crc32(const void* data, size_t size, uint32_t crc = 0);
+
+// Checks the header and the chunk table of a .smap file of size bytes, version 2 up to max_version, against each other
+// and the file. Returns nullptr, after printing why, if they are damaged or do not fit.
+const SmapHeader* validate_smap(const uint8_t* data, size_t size, uint32_t max_version);
+
+// Encodes count cells in whichever encoding is smallest into out, returns that encoding
+SMAP_ENCODING encode_smap_chunk(const uint32_t* cells, size_t count, std::vector<uint8_t>& out);
+
+// Decodes the size bytes of a chunk in the given encoding into count cells. Returns false if they are damaged.
+// Safe to call from several threads at once.
+bool decode_smap_chunk(const uint8_t* data, size_t size, uint32_t encoding, uint32_t* cells, size_t count);
+
+// The chunk table of a validated .smap file
+inline const SmapChunkEntry* smap_chunk_table(const SmapHeader* header) {
+	return reinterpret_cast<const SmapChunkEntry*>(reinterpret_cast<const uint8_t*>(header) + header->chunk_table_offset);
+}
+
+// A whole file mapped read-only into memory. Its pages are only read from disk when they are touched, and the OS can
+// drop them again at any time, so a mapped file costs neither load time nor heap.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile() { close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Maps the file at path, returns false if it can not be opened or is empty
+	bool open(const std::string& path);
+	void close();
+
+	bool is_open() const { return bytes != nullptr; }
+	const uint8_t* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
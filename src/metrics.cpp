@@ -0,0 +1,295 @@
+// internal
+#include "metrics.hpp"
+
+// stlib
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace {
+	// Function-local, so that metrics looked up by the static initializers of other files find it constructed
+	struct MetricsStore
+	{
+		std::mutex mutex;
+		std::map<std::string, std::unique_ptr<Counter>> counters;
+		std::map<std::string, std::unique_ptr<Gauge>> gauges;
+		std::map<std::string, std::unique_ptr<Histogram>> histograms;
+	};
+
+	MetricsStore& store()
+	{
+		static MetricsStore metrics;
+		return metrics;
+	}
+
+	template <typename T, typename... Args>
+	T& find_or_create(std::map<std::string, std::unique_ptr<T>>& metrics, const std::string& name, Args... args)
+	{
+		std::lock_guard<std::mutex> lock(store().mutex);
+		std::unique_ptr<T>& metric = metrics[name];
+		if (!metric)
+			metric.reset(new T(args...));
+		return *metric;
+	}
+
+	const char* kind_name(METRIC_KIND kind)
+	{
+		switch (kind) {
+		case METRIC_KIND::COUNTER: return "counter";
+		case METRIC_KIND::GAUGE: return "gauge";
+		default: return "histogram";
+		}
+	}
+}
+
+uint64_t Counter::value() const
+{
+	uint64_t total = 0;
+	for (const Shard& shard : shards)
+		total += shard.value.load(std::memory_order_relaxed);
+	return total;
+}
+
+int Histogram::bucket_of(uint64_t steps)
+{
+	// Below 2 * SUB_BUCKETS every value has a bucket of its own, above that the top SUB_BUCKET_BITS + 1 bits
+	// pick the bucket and the ones below them are dropped
+	if (steps < 2 * SUB_BUCKETS)
+		return (int)steps;
+	int top_bit = 63;
+	while (!(steps >> top_bit))
+		top_bit--;
+	int shift = std::min(top_bit - SUB_BUCKET_BITS, (int)MAX_SHIFT);
+	uint64_t top = std::min(steps >> shift, (uint64_t)(2 * SUB_BUCKETS - 1));
+	return (shift + 1) * SUB_BUCKETS + (int)(top - SUB_BUCKETS);
+}
+
+double Histogram::bucket_middle(int bucket)
+{
+	if (bucket < 2 * SUB_BUCKETS)
+		return (double)bucket;
+	int shift = bucket / SUB_BUCKETS - 1;
+	uint64_t low = (uint64_t)(bucket % SUB_BUCKETS + SUB_BUCKETS) << shift;
+	return (double)low + (double)((uint64_t)1 << shift) / 2.0;
+}
+
+void Histogram::record(double value)
+{
+	uint64_t steps = value > 0 ? (uint64_t)std::llround(value / resolution) : 0;
+	buckets[bucket_of(steps)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(steps, std::memory_order_relaxed);
+
+	uint64_t previous_max = max.load(std::memory_order_relaxed);
+	while (steps > previous_max && !max.compare_exchange_weak(previous_max, steps, std::memory_order_relaxed)) {}
+}
+
+HistogramSummary Histogram::summarize() const
+{
+	HistogramSummary summary;
+	uint32_t counts[BUCKETS];
+	for (int i = 0; i < BUCKETS; i++) {
+		counts[i] = buckets[i].load(std::memory_order_relaxed);
+		summary.count += counts[i];
+	}
+	if (summary.count == 0)
+		return summary;
+
+	summary.max = max.load(std::memory_order_relaxed) * resolution;
+	summary.mean = sum.load(std::memory_order_relaxed) * resolution / summary.count;
+
+	// The value below which the given share of the recorded values is, never above the maximum
+	auto percentile = [&](double share) {
+		uint64_t rank = std::max((uint64_t)1, (uint64_t)std::ceil(share * summary.count));
+		uint64_t seen = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			seen += counts[i];
+			if (seen >= rank)
+				return std::min(bucket_middle(i) * resolution, summary.max);
+		}
+		return summary.max;
+	};
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	return summary;
+}
+
+void Histogram::reset()
+{
+	for (std::atomic<uint32_t>& bucket : buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	count.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	max.store(0, std::memory_order_relaxed);
+}
+
+Counter& Metrics::counter(const std::string& name)
+{
+	return find_or_create(store().counters, name);
+}
+
+Gauge& Metrics::gauge(const std::string& name)
+{
+	return find_or_create(store().gauges, name);
+}
+
+Histogram& Metrics::histogram(const std::string& name, double resolution)
+{
+	return find_or_create(store().histograms, name, resolution);
+}
+
+std::vector<MetricValue> Metrics::collect(bool reset_histograms)
+{
+	std::vector<MetricValue> values;
+	MetricsStore& metrics = store();
+	std::lock_guard<std::mutex> lock(metrics.mutex);
+
+	for (auto& counter : metrics.counters) {
+		values.emplace_back();
+		values.back().name = counter.first;
+		values.back().kind = METRIC_KIND::COUNTER;
+		values.back().value = (double)counter.second->value();
+	}
+	for (auto& gauge : metrics.gauges) {
+		values.emplace_back();
+		values.back().name = gauge.first;
+		values.back().kind = METRIC_KIND::GAUGE;
+		values.back().value = gauge.second->value();
+	}
+	for (auto& histogram : metrics.histograms) {
+		values.emplace_back();
+		values.back().name = histogram.first;
+		values.back().kind = METRIC_KIND::HISTOGRAM;
+		values.back().histogram = histogram.second->summarize();
+		values.back().value = (double)values.back().histogram.count;
+		if (reset_histograms)
+			histogram.second->reset();
+	}
+
+	std::sort(values.begin(), values.end(), [](const MetricValue& a, const MetricValue& b) { return a.name < b.name; });
+	return values;
+}
+
+bool MetricsReporter::open(const std::string& path_arg, float interval_ms_arg)
+{
+	path = path_arg;
+	interval_ms = std::max(interval_ms_arg, 1.f);
+	csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+	if (!csv || path.empty())
+		return true;
+
+	// A new CSV file starts with its header
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "Could not open the metrics file %s\n", path.c_str());
+		path.clear();
+		return false;
+	}
+	fprintf(file, "time_s,metric,kind,value,per_second,p50,p95,p99,max\n");
+	fclose(file);
+	return true;
+}
+
+bool MetricsReporter::due() const
+{
+	return std::chrono::duration<float, std::milli>(Clock::now() - last_report_time).count() >= interval_ms;
+}
+
+void MetricsReporter::report()
+{
+	Clock::time_point now = Clock::now();
+	double interval_s = std::chrono::duration<double>(now - last_report_time).count();
+	double time_s = std::chrono::duration<double>(now - start).count();
+	last_report_time = now;
+
+	// Counter rates come from the totals of the previous report, both are sorted by name
+	std::vector<MetricValue> previous = std::move(last_report);
+	last_report = Metrics::collect(true);
+	auto previous_value = previous.begin();
+	for (MetricValue& value : last_report) {
+		if (value.kind != METRIC_KIND::COUNTER)
+			continue;
+		while (previous_value != previous.end() && previous_value->name < value.name)
+			previous_value++;
+		double before = previous_value != previous.end() && previous_value->name == value.name ? previous_value->value : 0;
+		value.per_second = interval_s > 0 ? (value.value - before) / interval_s : 0;
+	}
+
+	if (path.empty())
+		return;
+	if (csv)
+		write_csv(time_s);
+	else
+		write_json(time_s);
+}
+
+void MetricsReporter::write_csv(double time_s) const
+{
+	FILE* file = fopen(path.c_str(), "a");
+	if (!file)
+		return;
+	for (const MetricValue& value : last_report) {
+		const HistogramSummary& h = value.histogram;
+		fprintf(file, "%.3f,%s,%s,%.10g,%.6g,%.6g,%.6g,%.6g,%.6g\n", time_s, value.name.c_str(),
+			kind_name(value.kind), value.kind == METRIC_KIND::HISTOGRAM ? h.mean : value.value, value.per_second,
+			h.p50, h.p95, h.p99, h.max);
+	}
+	fclose(file);
+}
+
+void MetricsReporter::write_json(double time_s) const
+{
+	// Written next to the file and moved over it, so a reader never sees half a report
+	std::string temporary_path = path + ".tmp";
+	FILE* file = fopen(temporary_path.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "Could not write the metrics file %s\n", temporary_path.c_str());
+		return;
+	}
+	fprintf(file, "{\n  \"time_s\": %.3f,\n  \"metrics\": {", time_s);
+	bool first = true;
+	for (const MetricValue& value : last_report) {
+		fprintf(file, "%s\n    \"%s\": ", first ? "" : ",", value.name.c_str());
+		first = false;
+		const HistogramSummary& h = value.histogram;
+		if (value.kind == METRIC_KIND::COUNTER)
+			fprintf(file, "{\"total\": %.0f, \"per_second\": %.6g}", value.value, value.per_second);
+		else if (value.kind == METRIC_KIND::GAUGE)
+			fprintf(file, "%.10g", value.value);
+		else
+			fprintf(file, "{\"count\": %llu, \"mean\": %.6g, \"p50\": %.6g, \"p95\": %.6g, \"p99\": %.6g, \"max\": %.6g}",
+				(unsigned long long)h.count, h.mean, h.p50, h.p95, h.p99, h.max);
+	}
+	fprintf(file, "\n  }\n}\n");
+	fclose(file);
+
+	// Windows does not move over an existing file
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		std::remove(path.c_str());
+		if (std::rename(temporary_path.c_str(), path.c_str()) != 0)
+			fprintf(stderr, "Could not write the metrics file %s\n", path.c_str());
+	}
+}
+
+std::vector<std::string> MetricsReporter::hud_lines() const
+{
+	std::vector<std::string> lines;
+	char line[128];
+	for (const MetricValue& value : last_report) {
+		if (value.kind == METRIC_KIND::COUNTER)
+			snprintf(line, sizeof(line), "%s %.0f/s", value.name.c_str(), value.per_second);
+		else if (value.kind == METRIC_KIND::GAUGE) {
+			if (value.name.compare(0, 11, "containers.") == 0)
+				continue;
+			snprintf(line, sizeof(line), "%s %g", value.name.c_str(), value.value);
+		}
+		else
+			snprintf(line, sizeof(line), "%s p50 %.2f p95 %.2f p99 %.2f", value.name.c_str(),
+				value.histogram.p50, value.histogram.p95, value.histogram.p99);
+		lines.push_back(line);
+	}
+	return lines;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Counters are split over this many slots, so threads that count at the same time rarely share a cache line
+static constexpr unsigned int METRIC_SHARDS = 16;
+
+// The slot of the calling thread in a Counter
+inline unsigned int metric_shard()
+{
+	static std::atomic<unsigned int> next_shard{ 0 };
+	thread_local unsigned int shard = next_shard++ % METRIC_SHARDS;
+	return shard;
+}
+
+// A number that only grows, e.g. the SAT tests done so far
+class Counter
+{
+public:
+	void add(uint64_t n = 1) { shards[metric_shard()].value.fetch_add(n, std::memory_order_relaxed); }
+
+	uint64_t value() const;
+
+private:
+	struct Shard
+	{
+		std::atomic<uint64_t> value{ 0 };
+		char padding[64 - sizeof(std::atomic<uint64_t>)];
+	};
+	Shard shards[METRIC_SHARDS];
+};
+
+// The last value of something, e.g. the particles alive
+class Gauge
+{
+public:
+	void set(double value_arg) { current.store(value_arg, std::memory_order_relaxed); }
+	double value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<double> current{ 0.0 };
+};
+
+// Count, mean, percentiles and maximum of the values a Histogram got
+struct HistogramSummary
+{
+	uint64_t count = 0;
+	double mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+// Distribution of values, e.g. frame times. Like an HDR histogram it keeps counts in buckets that get wider as the
+// values get larger, so every value is off by at most 1/32 of itself (or one resolution step) and recording is a
+// few instructions, at any range from the resolution up to 2^40 times the resolution.
+class Histogram
+{
+public:
+	static constexpr int SUB_BUCKET_BITS = 5;
+	static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+	static constexpr int MAX_SHIFT = 40 - SUB_BUCKET_BITS;
+	static constexpr int BUCKETS = (MAX_SHIFT + 2) * SUB_BUCKETS;
+
+	// resolution: the smallest difference that matters, e.g. 0.001 for milliseconds measured in microseconds
+	explicit Histogram(double resolution_arg) : resolution(resolution_arg) { reset(); }
+
+	void record(double value);
+
+	HistogramSummary summarize() const;
+
+	// Starts over, e.g. for the next reporting interval
+	void reset();
+
+private:
+	double resolution;
+	std::atomic<uint32_t> buckets[BUCKETS];
+	std::atomic<uint64_t> count{ 0 };
+	std::atomic<uint64_t> sum{ 0 };		// in resolution steps
+	std::atomic<uint64_t> max{ 0 };
+
+	static int bucket_of(uint64_t steps);
+	static double bucket_middle(int bucket);
+};
+
+enum class METRIC_KIND : uint8_t {
+	COUNTER,
+	GAUGE,
+	HISTOGRAM
+};
+
+// One metric at the time of a report
+struct MetricValue
+{
+	std::string name;
+	METRIC_KIND kind;
+	double value = 0;			// total of a counter, value of a gauge, values recorded by a histogram
+	double per_second = 0;		// increase of a counter per second since the last report
+	HistogramSummary histogram;
+};
+
+// Named counters, gauges and histograms of the whole process, cheap enough to stay on in every build.
+// A metric is created the first time its name is asked for and lives until exit, so hot code looks it up once.
+// The worlds of a batch all count into the same metrics.
+// Usage:
+//		static Counter& sat_calls = Metrics::counter("physics.sat_calls");
+//		sat_calls.add();
+//		Metrics::histogram("frame_ms").record(elapsed_ms);
+class Metrics
+{
+public:
+	static Counter& counter(const std::string& name);
+	static Gauge& gauge(const std::string& name);
+	static Histogram& histogram(const std::string& name, double resolution = 0.001);
+
+	// The current value of every metric, sorted by name. Histograms start over if reset_histograms is set.
+	static std::vector<MetricValue> collect(bool reset_histograms);
+};
+
+// Reports the metrics every interval: to a file, if there is one, and as lines for the metrics HUD.
+// A path ending in ".csv" gets one row per metric and report appended, any other path is rewritten with a JSON
+// object of the last report. Histograms cover the interval since the previous report.
+// Usage:
+//		MetricsReporter reporter;
+//		reporter.open("metrics.csv", 1000.f);
+//		if (reporter.due())
+//			reporter.report();
+class MetricsReporter
+{
+public:
+	// Without a path the reports only go to hud_lines
+	bool open(const std::string& path_arg, float interval_ms_arg);
+
+	bool due() const;
+
+	// Collects the metrics and writes them out
+	void report();
+
+	// The last report in a few short lines. Gauges named "containers.*" only go to the file.
+	std::vector<std::string> hud_lines() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	std::string path;
+	bool csv = false;
+	float interval_ms = 1000.f;
+	Clock::time_point start = Clock::now();
+	Clock::time_point last_report_time = Clock::now();
+	std::vector<MetricValue> last_report;
+
+	void write_csv(double time_s) const;
+	void write_json(double time_s) const;
+};
@@ -16,9 +16,7 @@ void MobSystem::spawn_mobs() {
 	};
 	std::vector<vec2> zone_slime_locations = terrain->get_mob_spawn_locations(zone_mob_slime);
 
-	for (const auto& spawn_location: zone_slime_locations) {
-		create_mob(spawn_location, MOB_TYPE::SLIME);
-	}
+	create_mobs(zone_slime_locations, MOB_TYPE::SLIME);
 
 	// spawn ghosts
 	std::unordered_map<ZONE_NUMBER,int> zone_mob_ghost = {
@@ -30,9 +28,7 @@ void MobSystem::spawn_mobs() {
 	};
 	std::vector<vec2> zone_ghost_locations = terrain->get_mob_spawn_locations(zone_mob_ghost);
 
-	for (const auto& spawn_location: zone_ghost_locations) {
-		create_mob(spawn_location, MOB_TYPE::GHOST);
-	}
+	create_mobs(zone_ghost_locations, MOB_TYPE::GHOST);
 
 	// spawn brutes
 	std::unordered_map<ZONE_NUMBER,int> zone_mob_brute = {
@@ -44,9 +40,7 @@ void MobSystem::spawn_mobs() {
 	};
 	std::vector<vec2> zone_brute_locations = terrain->get_mob_spawn_locations(zone_mob_brute);
 
-	for (const auto& spawn_location: zone_brute_locations) {
-		create_mob(spawn_location, MOB_TYPE::BRUTE);
-	}
+	create_mobs(zone_brute_locations, MOB_TYPE::BRUTE);
 
 	// spawn DISRUPTOR
 	std::unordered_map<ZONE_NUMBER,int> zone_mob_disruptor = {
@@ -58,9 +52,7 @@ void MobSystem::spawn_mobs() {
 	};
 	std::vector<vec2> zone_disruptor_locations = terrain->get_mob_spawn_locations(zone_mob_disruptor);
 
-	for (const auto& spawn_location: zone_disruptor_locations) {
-		create_mob(spawn_location, MOB_TYPE::DISRUPTOR);
-	}
+	create_mobs(zone_disruptor_locations, MOB_TYPE::DISRUPTOR);
 }
 
 void MobSystem::apply_mob_attack_effects(Entity player, Entity mob) {
@@ -73,107 +65,75 @@ void MobSystem::apply_mob_attack_effects(Entity player, Entity mob) {
 }
 
 Entity MobSystem::create_mob(vec2 mob_position, MOB_TYPE mob_type, int current_health) {
-    auto entity = Entity();
-
-	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
-	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::MOB_SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
-
-	// Initialize the motion
-	auto& motion = registry.motions.emplace(entity);
-	motion.angle = 0.f;
-	motion.velocity = { 0.f, 0.f };
-	motion.position = mob_position;
-	motion.scale = vec2({ 1, 1 });
-
-	// Initialize path
-	registry.paths.emplace(entity);
+	return create_mobs({ mob_position }, mob_type, current_health)[0];
+};
 
-	// Classify this entity as a mob
-	auto& mob_info = registry.mobs.emplace(entity);
+std::vector<Entity> MobSystem::create_mobs(const std::vector<vec2>& mob_positions, MOB_TYPE mob_type, int current_health) {
+	unsigned int n = (unsigned int)mob_positions.size();
+	int max_health = mob_health_map.at(mob_type);
+	int health = (current_health != 0) ? current_health : max_health;
+
+	// Create a health bar for every mob, in one batch
+	Motion health_bar_motion;
+	health_bar_motion.scale = vec2(((float)health / (float)max_health) * 2.5, 0.3);
+	RenderRequest health_bar_request = {
+		TEXTURE_ASSET_ID::RED_BLOCK,
+		EFFECT_ASSET_ID::TEXTURED,
+		GEOMETRY_BUFFER_ID::SPRITE,
+		RENDER_LAYER_ID::LAYER_1
+	};
+	std::vector<Entity> health_bars = registry.spawn_n(n,
+		make_prefab(&renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE), health_bar_motion, health_bar_request),
+		[&](unsigned int i, Entity, Mesh*&, MotionRef motion, RenderRequest&) {
+			motion.position = { mob_positions[i].x, mob_positions[i].y - 0.8 };
+		});
+
+	// Everything that is the same for all mobs of this type
+	Mob mob_info;
 	mob_info.damage = mob_damage_map.at(mob_type);
 	mob_info.aggro_range = mob_aggro_range_map.at(mob_type);
 	mob_info.is_tracking_player = false;
-	vec2 health_position = { mob_position.x, mob_position.y - 0.8};
-	if (current_health != 0) {
-		mob_info.health = current_health;
-		// Create a health bar for the mob
-		mob_info.health_bar = create_mob_health_bar(renderer, health_position, current_health, mob_type);
-	}
-	else {
-		mob_info.health = mob_health_map.at(mob_type);
-		// Create a health bar for the mob
-		mob_info.health_bar = create_mob_health_bar(renderer, health_position, mob_health_map.at(mob_type), mob_type);
-	}
+	mob_info.health = health;
 	mob_info.speed_ratio = mob_speed_ratio_map.at(mob_type);
-	mob_info.curr_cell = terrain->get_cell(motion.position);
 	mob_info.type = mob_type;
 
-	// Initialize the collider
-	physics->createMeshCollider(entity, GEOMETRY_BUFFER_ID::MOB001_MESH, renderer);
-
-	TEXTURE_ASSET_ID texture = mob_textures_map.at(mob_type);
-	switch (mob_type) {
-		case MOB_TYPE::SLIME:	// Handle slime differently because it has a sprite sheet animation
-		{
-			// Attach animation component
-			Animation& animation = registry.animations.emplace(entity);
-			animation.framex = 0;
-			animation.framey = 1;
-			animation.frame_dimension_w = (float)(1.0f / 7.0f);
-			animation.frame_dimension_h = (float)(1.0f / 4.0f);
-
-			registry.renderRequests.insert(
-				entity,
-				{	
-					texture,
-					EFFECT_ASSET_ID::SPRITESHEET,
-					GEOMETRY_BUFFER_ID::MOB_SPRITE,
-					RENDER_LAYER_ID::LAYER_1 
-				}
-			);
-			break;
-		}
-		default:
-			registry.renderRequests.insert(
-				entity,
-				{	
-					texture,
-					EFFECT_ASSET_ID::TEXTURED,
-					GEOMETRY_BUFFER_ID::SPRITE,
-					RENDER_LAYER_ID::LAYER_1 
-				}
-			);
-			break;
-	}
-
-	return entity;
-};
+	Motion motion;
+	motion.angle = 0.f;
+	motion.velocity = { 0.f, 0.f };
+	motion.scale = vec2({ 1, 1 });
 
-Entity MobSystem::create_mob_health_bar(RenderSystem* renderer, vec2 position, int amount, MOB_TYPE type) {
-	auto entity = Entity();
+	// Slimes have a sprite sheet animation
+	bool is_slime = mob_type == MOB_TYPE::SLIME;
+	RenderRequest request = {
+		mob_textures_map.at(mob_type),
+		is_slime ? EFFECT_ASSET_ID::SPRITESHEET : EFFECT_ASSET_ID::TEXTURED,
+		is_slime ? GEOMETRY_BUFFER_ID::MOB_SPRITE : GEOMETRY_BUFFER_ID::SPRITE,
+		RENDER_LAYER_ID::LAYER_1
+	};
 
-	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
-	registry.meshPtrs.emplace(entity, &mesh);
+	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
+	Mesh* mesh = &renderer->getMesh(GEOMETRY_BUFFER_ID::MOB_SPRITE);
+
+	std::vector<Entity> entities = registry.spawn_n(n,
+		make_prefab(mesh, motion, Path(), mob_info, physics->makeMeshCollider(GEOMETRY_BUFFER_ID::MOB001_MESH, renderer, motion.scale), request),
+		[&](unsigned int i, Entity, Mesh*&, MotionRef motion, Path&, Mob& mob, ColliderRef collider, RenderRequest&) {
+			motion.position = mob_positions[i];
+			collider.position = mob_positions[i];
+			mob.health_bar = health_bars[i];
+			mob.curr_cell = terrain->get_cell(mob_positions[i]);
+		});
+
+	if (is_slime) {
+		// Attach animation component
+		Animation animation;
+		animation.framex = 0;
+		animation.framey = 1;
+		animation.frame_dimension_w = (float)(1.0f / 7.0f);
+		animation.frame_dimension_h = (float)(1.0f / 4.0f);
+		registry.animations.insert_n(entities, animation);
+	}
 
-	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
-	motion.angle = 0.f;
-	motion.velocity = { 0.f, 0.f };
-	motion.position = position;
-	motion.scale = vec2(((float)amount / (float)mob_health_map.at(type)) * 2.5, 0.3);
-
-	registry.renderRequests.insert(
-		entity,
-		{
-			TEXTURE_ASSET_ID::RED_BLOCK,
-			EFFECT_ASSET_ID::TEXTURED,
-			GEOMETRY_BUFFER_ID::SPRITE,
-			RENDER_LAYER_ID::LAYER_1
-		}
-	);
-
-	return entity;
+	return entities;
 }
 
 void MobSystem::apply_knockback(Entity player, Entity mob, float duration_ms, float knockback_speed_ratio) {
@@ -188,8 +148,8 @@ void MobSystem::apply_knockback(Entity player, Entity mob, float duration_ms, fl
 	playerKnockbackEffect.elapsed_knockback_time_ms = 0.f;
 
 	// Change velocity of player so that they move in the opposite they were just travelling (i.e. knock them back)
-	Motion& player_motion = registry.motions.get(player);
-	Motion& mob_motion = registry.motions.get(mob);
+	MotionRef player_motion = registry.motions.get(player);
+	MotionRef mob_motion = registry.motions.get(mob);
 	float angle = atan2(player_motion.position.y - mob_motion.position.y, player_motion.position.x - mob_motion.position.x);
 	player_motion.velocity[0] = cos(angle) * knockback_speed_ratio;
     player_motion.velocity[1] = sin(angle) * knockback_speed_ratio;
@@ -17,7 +17,8 @@ class MobSystem
 {
     public:
         /// @brief MobSystem constructor
-        MobSystem()
+        explicit MobSystem(ECSRegistry& registry_arg)
+            : registry(registry_arg)
         {
         }
 
@@ -28,7 +29,6 @@ class MobSystem
             this->renderer = renderer_arg;
             this->terrain = terrain_arg;
             this->physics = physics_arg;
-            this->rng = std::default_random_engine(std::random_device()());
         }
 
         /// @brief Function to update mob system in world time.
@@ -49,6 +49,13 @@ class MobSystem
         /// @return The created entity
         Entity create_mob(vec2 mob_position, MOB_TYPE mob_type, int current_health = 0);
 
+        /// @brief Creates one mob of the same type at each position, with one batch for the mobs and one for their health bars
+        /// @param mob_positions The initial positions of the mobs
+        /// @param mob_type The type of mob to be created
+        /// @param current_health The health of the mobs, 0 for full health
+        /// @return The created entities, in the order of mob_positions
+        std::vector<Entity> create_mobs(const std::vector<vec2>& mob_positions, MOB_TYPE mob_type, int current_health = 0);
+
         // Health for each mob
         const std::unordered_map<MOB_TYPE, int> mob_health_map = {
             {MOB_TYPE::GHOST, 50},
@@ -60,6 +67,7 @@ class MobSystem
 
     private:
         // Pointer to rendering system
+        ECSRegistry& registry;
         RenderSystem* renderer;
 
         // Pointer to terrain system
@@ -68,9 +76,6 @@ class MobSystem
         // Pointer to physics system
         PhysicsSystem* physics;
 
-        // C++ random number generator
-	    std::default_random_engine rng;
-
         // Harcoded mob data
         // Damage for each mob
         const std::unordered_map<MOB_TYPE, int> mob_damage_map = {
@@ -117,5 +122,4 @@ class MobSystem
         /// @param inaccuracy_percent How much inaccuracy there is for the player as a percentage [0, 1.0] (0 means no inaccuracy)
         void apply_inaccuracy(Entity player, float duration_ms, float inaccuracy_percent);
 
-        Entity create_mob_health_bar(RenderSystem* renderer, vec2 position, int amount, MOB_TYPE type);
 };
@@ -1,4 +1,5 @@
 #include "particle_system.hpp"
+#include "metrics.hpp"
 
 vec2 rotateByDegree(vec2 vector, float angleInDegree) {
 
@@ -13,83 +14,85 @@ float lerp(float v0, float v1, float t) {
     return (1 - t) * v0 + t * v1;
 }
 
+const float* ParticleSystem::random_burst(size_t count, float min, float max) {
+    burst_values.resize(count);
+    registry.random.stream(RANDOM_STREAM::PARTICLES).uniform(burst_values.data(), count, min, max);
+    return burst_values.data();
+}
+
 // reference on particle system: https://www.youtube.com/watch?v=GK0jHlv3e3w
 void ParticleSystem::step(float elapsed_ms) {
-    // Iterate through all particles
-    auto& particle_component_container = registry.particles.components;
-    auto& particle_entity_container = registry.particles.entities;
+    static Gauge& particles_alive = Metrics::gauge("particles.alive");
+    particles_alive.set((double)registry.particles.size());
 
-    for (int i = 0; i < particle_entity_container.size(); i++) {
-        auto& particle = particle_component_container[i];
+    // Iterate through all particles in chunks, emit() always gives them a color and a motion.
+    // Every particle only touches its own components, and destroys are recorded (and sorted at the flush), so the
+    // chunks can run on any thread.
+    registry.particles.parallel_for(*registry.jobs, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Entity entity = registry.particles.entities[i];
+            Particle& particle = registry.particles.components[i];
+            if (!registry.colors.has(entity) || !registry.motions.has(entity))
+                continue;
 
-        if (!particle.active) {
+            if (!particle.active) {
 
-            continue;
-        }
+                continue;
+            }
 
-        // kills the particle when no lifetime left
-        if (particle.lifeTimeRemaining <= 0.0f) {
-        
-            particle.active = false; //unnessary?
-            registry.remove_all_components_of(particle_entity_container[i]);
+            // kills the particle when no lifetime left
+            if (particle.lifeTimeRemaining <= 0.0f) {
 
-            continue;
+                particle.active = false; //unnessary?
+                registry.commands.destroy(entity);
 
-        }
+                continue;
 
-        // updates lifetime remaining
-        particle.lifeTimeRemaining -= elapsed_ms;
+            }
 
-        float life = (particle.lifeTimeRemaining / particle.lifeTime);
+            // updates lifetime remaining
+            particle.lifeTimeRemaining -= elapsed_ms;
 
-        // updates alpha
+            float life = (particle.lifeTimeRemaining / particle.lifeTime);
 
-        if (registry.colors.has(particle_entity_container[i])) {
-            registry.colors.get(particle_entity_container[i]).a *= life;
-        }
+            // updates alpha
+            vec4& color = registry.colors.get(entity);
+            color.a *= life;
 
-        // updates size
-        if (registry.motions.has(particle_entity_container[i])) {
-            registry.motions.get(particle_entity_container[i]).scale = vec2(lerp(particle.sizeEnd, particle.sizeBegin, life));
+            // updates size
+            registry.motions.get(entity).scale = vec2(lerp(particle.sizeEnd, particle.sizeBegin, life));
         }
-
-   
-    }
+    });
 }
 
 
 
 // Create a particle entity based on the template particle 
 Entity ParticleSystem::emit(ParticleTemplate temp) {
-    // Reserve an entity
-    auto entity = Entity();
-    
-    // Set particle components using template particle's entity
-    registry.particles.emplace(entity);
-
-    auto& entity_particle = registry.particles.get(entity);
-
-    entity_particle.lifeTime = temp.lifeTime;
-    entity_particle.lifeTimeRemaining = temp.lifeTimeRemaining;
-    entity_particle.texture = temp.texture;
-    entity_particle.sizeBegin = temp.sizeBegin;
-    entity_particle.sizeEnd = temp.sizeEnd;
-    entity_particle.active = temp.active;
-    
-    // Initialize the position, scale, and physics components
-    registry.motions.emplace(entity);
-    auto& entity_motion = registry.motions.get(entity);
-    
-    entity_motion.position = temp.position;
-    entity_motion.velocity = temp.velocity;
-    entity_motion.scale = vec2{ temp.sizeBegin, temp.sizeBegin };
+    return emit_n({ temp })[0];
+}
 
-    // Set the colour of the particle
-    registry.colors.emplace(entity);
-    registry.colors.get(entity) = temp.color;
-  
-    
-    return entity;
+// Create one particle entity per template, as a single batch
+std::vector<Entity> ParticleSystem::emit_n(const std::vector<ParticleTemplate>& samples) {
+    return registry.spawn_n((unsigned int)samples.size(), make_prefab(Particle(), Motion(), vec4()),
+        [&](unsigned int i, Entity, Particle& entity_particle, MotionRef entity_motion, vec4& color) {
+            const ParticleTemplate& temp = samples[i];
+
+            entity_particle.lifeTime = temp.lifeTime;
+            entity_particle.lifeTimeRemaining = temp.lifeTimeRemaining;
+            entity_particle.texture = temp.texture;
+            entity_particle.sizeBegin = temp.sizeBegin;
+            entity_particle.sizeEnd = temp.sizeEnd;
+            entity_particle.active = temp.active;
+
+            // Initialize the position, scale, and physics components
+            entity_motion.position = temp.position;
+            entity_motion.velocity = temp.velocity;
+            entity_motion.scale = vec2{ temp.sizeBegin, temp.sizeBegin };
+
+            // Set the colour of the particle
+            color = temp.color;
+        });
 }
 
 
@@ -113,10 +116,10 @@ void ParticleSystem::createParticleTrail(Entity targetEntity, TEXTURE_ASSET_ID t
     temp.color = registry.colors.get(targetEntity);
 
 
-    std::random_device rd;
-    std::default_random_engine gen(rd());
-    std::uniform_real_distribution<float> dist(-0.1, 0.1);
-    std::vector<Entity> entities;
+    // 2 random offsets per particle
+    const float* noise = random_burst(2 * numberOfParticles, -0.1f, 0.1f);
+    std::vector<ParticleTemplate> samples;
+    samples.reserve(numberOfParticles);
 
     
     // Create particles based on template
@@ -124,11 +127,13 @@ void ParticleSystem::createParticleTrail(Entity targetEntity, TEXTURE_ASSET_ID t
         ParticleTemplate sample = temp;
 
         // randomize the position
-        sample.position = temp.position + vec2(dist(gen), dist(gen));
-        entities.push_back(emit(sample));
+        sample.position = temp.position + vec2(noise[2 * i], noise[2 * i + 1]);
+        samples.push_back(sample);
 
     }
 
+    std::vector<Entity> entities = emit_n(samples);
+
     // Create one instanced render request 
     registry.instancedRenderRequests.insert(
         entities[0],
@@ -160,26 +165,29 @@ void ParticleSystem::createFloatingHeart(Entity targetEntity, TEXTURE_ASSET_ID t
     temp.color = registry.colors.get(targetEntity);
 
 
-    std::random_device rd;
-    std::default_random_engine gen(rd());
-    std::uniform_real_distribution<float> dist(-0.1, 0.1);
-    std::vector<Entity> entities;
+    // 4 random numbers per particle
+    const float* noise = random_burst(4 * numberOfParticles, -0.1f, 0.1f);
+    std::vector<ParticleTemplate> samples;
+    samples.reserve(numberOfParticles);
 
 
     // Create particles based on template
     for (int i = 0; i < numberOfParticles; i++) {
         ParticleTemplate sample = temp;
+        const float* r = &noise[4 * i];
 
         // randomize the x, y position and scale of hearts
-        sample.sizeBegin =  temp.sizeBegin += dist(gen);
-        sample.position.x = temp.position.x + 4 * dist(gen);
-        sample.position.y = temp.position.y + 4 * dist(gen);
-        sample.velocity.y = temp.velocity.y + 10 * dist(gen);
+        sample.sizeBegin =  temp.sizeBegin += r[0];
+        sample.position.x = temp.position.x + 4 * r[1];
+        sample.position.y = temp.position.y + 4 * r[2];
+        sample.velocity.y = temp.velocity.y + 10 * r[3];
 
-        entities.push_back(emit(sample));
+        samples.push_back(sample);
 
     }
 
+    std::vector<Entity> entities = emit_n(samples);
+
     // Ccreate one instanced render request 
     registry.instancedRenderRequests.insert(
         entities[0],
@@ -210,26 +218,26 @@ void ParticleSystem::createFloatingBullet(Entity targetEntity, int numberOfParti
     temp.color = registry.colors.get(targetEntity);
 
 
-    std::random_device rd;
-    std::default_random_engine gen(rd());
-    std::uniform_real_distribution<float> dist(-0.1, 0.1);
-    std::vector<Entity> entities;
+    // 4 random numbers per particle
+    Rng& rng = registry.random.stream(RANDOM_STREAM::PARTICLES);
+    const float* noise = random_burst(4 * numberOfParticles, -0.1f, 0.1f);
+    std::vector<ParticleTemplate> samples;
+    samples.reserve(numberOfParticles);
 
     // Create particles based on template
     for (int i = 0; i < numberOfParticles; i++) {
         ParticleTemplate sample = temp;
+        const float* r = &noise[4 * i];
 
         // randomize the x, y position and scale of hearts
-        sample.sizeBegin = temp.sizeBegin += dist(gen);
-        sample.position.x = temp.position.x + 4 * dist(gen);
-        sample.position.y = temp.position.y + 5 * dist(gen);
-        sample.velocity.y = temp.velocity.y + 10 * dist(gen);
+        sample.sizeBegin = temp.sizeBegin += r[0];
+        sample.position.x = temp.position.x + 4 * r[1];
+        sample.position.y = temp.position.y + 5 * r[2];
+        sample.velocity.y = temp.velocity.y + 10 * r[3];
 
         
 
-        std::uniform_int_distribution<int> dist(0, 3);
-
-        switch (dist(gen)) {
+        switch (rng.uniform_int(0, 3)) {
             case 0:
                 sample.texture = TEXTURE_ASSET_ID::WEAPON_SHURIKEN;
                 break;
@@ -249,10 +257,12 @@ void ParticleSystem::createFloatingBullet(Entity targetEntity, int numberOfParti
         }
        
        
-        entities.push_back(emit(sample));
+        samples.push_back(sample);
 
     }
 
+    std::vector<Entity> entities = emit_n(samples);
+
     // Ccreate one instanced render request 
     registry.instancedRenderRequests.insert(
         entities[0],
@@ -271,7 +281,7 @@ void ParticleSystem::createFloatingBullet(Entity targetEntity, int numberOfParti
 // spreads in a specified direction with a cone angle spread, with specified particle amounts and color
 void ParticleSystem::createParticleSplash(Entity projectile_entity, Entity mob_entity, int numberOfParticles, vec2 splashDirection) {
 
-    auto& projectile_motion = registry.motions.get(projectile_entity);
+    MotionRef projectile_motion = registry.motions.get(projectile_entity);
 
     // Create the template particle
     ParticleTemplate temp;
@@ -287,26 +297,29 @@ void ParticleSystem::createParticleSplash(Entity projectile_entity, Entity mob_e
 
    
 
-    std::random_device rd;
-    std::default_random_engine gen(rd());
-    std::uniform_real_distribution<float> dist(-1, 1);
+    // 4 random numbers per particle
+    const float* noise = random_burst(4 * numberOfParticles, -1.f, 1.f);
 
-    std::vector<Entity> entities;
+    std::vector<ParticleTemplate> samples;
+    samples.reserve(numberOfParticles);
   
     // Emit particles based on this template and number of particles per frame
     for (int i = 0; i < numberOfParticles; i++) {
         
         ParticleTemplate sampleParticle = temp;
+        const float* r = &noise[4 * i];
 
-        sampleParticle.sizeBegin = temp.sizeBegin += (0.2 * dist(gen));
-        sampleParticle.velocity = rotateByDegree(temp.velocity, dist(gen) * 20);
-        sampleParticle.velocity.x = temp.velocity.x + 3.f * dist(gen);
-        sampleParticle.velocity.y = temp.velocity.y + 3.f * dist(gen);
+        sampleParticle.sizeBegin = temp.sizeBegin += (0.2 * r[0]);
+        sampleParticle.velocity = rotateByDegree(temp.velocity, r[1] * 20);
+        sampleParticle.velocity.x = temp.velocity.x + 3.f * r[2];
+        sampleParticle.velocity.y = temp.velocity.y + 3.f * r[3];
 
-        entities.push_back(emit(sampleParticle));
+        samples.push_back(sampleParticle);
         
     }
 
+    std::vector<Entity> entities = emit_n(samples);
+
     // Create instanced render request 
     registry.instancedRenderRequests.insert(entities[0], {
         entities,
@@ -338,25 +351,28 @@ void ParticleSystem::createWaterSplash(Entity targetEntity, int numberOfParticle
     }
     
 
-    std::random_device rd;
-    std::default_random_engine gen(rd());
-    std::uniform_real_distribution<float> dist(-0.1, 0.1);
-    std::vector<Entity> entities;
+    // 4 random numbers per particle
+    const float* noise = random_burst(4 * numberOfParticles, -0.1f, 0.1f);
+    std::vector<ParticleTemplate> samples;
+    samples.reserve(numberOfParticles);
 
     // Create particles based on template
     for (int i = 0; i < numberOfParticles; i++) {
         ParticleTemplate sample = temp;
+        const float* r = &noise[4 * i];
 
         // randomize the x, y position and scale of hearts
-        sample.sizeBegin = temp.sizeBegin += 1.5f * dist(gen);
-        sample.position.x = temp.position.x + 4 * dist(gen);
-        sample.position.y = temp.position.y + 4 * dist(gen);
-        sample.velocity.y = temp.velocity.y + 10 * dist(gen);
+        sample.sizeBegin = temp.sizeBegin += 1.5f * r[0];
+        sample.position.x = temp.position.x + 4 * r[1];
+        sample.position.y = temp.position.y + 4 * r[2];
+        sample.velocity.y = temp.velocity.y + 10 * r[3];
 
-        entities.push_back(emit(sample));
+        samples.push_back(sample);
 
     }
 
+    std::vector<Entity> entities = emit_n(samples);
+
     // Create instanced render request 
     registry.instancedRenderRequests.insert(entities[0], {
         entities,
@@ -18,9 +18,8 @@ class ParticleSystem
 
     public:
     /// @brief ParticleSystem constructor
-    ParticleSystem() {
-        
-   
+    explicit ParticleSystem(ECSRegistry& registry_arg)
+        : registry(registry_arg) {
     }
 
     /// @brief ParticleSystem destructor
@@ -47,6 +46,11 @@ class ParticleSystem
     
     Entity emit(ParticleTemplate temp);
 
+    /// @brief emit one particle per template as a single batch, so a burst allocates once per container
+    /// @param samples templates of the particles
+    /// @return the particle entities, in the order of samples
+    std::vector<Entity> emit_n(const std::vector<ParticleTemplate>& samples);
+
     void createParticleTrail(Entity targetEntity, TEXTURE_ASSET_ID texture, int numberOfParticles, vec2 scale);
     void createFloatingHeart(Entity targetEntity, TEXTURE_ASSET_ID texture, int numberOfParticles);
     void createFloatingBullet(Entity targetEntity, int numberOfParticles);
@@ -81,8 +85,15 @@ class ParticleSystem
     const float DECAY_RATE = 0.005f;
 
     // The render system to draw particles
+    ECSRegistry& registry;
     RenderSystem* renderer;
 
+    // The random numbers of one burst, drawn at once, see random_burst
+    std::vector<float> burst_values;
+
+    // Draws count uniform numbers in [min, max) from the particle stream, valid until the next call
+    const float* random_burst(size_t count, float min, float max);
+
     /// @brief Creates the particle
     /// @return The entity of the created particle
     //Entity createParticle(TEXTURE_ASSET_ID texture, Motion* motion_component_ptr);
@@ -1,12 +1,11 @@
 #include "pathfinding_system.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
 
-float ELAPSED = 0;
-int MOB_DIRECTION = 1;  // Default to facing up
-int UP = 0; 
-int DOWN = 1; 
-int LEFT = 2;
-int RIGHT = 3; 
-int DIRECTION_CHANGE = 0;
+const int UP = 0; 
+const int DOWN = 1; 
+const int LEFT = 2;
+const int RIGHT = 3; 
 const int MAX_NUM_CELLS_TO_SEARCH = 200;
 
 void PathfindingSystem::init(TerrainSystem* terrain_arg, PowerupSystem* powerup_system_arg)
@@ -19,10 +18,14 @@ void PathfindingSystem::step(float elapsed_ms)
 {
     Entity player = registry.players.entities[0]; 
 
-    for (Entity mob : registry.mobs.entities) {
-        Mob& mob_mob = registry.mobs.get(mob);
-      
-       
+    // Decide first which mobs need a new path, then search all of them at once. The searches only read positions and
+    // the terrain, which nothing in this step changes, so they can run on any thread and are applied below in mob order.
+    std::vector<Entity>& mobs = registry.mobs.entities;
+    std::vector<int> path_slots(mobs.size(), -1);
+    std::vector<Entity> mobs_to_path;
+    for (size_t i = 0; i < mobs.size(); i++) {
+        Entity mob = mobs[i];
+        Mob& mob_mob = registry.mobs.components[i];
 
         // Stop mob from tracking the player if mob is tracking the player and:
         // 1) player is not in the aggro range of the mob, or
@@ -43,9 +46,25 @@ void PathfindingSystem::step(float elapsed_ms)
                 mob_mob.is_tracking_player = true;
             }
 
-            std::deque<Entity> new_path = find_shortest_path(player, mob);
+            path_slots[i] = (int)mobs_to_path.size();
+            mobs_to_path.push_back(mob);
+        }
+    }
+
+    // One search per job, they are much longer than a chunk of components
+    std::vector<std::deque<int>> new_paths(mobs_to_path.size());
+    registry.jobs->parallel_for(mobs_to_path.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            new_paths[i] = find_shortest_path(player, mobs_to_path[i]);
+    });
+
+    for (size_t i = 0; i < mobs.size(); i++) {
+        Entity mob = mobs[i];
+        Mob& mob_mob = registry.mobs.components[i];
+
+        if (path_slots[i] >= 0) {
             Path& mob_path = registry.paths.get(mob);
-            mob_path.path = new_path;
+            mob_path.path = std::move(new_paths[path_slots[i]]);
 
             update_velocity_to_next_cell(mob, elapsed_ms);
         }
@@ -61,9 +80,9 @@ void PathfindingSystem::step(float elapsed_ms)
         // Apply new terrain speed effect if the mob enters a new cell
         if (entered_new_cell(mob) && mob_mob.type != MOB_TYPE::GHOST) {
             // Get the cell the mob was previously in and the new cell the mob is in
-            Entity prev_mob_cell = mob_mob.curr_cell;
-            Motion& mob_motion = registry.motions.get(mob);
-            Entity new_mob_cell = terrain->get_cell(mob_motion.position);
+            int prev_mob_cell = mob_mob.curr_cell;
+            MotionRef mob_motion = registry.motions.get(mob);
+            int new_mob_cell = terrain->get_cell(mob_motion.position);
             
             // Update cell mob is currently in
             mob_mob.curr_cell = new_mob_cell;
@@ -82,10 +101,10 @@ void PathfindingSystem::step(float elapsed_ms)
             auto& animation = registry.animations.get(mob);
 
             // Update prev_mframex for the next step
-            int prev_mframex = DIRECTION_CHANGE;
+            int prev_mframex = direction_change;
 
             // Adjust this for mob animation speed
-            ELAPSED += elapsed_ms;
+            animation_elapsed_ms += elapsed_ms;
 
             // Get the current location of the mob
             float curr_loc_x = registry.motions.get(mob).position[0];
@@ -96,49 +115,49 @@ void PathfindingSystem::step(float elapsed_ms)
 
             // Check Mobs movement and update mob direction 
             if (dx > 0 && dy == 0)
-                MOB_DIRECTION = RIGHT; // Mob is moving to the right
+                mob_direction = RIGHT; // Mob is moving to the right
             else if (dx < 0 && dy == 0)
-                MOB_DIRECTION = LEFT;// Mob is moving to the left
+                mob_direction = LEFT;// Mob is moving to the left
             else if (dy > 0 && dx == 0)
-                MOB_DIRECTION = DOWN;// Mob is moving down
+                mob_direction = DOWN;// Mob is moving down
             else if (dy < 0 && dx == 0)
-                MOB_DIRECTION = UP; // Mob is moving up
+                mob_direction = UP; // Mob is moving up
 
             if (dx > 0 && dy > 0)
-                MOB_DIRECTION = RIGHT;// Mob is moving down and to the right
+                mob_direction = RIGHT;// Mob is moving down and to the right
             else if (dx > 0 && dy < 0)
-                MOB_DIRECTION = UP;// Mob is moving up and to the right
+                mob_direction = UP;// Mob is moving up and to the right
             else if (dx < 0 && dy > 0)
-                MOB_DIRECTION = LEFT;// Mob is moving down and to the left
+                mob_direction = LEFT;// Mob is moving down and to the left
             else if (dx < 0 && dy < 0)
-                MOB_DIRECTION = UP;// Mob is moving up and to the left
+                mob_direction = UP;// Mob is moving up and to the left
 
             // Calculate the direction based on the change in positions
             if (prev_loc_x < curr_loc_x)
-                DIRECTION_CHANGE = 1;// Mob moved right
+                direction_change = 1;// Mob moved right
             else if (prev_loc_x > curr_loc_x)
-                DIRECTION_CHANGE = 2; // Mob moved left
+                direction_change = 2; // Mob moved left
             else if (prev_loc_y < curr_loc_y)
-                DIRECTION_CHANGE = 3;// Mob moved down
+                direction_change = 3;// Mob moved down
             else if (prev_loc_y > curr_loc_y)
-                DIRECTION_CHANGE = 4;// Mob moved up
+                direction_change = 4;// Mob moved up
 
 
             // Check for a change in direction
-            if (DIRECTION_CHANGE != prev_mframex) {
+            if (direction_change != prev_mframex) {
                 // Direction changed, so reset frame x
-                DIRECTION_CHANGE = 0;
+                direction_change = 0;
                 animation.framex = 0;
             }
 
 
             // Update mobs's direction
-            animation.framey = MOB_DIRECTION;
+            animation.framey = mob_direction;
 
-            if (ELAPSED > 50) {
+            if (animation_elapsed_ms > 50) {
                 // Update walking animation
                 animation.framex = (animation.framex + 1) % 7;
-                ELAPSED = 0.0f; // Reset the timer
+                animation_elapsed_ms = 0.0f; // Reset the timer
             }
         }
 
@@ -148,13 +167,13 @@ void PathfindingSystem::step(float elapsed_ms)
 };
 
 
-std::deque<Entity> PathfindingSystem::find_shortest_path(Entity player, Entity mob)
+std::deque<int> PathfindingSystem::find_shortest_path(Entity player, Entity mob)
 {
     // Get the cells the player and mob are in
-    Motion& player_motion = registry.motions.get(player);
-    Motion& mob_motion = registry.motions.get(mob);
-    Entity player_cell = terrain->get_cell(player_motion.position);
-    Entity mob_cell = terrain->get_cell(mob_motion.position);
+    MotionRef player_motion = registry.motions.get(player);
+    MotionRef mob_motion = registry.motions.get(mob);
+    int player_cell = terrain->get_cell(player_motion.position);
+    int mob_cell = terrain->get_cell(mob_motion.position);
 
     // Initialize predecessor array for BFS
     // predecessor is a map of key, value pairs where the key corresponds to an index of a cell in the world grid 
@@ -176,24 +195,24 @@ std::deque<Entity> PathfindingSystem::find_shortest_path(Entity player, Entity m
     }
 
     // Get shortest path by backtracking through predecessors
-    std::deque<Entity> path;
+    std::deque<int> path;
     path.push_front(player_cell);
-    int index = terrain->get_cell_index(player_cell);
+    int index = player_cell;
     while (predecessor.count(index) == 1) {
-        path.push_front(terrain->get_cell(predecessor[index]));
+        path.push_front(predecessor[index]);
         index = predecessor[index];
     }
 
     return path;
 };
 
-bool PathfindingSystem::BFS(Entity player_cell, Entity mob_cell, std::unordered_map<int, int>& predecessor)
+bool PathfindingSystem::BFS(int player_cell, int mob_cell, std::unordered_map<int, int>& predecessor)
 {
     // Accumulator for number of cells searched
     int num_cells_searched = 0;
 
     // Initialize queue for BFS
-    std::queue<Entity> bfs_queue;
+    std::queue<int> bfs_queue;
 
     // Initialize visited array for BFS
     // visited is a map of key, value pairs where the key corresponds to the index of a cell in the world grid
@@ -201,7 +220,7 @@ bool PathfindingSystem::BFS(Entity player_cell, Entity mob_cell, std::unordered_
     std::unordered_map<int, bool> visited;
 
     // Start BFS from mob cell so mark it as visited and add to BFS queue
-    visited[terrain->get_cell_index(mob_cell)] = true;
+    visited[mob_cell] = true;
     bfs_queue.push(mob_cell);
 
     // BFS algorithm
@@ -212,25 +231,23 @@ bool PathfindingSystem::BFS(Entity player_cell, Entity mob_cell, std::unordered_
         }
 
         // Get and remove first cell from queue
-        Entity curr = bfs_queue.front();
-        int curr_cell_index = terrain->get_cell_index(curr);
+        int curr_cell_index = bfs_queue.front();
         bfs_queue.pop();
 
         // Get neighbors of cell
-        std::vector<Entity> neighbors;
-        terrain->get_accessible_neighbours(curr, neighbors, true); // BFS is only used by ghost, so we can ignore colliders here
+        std::vector<int> neighbors;
+        terrain->get_accessible_neighbours(curr_cell_index, neighbors, true); // BFS is only used by ghost, so we can ignore colliders here
 
-        for (Entity neighbor : neighbors) {
-            int neighbor_cell_index = terrain->get_cell_index(neighbor);
+        for (int neighbor_cell_index : neighbors) {
 
             // Set cell as visited, save its predecessor, and add it to the BFS queue if cell has not been visited yet
             if (visited.count(neighbor_cell_index) == 0) {
                 visited[neighbor_cell_index] = true;
                 predecessor[neighbor_cell_index] = curr_cell_index;
-                bfs_queue.push(neighbor);
+                bfs_queue.push(neighbor_cell_index);
 
                 // Stop BFS if the cell is the one the player is in
-                if (player_cell == neighbor) {
+                if (player_cell == neighbor_cell_index) {
                     return true;
                 }
             }
@@ -240,13 +257,22 @@ bool PathfindingSystem::BFS(Entity player_cell, Entity mob_cell, std::unordered_
     return false;
 };
 
-bool PathfindingSystem::A_star(Entity player_cell, Entity mob_cell, std::unordered_map<int, int>& predecessor)
+bool PathfindingSystem::A_star(int player_cell, int mob_cell, std::unordered_map<int, int>& predecessor)
 {
+    PROFILE_SCOPE("A_star");
+    static Histogram& cells_expanded = Metrics::histogram("pathfinding.astar_cells_expanded", 1.0);
+
     // Limit number of cells to search
     int num_cells_searched = 0;
 
+    // Every search ends here, recording how many cells it expanded
+    auto finish = [&](bool found) {
+        cells_expanded.record(num_cells_searched);
+        return found;
+    };
+
     // Resusable values
-    Motion& player_cell_motion = registry.motions.get(player_cell);
+    vec2 player_cell_position = terrain->get_cell_position(player_cell);
 
     // Initialize open priority queue for A*
     // Open is a min priority queue of pairs (x, y) ordered by x, where y = the index of a cell and x = f (f = g + h, 
@@ -268,7 +294,7 @@ bool PathfindingSystem::A_star(Entity player_cell, Entity mob_cell, std::unorder
     std::unordered_map<int, float> g;
 
     // Start A* from the mob cell so add it to open and set its g to 0
-    int mob_cell_index = terrain->get_cell_index(mob_cell);
+    int mob_cell_index = mob_cell;
     open.push(std::make_pair(0, mob_cell_index));
     g[mob_cell_index] = 0;
 
@@ -276,29 +302,27 @@ bool PathfindingSystem::A_star(Entity player_cell, Entity mob_cell, std::unorder
     while (!open.empty()) {
         // Stop search if going for too long
         if (num_cells_searched++ > MAX_NUM_CELLS_TO_SEARCH) {
-            return true;
+            return finish(true);
         }
 
         // Get and remove top cell (i.e. cell with min total cost) from open
         std::pair<float, int> p = open.top();
         open.pop();
         int curr_cell_index = p.second;
-        Entity curr = terrain->get_cell(curr_cell_index);
 
         // Set cell to closed
         closed[curr_cell_index] = true;
 
         // Stop A* if the cell is the one the player is in
-        if (curr == player_cell) {
-            return true;
+        if (curr_cell_index == player_cell) {
+            return finish(true);
         }
 
         // Get neighbors of cell
-        std::vector<Entity> neighbors;
-        terrain->get_accessible_neighbours(curr, neighbors, false);
+        std::vector<int> neighbors;
+        terrain->get_accessible_neighbours(curr_cell_index, neighbors, false);
 
-        for (Entity neighbor : neighbors) {
-            int neighbor_cell_index = terrain->get_cell_index(neighbor);
+        for (int neighbor_cell_index : neighbors) {
 
             // Skip neighbor if it is closed
             if (closed.count(neighbor_cell_index) == 1) {
@@ -306,9 +330,8 @@ bool PathfindingSystem::A_star(Entity player_cell, Entity mob_cell, std::unorder
             }
 
             // Calculate costs
-            Motion& neighbor_motion = registry.motions.get(neighbor);
-            float neighbor_g = g[curr_cell_index] + (1.0f * (1/terrain->get_terrain_speed_ratio(neighbor)));
-            float neighbor_h = distance(neighbor_motion.position, player_cell_motion.position);
+            float neighbor_g = g[curr_cell_index] + (1.0f * (1/terrain->get_terrain_speed_ratio(neighbor_cell_index)));
+            float neighbor_h = distance(terrain->get_cell_position(neighbor_cell_index), player_cell_position);
             float neighbor_f = neighbor_g + neighbor_h;
 
             // Do not add neighbor to open if it is already in open and came from a path with lower cost
@@ -323,16 +346,16 @@ bool PathfindingSystem::A_star(Entity player_cell, Entity mob_cell, std::unorder
         }
     }
 
-    return false;
+    return finish(false);
 }
 
 bool PathfindingSystem::same_cell(Entity player, Entity mob)
 {
     // Get cells the player and mob are in
-    Motion& player_motion = registry.motions.get(player);
-    Motion& mob_motion = registry.motions.get(mob);
-    Entity player_cell = terrain->get_cell(player_motion.position);
-    Entity mob_cell = terrain->get_cell(mob_motion.position);
+    MotionRef player_motion = registry.motions.get(player);
+    MotionRef mob_motion = registry.motions.get(mob);
+    int player_cell = terrain->get_cell(player_motion.position);
+    int mob_cell = terrain->get_cell(mob_motion.position);
 
     // Check if player is in the same cell as the mob
     return player_cell == mob_cell;
@@ -342,10 +365,10 @@ bool PathfindingSystem::same_cell(Entity player, Entity mob)
 bool PathfindingSystem::reached_next_cell(Entity mob)
 {
     // Get the next cell in the path and the cell the mob is in
-    Motion& mob_motion = registry.motions.get(mob);
-    Entity curr_cell = terrain->get_cell(mob_motion.position);
+    MotionRef mob_motion = registry.motions.get(mob);
+    int curr_cell = terrain->get_cell(mob_motion.position);
     Path& mob_path = registry.paths.get(mob);
-    Entity next_cell = mob_path.path.front();
+    int next_cell = mob_path.path.front();
 
     // Check if mob's current cell is the next cell
     return curr_cell == next_cell;
@@ -354,10 +377,10 @@ bool PathfindingSystem::reached_next_cell(Entity mob)
 bool PathfindingSystem::has_player_moved(Entity player, Entity mob) 
 {
     // Get the cell the player is in and the cell the mob believes the player is in
-    Motion& player_motion = registry.motions.get(player);
-    Entity curr_cell_of_player = terrain->get_cell(player_motion.position);
+    MotionRef player_motion = registry.motions.get(player);
+    int curr_cell_of_player = terrain->get_cell(player_motion.position);
     Path& mob_path = registry.paths.get(mob);
-    Entity expected_cell_of_player = mob_path.path.back();
+    int expected_cell_of_player = mob_path.path.back();
 
     // Check if the cell the player is in and the cell the mob believes the player is in are different
     return curr_cell_of_player != expected_cell_of_player;
@@ -366,7 +389,7 @@ bool PathfindingSystem::has_player_moved(Entity player, Entity mob)
 void PathfindingSystem::stop_tracking_player(Entity mob) 
 {
     // Get the motion, mob, path, and current cell of the mob
-    Motion& mob_motion = registry.motions.get(mob);
+    MotionRef mob_motion = registry.motions.get(mob);
     Mob& mob_mob = registry.mobs.get(mob);
     Path& mob_path = registry.paths.get(mob);
 
@@ -378,8 +401,8 @@ void PathfindingSystem::stop_tracking_player(Entity mob)
 
 bool PathfindingSystem::is_player_in_mob_aggro_range(Entity player, Entity mob) {
     // Get the player and mob motion and aggro range of the mob
-    Motion& player_motion = registry.motions.get(player);
-    Motion& mob_motion = registry.motions.get(mob);
+    MotionRef player_motion = registry.motions.get(player);
+    MotionRef mob_motion = registry.motions.get(mob);
     Mob& mob_mob = registry.mobs.get(mob);
     float mob_aggro_range = mob_mob.aggro_range;
 
@@ -394,22 +417,22 @@ bool PathfindingSystem::entered_new_cell(Entity mob)
 {
     // Get the cell the mob is expected to be in and the actual cell the mob is in 
     Mob& mob_mob = registry.mobs.get(mob);
-    Entity expected_mob_cell = mob_mob.curr_cell;
-    Motion& mob_motion = registry.motions.get(mob);
-    Entity actual_mob_cell = terrain->get_cell(mob_motion.position);
+    int expected_mob_cell = mob_mob.curr_cell;
+    MotionRef mob_motion = registry.motions.get(mob);
+    int actual_mob_cell = terrain->get_cell(mob_motion.position);
 
     // Check if mob has entered a new cell
     return expected_mob_cell != actual_mob_cell;
 }
 
-void PathfindingSystem::apply_new_terrain_speed_effect(Entity mob, Entity prev_cell, Entity new_cell)
+void PathfindingSystem::apply_new_terrain_speed_effect(Entity mob, int prev_cell, int new_cell)
 {
     // Get previous and new terrain speed ratios
     float prev_terrain_speed_ratio = terrain->get_terrain_speed_ratio(prev_cell);
     float new_terrain_speed_ratio = terrain->get_terrain_speed_ratio(new_cell);
 
     // Remove previous terrain speed effect and apply new terrain speed effect
-    Motion& mob_motion = registry.motions.get(mob);
+    MotionRef mob_motion = registry.motions.get(mob);
     mob_motion.velocity /= prev_terrain_speed_ratio;
     mob_motion.velocity *= new_terrain_speed_ratio;
 
@@ -428,7 +451,7 @@ void PathfindingSystem::apply_new_terrain_speed_effect(Entity mob, Entity prev_c
 void PathfindingSystem::update_velocity_to_next_cell(Entity mob, float elapsed_ms)
 {
     Path& mob_path = registry.paths.get(mob);
-    Motion& mob_motion = registry.motions.get(mob);
+    MotionRef mob_motion = registry.motions.get(mob);
 
     // Stop mob from tracking the player if it has reached the last cell in its path
     if (mob_path.path.size() <= 1) {
@@ -437,13 +460,12 @@ void PathfindingSystem::update_velocity_to_next_cell(Entity mob, float elapsed_m
     }
 
     // Get and remove previous cell in the path
-    Entity prev_cell = mob_path.path.front();
+    int prev_cell = mob_path.path.front();
     mob_path.path.pop_front();
 
     // Get angle to next cell in the path 
-    Entity next_cell = mob_path.path.front();
-    Motion& next_cell_motion = registry.motions.get(next_cell);
-    float angle = atan2(next_cell_motion.position.y - mob_motion.position.y, next_cell_motion.position.x - mob_motion.position.x);
+    vec2 next_cell_position = terrain->get_cell_position(mob_path.path.front());
+    float angle = atan2(next_cell_position.y - mob_motion.position.y, next_cell_position.x - mob_motion.position.x);
 
     // Update the velocity of the mob based on angle, the mob's speed ratio, and the terrain's speed ratio
     Mob& mob_mob = registry.mobs.get(mob);
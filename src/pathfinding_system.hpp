@@ -19,7 +19,7 @@
 class PathfindingSystem
 {
 public:
-	PathfindingSystem() {};
+	explicit PathfindingSystem(ECSRegistry& registry_arg) : registry(registry_arg) {};
 
 	/// <summary>
 	/// Initializes path finding system
@@ -34,10 +34,17 @@ public:
 	void step(float elapsed_ms);
 
 private:
+	/// Registry of the world the mobs live in
+	ECSRegistry& registry;
 	/// Terrain system pointer
 	TerrainSystem* terrain;
 	PowerupSystem* powerup_system;
 
+	// Mob walking animation state
+	float animation_elapsed_ms = 0;
+	int mob_direction = 1;	// Default to facing up
+	int direction_change = 0;
+
 
     /// <summary>
 	/// Finds the shortest path between a mob and the player
@@ -46,37 +53,37 @@ private:
 	/// <param name="player">The player entity</param>
 	/// <param name="mob">The mob entity</param>
     /// <returns>
-    /// Returns the shortest path as a deque of Entities which correspond to cells in the world grid. 
+    /// Returns the shortest path as a deque of indices of cells in the world grid. 
     /// Initially, the cell the mob is in is at the front of the deque and the cell the player is in is at the end of 
 	/// the deque
     /// </returns>
-    std::deque<Entity> find_shortest_path(Entity player, Entity mob);
+    std::deque<int> find_shortest_path(Entity player, Entity mob);
 
 	/// <summary>
 	/// Performs A* over the world grid cells, starting from the cell the mob is in, to find the shortest path to the 
 	/// cell the player is in. Since euclidean distance is used as the heuristic, the heuristic is admissible and A* 
 	/// will always find the shortest path. 
 	/// </summary>
-	/// <param name="player_cell">The cell the player is in</param>
-	/// <param name="mob_cell">The cell the mob is in</param>
+	/// <param name="player_cell">The index of the cell the player is in</param>
+	/// <param name="mob_cell">The index of the cell the mob is in</param>
 	/// <param name="predecessor">
     /// A map of key, value pairs where the key corresponds to an index of a cell in the world grid and the value 
 	/// represents the index of the immediate predecessor of the cell found during A*
     /// </param>
-    bool A_star(Entity player_cell, Entity mob_cell, std::unordered_map<int, int>& predecessor);
+    bool A_star(int player_cell, int mob_cell, std::unordered_map<int, int>& predecessor);
 
 	/// <summary>
 	/// Conducts a BFS over the world grid cells, starting from the cell the mob is in, to find the shortest path 
     /// to the cell the player is in
     /// Reference: https://www.geeksforgeeks.org/shortest-path-unweighted-graph/
 	/// </summary>
-	/// <param name="player_cell">The cell the player is in</param>
-	/// <param name="mob_cell">The cell the mob is in</param>
+	/// <param name="player_cell">The index of the cell the player is in</param>
+	/// <param name="mob_cell">The index of the cell the mob is in</param>
 	/// <param name="predecessor">
     /// A map of key, value pairs where the key corresponds to an index of a cell in the world grid and the value 
 	/// represents the index of the immediate predecessor of the cell found during BFS
     /// </param>
-	bool BFS(Entity player_cell, Entity mob_cell, std::unordered_map<int, int>& predecessor);
+	bool BFS(int player_cell, int mob_cell, std::unordered_map<int, int>& predecessor);
 
     /// <summary>
 	/// Checks if the player and a mob are in the same cell
@@ -131,7 +138,7 @@ private:
 	/// <param name="prev_cell">The previous cell the mob was in</param>
 	/// <param name="new_cell">The new cell the mob is in</param>
     /// <returns>Returns the terrain speed ratio of the cell</returns>
-    void apply_new_terrain_speed_effect(Entity mob, Entity prev_cell, Entity new_cell);
+    void apply_new_terrain_speed_effect(Entity mob, int prev_cell, int new_cell);
 
     /// <summary>
 	/// Updates a mob’s velocity to move to the next cell in its path
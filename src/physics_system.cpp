@@ -1,5 +1,15 @@
 // internal
 #include "physics_system.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
+
+namespace {
+	// Always-on counters of the collision detection, see Metrics
+	Counter& pairs_tested = Metrics::counter("physics.pairs_tested");
+	Counter& pairs_hit = Metrics::counter("physics.pairs_hit");
+	Counter& sat_calls = Metrics::counter("physics.sat_calls");
+	Counter& bvh_nodes_visited = Metrics::counter("physics.bvh_nodes_visited");
+}
 
 #pragma region Collider creation related function
 
@@ -20,17 +30,24 @@ void PhysicsSystem::createBoundingBox(std::vector<vec2>& points, vec2 scale) {
 
 void PhysicsSystem::createDefaultCollider(Entity entity) {
 
-	auto& motion = registry.motions.get(entity);
-	auto& collider = registry.colliders.emplace(entity);
+	MotionRef motion = registry.motions.get(entity);
+	Collider collider = makeBoxCollider(motion.position, motion.scale, motion.angle);
+
+	registry.colliders.insert(entity, std::move(collider));
+}
+
+Collider PhysicsSystem::makeBoxCollider(vec2 position, vec2 scale, float angle) {
+
+	Collider collider;
 
 	// world position, used in collision detection. This needs to be updated by physics::step
-	collider.position = motion.position;
+	collider.position = position;
 
 	// generating points in local coord(center at 0,0)
 	std::vector<glm::vec2> points;
 
 	// HARDCODED TO BOX NOW. Assuming all entity will use a box collider
-	createBoundingBox(points, motion.scale);
+	createBoundingBox(points, scale);
 
 	// generating normals
 	vec2 edge;
@@ -45,24 +62,33 @@ void PhysicsSystem::createDefaultCollider(Entity entity) {
 	collider.points = std::move(points);
 
 	// rotation
-	collider.rotation = mat2(cos(motion.angle), -sin(motion.angle), sin(motion.angle), cos(motion.angle));
+	collider.rotation = mat2(cos(angle), -sin(angle), sin(angle), cos(angle));
 
 	// scale
-	collider.scale = motion.scale;
+	collider.scale = scale;
 
 	// flags
 	collider.flag = 0;
 
+	return collider;
 }
 
 void PhysicsSystem::createMeshCollider(Entity entity, GEOMETRY_BUFFER_ID geom_id, RenderSystem* renderer) {
 
-	auto& motion = registry.motions.get(entity);
-	auto& collider = registry.colliders.emplace(entity);
+	MotionRef motion = registry.motions.get(entity);
+	Collider collider = makeMeshCollider(geom_id, renderer, motion.scale);
 
 	// world position, used in collision detection. This needs to be updated by physics::step
 	collider.position = motion.position;
 
+	registry.colliders.insert(entity, std::move(collider));
+}
+
+Collider PhysicsSystem::makeMeshCollider(GEOMETRY_BUFFER_ID geom_id, RenderSystem* renderer, vec2 scale) {
+
+	Collider collider;
+	collider.position = { 0.f, 0.f };
+
 	std::vector<vec2> points;
 
 	// grabing vertice from corresponding mesh
@@ -92,17 +118,18 @@ void PhysicsSystem::createMeshCollider(Entity entity, GEOMETRY_BUFFER_ID geom_id
 	collider.rotation = mat2(cos(0.f), -sin(0.f), sin(0.f), cos(0.f));
 
 	// scale
-	collider.scale = motion.scale;
+	collider.scale = scale;
 
 	// flags
 	collider.flag = 0;
 
+	return collider;
 }
 
 void PhysicsSystem::createCustomsizeBoxCollider(Entity entity, vec2 scale) {
 
-	auto& motion = registry.motions.get(entity);
-	auto& collider = registry.colliders.emplace(entity);
+	MotionRef motion = registry.motions.get(entity);
+	Collider collider;
 
 	// world position, used in collision detection. This needs to be updated by physics::step
 	collider.position = motion.position;
@@ -134,6 +161,8 @@ void PhysicsSystem::createCustomsizeBoxCollider(Entity entity, vec2 scale) {
 	// flags
 	collider.flag = 0;
 
+	// inserted once complete, so the collider observers see the final collider
+	registry.colliders.insert(entity, std::move(collider));
 }
 
 #pragma endregion
@@ -146,7 +175,7 @@ vec2 invertHelper(vec2 MTV)
 }
 
 // Broad phase collision detection in Axis Aligned Bounding Box (AABB)
-bool AABBCollides(const Collider& collider1, const Collider& collider2)
+bool AABBCollides(const ColliderRef& collider1, const ColliderRef& collider2)
 {
 	float xPos1 = collider1.position.x;
 	float yPos1 = collider1.position.y;
@@ -177,7 +206,7 @@ bool AABBCollides(const Collider& collider1, const Collider& collider2)
 
 }
 
-bool AABBCollides(const Collider& collider1, vec2 aabbMin, vec2 aabbMax)
+bool AABBCollides(const ColliderRef& collider1, vec2 aabbMin, vec2 aabbMax)
 {
 	float xPos1 = collider1.position.x;
 	float yPos1 = collider1.position.y;
@@ -206,8 +235,10 @@ bool AABBCollides(const Collider& collider1, vec2 aabbMin, vec2 aabbMax)
 // Separating axis theorem(SAT): if there are no axises(all normals of two collider's edges) that seperates two collider,
 // then they must intercept each other.
 // reference: https://gamedev.stackexchange.com/questions/105296/calculation-correct-position-of-object-after-collision-2d
-std::tuple <bool, float, vec2> SATcollides(const Collider& collider1, const Collider& collider2)
+std::tuple <bool, float, vec2> SATcollides(const ColliderRef& collider1, const ColliderRef& collider2)
 {
+	PROFILE_SCOPE("SATcollides");
+	sat_calls.add();
 	vec2 minimalTranslationVector;
 	float overlap = 10000;
 
@@ -406,9 +437,10 @@ std::tuple <bool, float, vec2> SATcollides(const Collider& collider1, const Coll
 /// <param name="entity1"></param>
 /// <param name="entity2"></param>
 bool PhysicsSystem::collides(Entity entity1, Entity entity2) {
-	auto& c1 = registry.colliders.get(entity1);
-	auto& c2 = registry.colliders.get(entity2);
+	ColliderRef c1 = registry.colliders.get(entity1);
+	ColliderRef c2 = registry.colliders.get(entity2);
 	bool isCollide = false; 
+	pairs_tested.add();
 	if (distance(c1.position, c2.position) < detectRange) {
 		if (AABBCollides(c1, c2)) {
 			auto result = SATcollides(c1, c2);
@@ -419,6 +451,8 @@ bool PhysicsSystem::collides(Entity entity1, Entity entity2) {
 
 			if (isCollide)
 			{
+				pairs_hit.add();
+
 				// Create a collisions event
 				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
 				registry.collisions.emplace_with_duplicates(entity1, entity2, overlap, MTV);
@@ -436,15 +470,110 @@ bool PhysicsSystem::collides(Entity entity1, Entity entity2) {
 
 #pragma region Bounding Volume Hierarchy for static collider
 
-void PhysicsSystem::initStaticBVH(size_t numberOfColliders) {
-	this->numberOfColliders = numberOfColliders;
+void PhysicsSystem::initStaticBVH(TerrainSystem* terrain) {
+	PROFILE_SCOPE("initStaticBVH");
+	this->terrain = terrain;
+
+	// every collidable tile of the active chunks is a primitive, in cell order
+	colliderMapping.clear();
+	terrain->get_active_colliders(colliderMapping);
+	this->bvhVersion = terrain->get_active_version();
+
+	this->numberOfColliders = (int)colliderMapping.size();
+	this->nodeUsed = 1;
 	this->bvhTree.clear();
-	this->bvhTree.resize(2 * numberOfColliders - 1);
-	this->colliderMapping.resize(this->numberOfColliders);
+	this->bvhTree.resize(std::max(2 * numberOfColliders - 1, 1));
 
-	std::cout << "started building BVH" << std::endl;
 	buildBVH();
-	std::cout << "done building BVH" << std::endl;
+}
+
+void PhysicsSystem::addTerrainCollider(int cell)
+{
+	// the tiles of inactive chunks are added when their chunk is activated and the tree rebuilt
+	if (!terrain->is_active(cell))
+		return;
+
+	// a tree without primitives has no leaf to insert into, build it anew with the tile
+	if (numberOfColliders == 0)
+		initStaticBVH(terrain);
+	else if (!bvhTree.empty())
+		insertIntoBVH(cell);
+}
+
+void PhysicsSystem::removeTerrainCollider(int cell)
+{
+	if (numberOfColliders > 0)
+		removeFromBVH(cell, rootNodeIndex);
+}
+
+void PhysicsSystem::growNodeBounds(int nodeIndex, int cell)
+{
+	BVHNode& node = bvhTree[nodeIndex];
+	vec2 position = terrain->get_cell_position(cell);
+	node.aabbMin.x = fminf(node.aabbMin.x, position.x - (tileCollider.scale.x / 2));
+	node.aabbMin.y = fminf(node.aabbMin.y, position.y - (tileCollider.scale.y / 2));
+	node.aabbMax.x = fmaxf(node.aabbMax.x, position.x + (tileCollider.scale.x / 2));
+	node.aabbMax.y = fmaxf(node.aabbMax.y, position.y + (tileCollider.scale.y / 2));
+}
+
+void PhysicsSystem::insertIntoBVH(int cell)
+{
+	vec2 position = terrain->get_cell_position(cell);
+
+	// descend into the child whose box is closest to the tile, growing the boxes on the way
+	int nodeIndex = rootNodeIndex;
+	while (bvhTree[nodeIndex].primitiveCount == 0) {
+		growNodeBounds(nodeIndex, cell);
+		int left = bvhTree[nodeIndex].leftFirst;
+		vec2 toLeft = max(max(bvhTree[left].aabbMin - position, position - bvhTree[left].aabbMax), vec2(0.f));
+		vec2 toRight = max(max(bvhTree[left + 1].aabbMin - position, position - bvhTree[left + 1].aabbMax), vec2(0.f));
+		nodeIndex = (dot(toLeft, toLeft) <= dot(toRight, toRight)) ? left : left + 1;
+	}
+	growNodeBounds(nodeIndex, cell);
+
+	// re-use the slot of a removed collider, e.g. when the editor toggles a tile back
+	BVHNode leaf = bvhTree[nodeIndex];
+	for (int i = 0; i < leaf.primitiveCount; i++) {
+		if (colliderMapping[leaf.leftFirst + i] < 0) {
+			colliderMapping[leaf.leftFirst + i] = cell;
+			return;
+		}
+	}
+
+	// otherwise the leaf becomes an internal node over its old colliders and a new leaf with this one
+	int leftChildIndex = nodeUsed++;
+	int rightChildIndex = nodeUsed++;
+	if (bvhTree.size() < (size_t)nodeUsed)
+		bvhTree.resize(nodeUsed);
+	bvhTree[leftChildIndex] = leaf;
+	bvhTree[rightChildIndex].leftFirst = (int)colliderMapping.size();
+	bvhTree[rightChildIndex].primitiveCount = 1;
+	colliderMapping.push_back(cell);
+	updateNodeBounds(rightChildIndex);
+
+	bvhTree[nodeIndex].leftFirst = leftChildIndex;
+	bvhTree[nodeIndex].primitiveCount = 0;
+}
+
+bool PhysicsSystem::removeFromBVH(int cell, int nodeIndex)
+{
+	// the tile is inside the boxes of all nodes that hold it, so only those are searched
+	BVHNode& node = bvhTree[nodeIndex];
+	vec2 position = terrain->get_cell_position(cell);
+	if (any(lessThan(position, node.aabbMin)) || any(greaterThan(position, node.aabbMax)))
+		return false;
+
+	if (node.primitiveCount > 0) {
+		for (int i = 0; i < node.primitiveCount; i++) {
+			if (colliderMapping[node.leftFirst + i] == cell) {
+				// leave an empty slot, the boxes stay as they are until the next build
+				colliderMapping[node.leftFirst + i] = -1;
+				return true;
+			}
+		}
+		return false;
+	}
+	return removeFromBVH(cell, node.leftFirst) || removeFromBVH(cell, node.leftFirst + 1);
 }
 
 void PhysicsSystem::updateNodeBounds(int nodeIndex)
@@ -453,18 +582,13 @@ void PhysicsSystem::updateNodeBounds(int nodeIndex)
 
 	// initialize very big number
 	node.aabbMin = { 1e30f, 1e30f };
-	node.aabbMin = { -1e30f, -1e30f };
+	node.aabbMax = { -1e30f, -1e30f };
 
 	// loop through each collider under the node
 	for (int first = node.leftFirst, i = 0; i < node.primitiveCount; i++)
 	{
-		auto& collider = registry.colliders.components[this->colliderMapping[first + i]];
-
-		node.aabbMin.x = fminf(node.aabbMin.x, collider.position.x - (collider.scale.x / 2));
-		node.aabbMin.y = fminf(node.aabbMin.y, collider.position.y - (collider.scale.y / 2));
-
-		node.aabbMax.x = fmaxf(node.aabbMax.x, collider.position.x + (collider.scale.x / 2));
-		node.aabbMax.y = fmaxf(node.aabbMax.y, collider.position.y + (collider.scale.y / 2));
+		if (this->colliderMapping[first + i] >= 0)
+			growNodeBounds(nodeIndex, this->colliderMapping[first + i]);
 	}
 }
 
@@ -498,8 +622,8 @@ void PhysicsSystem::subDivide(int nodeIndex)
 
 	while (i <= j)
 	{
-		// if the collider center is to the left of split axis, it belong to left child
-		if (registry.colliders.components[colliderMapping[i]].position[axis] < splitPos) {
+		// if the tile center is to the left of split axis, it belong to left child
+		if (terrain->get_cell_position(colliderMapping[i])[axis] < splitPos) {
 			i++;
 		}
 		else {
@@ -544,13 +668,7 @@ void PhysicsSystem::subDivide(int nodeIndex)
 
 void PhysicsSystem::buildBVH()
 {
-	auto& collider_container = registry.colliders.components;
-
-	// populate the mapping array for an indirect reference
-	for (int i = 0; i < colliderMapping.size(); i++)
-	{
-		colliderMapping[i] = i;
-	}
+	// the mapping array of cell indices was filled by initStaticBVH, the tree only reorders it
 
 	// set up root node's child node
 	BVHNode& root = bvhTree[rootNodeIndex];
@@ -567,8 +685,13 @@ void PhysicsSystem::buildBVH()
 }
 
 void PhysicsSystem::intersectBVH(Entity entity, const int nodeIndex) {
+	// no tree before the terrain is built, see initStaticBVH
+	if (bvhTree.empty() || numberOfColliders == 0)
+		return;
+
 	BVHNode& node = bvhTree[nodeIndex];
-	auto& collider = registry.colliders.get(entity);
+	ColliderRef collider = registry.colliders.get(entity);
+	bvh_nodes_visited.add();
 
 	// if does not collide with bounding box of this node, abort
 	if (!AABBCollides(collider, node.aabbMin, node.aabbMax))
@@ -577,17 +700,23 @@ void PhysicsSystem::intersectBVH(Entity entity, const int nodeIndex) {
 	// if node is a leaf node
 	if (node.primitiveCount > 0)
 	{
+		// the tiles only differ in position, so they share the shape of tileCollider
+		vec2 tilePosition;
+		ColliderRef collider_j = { tilePosition, tileCollider.points, tileCollider.normals, tileCollider.rotation, tileCollider.scale, tileCollider.flag };
+
 		// check target collider against all collider under this node
 		for (int i = 0; i < node.primitiveCount; i++)
 		{
-			Entity entity_j = registry.colliders.entities[colliderMapping[node.leftFirst + i]];
+			int cell = colliderMapping[node.leftFirst + i];
 
-			// Checking if the entity is itself 
-			if (entity != entity_j)
+			// Checking if the tile's collider was removed
+			if (cell >= 0)
 			{
-				if (AABBCollides(collider, registry.colliders.components[colliderMapping[node.leftFirst + i]]))
+				pairs_tested.add();
+				tilePosition = terrain->get_cell_position(cell);
+				if (AABBCollides(collider, collider_j))
 				{
-					auto result = SATcollides(collider, registry.colliders.components[colliderMapping[node.leftFirst + i]]);
+					auto result = SATcollides(collider, collider_j);
 					bool isCollide;
 					float overlap;
 					vec2 MTV;
@@ -595,12 +724,12 @@ void PhysicsSystem::intersectBVH(Entity entity, const int nodeIndex) {
 
 					if (isCollide)
 					{
-						// Create a collisions event
-						// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
-						registry.collisions.emplace_with_duplicates(entity, entity_j, overlap, MTV);
+						pairs_hit.add();
 
-						// inverting correction vector for other entites
-						registry.collisions.emplace_with_duplicates(entity_j, entity, overlap, invertHelper(MTV));
+						// Create a collisions event
+						// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity.
+						// Tiles are not entities and do not react, so there is no inverted collision for them.
+						registry.collisions.emplace_with_duplicates(entity, cell, overlap, MTV);
 					}
 
 				}
@@ -617,45 +746,94 @@ void PhysicsSystem::intersectBVH(Entity entity, const int nodeIndex) {
 
 #pragma endregion
 
-void PhysicsSystem::step(float elapsed_ms)
+void PhysicsSystem::integrate(float elapsed_ms)
 {
 	// POSITION UPDATE FROM VELOCITY
-	auto& motion_container = registry.motions;
-	auto& collider_container = registry.colliders;
+	// Motion is stored as a struct of arrays, so each chunk is a straight loop over two contiguous float arrays that the compiler can vectorize
+	const float step_seconds = elapsed_ms / 1000.f;
+	const size_t float_count = 2 * registry.motions.size();
+	if (float_count > 0) {
+		float* positions = &registry.motions.components.field<SoALayout<Motion>::POSITION>()[0].x;
+		const float* velocities = &registry.motions.components.field<SoALayout<Motion>::VELOCITY>()[0].x;
+		registry.motions.parallel_for(*registry.jobs, [=](size_t begin, size_t end) {
+			for (size_t i = 2 * begin; i < 2 * end; i++)
+				positions[i] += velocities[i] * step_seconds;
+		});
+
+		// Record what moved, so that the static terrain is skipped below
+		for (size_t i = 0; i < float_count; i += 2) {
+			if (velocities[i] != 0.f || velocities[i + 1] != 0.f)
+				registry.motions.mark_changed(registry.motions.entities[i / 2]);
+		}
+	}
 
-	for (uint i = 0; i < motion_container.size(); i++)
+	// adjusting collider center for objects that moved or were placed since the last step
+	registry.motions.each_changed([this](Entity entity)
 	{
-		Motion& motion = motion_container.components[i];
-		Entity entity = motion_container.entities[i];
-		motion.position += motion.velocity * elapsed_ms / 1000.f;
-
-		// adjusting collider center for moving object
-		if (collider_container.has(entity))
-		{
-			collider_container.get(entity).position = motion.position;
+		if (registry.colliders.has(entity))
+			registry.colliders.get(entity).position = registry.motions.get(entity).position;
+	});
+}
 
-			auto& player_container = registry.players;
-			if (player_container.has(entity))
-			{
-				// update collider rotation matrix since player angle changes
-				collider_container.get(entity).rotation = mat2(cos(motion.angle), -sin(motion.angle), sin(motion.angle), cos(motion.angle));
-			}
+void PhysicsSystem::detectProjectileCollisions()
+{
+	PROFILE_SCOPE("detectProjectileCollisions");
+	auto& projectile_entity_container = registry.projectiles.entities;
+	auto& mob_entity_container = registry.mobs.entities;
+	for (size_t i = 0; i < projectile_entity_container.size(); i++) {
+		intersectProjectileTerrain(projectile_entity_container[i]);
+		for (size_t j = 0; j < mob_entity_container.size(); j++)
+			collides(projectile_entity_container[i], mob_entity_container[j]);
+	}
+}
 
+void PhysicsSystem::intersectProjectileTerrain(Entity projectile)
+{
+	// there are no colliders past the active chunks, so a projectile that leaves them hits the edge of the streamed terrain
+	if (terrain != nullptr) {
+		int cell = terrain->get_nearest_cell(registry.motions.get(projectile).position);
+		if (!terrain->is_active(cell)) {
+			registry.collisions.emplace_with_duplicates(projectile, cell, 0.f, vec2(0.f));
+			return;
 		}
+	}
+	intersectBVH(projectile, rootNodeIndex);
+}
 
+void PhysicsSystem::step(float elapsed_ms)
+{
+	// the active chunks of the terrain changed since the tree was built, see TerrainSystem::stream
+	if (terrain != nullptr && terrain->get_active_version() != bvhVersion)
+		initStaticBVH(terrain);
+
+	// Fast movers are checked after every sub-step, so a projectile can not skip over a wall or a mob within one step.
+	// Everything else only collides at the end of the step, so its collisions are reported once.
+	const float substep_ms = elapsed_ms / (float)substeps;
+	for (unsigned int substep = 0; substep + 1 < substeps; substep++) {
+		integrate(substep_ms);
+		detectProjectileCollisions();
 	}
+	integrate(substep_ms);
+
+	// update collider rotation matrix since player angle changes
+	registry.view<Motion, Collider, Player>().each([](Entity entity, MotionRef motion, ColliderRef collider, Player& player)
+	{
+		collider.rotation = mat2(cos(motion.angle), -sin(motion.angle), sin(motion.angle), cos(motion.angle));
+	});
 
 	// COLLISION DETECTION 
 	 
 	// player against terrain - uses static BVH 
 	auto& player_entity = registry.players.entities[0];
-	intersectBVH(player_entity, rootNodeIndex);
-	
-	// projectile against terrain - uses static BVH
 	auto& projectile_entity_container = registry.projectiles.entities;
-
-	for (int i = 0; i < projectile_entity_container.size(); i++) {
-		intersectBVH(projectile_entity_container[i], rootNodeIndex);
+	{
+		PROFILE_SCOPE("intersectBVH");
+		intersectBVH(player_entity, rootNodeIndex);
+	
+		// projectile against terrain - uses static BVH
+		for (size_t i = 0; i < projectile_entity_container.size(); i++) {
+			intersectProjectileTerrain(projectile_entity_container[i]);
+		}
 	}
 
 	auto& mob_entity_container = registry.mobs.entities;
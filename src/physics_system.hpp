@@ -5,6 +5,7 @@
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
 #include "render_system.hpp"
+#include "terrain_system.hpp"
 #include <vector>
 #include <iostream>
 #include <cmath>
@@ -48,16 +49,26 @@ public:
 	void step(float elapsed_ms);
 	bool isPlayerInvincible = false;
 
+	// Number of pieces step() moves the entities in, projectiles are checked for collisions after every piece
+	unsigned int substeps = 1;
+
 	/// <summary>
-	/// Initializes the static BVH with N:number of colliders (all terrain colliders). Total number of tree nodes is 2N - 1.
-	/// ColliderMapping is used for indirect reference to avoid tempering with actual collider containers.
+	/// Initializes the static BVH over the N collidable cells of the terrain's active chunks. Total number of tree nodes is 2N - 1.
+	/// Tiles are not entities: every primitive is a cell index, the collider of a tile is a 1x1 box at the cell's position.
+	/// Must be called again after the terrain is re-initialized. step() calls it when the active chunks change.
 	/// </summary>
-	/// <param name="numberOfColliders">Number of colliders</param>
-	void initStaticBVH(size_t numberOfColliders);
+	/// <param name="terrain">The terrain, initialized</param>
+	void initStaticBVH(TerrainSystem* terrain);
+
+	/// <summary>
+	/// Adds or removes the collider of a tile after the build, e.g. when the map editor toggles TERRAIN_FLAGS::COLLIDABLE
+	/// </summary>
+	/// <param name="cell">The index of the tile</param>
+	void addTerrainCollider(int cell);
+	void removeTerrainCollider(int cell);
 
 	/// <summary>
 	/// building a static BVH tree for all terrain colliders in a top down approach.
-	/// This must be call after creating terrain colliders and before all other colliders such as items, mobs....
 	/// citation for reference1: https://jacco.ompf2.com/2022/04/13/how-to-build-a-bvh-part-1-basics/
 	/// reference2: https://box2d.org/files/ErinCatto_DynamicBVH_Full.pdf
 	/// </summary>
@@ -80,6 +91,15 @@ public:
 	/// <returns>void</returns>
 	void createBoundingBox(std::vector<vec2>& points, vec2 scale);
 
+	/// <summary>
+	/// Build a box collider without attaching it, e.g. for the terrain tiles.
+	/// </summary>
+	/// <param name="position">position of the collider</param>
+	/// <param name="scale">width and height of the box</param>
+	/// <param name="angle">rotation of the box</param>
+	/// <returns>the collider</returns>
+	Collider makeBoxCollider(vec2 position, vec2 scale, float angle);
+
 
 	/// <summary>
 	/// Create a box shape collider of size based on entity's scale at entity's motion location. 
@@ -96,6 +116,15 @@ public:
 	/// <returns>void</returns>
 	void createMeshCollider(Entity entity, GEOMETRY_BUFFER_ID geom_id, RenderSystem* renderer);
 
+	/// <summary>
+	/// Build a convex hull collider from the corresponding mesh without attaching it, e.g. as part of a prefab.
+	/// The position is left at the origin.
+	/// </summary>
+	/// <param name="geom_id">mesh of the collider</param>
+	/// <param name="scale">scale of the entity's motion</param>
+	/// <returns>the collider</returns>
+	Collider makeMeshCollider(GEOMETRY_BUFFER_ID geom_id, RenderSystem* renderer, vec2 scale);
+
 
 	/// <summary>
 	/// Create a box collider with given scale and attach to the entity
@@ -105,17 +134,34 @@ public:
 	/// <returns>void</returns>
 	void createCustomsizeBoxCollider(Entity entity, vec2 scale);
 
-	PhysicsSystem()
+	explicit PhysicsSystem(ECSRegistry& registry_arg)
+		: registry(registry_arg)
 	{
 		this->numberOfColliders = 0; 
 		this->detectRange = 2.f;
+		this->tileCollider = makeBoxCollider({ 0.f, 0.f }, { 1.f, 1.f }, 0.f);
 	}
 private:
+	ECSRegistry& registry;
+	TerrainSystem* terrain = nullptr;
 
 	int rootNodeIndex = 0;
 	int nodeUsed = 1;
-	std::vector<int> colliderMapping;
+	std::vector<int> colliderMapping;	// terrain cell of each BVH primitive, -1 once removed
 	std::vector<BVHNode> bvhTree;
+	unsigned int bvhVersion = 0;		// TerrainSystem::get_active_version the tree was built for
+
+	// The shape shared by all terrain tiles, only its position differs per tile
+	Collider tileCollider;
+
+	// internal functions: move every entity by its velocity and the colliders along with them
+	void integrate(float elapsed_ms);
+
+	// internal functions: check the projectiles against the terrain and the mobs, see substeps
+	void detectProjectileCollisions();
+
+	// internal functions: check a projectile against the terrain colliders and the edge of the active chunks
+	void intersectProjectileTerrain(Entity projectile);
 
 	// internal functions: update the AABB of the BVH node based on all colliders it holds
 	void updateNodeBounds(int nodeIndex);
@@ -123,6 +169,15 @@ private:
 	// internal functions: recursively divide nodes during tree construction. 
 	void subDivide(int nodeIndex);
 
+	// internal functions: extend the AABB of the node to contain the tile of the cell
+	void growNodeBounds(int nodeIndex, int cell);
+
+	// internal functions: add a terrain collider to the leaf closest to it, splitting the leaf if it has no free slot
+	void insertIntoBVH(int cell);
+
+	// internal functions: free the slot of a terrain collider, returns false if it is not under the node
+	bool removeFromBVH(int cell, int nodeIndex);
+
 };
 
 
@@ -175,7 +175,7 @@ void PowerupSystem::applyHealthRegenPowerup() {
 	// Add the powerup indicator
 	if (user_has_powerup)
 	registry.remove_all_components_of(powerup_indicator);
-	powerup_indicator = createPowerupIndicator(renderer, { 9.5f + 0.5, 6.f }, TEXTURE_ASSET_ID::ICON_POWERUP_HEALTH);
+	powerup_indicator = createPowerupIndicator(registry, renderer, { 9.5f + 0.5, 6.f }, TEXTURE_ASSET_ID::ICON_POWERUP_HEALTH);
 	user_has_powerup = true;
 
 	
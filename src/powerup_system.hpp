@@ -12,7 +12,8 @@ class PowerupSystem
 
 	public:
 
-		PowerupSystem()
+		explicit PowerupSystem(ECSRegistry& registry_arg)
+			: registry(registry_arg)
 		{
 			this->particles = nullptr;
 			this->renderer = nullptr;
@@ -47,6 +48,7 @@ class PowerupSystem
 
 	private:
 		// Pointer to rendering system 
+		ECSRegistry& registry;
 		RenderSystem* renderer;
 
 		// Pointer to particle systems
@@ -0,0 +1,124 @@
+// internal
+#include "profiler.hpp"
+
+// stlib
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+	// The ring buffer of one thread. Only that thread writes events; written is published after every event so
+	// write_chrome_trace can read the buffer from another thread.
+	struct ThreadEvents
+	{
+		std::unique_ptr<ProfileEvent[]> events{ new ProfileEvent[Profiler::EVENTS_PER_THREAD] };
+		std::atomic<uint64_t> written{ 0 };
+		unsigned int thread_id = 0;
+		std::string thread_name;	// guarded by threads_mutex
+	};
+
+	const Clock::time_point profiler_start = Clock::now();
+
+	// Every thread that ever recorded, kept after the thread exits so its events still end up in the trace
+	std::mutex threads_mutex;
+	std::vector<std::unique_ptr<ThreadEvents>> threads;
+	std::set<std::string> interned_names;
+
+	thread_local ThreadEvents* own_events = nullptr;
+
+	ThreadEvents& thread_events()
+	{
+		if (!own_events) {
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			threads.emplace_back(new ThreadEvents());
+			own_events = threads.back().get();
+			own_events->thread_id = (unsigned int)threads.size();
+		}
+		return *own_events;
+	}
+
+	void write_json_string(FILE* file, const char* text)
+	{
+		fputc('"', file);
+		for (; *text; text++) {
+			if (*text == '"' || *text == '\\')
+				fputc('\\', file);
+			if ((unsigned char)*text >= 0x20)
+				fputc(*text, file);
+		}
+		fputc('"', file);
+	}
+}
+
+uint64_t Profiler::now_ns()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - profiler_start).count();
+}
+
+void Profiler::record(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+	ThreadEvents& buffer = thread_events();
+	uint64_t index = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[index % EVENTS_PER_THREAD] = { name, start_ns, end_ns - start_ns };
+	buffer.written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::set_thread_name(const std::string& name)
+{
+	ThreadEvents& buffer = thread_events();
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	buffer.thread_name = name;
+}
+
+const char* Profiler::intern(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	return interned_names.insert(name).first->c_str();
+}
+
+bool Profiler::write_chrome_trace(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file) {
+		fprintf(stderr, "Could not write the trace %s\n", path.c_str());
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(threads_mutex);
+	size_t event_count = 0;
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (const std::unique_ptr<ThreadEvents>& thread : threads) {
+		if (!thread->thread_name.empty()) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+				first ? "" : ",\n", thread->thread_id);
+			write_json_string(file, thread->thread_name.c_str());
+			fprintf(file, "}}");
+			first = false;
+		}
+
+		// The newest EVENTS_PER_THREAD events, the older ones were overwritten
+		uint64_t written = thread->written.load(std::memory_order_acquire);
+		uint64_t begin = written > EVENTS_PER_THREAD ? written - EVENTS_PER_THREAD : 0;
+		for (uint64_t i = begin; i < written; i++) {
+			const ProfileEvent& event = thread->events[i % EVENTS_PER_THREAD];
+			fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+			write_json_string(file, event.name);
+			fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				thread->thread_id, event.start_ns / 1000.0, event.duration_ns / 1000.0);
+			first = false;
+		}
+		event_count += (size_t)(written - begin);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	printf("Wrote %zu profiled scopes of %zu threads to %s\n", event_count, threads.size(), path.c_str());
+	return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+// stlib
+#include <string>
+#include <stdint.h>
+
+// A scope the profiler measured: where it started and how long it took, in nanoseconds since the profiler started
+struct ProfileEvent
+{
+	const char* name;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+};
+
+// Low-overhead CPU profiler. PROFILE_SCOPE measures the rest of the enclosing scope and stores it in a ring buffer
+// of the calling thread, without locks: every thread only ever writes its own buffer. Once a buffer is full the
+// oldest events are overwritten, so a trace covers the last EVENTS_PER_THREAD scopes of every thread.
+// write_chrome_trace saves the events as a Chrome trace, to be opened in chrome://tracing or ui.perfetto.dev.
+// The scopes are only compiled in with STRANDED_PROFILER defined (cmake -DENABLE_PROFILER=ON), otherwise
+// PROFILE_SCOPE is empty and nothing is recorded.
+// Names must outlive the profiler: string literals, or names from intern().
+// Usage:
+//		void PhysicsSystem::step(float elapsed_ms)
+//		{
+//			PROFILE_SCOPE("PhysicsSystem::step");
+//			...
+//		}
+//		Profiler::write_chrome_trace("trace.json");
+class Profiler
+{
+public:
+	static constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+	// Check if PROFILE_SCOPE records anything in this build
+	static constexpr bool compiled_in()
+	{
+#ifdef STRANDED_PROFILER
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static uint64_t now_ns();
+
+	// Adds an event to the calling thread's buffer
+	static void record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+	// The name of the calling thread in the trace, e.g. "main" or "job worker 3"
+	static void set_thread_name(const std::string& name);
+
+	// A copy of name that stays valid until the program exits, for names that are not literals
+	static const char* intern(const std::string& name);
+
+	// Writes the events of all threads as a Chrome trace JSON file. Threads may keep recording meanwhile, but
+	// the events they write at the same time may come out torn, so better call this between frames.
+	static bool write_chrome_trace(const std::string& path);
+};
+
+// Measures its own lifetime, see PROFILE_SCOPE
+class ProfileScope
+{
+	const char* name;
+	uint64_t start_ns;
+public:
+	explicit ProfileScope(const char* name_arg) : name(name_arg), start_ns(Profiler::now_ns()) {}
+	~ProfileScope() { Profiler::record(name, start_ns, Profiler::now_ns()); }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#ifdef STRANDED_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
@@ -39,7 +39,7 @@ void QuestSystem::processQuestItem(ITEM_TYPE type, QUEST_ITEM_STATUS new_status)
         QuestItemIndicator& c = registry.questItemIndicators.components[i];
 
         if (c.quest_item == type) {
-            registry.remove_all_components_of(e);
+            registry.commands.destroy(e);
         }
     }
 
@@ -94,7 +94,7 @@ Entity QuestSystem::createQuestItemIndicator(vec2 position, ITEM_TYPE type, QUES
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -141,7 +141,7 @@ Entity QuestSystem::createSpaceshipPart(ITEM_TYPE type) {
     registry.meshPtrs.emplace(entity, &mesh);
 
     // Initialize the position, scale, and physics components
-    auto& motion = registry.motions.emplace(entity);
+    MotionRef motion = registry.motions.emplace(entity);
     motion.angle = 0.f;
     motion.velocity = { 0.f, 0.f };
     motion.position = { 0, -2.5 };
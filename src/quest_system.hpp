@@ -13,7 +13,8 @@ class QuestSystem
 {
     public:
         /// @brief QuestSystem constructor
-        QuestSystem()
+        explicit QuestSystem(ECSRegistry& registry_arg)
+            : registry(registry_arg)
         {
         }
 
@@ -45,6 +46,7 @@ class QuestSystem
         const vec2 QUEST_3_INDICATOR_POSITION = { 10.f, 1.0f };
         const vec2 QUEST_4_INDICATOR_POSITION = { 10.f, 3.5f };
 
+        ECSRegistry& registry;
         RenderSystem* renderer;
 
         std::map<ITEM_TYPE, TEXTURE_ASSET_ID> quest_item_indicator_not_found_textures_map {
@@ -0,0 +1,79 @@
+// internal
+#include "random.hpp"
+
+// stlib
+#include <cmath>
+#include <random>
+
+namespace {
+	// SplitMix64: neighbouring inputs give unrelated outputs, which makes it a good hash from a counter to a seed
+	uint64_t splitmix64(uint64_t& x)
+	{
+		uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	const float TWO_PI_F = 6.28318530717958647692f;
+}
+
+void Rng::reseed(uint64_t seed)
+{
+	uint64_t a = splitmix64(seed);
+	uint64_t b = splitmix64(seed);
+	state[0] = (uint32_t)a;
+	state[1] = (uint32_t)(a >> 32);
+	state[2] = (uint32_t)b;
+	state[3] = (uint32_t)(b >> 32);
+	has_spare_normal = false;
+}
+
+float Rng::normal(float mean, float stddev)
+{
+	if (has_spare_normal) {
+		has_spare_normal = false;
+		return mean + stddev * spare_normal;
+	}
+
+	// Box-Muller, 1 - uniform() is in (0, 1] so the log is finite
+	float radius = sqrtf(-2.f * logf(1.f - uniform()));
+	float angle = TWO_PI_F * uniform();
+	spare_normal = radius * sinf(angle);
+	has_spare_normal = true;
+	return mean + stddev * radius * cosf(angle);
+}
+
+void Rng::uniform(float* out, size_t count, float min, float max)
+{
+	float scale = (max - min) * (1.f / 16777216.f);
+	for (size_t i = 0; i < count; i++)
+		out[i] = min + (float)((*this)() >> 8) * scale;
+}
+
+void Rng::normal(float* out, size_t count, float mean, float stddev)
+{
+	size_t i = 0;
+	if (count > 0 && has_spare_normal)
+		out[i++] = normal(mean, stddev);
+	for (; i + 1 < count; i += 2) {
+		float radius = stddev * sqrtf(-2.f * logf(1.f - uniform()));
+		float angle = TWO_PI_F * uniform();
+		out[i] = mean + radius * cosf(angle);
+		out[i + 1] = mean + radius * sinf(angle);
+	}
+	if (i < count)
+		out[i] = normal(mean, stddev);
+}
+
+RandomService::RandomService()
+{
+	set_seed(std::random_device()());
+}
+
+void RandomService::set_seed(uint32_t seed)
+{
+	world_seed = seed;
+	for (int i = 0; i < (int)RANDOM_STREAM::STREAM_COUNT; i++)
+		streams[i].reseed(((uint64_t)seed << 8) | (uint64_t)i);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A fast random number generator (xoshiro128**): 16 bytes of state, no system calls, cheap to seed and to copy.
+// It satisfies UniformRandomBitGenerator, so it also works with the distributions of <random>.
+class Rng
+{
+public:
+	typedef uint32_t result_type;
+
+	explicit Rng(uint64_t seed = 0) { reseed(seed); }
+
+	// Derives the whole state from one value, different seeds give unrelated sequences
+	void reseed(uint64_t seed);
+
+	uint32_t operator()()
+	{
+		uint32_t result = rotl(state[1] * 5, 7) * 9;
+		uint32_t t = state[1] << 9;
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotl(state[3], 11);
+		return result;
+	}
+
+	static constexpr uint32_t min() { return 0; }
+	static constexpr uint32_t max() { return UINT32_MAX; }
+
+	// In [0, 1)
+	float uniform() { return (float)((*this)() >> 8) * (1.f / 16777216.f); }
+
+	// In [min, max)
+	float uniform(float min, float max) { return min + (max - min) * uniform(); }
+
+	// In [min, max], both included
+	int uniform_int(int min, int max) { return min + (int)(((uint64_t)(*this)() * (uint64_t)(max - min + 1)) >> 32); }
+
+	float normal(float mean, float stddev);
+
+	// A whole burst at once, e.g. the offsets of all particles of an effect
+	void uniform(float* out, size_t count, float min, float max);
+	void normal(float* out, size_t count, float mean, float stddev);
+
+private:
+	uint32_t state[4];
+
+	// normal() makes two numbers at a time and keeps the second one for the next call
+	bool has_spare_normal = false;
+	float spare_normal = 0.f;
+
+	static uint32_t rotl(uint32_t x, int k) { return (x << k) | (x >> (32 - k)); }
+};
+
+// The systems that draw random numbers, each gets a stream of its own
+enum class RANDOM_STREAM : uint8_t {
+	WORLD,		// WorldSystem
+	TERRAIN,	// random spawn locations
+	PARTICLES,
+	WEAPONS,	// inaccuracy of projectiles
+	STREAM_COUNT
+};
+
+// The random numbers of one world. Every stream follows from a single world seed, so a world that is seeded the
+// same way and gets the same input plays out the same, e.g. when replaying a recorded session (see InputLog).
+// Without set_seed the world seed comes from std::random_device.
+// A stream belongs to its system: systems that the SystemScheduler overlaps draw from different streams, so the
+// numbers every system gets do not depend on how the frame was scheduled.
+// Usage:
+//		registry.random.set_seed(42);
+//		Rng& rng = registry.random.stream(RANDOM_STREAM::PARTICLES);
+//		rng.uniform(offsets, 2 * count, -0.1f, 0.1f);
+class RandomService
+{
+public:
+	RandomService();
+
+	// Restarts every stream from a world seed
+	void set_seed(uint32_t seed);
+
+	uint32_t seed() const { return world_seed; }
+
+	Rng& stream(RANDOM_STREAM id) { return streams[(int)id]; }
+
+private:
+	uint32_t world_seed = 0;
+	Rng streams[(int)RANDOM_STREAM::STREAM_COUNT];
+};
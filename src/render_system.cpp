@@ -3,15 +3,25 @@
 #include <SDL.h>
 #include <iostream>
 #include "tiny_ecs_registry.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
+
+namespace {
+	// Always-on counters of the GL work, see Metrics. State changes are program, texture, VAO and framebuffer binds.
+	Counter& draw_calls = Metrics::counter("render.draw_calls");
+	Counter& state_changes = Metrics::counter("render.state_changes");
+}
 
 void RenderSystem::drawTexturedMesh(Entity entity,
 									const mat3& view_matrix,
 									const mat3& projection)
 {
+	PROFILE_SCOPE("drawTexturedMesh");
+
 	// Transformation code, see Rendering and Transformation in the template
 	// specification for more info Incrementally updates transformation matrix,
 	// thus ORDER IS IMPORTANT
-	mat3 transform = createModelMatrix(entity);	// Model matrix
+	mat3 transform = createInterpolatedModelMatrix(entity);	// Model matrix
 
 	assert(registry.renderRequests.has(entity));
 	const RenderRequest &render_request = registry.renderRequests.get(entity);
@@ -22,6 +32,7 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 
 	// Setting shaders
 	glUseProgram(program);
+	state_changes.add();
 	gl_has_errors();
 
 	assert(render_request.used_geometry != GEOMETRY_BUFFER_ID::GEOMETRY_COUNT);
@@ -75,6 +86,7 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
 
 		glBindTexture(GL_TEXTURE_2D, texture_id);
+		state_changes.add();
 		gl_has_errors();
 		
 		if (registry.animations.has(entity)) {
@@ -142,6 +154,7 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 	gl_has_errors();
 	// Drawing of num_indices/3 triangles specified in the index buffer
 	glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
+	draw_calls.add();
 	gl_has_errors();
 
 }
@@ -166,7 +179,7 @@ void RenderSystem::drawParticles(Entity entity,const mat3& view_matrix,const mat
 
 	for (int i = 0; i < particle_entities.size(); i++) {
 		if (registry.motions.has(particle_entities[i])) {
-			mat3 transform = createModelMatrix(particle_entities[i]);	
+			mat3 transform = createInterpolatedModelMatrix(particle_entities[i]);
 			modelMatrixes.push_back(transform);
 		}
 		
@@ -178,6 +191,7 @@ void RenderSystem::drawParticles(Entity entity,const mat3& view_matrix,const mat
 
 	// Setting shaders
 	glUseProgram(program);
+	state_changes.add();
 	gl_has_errors();
 
 
@@ -219,6 +233,7 @@ void RenderSystem::drawParticles(Entity entity,const mat3& view_matrix,const mat
 			texture_gl_handles[(GLuint)render_request.used_texture];
 
 		glBindTexture(GL_TEXTURE_2D, texture_id);
+		state_changes.add();
 		gl_has_errors();
 
 		// else if (render_request.used_texture == TEXTURE_ASSET_ID::PLAYER_PARTICLE) {
@@ -300,6 +315,7 @@ void RenderSystem::drawParticles(Entity entity,const mat3& view_matrix,const mat
 	gl_has_errors();
 	// Drawing of num_indices/3 triangles specified in the index buffer and number of instance depending on number of particles
 	glDrawElementsInstanced(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr, particle_entities.size());
+	draw_calls.add();
 	gl_has_errors();
 
 	// Free up the buffers
@@ -317,11 +333,13 @@ void RenderSystem::drawToScreen()
 	// Setting shaders
 	// get the texture, sprite mesh, and program
 	glUseProgram(effects[(GLuint)EFFECT_ASSET_ID::FOG]);
+	state_changes.add();
 	gl_has_errors();
 	// Clearing backbuffer
 	int w, h;
 	glfwGetFramebufferSize(window, &w, &h); // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	state_changes.add();
 	glViewport(0, 0, w, h);
 	glDepthRange(0, 10);
 	glClearColor(1.f, 0, 0, 1.0);
@@ -371,6 +389,7 @@ void RenderSystem::drawToScreen()
 	glActiveTexture(GL_TEXTURE0);
 
 	glBindTexture(GL_TEXTURE_2D, off_screen_render_buffer_color);
+	state_changes.add();
 	gl_has_errors();
 	
 	// Draw
@@ -378,20 +397,21 @@ void RenderSystem::drawToScreen()
 		GL_TRIANGLES, 3, GL_UNSIGNED_SHORT,
 		nullptr); // one triangle = 3 vertices; nullptr indicates that there is
 				  // no offset from the bound index buffer
+	draw_calls.add();
 	gl_has_errors();
 }
 
 /// Totally not a blatant copy of the template code.
 void RenderSystem::drawTerrain(const mat3& view_2D, const mat3& projection_2D)
 {
+	uploadTerrainChunks();
+
 	GLuint program = effects[(GLuint)EFFECT_ASSET_ID::TERRAIN];
 	glUseProgram(program);
+	state_changes.add();
 
-	const GLuint vbo = vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN];
+	// Shared by all chunks, see initializeGlGeometryBuffers
 	const GLuint ibo = index_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN];
-
-	// Load vertex and index buffers from GPU memory from GPU "address" vbo and ibo
-	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
 	gl_has_errors();
 
@@ -429,23 +449,10 @@ void RenderSystem::drawTerrain(const mat3& view_2D, const mat3& projection_2D)
 	const void* FLAGS_OFFSET = reinterpret_cast<void*>(offsetof(BatchedVertex, flags));
 	const void* FRAME_VALUE_OFFSET = reinterpret_cast<void*>(offsetof(BatchedVertex, frameValue));
 
-	// Vertex position
 	glEnableVertexAttribArray(in_position_loc);
-	gl_has_errors();
-	glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, SIZE_OF_EACH_VERTEX, POSITION_OFFSET);
-	gl_has_errors();
-
-	// Texture uv
 	glEnableVertexAttribArray(in_texcoord_loc);
-	gl_has_errors();
-	glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, SIZE_OF_EACH_VERTEX, UV_OFFSET);
-	gl_has_errors();
-
-	// Texture index used for the 2D texture array
 	glEnableVertexAttribArray(in_tex_i_loc);
 	gl_has_errors();
-	glVertexAttribIPointer(in_tex_i_loc, 1, GL_UNSIGNED_SHORT, SIZE_OF_EACH_VERTEX, TEX_INDEX_OFFSET);
-	gl_has_errors();
 
 	/*
 	glEnableVertexAttribArray(in_flags_loc);
@@ -477,18 +484,27 @@ void RenderSystem::drawTerrain(const mat3& view_2D, const mat3& projection_2D)
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+	state_changes.add();
 	gl_has_errors();
 
-	// Get number of indices from index buffer, which has elements uint32_t
-	GLint size = 0;
-	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
-	gl_has_errors();
-	size /= sizeof(uint32_t);
+	for (auto& kv : terrain_chunks) {
+		// The attributes point into the bound vertex buffer, so they are set again for every chunk
+		glBindBuffer(GL_ARRAY_BUFFER, kv.second.vbo);
 
-	// Draw!
-	// Recall that we're using GL_UNSIGNED_INT because the index buffer are int32_t's
-	glDrawElements(GL_TRIANGLES, size, GL_UNSIGNED_INT, nullptr);
-	gl_has_errors();
+		// Vertex position
+		glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, SIZE_OF_EACH_VERTEX, POSITION_OFFSET);
+		// Texture uv
+		glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, SIZE_OF_EACH_VERTEX, UV_OFFSET);
+		// Texture index used for the 2D texture array
+		glVertexAttribIPointer(in_tex_i_loc, 1, GL_UNSIGNED_SHORT, SIZE_OF_EACH_VERTEX, TEX_INDEX_OFFSET);
+		gl_has_errors();
+
+		// Draw!
+		// The index buffer is uint16_t's, a chunk has less than 2^16 vertices
+		glDrawElements(GL_TRIANGLES, TERRAIN_CHUNK_CELLS * 6, GL_UNSIGNED_SHORT, nullptr);
+		draw_calls.add();
+		gl_has_errors();
+	}
 
 	// Free up the buffers
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -499,12 +515,15 @@ void RenderSystem::drawTerrain(const mat3& view_2D, const mat3& projection_2D)
 // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-14-render-to-texture/
 void RenderSystem::draw()
 {
+	PROFILE_SCOPE("RenderSystem::draw");
+
 	// Getting size of window
 	int w, h;
 	glfwGetFramebufferSize(window, &w, &h); // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
 
 	// First render to the custom framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+	state_changes.add();
 	gl_has_errors();
 	// Clearing backbuffer
 	glViewport(0, 0, w, h);
@@ -528,54 +547,32 @@ void RenderSystem::draw()
 	//		What we want here is the opposite: turning world space values into "camera" or "view" space.
 	//		We can achieve this by inversing the local -> world matrix (regular Transform matrix!)
 	//		This will give us a world -> local matrix.
-	mat3 view_2D = inverse(createModelMatrix(main_camera));
+	mat3 view_2D = inverse(createInterpolatedModelMatrix(main_camera));
 
 	// Generate projection matrix. This maps camera-relative coords to pixel/window coordinates.
 	mat3 projection_2D = createScaledProjectionMatrix();
 
+	// Only layer 1 is filtered per frame, the other layers are drawn straight from their buckets
 	std::vector<Entity> layer_1_entities;
-	std::vector<Entity> layer_2_entities;
-	std::vector<Entity> layer_3_entities;
-	std::vector<Entity> layer_4_entities;
-	std::vector<Entity> layer_5_entities;
 	Entity player_entity = registry.players.entities[0];
+	vec2 player_position = registry.motions.get(player_entity).position;
+	ComponentSignature fow_mask = ECSRegistry::signature_mask<Item, Mob>();
 
-	for (Entity entity : registry.renderRequests.entities)
-	{
+	for (Entity entity : layer_entities[(int)RENDER_LAYER_ID::LAYER_1].entities) {
 		if (!registry.motions.has(entity))
 			continue;
-		// Note, its not very efficient to access elements indirectly via the entity
-		// albeit iterating through all Sprites in sequence. A good point to optimize
-		// re-sort them in different queue of render request based on layer they belong to
-		if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_1) {
-
-			// if entity is item or mob
-			if (registry.items.has(entity) || (registry.mobs.has(entity)) || registry.renderRequests.get(entity).used_texture == TEXTURE_ASSET_ID::RED_BLOCK) {
-
-				// put in draw array if distance to player is close enough
-				if ((distance(registry.motions.get(player_entity).position, registry.motions.get(entity).position) < fow_radius) || enableFow == 0) {
-					layer_1_entities.push_back(entity);
-				}
-			}
-			else {
-				// draw everything else
+
+		// if entity is item or mob
+		if ((registry.signature_of(entity) & fow_mask).any() || registry.renderRequests.get(entity).used_texture == TEXTURE_ASSET_ID::RED_BLOCK) {
+
+			// put in draw array if distance to player is close enough
+			if ((distance(player_position, registry.motions.get(entity).position) < fow_radius) || enableFow == 0) {
 				layer_1_entities.push_back(entity);
 			}
 		}
-		else if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_2) {
-			layer_2_entities.push_back(entity);
-		}
-		else if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_3) {
-			layer_3_entities.push_back(entity);
-		}
-		else if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_4) {
-			layer_4_entities.push_back(entity);
-		} 
-		else if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_5) {
-			layer_5_entities.push_back(entity);
-		}
 		else {
-			assert(registry.renderRequests.get(entity).layer_id != RENDER_LAYER_ID::LAYER_COUNT && "entity render request with incorrect layer ID (LAYER_COUNT)");
+			// draw everything else
+			layer_1_entities.push_back(entity);
 		}
 	}
 
@@ -612,9 +609,7 @@ void RenderSystem::draw()
 	}
 	
 
-	for (Entity entity : layer_2_entities) {
-		drawTexturedMesh(entity, view_2D, projection_2D);
-	}
+	drawLayer(RENDER_LAYER_ID::LAYER_2, view_2D, projection_2D);
 
 	// DRAW all particle effects
 	for (Entity entity : instanced_layer_2_entities) {
@@ -623,10 +618,7 @@ void RenderSystem::draw()
 
 	// added guard to turn off while in debug mode 
 	if (debugging.in_debug_mode == false) {
-		for (Entity entity : layer_3_entities) {
-
-			drawTexturedMesh(entity, view_2D, projection_2D);
-		}
+		drawLayer(RENDER_LAYER_ID::LAYER_3, view_2D, projection_2D);
 	}
 	
 	// Truely render to the screen. Multipass rendering with fog program
@@ -639,9 +631,7 @@ void RenderSystem::draw()
 	// Draw for UI elements
 	
 	if (!debugging.hide_ui) {
-		for (Entity entity : layer_4_entities) {
-			drawTexturedMesh(entity, view_2D, projection_2D);
-		}
+		drawLayer(RENDER_LAYER_ID::LAYER_4, view_2D, projection_2D);
 	}
 
 	// TODO: Process text rendering here and ONLY here.
@@ -649,15 +639,16 @@ void RenderSystem::draw()
 	// If you render text before the layer_4_entities for loop, then UI will write over it
 	for (Entity entity : registry.texts.entities) {
 		Text& text = registry.texts.get(entity);
-		Motion& motion = registry.motions.get(entity);
+		vec2 position = interpolatedPosition(entity, registry.motions.get(entity).position);
 
-		renderText(text.str, motion.position.x, motion.position.y, text.scale, text.color, projection_2D, view_2D);
+		renderText(text.str, position.x, position.y, text.scale, text.color, projection_2D, view_2D);
 	}
 
 	// For tutorial dialogs 
-	for (Entity entity : layer_5_entities) {
-		drawTexturedMesh(entity, view_2D, projection_2D);
-	}
+	drawLayer(RENDER_LAYER_ID::LAYER_5, view_2D, projection_2D);
+
+	if (show_metrics_hud)
+		drawMetricsHud();
 
 	// Do not touch anything past this point.
 	// flicker-free display with a double buffer
@@ -673,6 +664,7 @@ void RenderSystem::drawStartScreens() {
 
 	// First render to the custom framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
+	state_changes.add();
 	gl_has_errors();
 	// Clearing backbuffer
 	glViewport(0, 0, w, h);
@@ -689,20 +681,6 @@ void RenderSystem::drawStartScreens() {
 	// Generate projection matrix. This is unscaled (does not take into account tile width).
 	mat3 projection_2D = createUnscaledProjectionMatrix();
 
-	// Only track layer 1, 2, and 3 entities. There should not be any other layer active at this stage.
-	std::vector<Entity> layer_1_entities;
-	std::vector<Entity> layer_2_entities;
-	std::vector<Entity> layer_3_entities;
-	for (Entity entity : registry.renderRequests.entities) {
-		if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_1) {
-			layer_1_entities.push_back(entity);
-		} else if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_2) {
-			layer_2_entities.push_back(entity);
-		} else if (registry.renderRequests.get(entity).layer_id == RENDER_LAYER_ID::LAYER_3) {
-			layer_3_entities.push_back(entity);
-		}
-	}
-
 	// Render terrain first
 	Entity main_camera = registry.get_main_camera();
 	mat3 view_2D = inverse(createModelMatrix(main_camera));
@@ -715,23 +693,15 @@ void RenderSystem::drawStartScreens() {
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-	// Draw the meshes
-	for (Entity entity : layer_1_entities) {
-		// pass identity matrix for view_matrix since main camera not exist
-		drawTexturedMesh(entity, mat3(1.f), projection_2D);
-	}
-	for (Entity entity : layer_2_entities) {
-		// pass identity matrix for view_matrix since main camera not exist
-		drawTexturedMesh(entity, mat3(1.f), projection_2D);
-	}
-	for (Entity entity : layer_3_entities) {
-		// pass identity matrix for view_matrix since main camera not exist
-		drawTexturedMesh(entity, mat3(1.f), projection_2D);
-	}
+	// Draw the meshes. Only layer 1, 2, and 3 are drawn, layer 4 hides the inactive start button.
+	// pass identity matrix for view_matrix since main camera not exist
+	drawLayer(RENDER_LAYER_ID::LAYER_1, mat3(1.f), projection_2D);
+	drawLayer(RENDER_LAYER_ID::LAYER_2, mat3(1.f), projection_2D);
+	drawLayer(RENDER_LAYER_ID::LAYER_3, mat3(1.f), projection_2D);
 
 	for (Entity entity : registry.texts.entities) {
 		Text& text = registry.texts.get(entity);
-		Motion& motion = registry.motions.get(entity);
+		MotionRef motion = registry.motions.get(entity);
 
 		renderText(text.str, motion.position.x, motion.position.y, text.scale, text.color, projection_2D, mat3(1.f));
 	}
@@ -741,21 +711,59 @@ void RenderSystem::drawStartScreens() {
 	gl_has_errors();
 }
 
-/// <summary>
-/// Generates a TRS matrix from an entity. Entity must have a Motion component.
-/// </summary>
-/// <param name="entity">Entity with a motion component to generate from</param>
-/// <returns>A TRS Matrix that converts from local space to the parent space (usually world).</returns>
-mat3 RenderSystem::createModelMatrix(Entity entity)
+void RenderSystem::drawLayer(RENDER_LAYER_ID layer, const mat3& view_2D, const mat3& projection_2D)
+{
+	for (Entity entity : layer_entities[(int)layer].entities) {
+		if (registry.motions.has(entity))
+			drawTexturedMesh(entity, view_2D, projection_2D);
+	}
+}
+
+void RenderSystem::setRenderLayer(Entity entity, RENDER_LAYER_ID layer)
+{
+	RenderRequest& render_request = registry.renderRequests.get(entity);
+	layer_entities[(int)render_request.layer_id].remove(entity);
+	render_request.layer_id = layer;
+	layer_entities[(int)layer].emplace(entity);
+}
+
+void RenderSystem::snapshotMotions()
+{
+	size_t capacity = Entity::allocator().capacity();
+	if (previous_positions.size() < capacity) {
+		previous_positions.resize(capacity);
+		previous_entities.resize(capacity, Entity::null());
+	}
+
+	for (unsigned int i = 0; i < registry.motions.size(); i++) {
+		unsigned int index = registry.motions.entities[i].index();
+		previous_positions[index] = registry.motions.components[i].position;
+		previous_entities[index] = registry.motions.entities[i];
+	}
+}
+
+void RenderSystem::setInterpolation(float alpha)
+{
+	interpolation = alpha;
+}
+
+vec2 RenderSystem::interpolatedPosition(Entity entity, vec2 position)
 {
-	Motion& motion = registry.motions.get(entity);
+	unsigned int index = entity.index();
+	if (interpolation >= 1.f || index >= previous_entities.size() || previous_entities[index] != entity)
+		return position;
+	return mix(previous_positions[index], position, interpolation);
+}
+
+mat3 RenderSystem::createInterpolatedModelMatrix(Entity entity)
+{
+	MotionRef motion = registry.motions.get(entity);
 
 	Transform modelMatrix;
-	modelMatrix.translate(motion.position);
+	modelMatrix.translate(interpolatedPosition(entity, motion.position));
 	modelMatrix.rotate(motion.angle);
 	modelMatrix.scale(motion.scale);
 
-	// Parent space -> local/model space? Inverse this TRS matrix!
 	return modelMatrix.mat;
 }
 
@@ -763,30 +771,19 @@ mat3 RenderSystem::createModelMatrix(Entity entity)
 /// Generates an orthogonal projection matrix. 
 /// </summary>
 /// <returns>An orthogonal projection matrix relative to the window size</returns>
-mat3 RenderSystem::createScaledProjectionMatrix()
+void RenderSystem::drawMetricsHud()
 {
-	// Othogonal projection matrix.
-	// Same code as the template since it scales with aspect ratio.
-	int x = window_resolution.x;
-	int y = window_resolution.y;
-
-	// We must scale how each tile is affected by the resolution because:
-	//	1. We don't want the player to see more of the map if they play on a larger resolution
-	const double s = static_cast<double>(x) / target_resolution.x;
-	const float tile_size_px_scaled = tile_size_px * s;
-
-	float left = -x / 2.f; // Modified these values so the middle of the screen is now 0,0
-	float top = -y / 2.f;
-	
-	float right = x / 2.f;
-	float bottom = y /2.f;
-
-	float sx = 2.f / (right - left) * tile_size_px_scaled;	// We finally scale the world space -> screen space tile size mappings
-	float sy = 2.f / (top - bottom) * tile_size_px_scaled;
-	float tx = -(right + left) / (right - left) * tile_size_px_scaled;
-	float ty = -(top + bottom) / (top - bottom) * tile_size_px_scaled;
+	// The scaled projection puts the middle of the screen at 0,0 and measures in tiles, the width always spans
+	// the same number of tiles
+	mat3 projection_2D = createScaledProjectionMatrix();
+	float half_width = target_resolution.x / (2.f * tile_size_px);
+	float half_height = half_width * window_resolution.y / window_resolution.x;
 
-	return {{sx, 0.f, 0.f}, {0.f, sy, 0.f}, {tx, ty, 1.f}};
+	float y = -half_height + METRICS_HUD_LINE_HEIGHT;
+	for (const std::string& line : metrics_hud_lines) {
+		renderText(line, -half_width + 0.2f, y, METRICS_HUD_TEXT_SCALE, vec3(1.f, 1.f, 0.6f), projection_2D, mat3(1.f));
+		y += METRICS_HUD_LINE_HEIGHT;
+	}
 }
 
 mat3 RenderSystem::createUnscaledProjectionMatrix()
@@ -806,30 +803,74 @@ mat3 RenderSystem::createUnscaledProjectionMatrix()
 	return {{sx, 0.f, 0.f}, {0.f, sy, 0.f}, {tx, ty, 1.f}};
 }
 
-void RenderSystem::changeTerrainData(Entity cell, unsigned int i, TerrainCell& data, uint8_t frameValue)
+void RenderSystem::changeTerrainData(int chunk, unsigned int i, vec2 position, TerrainCell& data, uint8_t frameValue)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN]);
-	gl_has_errors();
+	auto it = terrain_chunks.find(chunk);
+	assert(it != terrain_chunks.end() && "The terrain chunk is not loaded");
+	TerrainChunkMesh& mesh = it->second;
+
 	std::vector<BatchedVertex> vertices;
-	mat3 transform = createModelMatrix(cell);
+	Transform model;
+	model.translate(position);
+	mat3 transform = model.mat;
 	uint8_t vertex_flags = directional_terrain.count(data.terrain_type) ? DIRECTIONAL : 0;
 	makeQuadVertices(transform, (uint16_t)data.terrain_type, vertices, vertex_flags, frameValue);
 
-	int x = i * sizeof(BatchedVertex) * 4;
-	int y = sizeof(BatchedVertex) * 4;
-	glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(BatchedVertex) * 4, sizeof(BatchedVertex) * 4, vertices.data());
-	gl_has_errors();
+	if (!mesh.vertices.empty()) {
+		// Not uploaded yet, the upload picks the change up
+		std::copy(vertices.begin(), vertices.end(), mesh.vertices.begin() + i * 4);
+		return;
+	}
+	mesh.changed_tiles.push_back(i);
+	mesh.changed_vertices.insert(mesh.changed_vertices.end(), vertices.begin(), vertices.end());
+}
+
+void RenderSystem::unloadTerrainChunk(int chunk)
+{
+	auto it = terrain_chunks.find(chunk);
+	if (it == terrain_chunks.end())
+		return;
+	if (it->second.vbo != 0)
+		released_terrain_buffers.push_back(it->second.vbo);
+	terrain_chunks.erase(it);
 }
 
 void RenderSystem::empty_terrain_buffer()
 {
-	// Tell GPU to deallocate those buffers
-	glDeleteBuffers(1, &vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN]);
-	glDeleteBuffers(1, &index_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN]);
+	for (auto& kv : terrain_chunks) {
+		if (kv.second.vbo != 0)
+			released_terrain_buffers.push_back(kv.second.vbo);
+	}
+	terrain_chunks.clear();
+}
+
+void RenderSystem::uploadTerrainChunks()
+{
+	// Tell GPU to deallocate the buffers of the chunks that were unloaded
+	if (!released_terrain_buffers.empty()) {
+		glDeleteBuffers((GLsizei)released_terrain_buffers.size(), released_terrain_buffers.data());
+		released_terrain_buffers.clear();
+	}
 
-	// Tell GPU to reallocate those buffers
-	glGenBuffers(1, &vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN]);
-	glGenBuffers(1, &index_buffers[(GLuint)GEOMETRY_BUFFER_ID::TERRAIN]);
+	for (auto& kv : terrain_chunks) {
+		TerrainChunkMesh& mesh = kv.second;
+		if (!mesh.vertices.empty()) {
+			if (mesh.vbo == 0)
+				glGenBuffers(1, &mesh.vbo);
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(BatchedVertex) * mesh.vertices.size(), mesh.vertices.data(), GL_STATIC_DRAW);
+			std::vector<BatchedVertex>().swap(mesh.vertices);
+		}
+		else if (!mesh.changed_tiles.empty()) {
+			glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+			for (size_t j = 0; j < mesh.changed_tiles.size(); j++) {
+				glBufferSubData(GL_ARRAY_BUFFER, mesh.changed_tiles[j] * sizeof(BatchedVertex) * 4, sizeof(BatchedVertex) * 4, &mesh.changed_vertices[j * 4]);
+			}
+			mesh.changed_tiles.clear();
+			mesh.changed_vertices.clear();
+		}
+		gl_has_errors();
+	}
 }
 
 /// <summary>
@@ -852,12 +893,14 @@ void RenderSystem::renderText(
 	const mat3& view_matrix) {
 	// Switch to text vao
 	glBindVertexArray(text_vao);
+	state_changes.add();
 	// Load the vertex buffer allocated for "TEXT"
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint) GEOMETRY_BUFFER_ID::TEXT]);
 
 	// Load the text shader
 	const GLuint program = effects[(GLuint)EFFECT_ASSET_ID::TEXT];
 	glUseProgram(program);
+	state_changes.add();
 	gl_has_errors();
 
 	// Pass a colour to a uniform "textColor". We expect it to stay constant for this render pass.
@@ -902,6 +945,7 @@ void RenderSystem::renderText(
         };
         // Tell OpenGL to load in the glyph/texture associated with this character.
         glBindTexture(GL_TEXTURE_2D, ch.textureID);
+        state_changes.add();
 		gl_has_errors();
 
 		// We replace the current vertex buffer with the new positions of the next character
@@ -912,6 +956,7 @@ void RenderSystem::renderText(
 		// read the vertex buffer for the text VAO. 
 		// VAOs allow us to let OpenGL know ahead of time what to expect when draw is called.
         glDrawArrays(GL_TRIANGLES, 0, 6);
+        draw_calls.add();
 
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.advance >> 6) * scale / tile_size_px; // bitshift by 6 to get value in pixels (2^6 = 64)
@@ -919,4 +964,5 @@ void RenderSystem::renderText(
     }
 	glBindBuffer(GL_ARRAY_BUFFER, 0);	// Release the vertex buffer, not really important
 	glBindVertexArray(global_vao);	// Return to regular vao
+	state_changes.add();
 }
@@ -6,6 +6,7 @@
 #include "common.hpp"
 #include "components.hpp"
 #include "tiny_ecs.hpp"
+#include "tiny_ecs_registry.hpp"
 #include <unordered_set>
 
 #include <ft2build.h>
@@ -15,6 +16,8 @@
 // visual entities in the game
 class RenderSystem {
 public:
+	explicit RenderSystem(ECSRegistry& registry_arg) : registry(registry_arg) {}
+
 	/// TODO: add more orientations
 	enum ORIENTATIONS : uint8 {
 		ISOLATED,
@@ -268,10 +271,28 @@ public:
 	template <class T, class U>
 	void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<U> indices);
 
+	// A tile of a terrain chunk to draw, see loadTerrainChunk
+	struct TerrainTile
+	{
+		int local;				// index of the tile in its chunk, see TerrainChunk::cells
+		vec2 position;
+		TerrainCell cell;
+		uint8_t frame_value;	// orientation of directional terrain
+	};
+
 	/// <summary>
-	/// Generates the vertex and index buffers for batch rendering terrain.
+	/// Builds the vertices of a terrain chunk, which are drawn from then on. They reach the GPU at the next draw,
+	/// so this can be called before GL is initialized and from any thread the terrain steps on.
 	/// </summary>
-	void initializeTerrainBuffers(std::unordered_map<unsigned int, ORIENTATIONS>& directional_tex_orientations);
+	/// <param name="chunk">The index of the chunk, see TerrainSystem</param>
+	/// <param name="tiles">The tiles of the chunk. Tiles left out, past the edge of the map, are not drawn.</param>
+	void loadTerrainChunk(int chunk, const std::vector<TerrainTile>& tiles);
+
+	/// <summary>
+	/// Stops drawing a terrain chunk and frees its vertex buffer at the next draw.
+	/// </summary>
+	/// <param name="chunk">The index of the chunk, see TerrainSystem</param>
+	void unloadTerrainChunk(int chunk);
 
 	void initializeGlTextures();
 
@@ -283,6 +304,10 @@ public:
 	void initializeGlEffects();
 
 	void initializeGlMeshes();
+
+	// Loads the meshes that colliders are made from without touching GL, for simulating without a window
+	void loadColliderMeshes();
+
 	Mesh& getMesh(GEOMETRY_BUFFER_ID id) { return meshes[(int)id]; };
 	void initializeSpriteSheetQuad(GEOMETRY_BUFFER_ID gid, int numberOfRowSprites, float numberOfColumnSprites);
 
@@ -299,6 +324,12 @@ public:
 	// Destroy resources associated to one or all entities created by the system
 	~RenderSystem();
 
+	// Remembers the position of every Motion before a simulation tick, for draw() to interpolate from
+	void snapshotMotions();
+
+	// Where draw() places the entities between the previous tick (0) and the last one (1), see FixedTimestep::alpha
+	void setInterpolation(float alpha);
+
 	// Draw all entities when in the world
 	void draw();
 
@@ -310,15 +341,16 @@ public:
 	mat3 createUnscaledProjectionMatrix();
 
 	/// <summary>
-	/// Modifies the terrain vertex buffer to regenerate rendering values for a specific tile.
+	/// Modifies the vertex buffer of a terrain chunk to regenerate rendering values for a specific tile.
 	/// </summary>
-	/// <param name="cell">The tile</param>
-	/// <param name="i">The tile's index in the Cell array</param>
+	/// <param name="chunk">The index of the loaded chunk the tile is in</param>
+	/// <param name="i">The tile's index in its chunk</param>
+	/// <param name="position">The tile's world position</param>
 	/// <param name="data">The updated render request</param>
-	void changeTerrainData(Entity cell, unsigned int i, TerrainCell& data, uint8_t frameValue = 0);
+	void changeTerrainData(int chunk, unsigned int i, vec2 position, TerrainCell& data, uint8_t frameValue = 0);
 
 	/// <summary>
-	/// Releases the frame buffer. Make sure you call initializeTerrainBuffers again.
+	/// Unloads every terrain chunk. The terrain loads the ones it needs again, see TerrainSystem::stream.
 	/// </summary>
 	void empty_terrain_buffer();
 
@@ -326,13 +358,40 @@ public:
 	// Code based off: https://learnopengl.com/In-Practice/Text-Rendering
 	void renderText(std::string text, float x, float y, float scale, glm::vec3 color, const mat3& projection_matrix, const mat3& view_matrix);
 
-	// Do not modify this. READ ONLY!!
-	bool is_terrain_mesh_loaded = false;
-
 	void drawParticles(Entity entity ,const mat3& view_matrix, const mat3& projection);
 
+	/// <summary>
+	/// Moves an entity to another render layer. Use this instead of writing RenderRequest::layer_id,
+	/// so that the layer buckets stay up to date.
+	/// </summary>
+	/// <param name="entity">Entity with a render request</param>
+	/// <param name="layer">The new layer</param>
+	void setRenderLayer(Entity entity, RENDER_LAYER_ID layer);
+
+	// Draw the lines of the metrics HUD in the top left corner, over everything else (see MetricsReporter::hud_lines)
+	bool show_metrics_hud = false;
+	void setMetricsHud(std::vector<std::string> lines) { metrics_hud_lines = std::move(lines); }
+
 
 private:
+	ECSRegistry& registry;
+
+	// Positions before the last tick by entity index, and the entity each one belongs to, see snapshotMotions
+	std::vector<vec2> previous_positions;
+	std::vector<Entity> previous_entities;
+	float interpolation = 1.f;
+
+	// The position of the entity as drawn: between the previous and current one, unless it did not exist before the tick
+	vec2 interpolatedPosition(Entity entity, vec2 position);
+
+	// Same as createModelMatrix, at the interpolated position
+	mat3 createInterpolatedModelMatrix(Entity entity);
+
+	std::vector<std::string> metrics_hud_lines;
+	const float METRICS_HUD_TEXT_SCALE = 0.3f;
+	const float METRICS_HUD_LINE_HEIGHT = 0.35f;	// in tiles
+	void drawMetricsHud();
+
 	// Freetype stuff
 	typedef struct {
 		unsigned int textureID;  // ID handle of the glyph texture
@@ -364,31 +423,47 @@ private:
 	void drawTexturedMesh(Entity entity, const mat3& view_matrix, const mat3& projection);
 	void drawToScreen();
 
-	/// <summary>
-	/// Adds 4 vertices and 6 indices to make a quad. Does not check for overlapping vertices.
-	/// </summary>
-	/// <typeparam name="T">Index buffer integer type</typeparam>
-	/// <param name="modelMatrix">The transform matrix of the quad</param>
-	/// <param name="texture">Texture ID assigned to this quad</param>
-	/// <param name="vertices">The vertex buffer</param>
-	/// <param name="indicies">The index buffer</param>
-	template <class T>
-	void make_quad(mat3 modelMatrix, uint16_t texture_id, std::vector<BatchedVertex>& vertices, std::vector<T>& indicies,
-		uint8_t flags = 0, uint8_t frameValue = 0);
-
 	void makeQuadVertices(glm::mat3& modelMatrix, uint16_t texture_id, std::vector<RenderSystem::BatchedVertex>& vertices,
 		uint8_t flags = 0, uint8_t frameValue = 0);
 
+	// Vertex buffer of a loaded terrain chunk, drawn with the shared TERRAIN index buffer
+	struct TerrainChunkMesh
+	{
+		GLuint vbo = 0;
+		std::vector<BatchedVertex> vertices;		// not on the GPU yet, uploaded by drawTerrain
+		std::vector<unsigned int> changed_tiles;	// changed since the upload, their quads are in changed_vertices
+		std::vector<BatchedVertex> changed_vertices;
+	};
+	std::unordered_map<int, TerrainChunkMesh> terrain_chunks;
+	std::vector<GLuint> released_terrain_buffers;	// of unloaded chunks, deleted by drawTerrain
+
+	// Moves the pending changes of the terrain chunks to the GPU
+	void uploadTerrainChunks();
+
 	/// <summary>
-	/// Batch-draws the terrain layer.
+	/// Batch-draws the terrain layer, one draw call per loaded chunk.
 	/// </summary>
 	/// <param name="view_2D">The camera view matrix</param>
 	/// <param name="projection_2D">The screen projection matrix</param>
 	void drawTerrain(const mat3& view_2D, const mat3& projection_2D);
+	/// <summary>
+	/// Draws every entity of a render layer that has a motion.
+	/// </summary>
+	void drawLayer(RENDER_LAYER_ID layer, const mat3& view_2D, const mat3& projection_2D);
+
+	// Reads a mesh from its .obj file into meshes
+	void loadMesh(GEOMETRY_BUFFER_ID geom_index, const std::string& name);
+
+	// Flips the collider meshes (player and mob) into the orientation the physics expects
+	void adjustColliderMesh(GEOMETRY_BUFFER_ID geom_index);
+
+	// Entities of each render layer, kept up to date by observers on registry.renderRequests (see init)
+	EntitySet layer_entities[(int)RENDER_LAYER_ID::LAYER_COUNT];
+
 	// void drawFOW();
 	//void load(); 
 	// Window handle
-	GLFWwindow* window;
+	GLFWwindow* window = nullptr;
 
 	// Screen texture handles
 	GLuint frame_buffer;
@@ -72,27 +72,20 @@ bool RenderSystem::init(GLFWwindow* window_arg, const ivec2 window_size)
 	initializeGlGeometryBuffers();
 	initializeTextRenderer();
 
-	return true;
-}
+	// Bucket the render requests by layer as they come and go, so draw() does not re-bucket every frame
+	registry.renderRequests.on_add([this](const Entity* batch, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			RENDER_LAYER_ID layer = registry.renderRequests.get(batch[i]).layer_id;
+			assert(layer != RENDER_LAYER_ID::LAYER_COUNT && "entity render request with incorrect layer ID (LAYER_COUNT)");
+			layer_entities[(int)layer].emplace(batch[i]);
+		}
+	});
+	registry.renderRequests.on_remove([this](const Entity* batch, size_t count) {
+		for (size_t i = 0; i < count; i++)
+			layer_entities[(int)registry.renderRequests.get(batch[i]).layer_id].remove(batch[i]);
+	});
 
-/// <summary>
-/// Adds a new quad and places it in the vertex and index buffer.
-/// Used for batch rendering.
-/// </summary>
-/// <param name="modelMatrix"></param>
-/// <param name="texture"></param>
-/// <param name="vertices"></param>
-/// <param name="indicies"></param>
-template <class T>
-void RenderSystem::make_quad(mat3 modelMatrix, uint16_t texture_id, std::vector<BatchedVertex>& vertices, 
-	std::vector<T>& indicies, uint8_t flags, uint8_t frameValue) {
-
-	makeQuadVertices(modelMatrix, texture_id, vertices, flags, frameValue);
-
-	int i = vertices.size() / 4 - 1;
-	for (uint x : { 0, 3, 1, 1, 3, 2 }) {
-		indicies.push_back(i * 4 + x);
-	}
+	return true;
 }
 
 void RenderSystem::makeQuadVertices(glm::mat3& modelMatrix, uint16_t texture_id, std::vector<BatchedVertex>& vertices, 
@@ -148,28 +141,29 @@ void RenderSystem::makeQuadVertices(glm::mat3& modelMatrix, uint16_t texture_id,
 	}
 }
 
-void RenderSystem::initializeTerrainBuffers(std::unordered_map<unsigned int, ORIENTATIONS>& directional_tex_orientations)
+void RenderSystem::loadTerrainChunk(int chunk, const std::vector<TerrainTile>& tiles)
 {
-	std::vector<BatchedVertex> vertices;
-	// We need 32-bit indices because 16-bit indices limits us to 
-	// sqrt[2^16 / (number of indices per quad = 6)] = ~104 x 104 grid
-	// The new maximum should be ~26,754 x 26,754.
-	std::vector<uint32_t> indices;
-
-	for (uint32_t i = 0; i < registry.terrainCells.entities.size(); i++) {
-		Entity e = registry.terrainCells.entities[i];
-		TerrainCell& cell = registry.terrainCells.components[i];
+	TerrainChunkMesh& mesh = terrain_chunks[chunk];
+	mesh.changed_tiles.clear();
+	mesh.changed_vertices.clear();
+
+	// Every chunk has a quad per cell so that they can share an index buffer, the quads of missing tiles are empty
+	mesh.vertices.assign(TERRAIN_CHUNK_CELLS * 4, BatchedVertex());
+	std::vector<BatchedVertex> quad;
+	for (const TerrainTile& tile : tiles) {
+		TerrainCell cell = tile.cell;
 		uint8_t flags = directional_terrain.count(cell.terrain_type) ? DIRECTIONAL : 0;
-		bool has_orientation = flags & DIRECTIONAL;
-		uint8_t frameValue = has_orientation ? directional_tex_orientations[i] : 0;
-		mat3 modelMatrix = createModelMatrix(e);	// preprocess transform matrices because
-													// we can't really have per-mesh transforms so let's just bake them in!
-
-		make_quad(modelMatrix, cell.terrain_type, vertices, indices, flags, frameValue);
+		uint8_t frameValue = (flags & DIRECTIONAL) ? tile.frame_value : 0;
+		// preprocess transform matrices because
+		// we can't really have per-mesh transforms so let's just bake them in!
+		Transform transform;
+		transform.translate(tile.position);
+		mat3 modelMatrix = transform.mat;
+
+		quad.clear();
+		makeQuadVertices(modelMatrix, cell.terrain_type, quad, flags, frameValue);
+		std::copy(quad.begin(), quad.end(), mesh.vertices.begin() + tile.local * 4);
 	}
-
-	bindVBOandIBO(GEOMETRY_BUFFER_ID::TERRAIN, vertices, indices);
-	is_terrain_mesh_loaded = true;
 }
 
 void RenderSystem::initializeGlTextures()
@@ -403,34 +397,13 @@ void RenderSystem::initializeGlMeshes()
 	{
 		// Initialize meshes
 		GEOMETRY_BUFFER_ID geom_index = mesh_paths[i].first;
-		std::string name = mesh_paths[i].second;
-		Mesh::loadFromOBJFile(name, 
-			meshes[(int)geom_index].vertices,
-			meshes[(int)geom_index].vertex_indices,
-			meshes[(int)geom_index].original_size);
+		loadMesh(geom_index, mesh_paths[i].second);
 
 		bindVBOandIBO(geom_index,
 			meshes[(int)geom_index].vertices, 
 			meshes[(int)geom_index].vertex_indices);
 
-		// adjustment for player mesh vertices (invert y and some offset)
-		if (geom_index == GEOMETRY_BUFFER_ID::PLAYER_MESH) {
-			
-			for (int j = 0; j < meshes[(int)geom_index].vertices.size(); j++)
-			{
-				meshes[(int)geom_index].vertices[j].position.y = (meshes[(int)geom_index].vertices[j].position.y * -1.f) - 0.5f;
-			}
-		}
-
-		// adjustment for mob mesh
-		if (geom_index == GEOMETRY_BUFFER_ID::MOB001_MESH) {
-
-			for (int j = 0; j < meshes[(int)geom_index].vertices.size(); j++)
-			{
-				meshes[(int)geom_index].vertices[j].position.y = (meshes[(int)geom_index].vertices[j].position.y * -1.f);
-			}
-		}
-
+		adjustColliderMesh(geom_index);
 	}
 }
 
@@ -461,6 +434,21 @@ void RenderSystem::initializeGlGeometryBuffers()
 	const std::vector<uint16_t> textured_indices = { 0, 3, 1, 1, 3, 2 };
 	bindVBOandIBO(GEOMETRY_BUFFER_ID::SPRITE, textured_vertices, textured_indices);
 
+	////////////////////////
+	// Initialize terrain
+	// Each terrain chunk has its own vertex buffer (see loadTerrainChunk), with a quad per cell in the same order,
+	// so they all share these indices. A chunk has few enough vertices for 16-bit indices.
+	std::vector<uint16_t> terrain_indices;
+	for (uint16_t i = 0; i < TERRAIN_CHUNK_CELLS; i++) {
+		for (uint16_t x : { 0, 3, 1, 1, 3, 2 }) {
+			terrain_indices.push_back(i * 4 + x);
+		}
+	}
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)GEOMETRY_BUFFER_ID::TERRAIN]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		sizeof(terrain_indices[0]) * terrain_indices.size(), terrain_indices.data(), GL_STATIC_DRAW);
+	gl_has_errors();
+
 	////////////////////////
 	// Initialize pebble
 	std::vector<ColoredVertex> pebble_vertices;
@@ -569,20 +557,25 @@ RenderSystem::~RenderSystem()
 {
 	// Don't need to free gl resources since they last for as long as the program,
 	// but it's polite to clean after yourself.
-	glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
-	glDeleteBuffers((GLsizei)index_buffers.size(), index_buffers.data());
-	glDeleteTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
-	glDeleteTextures(1, &off_screen_render_buffer_color);
-	glDeleteTextures(1, &texture_array);
-	glDeleteRenderbuffers(1, &off_screen_render_buffer_depth);
-	gl_has_errors();
+	// Without init there is no GL context and nothing to free, e.g. for the worlds of a WorldBatch
+	if (window) {
+		glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
+		glDeleteBuffers((GLsizei)index_buffers.size(), index_buffers.data());
+		empty_terrain_buffer();
+		glDeleteBuffers((GLsizei)released_terrain_buffers.size(), released_terrain_buffers.data());
+		glDeleteTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
+		glDeleteTextures(1, &off_screen_render_buffer_color);
+		glDeleteTextures(1, &texture_array);
+		glDeleteRenderbuffers(1, &off_screen_render_buffer_depth);
+		gl_has_errors();
 
-	for(uint i = 0; i < effect_count; i++) {
-		glDeleteProgram(effects[i]);
+		for(uint i = 0; i < effect_count; i++) {
+			glDeleteProgram(effects[i]);
+		}
+		// delete allocated resources
+		glDeleteFramebuffers(1, &frame_buffer);
+		gl_has_errors();
 	}
-	// delete allocated resources
-	glDeleteFramebuffers(1, &frame_buffer);
-	gl_has_errors();
 
 	// remove all entities created by the render system
 	while (registry.renderRequests.entities.size() > 0)
@@ -616,6 +609,47 @@ bool RenderSystem::initScreenTexture()
 	return true;
 }
 
+bool gl_has_errors()
+{
+	// TODO: Uncomment for debugging. Find out how to not let this compile w/ CMake release builds.
+
+	
+	GLenum error = glGetError();
+
+	if (error == GL_NO_ERROR) return false;
+
+	while (error != GL_NO_ERROR)
+	{
+		const char* error_str = "";
+		switch (error)
+		{
+		case GL_INVALID_OPERATION:
+			error_str = "INVALID_OPERATION";
+			break;
+		case GL_INVALID_ENUM:
+			error_str = "INVALID_ENUM";
+			break;
+		case GL_INVALID_VALUE:
+			error_str = "INVALID_VALUE";
+			break;
+		case GL_OUT_OF_MEMORY:
+			error_str = "OUT_OF_MEMORY";
+			break;
+		case GL_INVALID_FRAMEBUFFER_OPERATION:
+			error_str = "INVALID_FRAMEBUFFER_OPERATION";
+			break;
+		}
+
+		fprintf(stderr, "OpenGL: %s", error_str);
+		error = glGetError();
+		assert(false);
+	}
+
+	return true;
+	
+	//return false;
+}
+
 bool gl_compile_shader(GLuint shader)
 {
 	glCompileShader(shader);
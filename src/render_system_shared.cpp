@@ -0,0 +1,87 @@
+// internal
+#include "render_system.hpp"
+
+// The parts of the render system that need no GL context. The headless build (src/headless/) links these
+// with stubs for everything else.
+
+/// <summary>
+/// Generates a TRS matrix from an entity. Entity must have a Motion component.
+/// </summary>
+/// <param name="entity">Entity with a motion component to generate from</param>
+/// <returns>A TRS Matrix that converts from local space to the parent space (usually world).</returns>
+mat3 RenderSystem::createModelMatrix(Entity entity)
+{
+	MotionRef motion = registry.motions.get(entity);
+
+	Transform modelMatrix;
+	modelMatrix.translate(motion.position);
+	modelMatrix.rotate(motion.angle);
+	modelMatrix.scale(motion.scale);
+
+	// Parent space -> local/model space? Inverse this TRS matrix!
+	return modelMatrix.mat;
+}
+
+mat3 RenderSystem::createScaledProjectionMatrix()
+{
+	// Othogonal projection matrix.
+	// Same code as the template since it scales with aspect ratio.
+	int x = window_resolution.x;
+	int y = window_resolution.y;
+
+	// We must scale how each tile is affected by the resolution because:
+	//	1. We don't want the player to see more of the map if they play on a larger resolution
+	const double s = static_cast<double>(x) / target_resolution.x;
+	const float tile_size_px_scaled = tile_size_px * s;
+
+	float left = -x / 2.f; // Modified these values so the middle of the screen is now 0,0
+	float top = -y / 2.f;
+	
+	float right = x / 2.f;
+	float bottom = y /2.f;
+
+	float sx = 2.f / (right - left) * tile_size_px_scaled;	// We finally scale the world space -> screen space tile size mappings
+	float sy = 2.f / (top - bottom) * tile_size_px_scaled;
+	float tx = -(right + left) / (right - left) * tile_size_px_scaled;
+	float ty = -(top + bottom) / (top - bottom) * tile_size_px_scaled;
+
+	return {{sx, 0.f, 0.f}, {0.f, sy, 0.f}, {tx, ty, 1.f}};
+}
+
+void RenderSystem::loadColliderMeshes()
+{
+	for (uint i = 0; i < mesh_paths.size(); i++)
+	{
+		loadMesh(mesh_paths[i].first, mesh_paths[i].second);
+		adjustColliderMesh(mesh_paths[i].first);
+	}
+}
+
+void RenderSystem::loadMesh(GEOMETRY_BUFFER_ID geom_index, const std::string& name)
+{
+	Mesh::loadFromOBJFile(name, 
+		meshes[(int)geom_index].vertices,
+		meshes[(int)geom_index].vertex_indices,
+		meshes[(int)geom_index].original_size);
+}
+
+void RenderSystem::adjustColliderMesh(GEOMETRY_BUFFER_ID geom_index)
+{
+	// adjustment for player mesh vertices (invert y and some offset)
+	if (geom_index == GEOMETRY_BUFFER_ID::PLAYER_MESH) {
+		
+		for (int j = 0; j < meshes[(int)geom_index].vertices.size(); j++)
+		{
+			meshes[(int)geom_index].vertices[j].position.y = (meshes[(int)geom_index].vertices[j].position.y * -1.f) - 0.5f;
+		}
+	}
+
+	// adjustment for mob mesh
+	if (geom_index == GEOMETRY_BUFFER_ID::MOB001_MESH) {
+
+		for (int j = 0; j < meshes[(int)geom_index].vertices.size(); j++)
+		{
+			meshes[(int)geom_index].vertices[j].position.y = (meshes[(int)geom_index].vertices[j].position.y * -1.f);
+		}
+	}
+}
@@ -107,11 +107,11 @@ void from_json(const json& j, Powerup& powerup) {
 // NOTE: Currently saving every field of these structs - but this isn't necessary, just for cleanliness of code. If we need more space we can trim here :)
 void SaveGame(
     Player& player, 
-    Motion& player_motion,
+    const Motion& player_motion,
     ITEM_TYPE active_weapon,
     std::vector<Weapon> weapons,
-    std::vector<std::pair<Mob&, Motion&>> mobs, 
-    std::vector<std::pair<Item&, Motion&>> items, 
+    std::vector<std::pair<Mob&, Motion>> mobs, 
+    std::vector<std::pair<Item&, Motion>> items, 
     std::vector<QUEST_ITEM_STATUS> quest_item_statuses, 
     SpaceshipHome& spaceshipHome, 
     std::vector<Powerup> powerups,
@@ -1,15 +1,22 @@
 #include "spaceship_home_system.hpp"
 
 void SpaceshipHomeSystem::step(float elapsed_ms) {
-	Motion& camera_motion = registry.motions.get(registry.cameras.entities[0]);
+	MotionRef camera_motion = registry.motions.get(registry.cameras.entities[0]);
 
-	// UI Movement
-	for (Entity e : registry.screenUI.entities) {
+	// UI Movement, all of it when the camera moved, otherwise only the UI that was just added
+	auto move_ui = [&](Entity e) {
 		if (registry.motions.has(e)) {
 			vec2& ui_inital_position = registry.screenUI.get(e);
-			Motion& ui_motion = registry.motions.get(e);
+			MotionRef ui_motion = registry.motions.get(e);
 			ui_motion.position = ui_inital_position + camera_motion.position;
 		}
+	};
+	if (registry.motions.is_changed(registry.cameras.entities[0])) {
+		for (Entity e : registry.screenUI.entities)
+			move_ui(e);
+	}
+	else {
+		registry.screenUI.each_changed(move_ui);
 	}
 };
 
@@ -43,7 +50,7 @@ void SpaceshipHomeSystem::enterSpaceship() {
 
 	// No camera shake 
 	Entity camera = registry.cameras.entities[0];
-	Motion& camera_motion = registry.motions.get(camera);
+	MotionRef camera_motion = registry.motions.get(camera);
 	camera_motion.angle = 0;
 	camera_motion.scale = { 1.f, 1.f };
 
@@ -55,6 +62,7 @@ void SpaceshipHomeSystem::enterSpaceship() {
 
 	// Create ammo storage count
 	ammo_storage_count = createText(
+		registry,
 		renderer, 
 		AMMO_STORAGE_COUNT_POSITION, 
 		createStorageCountTextString(spaceship_home_info.ammo_storage), 
@@ -64,6 +72,7 @@ void SpaceshipHomeSystem::enterSpaceship() {
 
 	// Create food storage count
 	food_storage_count = createText(
+		registry,
 		renderer, 
 		FOOD_STORAGE_COUNT_POSITION, 
 		createStorageCountTextString(spaceship_home_info.food_storage), 
@@ -73,6 +82,7 @@ void SpaceshipHomeSystem::enterSpaceship() {
 
 	// Create health storage text
 	health_storage_count = createText(
+		registry,
 		renderer, 
 		HEALTH_STORAGE_COUNT_POSITION, 
 		createStorageCountTextString(spaceship_home_info.health_storage), 
@@ -89,7 +99,7 @@ void SpaceshipHomeSystem::exitSpaceship() {
 
 	// Reset player's position
 	Entity player = registry.players.entities[0]; 
-	Motion& motion = registry.motions.get(player);
+	MotionRef motion = registry.motions.get_mut(player);
 	motion.position = { 0.f, 0.f };
 
 	// Set player to not be home
@@ -143,8 +153,8 @@ bool SpaceshipHomeSystem::isMouseOverStorageItem(vec2 mouse_pos, TEXTURE_ASSET_I
 void SpaceshipHomeSystem::regenerateStat(RESOURCE_TYPE type, Entity player_food_bar, Entity player_health_bar) {
 	SpaceshipHome& spaceship_home_info = registry.spaceshipHomes.get(spaceship_home);
 	Player& player_info = registry.players.get(registry.players.entities[0]);
-	Motion& player_health_bar_motion = registry.motions.get(player_health_bar);
-	Motion& player_food_bar_motion = registry.motions.get(player_food_bar);
+	MotionRef player_health_bar_motion = registry.motions.get(player_health_bar);
+	MotionRef player_food_bar_motion = registry.motions.get(player_food_bar);
 
 	switch(type) {
 		case RESOURCE_TYPE::AMMO:
@@ -178,7 +188,7 @@ void SpaceshipHomeSystem::regenerateStat(RESOURCE_TYPE type, Entity player_food_
 Entity SpaceshipHomeSystem::updateStorageCountText(RESOURCE_TYPE type) {
 	SpaceshipHome& spaceship_home_info = registry.spaceshipHomes.get(spaceship_home);
 
-	Entity old_count;
+	Entity old_count = Entity::null();
 	vec2 position;
 	int amt_in_storage;
 	switch(type) {
@@ -204,6 +214,7 @@ Entity SpaceshipHomeSystem::updateStorageCountText(RESOURCE_TYPE type) {
 
 	// Create new count
 	Entity new_count = createText(
+		registry,
 		renderer, 
 		position, 
 		createStorageCountTextString(amt_in_storage), 
@@ -222,7 +233,7 @@ Entity SpaceshipHomeSystem::createSpaceshipHome(vec2 position, int health_storag
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the motion
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -257,7 +268,7 @@ Entity SpaceshipHomeSystem::createSpaceshipHomeItem(vec2 position, TEXTURE_ASSET
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -302,11 +313,11 @@ void SpaceshipHomeSystem::updateStat(int& stat, int& storage, int max_stat_value
 	}
 };
 
-void SpaceshipHomeSystem::updateStatBar(int new_val, Motion& bar, int max_bar_value, vec2 scale_factor) {
+void SpaceshipHomeSystem::updateStatBar(int new_val, MotionRef bar, int max_bar_value, vec2 scale_factor) {
 	bar.scale = vec2(((float) new_val / (float) max_bar_value) * scale_factor.x, scale_factor.y);
 };
 
-void SpaceshipHomeSystem::updateStorageBar(int new_val, Motion& bar, int max_bar_value, vec2 scale_factor) {
+void SpaceshipHomeSystem::updateStorageBar(int new_val, MotionRef bar, int max_bar_value, vec2 scale_factor) {
 	bar.scale = vec2(scale_factor.x, ((float) new_val / (float) max_bar_value) * scale_factor.y);
 };
 
@@ -14,7 +14,8 @@ class SpaceshipHomeSystem
 {
     public:
         /// @brief SpaceshipHomeSystem constructor
-        SpaceshipHomeSystem()
+        explicit SpaceshipHomeSystem(ECSRegistry& registry_arg)
+            : registry(registry_arg)
         {
         }
 
@@ -77,6 +78,7 @@ class SpaceshipHomeSystem
         const vec3 STORAGE_EMPTY_TEXT_COLOR = { 1.f, 0.f, 0.f };
         const float STORAGE_COUNT_TEXT_SCALE = 0.5;
 
+        ECSRegistry& registry;
         RenderSystem* renderer;
         WeaponsSystem* weaponsSystem;
         QuestSystem* quest_system;
@@ -113,14 +115,14 @@ class SpaceshipHomeSystem
         /// @param bar The motion component of the bar
         /// @param max_bar_value The max value the bar can be
         /// @param scale_factor The scale factor for the bar
-        void updateStatBar(int new_val, Motion& bar, int max_bar_value, vec2 scale_factor);
+        void updateStatBar(int new_val, MotionRef bar, int max_bar_value, vec2 scale_factor);
 
         /// @brief Updates the scale of a spaceship sstorage bar
         /// @param new_val The new value for the bar
         /// @param bar The motion component of the bar
         /// @param max_bar_value The max value the bar can be
         /// @param scale_factor The scale factor for the bar
-        void updateStorageBar(int new_val, Motion& bar, int max_bar_value, vec2 scale_factor);
+        void updateStorageBar(int new_val, MotionRef bar, int max_bar_value, vec2 scale_factor);
 
         /// @brief Updates the text count for a resource in storage
         /// @param type The type of the resource to update the text count for
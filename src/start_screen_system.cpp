@@ -37,7 +37,7 @@ void StartScreenSystem::init(GLFWwindow* window_arg, RenderSystem* renderer_arg,
 
     // Set a starting camera position and movement direction
     camera_position = {0.f, 0.f};   // camera at origin
-    createCamera(camera_position);
+    createCamera(registry, camera_position);
     movement_idx = 0;               // camera will move right
 
     // The mouse is not hovering over anything
@@ -85,7 +85,7 @@ void StartScreenSystem::step(float elapsed_ms) {
     }
 
     // Update camera position
-    Motion& motion = registry.motions.get(registry.get_main_camera());
+    MotionRef motion = registry.motions.get(registry.get_main_camera());
     motion.position += camera_movement[movement_idx].first;
 
     // Decrement the camera movement tracker and check if we need to change direction
@@ -103,7 +103,7 @@ void StartScreenSystem::step(float elapsed_ms) {
         vec2 norm_velocity = normalize(vec2(window_w, window_h));
 
         for (Entity e : moving_entities) {
-            Motion& motion = registry.motions.get(e);
+            MotionRef motion = registry.motions.get(e);
 
             // 0.5 velocity and 0.5 degree rotation every frame
             motion.position += (norm_velocity * .5f);
@@ -123,7 +123,7 @@ void StartScreenSystem::setupScreen(int screen_num) {
     // The origin of the mesh is the centre. The origin of the screen is top right.
     // We need to shift the position to fill up the screen.
     // We also need to scale the mesh to match the screen size.
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = { (float)window_w/2, (float)window_h/2 };
@@ -167,7 +167,7 @@ void StartScreenSystem::setupScreenOneObjects() {
 	Mesh& mesh_one = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity_one, &mesh_one);
 
-    auto& motion_one = registry.motions.emplace(entity_one);
+    MotionRef motion_one = registry.motions.emplace(entity_one);
 	motion_one.angle = 0.f;
 	motion_one.velocity = { 0.f, 0.f };
 	motion_one.position = { button_x, button_y };
@@ -189,7 +189,7 @@ void StartScreenSystem::setupScreenOneObjects() {
 	Mesh& mesh_two = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity_two, &mesh_two);
 
-    auto& motion_two = registry.motions.emplace(entity_two);
+    MotionRef motion_two = registry.motions.emplace(entity_two);
 	motion_two.angle = 0.f;
 	motion_two.velocity = { 0.f, 0.f };
 	motion_two.position = { button_x, button_y };
@@ -220,7 +220,7 @@ void StartScreenSystem::setupScreenTwoObjects() {
     Mesh& mesh_spaceship = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
     registry.meshPtrs.emplace(spaceship_entity, &mesh_spaceship);
 
-    auto& motion_two = registry.motions.emplace(spaceship_entity);
+    MotionRef motion_two = registry.motions.emplace(spaceship_entity);
 	motion_two.angle = 0.f;
 	motion_two.velocity = { 0.f, 0.f };
 	motion_two.position = { -150, -150 };
@@ -241,7 +241,7 @@ void StartScreenSystem::setupScreenTwoObjects() {
     Mesh& mesh_part1 = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
     registry.meshPtrs.emplace(part1_entity, &mesh_part1);
 
-    auto& motion_part1 = registry.motions.emplace(part1_entity);
+    MotionRef motion_part1 = registry.motions.emplace(part1_entity);
 	motion_part1.angle = 0.f;
 	motion_part1.velocity = { 0.f, 0.f };
 	motion_part1.position = { 50, -150 };
@@ -262,7 +262,7 @@ void StartScreenSystem::setupScreenTwoObjects() {
     Mesh& mesh_part2 = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
     registry.meshPtrs.emplace(part2_entity, &mesh_part2);
 
-    auto& motion_part2 = registry.motions.emplace(part2_entity);
+    MotionRef motion_part2 = registry.motions.emplace(part2_entity);
 	motion_part2.angle = 0.f;
 	motion_part2.velocity = { 0.f, 0.f };
 	motion_part2.position = { -100, 50 };
@@ -284,7 +284,7 @@ void StartScreenSystem::setupScreenTwoObjects() {
     Mesh& mesh_part3 = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
     registry.meshPtrs.emplace(part3_entity, &mesh_part3);
 
-    auto& motion_part3 = registry.motions.emplace(part3_entity);
+    MotionRef motion_part3 = registry.motions.emplace(part3_entity);
 	motion_part3.angle = 0.f;
 	motion_part3.velocity = { 0.f, 0.f };
 	motion_part3.position = { -25, -25 };
@@ -305,7 +305,7 @@ void StartScreenSystem::setupScreenTwoObjects() {
     Mesh& mesh_part4 = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
     registry.meshPtrs.emplace(part4_entity, &mesh_part4);
 
-    auto& motion_part4 = registry.motions.emplace(part4_entity);
+    MotionRef motion_part4 = registry.motions.emplace(part4_entity);
 	motion_part4.angle = 0.f;
 	motion_part4.velocity = { 0.f, 0.f };
 	motion_part4.position = { 125, -100 };
@@ -326,7 +326,7 @@ void StartScreenSystem::setupScreenTwoObjects() {
     Mesh& mesh_player = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
     registry.meshPtrs.emplace(player_entity, &mesh_player);
 
-    auto& motion_player = registry.motions.emplace(player_entity);
+    MotionRef motion_player = registry.motions.emplace(player_entity);
 	motion_player.angle = 0.f;
 	motion_player.velocity = { 0.f, 0.f };
 	motion_player.position = { -350, -275 };
@@ -362,9 +362,9 @@ void StartScreenSystem::on_mouse_move(vec2 mouse_position) {
             Entity e_two = screen_one_hover_swaps["start_button"].second;
 
             RenderRequest& one_rr = registry.renderRequests.get(e_one);
-            one_rr.layer_id = one_rr.layer_id == RENDER_LAYER_ID::LAYER_3 ? RENDER_LAYER_ID::LAYER_4 : RENDER_LAYER_ID::LAYER_3;
+            renderer->setRenderLayer(e_one, one_rr.layer_id == RENDER_LAYER_ID::LAYER_3 ? RENDER_LAYER_ID::LAYER_4 : RENDER_LAYER_ID::LAYER_3);
             RenderRequest& two_rr = registry.renderRequests.get(e_two);
-            two_rr.layer_id = two_rr.layer_id == RENDER_LAYER_ID::LAYER_3 ? RENDER_LAYER_ID::LAYER_4 : RENDER_LAYER_ID::LAYER_3;
+            renderer->setRenderLayer(e_two, two_rr.layer_id == RENDER_LAYER_ID::LAYER_3 ? RENDER_LAYER_ID::LAYER_4 : RENDER_LAYER_ID::LAYER_3);
 
             was_hovering = is_currently_hovering;
         }
@@ -392,6 +392,11 @@ void StartScreenSystem::on_mouse_click(int button, int action, int mods) {
 	}
 }
 
+void StartScreenSystem::skip() {
+    screen_idx = screen_textures.size();
+    renderer->fow_radius = 4.5f;
+}
+
 bool StartScreenSystem::is_finished() {
     return finished_start_screens || bool(glfwWindowShouldClose(window));
 }
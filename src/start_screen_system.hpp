@@ -10,7 +10,8 @@
 class StartScreenSystem
 {
     public:
-    StartScreenSystem()
+    explicit StartScreenSystem(ECSRegistry& registry_arg)
+        : registry(registry_arg)
     {
     }
 
@@ -22,6 +23,9 @@ class StartScreenSystem
 
     bool is_finished();
 
+    // Goes past all screens, the next step finishes. Recorded sessions skip them so their replays start the same way.
+    void skip();
+
     private:
     // The window
     GLFWwindow* window;
@@ -29,6 +33,7 @@ class StartScreenSystem
     int window_h;
 
     // The rendering system
+    ECSRegistry& registry;
     RenderSystem* renderer;
 
     // The terrain system
@@ -0,0 +1,155 @@
+// internal
+#include "system_scheduler.hpp"
+#include "profiler.hpp"
+
+// stlib
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+using Clock = std::chrono::high_resolution_clock;
+
+namespace {
+	bool shares_state(const std::vector<const void*>& a, const std::vector<const void*>& b)
+	{
+		for (const void* owner : a) {
+			if (std::find(b.begin(), b.end(), owner) != b.end())
+				return true;
+		}
+		return false;
+	}
+}
+
+SystemScheduler::System& SystemScheduler::add(std::string name, std::function<void(float)> step)
+{
+	systems.emplace_back(new System(std::move(name), std::move(step)));
+	systems.back()->profile_name = Profiler::intern(systems.back()->name);
+	systems.back()->run_times = &Metrics::histogram("system." + systems.back()->name + "_ms");
+	return *systems.back();
+}
+
+bool SystemScheduler::conflicts(const System& a, const System& b)
+{
+	if (a.runs_alone() || b.runs_alone())
+		return true;
+	if ((a.written_types & (b.read_types | b.written_types)).any() || (b.written_types & a.read_types).any())
+		return true;
+	return shares_state(a.written_states, b.read_states) || shares_state(a.written_states, b.written_states) ||
+		shares_state(b.written_states, a.read_states);
+}
+
+void SystemScheduler::build_frame()
+{
+	frame.clear();
+	for (std::unique_ptr<System>& system : systems) {
+		if (!system->condition || system->condition())
+			frame.push_back(system.get());
+	}
+
+	// Only the conflicts that are not already implied by others become edges, e.g. a system after an exclusive one
+	// only waits for that one. reached[i][j] is true if system i waits for j, directly or not.
+	std::vector<std::vector<bool>> reached(frame.size(), std::vector<bool>(frame.size(), false));
+	for (size_t i = 0; i < frame.size(); i++) {
+		System& system = *frame[i];
+		system.dependencies.clear();
+		system.wave = 0;
+		for (size_t j = i; j-- > 0;) {
+			if (reached[i][j] || !conflicts(*frame[j], system))
+				continue;
+			system.dependencies.push_back(j);
+			system.wave = std::max(system.wave, frame[j]->wave + 1);
+			reached[i][j] = true;
+			for (size_t k = 0; k < j; k++) {
+				if (reached[j][k])
+					reached[i][k] = true;
+			}
+		}
+		std::reverse(system.dependencies.begin(), system.dependencies.end());
+	}
+}
+
+void SystemScheduler::run_timed(System& system, float elapsed_ms)
+{
+	PROFILE_SCOPE(system.profile_name);
+	auto start = Clock::now();
+	system.step(elapsed_ms);
+	system.last_ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	system.total_ms += system.last_ms;
+	system.runs++;
+	system.run_times->record(system.last_ms);
+}
+
+void SystemScheduler::run(float elapsed_ms, JobSystem& jobs)
+{
+	build_frame();
+
+	if (jobs.thread_count() == 1) {
+		for (System* system : frame)
+			run_timed(*system, elapsed_ms);
+		return;
+	}
+
+	// Every system starts once the last system it waits for is done
+	std::vector<std::vector<size_t>> dependents(frame.size());
+	std::unique_ptr<std::atomic<size_t>[]> waiting(new std::atomic<size_t>[frame.size()]);
+	for (size_t i = 0; i < frame.size(); i++) {
+		waiting[i] = frame[i]->dependencies.size();
+		for (size_t j : frame[i]->dependencies)
+			dependents[j].push_back(i);
+	}
+
+	// Systems may run on any thread of jobs, but create their entities with the ids of the calling thread's world
+	EntityAllocator& allocator = Entity::allocator();
+	std::atomic<size_t> remaining(frame.size());
+	std::function<void(size_t)> start = [&](size_t i) {
+		jobs.run([&, i]() {
+			{
+				EntityAllocator::Binding binding(allocator);
+				run_timed(*frame[i], elapsed_ms);
+			}
+			for (size_t dependent : dependents[i]) {
+				if (--waiting[dependent] == 0)
+					start(dependent);
+			}
+			remaining--;
+		});
+	};
+	for (size_t i = 0; i < frame.size(); i++) {
+		if (frame[i]->dependencies.empty())
+			start(i);
+	}
+
+	while (remaining.load() > 0) {
+		if (!jobs.run_one())
+			std::this_thread::yield();
+	}
+}
+
+void SystemScheduler::print_schedule(FILE* out) const
+{
+	unsigned int waves = 0;
+	for (const System* system : frame)
+		waves = std::max(waves, system->wave + 1);
+
+	fprintf(out, "Schedule of %zu systems in %u waves:\n", frame.size(), waves);
+	for (unsigned int wave = 0; wave < waves; wave++) {
+		fprintf(out, "  wave %u\n", wave);
+		for (const System* system : frame) {
+			if (system->wave != wave)
+				continue;
+			fprintf(out, "    %-16s%s", system->name.c_str(), system->runs_alone() ? " exclusive" : "");
+			for (size_t i = 0; i < system->dependencies.size(); i++)
+				fprintf(out, "%s%s", i == 0 ? " after " : ", ", frame[system->dependencies[i]]->name.c_str());
+			fprintf(out, "\n");
+		}
+	}
+}
+
+void SystemScheduler::print_timings(FILE* out) const
+{
+	fprintf(out, "%-16s %8s %12s %12s\n", "system", "runs", "avg (ms)", "last (ms)");
+	for (const std::unique_ptr<System>& system : systems) {
+		fprintf(out, "%-16s %8u %12.3f %12.3f\n", system->name.c_str(), system->runs,
+			system->runs > 0 ? system->total_ms / system->runs : 0.0, system->last_ms);
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiny_ecs_registry.hpp"
+#include "job_system.hpp"
+#include "metrics.hpp"
+
+// Runs the systems of a frame, overlapping the ones that do not touch the same data.
+// Every system declares the component types it reads and writes, and the state of other systems it depends on.
+// Two systems conflict if one writes what the other reads or writes, or if either of them is exclusive.
+// Each frame the enabled systems form a DAG in which a system waits for every earlier one (in the order they
+// were added) it conflicts with, so a frame has the same result as calling them one after another, on any
+// number of threads. With one thread that is exactly what happens.
+// A system that creates entities or adds or removes components directly, instead of through registry.commands,
+// must be exclusive: that changes the entity signatures and ids that every system shares.
+// A system that declares nothing is exclusive too, so a system that gains code before it gains declarations
+// runs alone rather than racing the others.
+// Usage:
+//		scheduler.add("physics", [&](float ms) { physics.step(ms); }).exclusive();
+//		scheduler.add("weapons", [&](float ms) { weapons.step(ms); }).writes<Weapon>().reads_state(&powerups);
+//		scheduler.run(elapsed_ms, *registry.jobs);
+class SystemScheduler
+{
+public:
+	class System
+	{
+		friend class SystemScheduler;
+
+		std::string name;
+		const char* profile_name = nullptr;	// name in the profiler's traces, see Profiler::intern
+		std::function<void(float)> step;
+		std::function<bool()> condition;
+
+		ComponentSignature read_types;
+		ComponentSignature written_types;
+		std::vector<const void*> read_states;
+		std::vector<const void*> written_states;
+		bool is_exclusive = false;
+
+		// The schedule of the last frame, as positions in SystemScheduler::frame
+		std::vector<size_t> dependencies;
+		unsigned int wave = 0;
+
+		// Exclusive, or declares nothing at all
+		bool runs_alone() const {
+			return is_exclusive || (read_types.none() && written_types.none() && read_states.empty() && written_states.empty());
+		}
+
+		// Timings of the frames the system ran in
+		double last_ms = 0;
+		double total_ms = 0;
+		unsigned int runs = 0;
+		Histogram* run_times = nullptr;		// the metric "system.<name>_ms"
+
+	public:
+		System(std::string name_arg, std::function<void(float)> step_arg) : name(std::move(name_arg)), step(std::move(step_arg)) {}
+
+		template <typename... Components>
+		System& reads() {
+			read_types |= ECSRegistry::signature_mask<Components...>();
+			return *this;
+		}
+
+		template <typename... Components>
+		System& writes() {
+			written_types |= ECSRegistry::signature_mask<Components...>();
+			return *this;
+		}
+
+		// State outside the registry, e.g. the flags of another system, identified by its owner
+		System& reads_state(const void* owner) {
+			read_states.push_back(owner);
+			return *this;
+		}
+
+		System& writes_state(const void* owner) {
+			written_states.push_back(owner);
+			return *this;
+		}
+
+		// Runs alone, after every earlier system and before every later one
+		System& exclusive() {
+			is_exclusive = true;
+			return *this;
+		}
+
+		// Only runs in frames where condition() is true, checked for all systems before the frame starts
+		System& when(std::function<bool()> condition_arg) {
+			condition = std::move(condition_arg);
+			return *this;
+		}
+	};
+
+	// Adds a system after the ones added so far. The reference stays valid for the scheduler's lifetime.
+	System& add(std::string name, std::function<void(float)> step);
+
+	// Runs the enabled systems of one frame on the threads of jobs and returns once all of them are done
+	void run(float elapsed_ms, JobSystem& jobs);
+
+	// Prints the systems of the last frame grouped in waves, each wave only waiting for earlier ones
+	void print_schedule(FILE* out) const;
+
+	// Prints the average and last run time of every system
+	void print_timings(FILE* out) const;
+
+private:
+	std::vector<std::unique_ptr<System>> systems;
+
+	// The systems enabled in the current frame, in the order they were added
+	std::vector<System*> frame;
+
+	static bool conflicts(const System& a, const System& b);
+
+	// Picks the enabled systems and links every one to the earlier ones it conflicts with
+	void build_frame();
+
+	static void run_timed(System& system, float elapsed_ms);
+};
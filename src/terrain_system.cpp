@@ -1,156 +1,520 @@
 #include "terrain_system.hpp"
+#include "profiler.hpp"
+#include "metrics.hpp"
 #include "cstring"
 
+namespace {
+	// Always-on counters of the chunk streaming, see Metrics
+	Counter& chunks_loaded = Metrics::counter("terrain.chunks_loaded");
+	Counter& chunks_evicted = Metrics::counter("terrain.chunks_evicted");
+	Gauge& chunks_resident = Metrics::gauge("terrain.chunks_resident");
+
+	// Offset of the neighbour in each ori_index direction: top, right, bottom, left, top-right, bottom-right,
+	// bottom-left, top-left
+	const int NEIGHBOUR_X[8] = { 0, 1, 0, -1, 1, 1, -1, -1 };
+	const int NEIGHBOUR_Y[8] = { -1, 0, 1, 0, -1, 1, 1, -1 };
+}
+
 void TerrainSystem::init(const unsigned int x, const unsigned int y, RenderSystem* renderer)
 {
+	PROFILE_SCOPE("TerrainSystem::init");
 	this->renderer = renderer;
 
-	if (terraincell_grid != nullptr) {		// if grid is allocated, deallocate
-		registry.terrainCells.clear();
-		deallocate_terrain_grid();
-	}
-
-	if (entity_grid != nullptr) {			// if grid is allocated, deallocate
-		deallocate_entity_grid();
-	}
+	release();
+	renderer->empty_terrain_buffer();
 
 	size_x = x;
 	size_y = y;
 
-	entity_grid = new Entity[x * y]();			// 1D 2-dimensional array so we can guarantee that
-	terraincell_grid = new uint32_t[x * y];	// the entire world is in the same memory block.
-	entityStart = entity_grid[0];
-
-	for (int i = 0; i < x * y; i++) {
-		Entity& entity = entity_grid[i];
-		Motion& motion = registry.motions.emplace(entity);
-		motion.position = to_world_coordinates(i);
-		if (i % x == 0 || i % x == x - 1 ||
-			i / y == 0 || i / y == y - 1) {
-			terraincell_grid[i] = ((uint32)TERRAIN_TYPE::ROCK << 16) | TERRAIN_FLAGS::COLLIDABLE;
+	// The cells are generated chunk by chunk as they are needed, see read_chunk
+	allocate_chunks();
+	stream({ 0.f, 0.f });
+}
+
+void TerrainSystem::init(const std::string& map_name, RenderSystem* renderer)
+{
+	PROFILE_SCOPE("TerrainSystem::init");
+	this->renderer = renderer;
+
+	release();
+	renderer->empty_terrain_buffer();
+
+	load_grid(map_name);	// Load map from file
+	//clean_map_tiles();
+	stream({ 0.f, 0.f });
+}
+
+void TerrainSystem::step(float delta_time)
+{
+	PROFILE_SCOPE("TerrainSystem::step");
+	if (registry.players.entities.empty())
+		return;
+	stream(registry.motions.get(registry.players.entities[0]).position);
+}
+
+void TerrainSystem::stream(vec2 focus)
+{
+	ivec2 half_size = { size_x / 2, size_y / 2 };
+	ivec2 cell = glm::clamp(quantize_vec2(focus) + half_size, ivec2(0), ivec2(size_x - 1, size_y - 1));
+	ivec2 centre = cell / TERRAIN_CHUNK_SIZE;
+	if (centre != focus_chunk || active_chunks.empty()) {
+		PROFILE_SCOPE("TerrainSystem::activate_chunks");
+		focus_chunk = centre;
+		activate_chunks(centre);
+	}
+
+	if ((int)resident_chunks.size() > max_resident_chunks) {
+		PROFILE_SCOPE("TerrainSystem::evict_chunks");
+		// Furthest from the focus last
+		auto distance = [this](int index) {
+			return std::max(abs(index % chunks_x - focus_chunk.x), abs(index / chunks_x - focus_chunk.y));
+		};
+		std::vector<int> by_distance = resident_chunks;
+		std::sort(by_distance.begin(), by_distance.end(), [&](int a, int b) { return distance(a) < distance(b); });
+		while ((int)by_distance.size() > max_resident_chunks) {
+			if (!evict_chunk(by_distance.back()))
+				break;
+			by_distance.pop_back();
 		}
-		else {
-			terraincell_grid[i] = ((uint32_t)TERRAIN_TYPE::GRASS) << 16 | TERRAIN_FLAGS::ALLOW_SPAWNS;
+		resident_chunks.clear();
+		for (int index : by_distance) {
+			if (chunks[index].load(std::memory_order_relaxed) != nullptr)
+				resident_chunks.push_back(index);
 		}
+	}
+	chunks_resident.set((double)resident_chunks.size());
+}
 
-		TerrainCell& cell = registry.terrainCells.emplace(entity, terraincell_grid[i]);
+void TerrainSystem::activate_chunks(ivec2 centre)
+{
+	std::vector<int> next;
+	for (int y = std::max(centre.y - active_radius, 0); y <= std::min(centre.y + active_radius, chunks_y - 1); y++) {
+		for (int x = std::max(centre.x - active_radius, 0); x <= std::min(centre.x + active_radius, chunks_x - 1); x++) {
+			next.push_back(y * chunks_x + x);
+		}
 	}
+	assert((int)next.size() <= max_resident_chunks && "The active chunks must fit in memory");
+
+	for (int index : active_chunks) {
+		if (!std::binary_search(next.begin(), next.end(), index))
+			deactivate_chunk(index);
+	}
+	prefetch_chunks(next);
+	for (int index : next) {
+		if (!std::binary_search(active_chunks.begin(), active_chunks.end(), index))
+			activate_chunk(index);
+	}
+	active_chunks.swap(next);
+	active_version++;
 }
 
-void TerrainSystem::init(const std::string& map_name, RenderSystem* renderer)
+void TerrainSystem::prefetch_chunks(const std::vector<int>& indices)
 {
-	this->renderer = renderer;
+	if (mapped_header == nullptr)
+		return;
+
+	// Only chunks that are decoded from the mapped file: it is read-only, so they can be decoded on any thread
+	std::vector<int> missing;
+	const SmapChunkEntry* table = smap_chunk_table(mapped_header);
+	for (int index : indices) {
+		if (chunks[index].load(std::memory_order_acquire) == nullptr && page_offsets[index] < 0 &&
+			table[index].encoding != SMAP_ENCODING::RAW)
+			missing.push_back(index);
+	}
+	if (missing.size() < 2)
+		return;
+
+	std::vector<std::unique_ptr<TerrainChunk>> decoded(missing.size());
+	registry.jobs->parallel_for(missing.size(), 4, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			decoded[i].reset(new TerrainChunk());
+			decoded[i]->own_cells.reset(new uint32_t[TERRAIN_CHUNK_CELLS]());
+			read_chunk(missing[i], decoded[i]->own_cells.get());
+			decoded[i]->cells = decoded[i]->own_cells.get();
+			build_layers(*decoded[i], missing[i]);
+		}
+	});
 
-	if (terraincell_grid != nullptr) {		// if grid is allocated, deallocate
-		registry.terrainCells.clear();
-		deallocate_terrain_grid();
+	std::lock_guard<std::mutex> lock(chunk_mutex);
+	for (size_t i = 0; i < missing.size(); i++) {
+		if (chunks[missing[i]].load(std::memory_order_relaxed) != nullptr)
+			continue;		// loaded by a path search meanwhile
+		resident_chunks.push_back(missing[i]);
+		chunks_loaded.add();
+		chunks[missing[i]].store(decoded[i].release(), std::memory_order_release);
 	}
+}
 
-	if (entity_grid != nullptr) {			// if grid is allocated, deallocate
-		deallocate_entity_grid();
+void TerrainSystem::activate_chunk(int index)
+{
+	TerrainChunk& chunk = this->chunk(index);
+	chunk.active = true;
+	chunk.colliders.clear();
+
+	const int x0 = (index % chunks_x) * TERRAIN_CHUNK_SIZE;
+	const int y0 = (index / chunks_x) * TERRAIN_CHUNK_SIZE;
+	const int width = std::min(TERRAIN_CHUNK_SIZE, size_x - x0);
+	const int height = std::min(TERRAIN_CHUNK_SIZE, size_y - y0);
+
+	std::vector<RenderSystem::TerrainTile> tiles;
+	tiles.reserve(width * height);
+	for (int row = 0; row < height; row++) {
+		for (int column = 0; column < width; column++) {
+			int local = row * TERRAIN_CHUNK_SIZE + column;
+			int cell = (y0 + row) * size_x + x0 + column;
+			TerrainCell data = chunk.cells[local];
+			if (data.flag & TERRAIN_FLAGS::COLLIDABLE)
+				chunk.colliders.push_back(cell);
+
+			uint8_t frame_value = directional_terrain.count(data.terrain_type) ? find_tile_orientation(cell) : 0;
+			tiles.push_back({ local, to_world_coordinates(cell), data, frame_value });
+		}
 	}
+	renderer->loadTerrainChunk(index, tiles);
+}
 
-	load_grid(map_name);	// Load map from file
-	entity_grid = new Entity[size_x * size_y]();
-	entityStart = entity_grid[0];
-	//clean_map_tiles();
+void TerrainSystem::deactivate_chunk(int index)
+{
+	TerrainChunk& chunk = this->chunk(index);
+	chunk.active = false;
+	std::vector<int>().swap(chunk.colliders);
+	renderer->unloadTerrainChunk(index);
+}
 
-	// Bind entities to respective TerrainCell
-	for (unsigned int i = 0; i < size_x * size_y; i++) {
-		Entity& entity = entity_grid[i];
-		Motion& motion = registry.motions.emplace(entity);
-		motion.position = to_world_coordinates(i);
-		TerrainCell& cell = registry.terrainCells.emplace(entity, terraincell_grid[i]);
+void TerrainSystem::get_active_colliders(std::vector<int>& cells)
+{
+	// Chunks in a row interleave their cells, so their lists are merged rather than appended
+	size_t first = cells.size();
+	for (int index : active_chunks) {
+		const std::vector<int>& colliders = chunk(index).colliders;
+		cells.insert(cells.end(), colliders.begin(), colliders.end());
 	}
+	std::sort(cells.begin() + first, cells.end());
 }
 
-void TerrainSystem::step(float delta_time)
+TerrainChunk& TerrainSystem::load_chunk(int index)
 {
+	std::lock_guard<std::mutex> lock(chunk_mutex);
+	TerrainChunk* chunk = chunks[index].load(std::memory_order_relaxed);
+	if (chunk != nullptr)
+		return *chunk;		// another thread got to it first
+
+	chunk = new TerrainChunk();
+	if (page_offsets[index] < 0)
+		chunk->cells = mapped_chunk(index);		// no copy, the chunk uses the pages of the map file
+	if (chunk->cells == nullptr) {
+		chunk->own_cells.reset(new uint32_t[TERRAIN_CHUNK_CELLS]());
+		read_chunk(index, chunk->own_cells.get());
+		chunk->cells = chunk->own_cells.get();
+	}
+	build_layers(*chunk, index);
+	resident_chunks.push_back(index);
+	chunks_loaded.add();
+	chunks[index].store(chunk, std::memory_order_release);
+	return *chunk;
 }
 
-Entity TerrainSystem::get_cell(vec2 position)
+const uint32_t* TerrainSystem::mapped_chunk(int index)
 {
-	// round x and y value before casting for more accurate mapping of position to cell
-	ivec2 quantized_position = quantize_vec2(position);
-	return get_cell(quantized_position.x, quantized_position.y);
+	if (mapped_header == nullptr)
+		return nullptr;
+
+	const SmapChunkEntry& entry = smap_chunk_table(mapped_header)[index];
+	if (entry.encoding != SMAP_ENCODING::RAW || entry.size != sizeof(uint32_t) * TERRAIN_CHUNK_CELLS ||
+		entry.offset % alignof(uint32_t) != 0)
+		return nullptr;
+
+	const uint8_t* data = mapped_map->data() + entry.offset;
+	if (crc32(data, entry.size) != entry.crc) {
+		fprintf(stderr, "Terrain chunk %d of the map file is damaged, generating it instead\n", index);
+		return nullptr;
+	}
+	return reinterpret_cast<const uint32_t*>(data);
 }
 
-Entity TerrainSystem::get_cell(int x, int y)
+uint32_t* TerrainSystem::writable_cells(TerrainChunk& chunk)
 {
-	assert(entity_grid != nullptr);
-	assert(abs(x) <= size_x / 2);
-	assert(abs(y) <= size_y / 2);
-	return get_cell(to_array_index(x, y));
+	// Copy on write: the mapped file is read-only and shared with every other chunk that was not changed
+	if (chunk.own_cells == nullptr) {
+		chunk.own_cells.reset(new uint32_t[TERRAIN_CHUNK_CELLS]);
+		memcpy(chunk.own_cells.get(), chunk.cells, sizeof(uint32_t) * TERRAIN_CHUNK_CELLS);
+		chunk.cells = chunk.own_cells.get();
+	}
+	chunk.dirty = true;
+	return chunk.own_cells.get();
 }
 
-Entity TerrainSystem::get_cell(int index)
+void TerrainSystem::build_layers(TerrainChunk& chunk, int index)
 {
-	assert(entity_grid != nullptr);
-	assert(index >= 0);
-	assert(index < size_x * size_y);
-	return entity_grid[index];
+	const int x0 = (index % chunks_x) * TERRAIN_CHUNK_SIZE;
+	const int y0 = (index / chunks_x) * TERRAIN_CHUNK_SIZE;
+	memset(chunk.collidable, 0, sizeof(chunk.collidable));
+	memset(chunk.no_pathfind, 0, sizeof(chunk.no_pathfind));
+	memset(chunk.spawnable, 0, sizeof(chunk.spawnable));
+
+	for (int local = 0; local < TERRAIN_CHUNK_CELLS; local++) {
+		const uint32_t cell = chunk.cells[local];
+		TerrainChunk::set_bit(chunk.collidable, local, cell & TERRAIN_FLAGS::COLLIDABLE);
+		TerrainChunk::set_bit(chunk.no_pathfind, local, cell & TERRAIN_FLAGS::DISABLE_PATHFIND);
+		TerrainChunk::set_bit(chunk.spawnable, local, (cell & (COLLIDABLE | ALLOW_SPAWNS)) == ALLOW_SPAWNS);
+
+		// The smallest zone whose circle holds the cell, in whole cells so that no square root is needed
+		const int64_t x = x0 + local % TERRAIN_CHUNK_SIZE - size_x / 2;
+		const int64_t y = y0 + local / TERRAIN_CHUNK_SIZE - size_y / 2;
+		const int64_t distance_squared = x * x + y * y;
+		uint8_t zone = ZONE_COUNT;
+		for (int z = 0; z < ZONE_COUNT; z++) {
+			if (distance_squared <= zone_radii_squared[z]) {
+				zone = (uint8_t)z | (distance_squared == zone_radii_squared[z] ? ZONE_OUTER_EDGE : 0);
+				break;
+			}
+		}
+		chunk.zones[local] = zone;
+	}
+
+	for (int local = 0; local < TERRAIN_CHUNK_CELLS; local++)
+		chunk.passable[local] = passable_neighbours(chunk, index, local);
 }
 
-int TerrainSystem::get_cell_index(Entity cell)
+void TerrainSystem::update_layers(TerrainChunk& chunk, int index, int local)
 {
-	int cell_index = cell - entityStart;
-	assert(cell_index >= 0);
-	assert(cell_index < size_x * size_y);
-	return cell_index;
+	const uint32_t cell = chunk.cells[local];
+	const bool was_collidable = TerrainChunk::bit(chunk.collidable, local);
+	TerrainChunk::set_bit(chunk.collidable, local, cell & TERRAIN_FLAGS::COLLIDABLE);
+	TerrainChunk::set_bit(chunk.no_pathfind, local, cell & TERRAIN_FLAGS::DISABLE_PATHFIND);
+	TerrainChunk::set_bit(chunk.spawnable, local, (cell & (COLLIDABLE | ALLOW_SPAWNS)) == ALLOW_SPAWNS);
+
+	// Neighbours in other chunks read the collidable layer of this one, see get_accessible_neighbours
+	if (was_collidable == (bool)(cell & TERRAIN_FLAGS::COLLIDABLE))
+		return;
+	const int column = local % TERRAIN_CHUNK_SIZE;
+	const int row = local / TERRAIN_CHUNK_SIZE;
+	const uint8_t inside = neighbours_within(column, row, TERRAIN_CHUNK_SIZE, TERRAIN_CHUNK_SIZE);
+	for (int k = 0; k < orientations_n_indices; k++) {
+		if (inside & (1 << k)) {
+			int neighbour = local + NEIGHBOUR_Y[k] * TERRAIN_CHUNK_SIZE + NEIGHBOUR_X[k];
+			chunk.passable[neighbour] = passable_neighbours(chunk, index, neighbour);
+		}
+	}
 }
 
-float TerrainSystem::get_terrain_speed_ratio(Entity cell)
+uint8_t TerrainSystem::passable_neighbours(const TerrainChunk& chunk, int index, int local) const
 {
-    // Get terrain type of cell
-	TerrainCell& c = registry.terrainCells.get(cell);
+	const int column = local % TERRAIN_CHUNK_SIZE;
+	const int row = local / TERRAIN_CHUNK_SIZE;
+	const int x = (index % chunks_x) * TERRAIN_CHUNK_SIZE + column;
+	const int y = (index / chunks_x) * TERRAIN_CHUNK_SIZE + row;
+	if (x >= size_x || y >= size_y)
+		return 0;
+
+	const uint8_t candidates = neighbours_within(column, row, TERRAIN_CHUNK_SIZE, TERRAIN_CHUNK_SIZE) &
+		neighbours_within(x, y, size_x, size_y);
+	uint8_t passable = 0;
+	for (int k = 0; k < orientations_n_indices; k++) {
+		if ((candidates & (1 << k)) &&
+			!TerrainChunk::bit(chunk.collidable, local + NEIGHBOUR_Y[k] * TERRAIN_CHUNK_SIZE + NEIGHBOUR_X[k]))
+			passable |= 1 << k;
+	}
+	return passable;
+}
 
-	return terrain_type_to_speed_ratio[c.terrain_type];
+bool TerrainSystem::in_zone(int cell, ZONE_NUMBER zone)
+{
+	int local;
+	const int index = chunk_of(cell, local);
+	const uint8_t value = chunk(index).zones[local];
+	const int cell_zone = value & ~ZONE_OUTER_EDGE;
+	return cell_zone == zone || ((value & ZONE_OUTER_EDGE) && cell_zone + 1 == zone);
 }
 
-void TerrainSystem::get_accessible_neighbours(Entity cell, std::vector<Entity>& buffer, bool ignoreColliders, bool checkPathfind)
+void TerrainSystem::read_chunk(int index, uint32_t cells[TERRAIN_CHUNK_CELLS])
 {
-	assert(entity_grid != nullptr);
-	assert(terraincell_grid != nullptr);
-	assert(registry.terrainCells.has(cell));
-	int cell_index = cell - entityStart;
-	unsigned int filter = TERRAIN_FLAGS::COLLIDABLE;	// check if tile is collidable
+	if (page_offsets[index] >= 0) {
+		std::fseek(page_file, page_offsets[index], SEEK_SET);
+		if (std::fread(cells, sizeof(uint32_t), TERRAIN_CHUNK_CELLS, page_file) != TERRAIN_CHUNK_CELLS)
+			fprintf(stderr, "Could not read terrain chunk %d back from the page file\n", index);
+		return;
+	}
+
+	const int x0 = (index % chunks_x) * TERRAIN_CHUNK_SIZE;
+	const int y0 = (index / chunks_x) * TERRAIN_CHUNK_SIZE;
+	const int width = std::min(TERRAIN_CHUNK_SIZE, size_x - x0);
+	const int height = std::min(TERRAIN_CHUNK_SIZE, size_y - y0);
+
+	if (mapped_header != nullptr) {
+		const SmapChunkEntry& entry = smap_chunk_table(mapped_header)[index];
+		const uint8_t* data = mapped_map->data() + entry.offset;
+		if (crc32(data, entry.size) == entry.crc &&
+			decode_smap_chunk(data, entry.size, entry.encoding, cells, TERRAIN_CHUNK_CELLS))
+			return;
+		fprintf(stderr, "Terrain chunk %d of the map file is damaged, generating it instead\n", index);
+		memset(cells, 0, sizeof(uint32_t) * TERRAIN_CHUNK_CELLS);
+	}
+
+	if (map_file.is_open()) {
+		for (int row = 0; row < height; row++) {
+			map_file.seekg(map_cells_offset + (std::streamoff)sizeof(uint32_t) * ((y0 + row) * (std::streamoff)size_x + x0));
+			map_file.read((char*)&cells[row * TERRAIN_CHUNK_SIZE], sizeof(uint32_t) * width);
+		}
+		return;
+	}
 
-	if (checkPathfind)
-		filter |= TERRAIN_FLAGS::DISABLE_PATHFIND;	// check if tile has pathfinding disabled
+	// Rock around the edges of the map, grass everywhere else
+	for (int row = 0; row < height; row++) {
+		for (int column = 0; column < width; column++) {
+			int i = (y0 + row) * size_x + x0 + column;
+			if (i % size_x == 0 || i % size_x == size_x - 1 ||
+				i / size_y == 0 || i / size_y == size_y - 1) {
+				cells[row * TERRAIN_CHUNK_SIZE + column] = ((uint32)TERRAIN_TYPE::ROCK << 16) | TERRAIN_FLAGS::COLLIDABLE;
+			}
+			else {
+				cells[row * TERRAIN_CHUNK_SIZE + column] = ((uint32_t)TERRAIN_TYPE::GRASS) << 16 | TERRAIN_FLAGS::ALLOW_SPAWNS;
+			}
+		}
+	}
+}
 
-	int indices[orientations_n_indices] = {
-		cell_index - size_x,		// Top cell
-		cell_index + 1,				// Right cell
-		cell_index + size_x,		// Bottom cell
-		cell_index - 1,				// Left cell
-		cell_index - size_x + 1,	// Top-right cell
-		cell_index + size_x + 1,	// Bottom-right cell
-		cell_index + size_x - 1,	// Bottom-left cell
-		cell_index - size_x - 1,	// Top-left cell
-	};
+void TerrainSystem::copy_chunk(int index, uint32_t cells[TERRAIN_CHUNK_CELLS])
+{
+	std::lock_guard<std::mutex> lock(chunk_mutex);
+	TerrainChunk* chunk = chunks[index].load(std::memory_order_relaxed);
+	if (chunk != nullptr)
+		memcpy(cells, chunk->cells, sizeof(uint32_t) * TERRAIN_CHUNK_CELLS);
+	else
+		read_chunk(index, cells);
+}
 
-	filter_neighbouring_indices(cell_index, indices);
+bool TerrainSystem::evict_chunk(int index)
+{
+	TerrainChunk* chunk = chunks[index].load(std::memory_order_relaxed);
+	assert(chunk != nullptr && !chunk->active);
+
+	if (chunk->dirty) {
+		if (page_file == nullptr)
+			page_file = std::tmpfile();
+		if (page_file == nullptr) {
+			fprintf(stderr, "Could not create the terrain page file, keeping changed chunks in memory\n");
+			return false;
+		}
+		if (page_offsets[index] < 0) {
+			page_offsets[index] = page_file_size;
+			page_file_size += sizeof(uint32_t) * TERRAIN_CHUNK_CELLS;
+		}
+		std::fseek(page_file, page_offsets[index], SEEK_SET);
+		if (std::fwrite(chunk->cells, sizeof(uint32_t) * TERRAIN_CHUNK_CELLS, 1, page_file) != 1) {
+			fprintf(stderr, "Could not page out terrain chunk %d, keeping it in memory\n", index);
+			return false;
+		}
+	}
 
-	for (int i = 0; i < 8; i++) {
-		int index = indices[i];
+	chunks[index].store(nullptr, std::memory_order_relaxed);
+	delete chunk;
+	chunks_evicted.add();
+	return true;
+}
 
-		// Skip cell if index is -1
-		if (index < 0) {
-			continue;
-		}
+void TerrainSystem::allocate_chunks()
+{
+	chunks_x = (size_x + TERRAIN_CHUNK_SIZE - 1) / TERRAIN_CHUNK_SIZE;
+	chunks_y = (size_y + TERRAIN_CHUNK_SIZE - 1) / TERRAIN_CHUNK_SIZE;
+	chunks.reset(new std::atomic<TerrainChunk*>[chunks_x * chunks_y]);
+	for (int i = 0; i < chunks_x * chunks_y; i++)
+		chunks[i].store(nullptr, std::memory_order_relaxed);
+	page_offsets.assign(chunks_x * chunks_y, -1);
+	focus_chunk = { -1, -1 };
+
+	// Chunks are loaded on job threads too, which must not touch the maps
+	for (int type = 0; type < TERRAIN_COUNT; type++) {
+		auto it = terrain_type_to_speed_ratio.find((TERRAIN_TYPE)type);
+		speed_ratios[type] = it != terrain_type_to_speed_ratio.end() ? it->second : 1.f;
+	}
+	for (int zone = 0; zone < ZONE_COUNT; zone++) {
+		auto it = zone_radius_map.find((ZONE_NUMBER)zone);
+		int64_t radius = it != zone_radius_map.end() ? it->second : 0;
+		zone_radii_squared[zone] = radius * radius;
+	}
+}
+
+void TerrainSystem::release()
+{
+	for (int index : resident_chunks)
+		delete chunks[index].load(std::memory_order_relaxed);
+	chunks.reset();
+	resident_chunks.clear();
+	active_chunks.clear();
+
+	if (page_file != nullptr)
+		std::fclose(page_file);
+	page_file = nullptr;
+	page_offsets.clear();
+	page_file_size = 0;
+
+	if (map_file.is_open())
+		map_file.close();
+	map_file.clear();
+	mapped_map->close();
+	mapped_header = nullptr;
+}
 
-		Entity& tile = entity_grid[index];
-		unsigned int cell = terraincell_grid[index];
+int TerrainSystem::get_cell(vec2 position)
+{
+	// round x and y value before casting for more accurate mapping of position to cell
+	ivec2 quantized_position = quantize_vec2(position);
+	return get_cell(quantized_position.x, quantized_position.y);
+}
 
-		// If a cell is not collidable and pathfinding is not disabled, add to buffer
-		if (ignoreColliders) {
-			buffer.push_back(tile);
+int TerrainSystem::get_cell(int x, int y)
+{
+	assert(chunks != nullptr);
+	assert(abs(x) <= size_x / 2);
+	assert(abs(y) <= size_y / 2);
+	return to_array_index(x, y);
+}
+
+float TerrainSystem::get_terrain_speed_ratio(int cell)
+{
+	// The type is a plain index into speed_ratios, so the path searches of PathfindingSystem::step can look up
+	// concurrently
+	const uint32_t type = get_cell_data(cell).terrain_type;
+	assert(type < TERRAIN_COUNT && "Unknown terrain type");
+	return type < TERRAIN_COUNT ? speed_ratios[type] : 1.f;
+}
+
+void TerrainSystem::get_accessible_neighbours(int cell_index, std::vector<int>& buffer, bool ignoreColliders, bool checkPathfind)
+{
+	assert(chunks != nullptr);
+	assert(cell_index >= 0 && cell_index < size_x * size_y);
+	const int x = cell_index % size_x;
+	const int y = cell_index / size_x;
+	uint8_t neighbours = neighbours_within(x, y, size_x, size_y);
+
+	if (!ignoreColliders) {
+		// The neighbours in the same chunk are in its passable layer, only the others need a look at their chunk
+		const int column = x % TERRAIN_CHUNK_SIZE;
+		const int row = y % TERRAIN_CHUNK_SIZE;
+		const TerrainChunk& chunk = this->chunk((y / TERRAIN_CHUNK_SIZE) * chunks_x + x / TERRAIN_CHUNK_SIZE);
+		const uint8_t outside = neighbours & ~neighbours_within(column, row, TERRAIN_CHUNK_SIZE, TERRAIN_CHUNK_SIZE);
+		uint8_t passable = chunk.passable[row * TERRAIN_CHUNK_SIZE + column];
+		for (int k = 0; outside != 0 && k < orientations_n_indices; k++) {
+			if ((outside & (1 << k)) && !is_impassable(cell_index + NEIGHBOUR_Y[k] * size_x + NEIGHBOUR_X[k]))
+				passable |= 1 << k;
 		}
-		else {
-			if (!(cell & filter)) {
-				buffer.push_back(tile);
-			}
+		neighbours = passable;
+	}
+
+	for (int k = 0; neighbours != 0; k++, neighbours >>= 1) {
+		if (!(neighbours & 1))
+			continue;
+		int index = cell_index + NEIGHBOUR_Y[k] * size_x + NEIGHBOUR_X[k];
+
+		// Skip cells that have pathfinding disabled
+		if (checkPathfind && !ignoreColliders) {
+			int neighbour_local;
+			const TerrainChunk& neighbour_chunk = this->chunk(chunk_of(index, neighbour_local));
+			if (TerrainChunk::bit(neighbour_chunk.no_pathfind, neighbour_local))
+				continue;
 		}
+		buffer.push_back(index);
 	}
 }
 
@@ -186,19 +550,90 @@ void TerrainSystem::filter_neighbouring_indices(int cell_index, int indices[orie
 void TerrainSystem::save_grid(const std::string& name)
 {
 	const std::string path = map_path_builder(name);
-	std::ofstream file(path.c_str(), std::ios::binary | std::ios::out);
-	file.write(map_ext.c_str(), map_ext.size());
-	assert(file.is_open() && "Map file cannot be created or modified.");
-	write_to_file(file, savefile_version);
-	write_to_file(file, size_x);
-	write_to_file(file, size_y);
 
-	// Add 32 bytes of padding
-	file.seekp(SMAP_PADDING_BYTES, std::ios::cur);
-
-	file.write((char*)terraincell_grid, sizeof(uint32_t) * size_x * size_y);
+	// Written next to the map first, as the chunks that were never changed are still read from the map file
+	const std::string temporary_path = path + ".tmp";
+	std::ofstream file(temporary_path.c_str(), std::ios::binary | std::ios::out);
+	assert(file.is_open() && "Map file cannot be created or modified.");
 
+	SmapHeader header = {};
+	memcpy(header.magic, map_ext.c_str(), sizeof(header.magic));
+	header.version = savefile_version;
+	header.size_x = size_x;
+	header.size_y = size_y;
+	header.chunk_size = TERRAIN_CHUNK_SIZE;
+	header.chunks_x = chunks_x;
+	header.chunks_y = chunks_y;
+	header.chunk_table_offset = sizeof(SmapHeader);
+
+	// The chunks follow the table, each on its own page if they are RAW and right after each other otherwise
+	std::vector<SmapChunkEntry> table(chunks_x * chunks_y);
+	uint64_t offset = header.chunk_table_offset + sizeof(SmapChunkEntry) * table.size();
+	if (!compress_saved_maps)
+		offset = (offset + SMAP_ALIGNMENT - 1) / SMAP_ALIGNMENT * SMAP_ALIGNMENT;
+
+	uint32_t cells[TERRAIN_CHUNK_CELLS];
+	std::vector<uint8_t> encoded;
+	for (int index = 0; index < chunks_x * chunks_y; index++) {
+		memset(cells, 0, sizeof(cells));
+		copy_chunk(index, cells);
+
+		SmapChunkEntry& entry = table[index];
+		if (compress_saved_maps) {
+			entry.encoding = encode_smap_chunk(cells, TERRAIN_CHUNK_CELLS, encoded);
+		}
+		else {
+			entry.encoding = SMAP_ENCODING::RAW;
+			encoded.assign((uint8_t*)cells, (uint8_t*)cells + sizeof(cells));
+		}
+		entry.offset = offset;
+		entry.size = (uint32_t)encoded.size();
+		entry.crc = crc32(encoded.data(), encoded.size());
+		file.seekp((std::streamoff)offset);
+		file.write((char*)encoded.data(), encoded.size());
+		offset += encoded.size();
+	}
+
+	header.crc = crc32(table.data(), sizeof(SmapChunkEntry) * table.size(), crc32(&header, sizeof(header)));
+	file.seekp(0);
+	write_to_file(file, header);
+	file.write((char*)table.data(), sizeof(SmapChunkEntry) * table.size());
 	file.close();
+
+	// Version 1 maps are read through map_file, which has to be closed before the file can be replaced everywhere.
+	// A mapped map can be replaced while it is mapped, see MappedFile::open.
+	if (map_file.is_open())
+		map_file.close();
+	std::string saved_path = path;
+	std::remove(path.c_str());
+	if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+		fprintf(stderr, "Could not replace the map file %s, it is saved as %s\n", path.c_str(), temporary_path.c_str());
+		saved_path = temporary_path;
+	}
+
+	// The saved map holds the current terrain, so chunks are read from it from now on. The old mapping stays
+	// alive until the resident chunks that use it point at the new one.
+	std::unique_ptr<MappedFile> saved(new MappedFile());
+	const SmapHeader* saved_header = saved->open(saved_path) ? validate_smap(saved->data(), saved->size(), savefile_version) : nullptr;
+	if (saved_header == nullptr) {
+		fprintf(stderr, "Could not map the saved map file %s\n", saved_path.c_str());
+		return;
+	}
+	std::swap(mapped_map, saved);
+	mapped_header = saved_header;
+	for (int index : resident_chunks) {
+		TerrainChunk* chunk = chunks[index].load(std::memory_order_relaxed);
+		if (chunk->own_cells == nullptr) {
+			const uint32_t* mapped_cells = mapped_chunk(index);
+			if (mapped_cells != nullptr)
+				chunk->cells = mapped_cells;
+			else
+				writable_cells(*chunk);		// compressed now, or the old mapping goes away
+		}
+		chunk->dirty = false;
+	}
+	page_offsets.assign(chunks_x * chunks_y, -1);
+	page_file_size = 0;
 }
 
 void TerrainSystem::load_grid(const std::string& name)
@@ -216,17 +651,43 @@ void TerrainSystem::load_grid(const std::string& name)
 	}
 
 	read_from_file(file, save_version);
+
+	if (save_version >= 2) {
+		// Mapped rather than read, loading only touches the header and the chunk table. RAW chunks use the pages
+		// of the file in place (see mapped_chunk), compressed ones are decoded as they are loaded.
+		file.close();
+		if (mapped_map->open(path))
+			mapped_header = validate_smap(mapped_map->data(), mapped_map->size(), savefile_version);
+		if (mapped_header != nullptr && mapped_header->chunk_size != TERRAIN_CHUNK_SIZE) {
+			fprintf(stderr, "Map file has chunks of %u cells, expected %d\n", mapped_header->chunk_size, TERRAIN_CHUNK_SIZE);
+			mapped_header = nullptr;
+		}
+		if (mapped_header == nullptr) {
+			assert(false && "Map file cannot be mapped.");
+			fprintf(stderr, "Generating a %d x %d map instead of %s\n", world_size_x, world_size_y, path.c_str());
+			mapped_map->close();
+			size_x = world_size_x;
+			size_y = world_size_y;
+		}
+		else {
+			size_x = mapped_header->size_x;
+			size_y = mapped_header->size_y;
+		}
+		allocate_chunks();
+		return;
+	}
+
+	// Version 1: the cells row by row after a short header
 	read_from_file(file, size_x);
 	read_from_file(file, size_y);
 
 	// Read past 32 bytes of padding
 	file.seekg(SMAP_PADDING_BYTES, std::ios::cur);
-	if (terraincell_grid == nullptr) {
-		terraincell_grid = new uint32_t[size_x * size_y];
-	}
 
-	file.read((char*)terraincell_grid, sizeof(uint32_t) * size_x * size_y);
-	file.close();
+	// The file stays open, chunks are read from it as they are needed (see read_chunk)
+	map_cells_offset = file.tellg();
+	map_file = std::move(file);
+	allocate_chunks();
 }
 
 unsigned int TerrainSystem::to_array_index(int x, int y)
@@ -246,13 +707,12 @@ unsigned int TerrainSystem::to_array_index(ivec2 position)
 vec2 TerrainSystem::to_world_coordinates(const int index)
 {
 	assert(index >= 0 && index < size_x * size_y);
-	return { (index % size_x) - size_x / 2,
-			index / size_x - size_y / 2 };
+	return terrain_cell_position(index, size_x, size_y);
 }
 
 bool TerrainSystem::matches_terrain_type(uint16_t current_type, int index) {
 	if (index < 0) return true;
-	uint16_t cell_type = terraincell_grid[index] >> 16;
+	uint16_t cell_type = cell_at(index) >> 16;
 	return !(current_type ^ cell_type);
 }
 
@@ -288,7 +748,7 @@ RenderSystem::ORIENTATIONS TerrainSystem::find_tile_orientation(int centre_index
 	centre_index - size_x - 1,	// Top-left cell
 	};
 	filter_neighbouring_indices(centre_index, indices);
-	return find_tile_orientation((uint16_t)(terraincell_grid[centre_index] >> 16), indices);
+	return find_tile_orientation((uint16_t)(cell_at(centre_index) >> 16), indices);
 }
 
 RenderSystem::ORIENTATIONS TerrainSystem::find_tile_orientation(uint16_t current, int indices[orientations_n_indices]) {
@@ -370,19 +830,8 @@ RenderSystem::ORIENTATIONS TerrainSystem::find_tile_orientation(uint16_t current
 	return RenderSystem::ORIENTATIONS::ISOLATED;	// default texture
 }
 
-void TerrainSystem::generate_orientation_map(std::unordered_map<unsigned int, RenderSystem::ORIENTATIONS>& map)
-{
-	for (int cell_index = 0; cell_index < size_x * size_y; cell_index++) {
-		uint16_t current = terraincell_grid[cell_index] >> 16;
-		if (directional_terrain.count(static_cast<TERRAIN_TYPE>(current))) {
-			map.insert({ cell_index, find_tile_orientation(cell_index)});
-		}
-	}
-}
-
 std::vector<vec2> TerrainSystem::get_mob_spawn_locations(std::unordered_map<ZONE_NUMBER,int> num_per_zone) {
     std::vector<vec2> result;
-    std::default_random_engine rng;
 
     for (const auto& kv : num_per_zone) {
         ZONE_NUMBER zone = kv.first;
@@ -404,10 +853,8 @@ std::vector<vec2> TerrainSystem::get_mob_spawn_locations(std::unordered_map<ZONE
 
 vec2 TerrainSystem::get_random_terrain_location() {
 	// Get a random zone
-	std::random_device rd;
-	std::default_random_engine rng(rd());
-	std::uniform_int_distribution<int> distribution(0, ZONE_COUNT-1);
-	ZONE_NUMBER random_zone = static_cast<ZONE_NUMBER>(distribution(rng));
+	Rng& rng = registry.random.stream(RANDOM_STREAM::TERRAIN);
+	ZONE_NUMBER random_zone = static_cast<ZONE_NUMBER>(rng.uniform_int(0, ZONE_COUNT-1));
 
 	// Uncomment for debug
 	// printf("zone: %i\n", random_zone);
@@ -424,24 +871,12 @@ vec2 TerrainSystem::get_random_terrain_location(ZONE_NUMBER zone) {
 	int range_y = zone_radius_map[zone] * 2 > size_y ? size_y : zone_radius_map[zone] * 2;
 
 	// set up the random number generator
-	std::random_device rng;
-	std::mt19937 generator(rng());  // Seed the generator
-	std::uniform_int_distribution<> distribution_x(-range_x/2 + 1, range_x/2 - 1);
-	std::uniform_int_distribution<> distribution_y(-range_y/2 + 1, range_y/2 - 1);
-
-	// Store the radius of the current and previous zones
-	float curr_zone_radius = (float) zone_radius_map[zone];
-	float prev_zone_radius;
-	if (zone == ZONE_0)
-		prev_zone_radius = 0.f;
-	else
-		prev_zone_radius = (float) zone_radius_map[static_cast<ZONE_NUMBER>(zone-1)];
-
+	Rng& rng = registry.random.stream(RANDOM_STREAM::TERRAIN);
 
 	// Get unused spawn location within the given zone
 	while (true) {
-		position.x = distribution_x(generator);
-		position.y = distribution_y(generator);
+		position.x = rng.uniform_int(-range_x/2 + 1, range_x/2 - 1);
+		position.y = rng.uniform_int(-range_y/2 + 1, range_y/2 - 1);
 
 		// Skip locations that are covered by spaceship
 		if (position.x <= 1 && position.x >= -1 && position.y <= 2 && position.y >= -2) {
@@ -453,13 +888,12 @@ vec2 TerrainSystem::get_random_terrain_location(ZONE_NUMBER zone) {
 			continue;
 
 		// Skip locations that is not within the current zone
-		float distance = sqrt(pow(position.x,2) + pow(position.y,2));
-		if (distance > curr_zone_radius || distance < prev_zone_radius)
+		if (!in_zone(get_cell(position), zone))
 			continue;
 
 		if (!is_terrain_location_used(position)) {
 			// Uncomment for debug
-			// printf("position.x: %f, position.y: %f, distance: %f \n", position.x, position.y, distance);
+			// printf("position.x: %f, position.y: %f\n", position.x, position.y);
 			break;
 		}
 	}
@@ -482,15 +916,10 @@ void TerrainSystem::expand_map(const int new_x,const int new_y)
 											(new_y - old_y) / 2
 	};
 
-	// REMEMBER TO FREE THESE
-	Entity* old_entity_grid = entity_grid;
-	uint32_t* old_terraincell_grid = terraincell_grid;
-
-	// Trick init() into thinking the map isn't loaded yet
-	entity_grid = nullptr;
-	terraincell_grid = nullptr;	
-
-	registry.terrainCells.clear();				// Clear so the vector doesn't have to expand more than it needs
+	std::vector<uint32_t> old_cells(old_x * old_y);
+	for (int i = 0; i < old_x * old_y; i++) {
+		old_cells[i] = cell_at(i);
+	}
 
 	init(new_x, new_y, renderer);				// Load empty map with new x and y
 
@@ -499,16 +928,19 @@ void TerrainSystem::expand_map(const int new_x,const int new_y)
 		int y = old_to_new_index_offset.y + (i / old_x);
 		int i_new = x + y * size_x;
 
-		if (i_new < size_x * size_y) {
+		if (i_new >= 0 && i_new < size_x * size_y) {
 			// Truncate if we resized into a smaller map
-			uint32_t data = old_terraincell_grid[i];
-			TerrainCell& cell = registry.terrainCells.get(entity_grid[i_new]);
-
-			terraincell_grid[i_new] = data;		// Replace data with what we have
-			cell.from_uint32(data);				// Also update the TerrainCell component
+			int local;
+			TerrainChunk& chunk = this->chunk(chunk_of(i_new, local));
+			writable_cells(chunk)[local] = old_cells[i];		// Replace data with what we have
 		}
 	}
+	for (int index : resident_chunks)
+		build_layers(this->chunk(index), index);
 
-	deallocate_terrain_grid(old_terraincell_grid);
-	deallocate_entity_grid(old_entity_grid, old_x, old_y);
+	// init() activated the generated cells, hand the copied ones out instead
+	for (int index : active_chunks)
+		deactivate_chunk(index);
+	active_chunks.clear();
+	activate_chunks(focus_chunk);
 }
\ No newline at end of file
@@ -1,5 +1,11 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <map>
 #include <unordered_map>
@@ -10,6 +16,41 @@
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
 #include "render_system.hpp"
+#include "map_file.hpp"
+
+// Words of a bitboard layer of TerrainChunk, a bit per cell in the order of the cells
+const int TERRAIN_CHUNK_WORDS = TERRAIN_CHUNK_CELLS / 64;
+
+/// <summary>
+/// A TERRAIN_CHUNK_SIZE x TERRAIN_CHUNK_SIZE square of the terrain grid, the unit that TerrainSystem keeps in memory,
+/// hands to the renderer and builds colliders from. Chunks on the right and bottom edge of a map whose size is not a
+/// multiple of TERRAIN_CHUNK_SIZE are cut off, their cells past the edge are unused.
+/// </summary>
+struct TerrainChunk
+{
+	// TERRAIN_CHUNK_CELLS packed TerrainCells, row by row: own_cells, or the pages of the mapped map file until the
+	// chunk is changed, see TerrainSystem::writable_cells
+	const uint32_t* cells = nullptr;
+	std::unique_ptr<uint32_t[]> own_cells;
+	bool dirty = false;						// changed since it was loaded, so it is paged out when evicted
+	bool active = false;					// drawn and collidable, see TerrainSystem::stream
+	std::vector<int> colliders;				// the collidable cells while active, in cell order
+
+	// Layers derived from the cells, so that hot queries test a bit or read a byte instead of unpacking cells.
+	// Built when the chunk is loaded and kept current by TerrainSystem::update_tile, see TerrainSystem::build_layers.
+	uint64_t collidable[TERRAIN_CHUNK_WORDS];		// COLLIDABLE
+	uint64_t no_pathfind[TERRAIN_CHUNK_WORDS];		// DISABLE_PATHFIND
+	uint64_t spawnable[TERRAIN_CHUNK_WORDS];		// ALLOW_SPAWNS and not COLLIDABLE
+	uint8_t zones[TERRAIN_CHUNK_CELLS];				// the ZONE_NUMBER of a cell, see TerrainSystem::in_zone
+	uint8_t passable[TERRAIN_CHUNK_CELLS];			// a bit per ori_index: that neighbour is in this chunk and not COLLIDABLE
+
+	static bool bit(const uint64_t layer[TERRAIN_CHUNK_WORDS], int local) {
+		return (layer[local >> 6] >> (local & 63)) & 1;
+	}
+	static void set_bit(uint64_t layer[TERRAIN_CHUNK_WORDS], int local, bool value) {
+		layer[local >> 6] = (layer[local >> 6] & ~(1ull << (local & 63))) | ((uint64_t)value << (local & 63));
+	}
+};
 
 // The underlying terrain grid square
 class TerrainSystem
@@ -22,46 +63,27 @@ private:
 		TOP, RIGHT, BOTTOM, LEFT, TR, BR, BL, TL, orientations_n_indices
 	};
 
-	inline void deallocate_terrain_grid(uint32_t*& terraincell_grid_pointer)	{ // cursed type 
-		delete[] terraincell_grid_pointer;
-		terraincell_grid_pointer = nullptr;
-	}
-
-	inline void deallocate_terrain_grid() {
-		deallocate_terrain_grid(terraincell_grid);
-	}
-
-	inline void deallocate_entity_grid(Entity*& entity_grid_pointer, size_t x, size_t y) {
-
-		for (size_t i = 0; i < x * y; i++) {
-			registry.remove_all_components_of(entity_grid_pointer[i]);
-		}
-		delete[] entity_grid_pointer;
-		entity_grid_pointer = nullptr;
-	}
-
-	inline void deallocate_entity_grid() {
-		deallocate_entity_grid(entity_grid, size_x, size_y);
-	}
-
 public:
 	// size of each respective axes (absolute)
 	int size_x, size_y;
-	
-	TerrainSystem() { entity_grid = nullptr; terraincell_grid = nullptr; }
 
-	~TerrainSystem() {
-		registry.terrainCells.clear();
-		delete[] terraincell_grid;
+	// Chunks within this many chunks of the player are active: drawn and collidable. See stream.
+	int active_radius = 3;
 
-		for (uint i = 0; i < size_x * size_y; i++) {
-			registry.remove_all_components_of(entity_grid[i]);
-		}
+	// Most chunks kept in memory, past it the ones furthest from the player are evicted. Must hold the active ones.
+	int max_resident_chunks = 256;
+
+	// Whether save_grid compresses the chunks (see encode_smap_chunk). Compressed maps are a fraction of the size,
+	// RAW maps are used in place once mapped, without decoding or copying a chunk.
+	bool compress_saved_maps = true;
+	
+	explicit TerrainSystem(ECSRegistry& registry_arg) : registry(registry_arg) {}
 
-		delete[] entity_grid;
+	~TerrainSystem() {
+		release();
 	}	
 
-	// Look-up table for terrain type slow ratios
+	// Look-up table for terrain type slow ratios, copied into speed_ratios when a map is loaded
 	std::unordered_map<TERRAIN_TYPE, float> terrain_type_to_speed_ratio = {
 		{TERRAIN_TYPE::AIR, 1.f},
 		{TERRAIN_TYPE::GRASS, 1.f},
@@ -73,7 +95,7 @@ public:
 	};
 
 	// Look-up table for zone boundaries. Zones are circular.
-	// Key is zone number. Value is the radius from the spaceship
+	// Key is zone number. Value is the radius from the spaceship. Baked into TerrainChunk::zones when a map is loaded.
 	std::unordered_map<ZONE_NUMBER, int> zone_radius_map = {
 		{ZONE_0, 10},
 		{ZONE_1, 17},
@@ -106,11 +128,44 @@ public:
 	void init(const std::string& map_name, RenderSystem* renderer);
 
 	/// <summary>
-	/// Used for cells that may have ticking logic. futureproofing.
+	/// Streams the chunks around the player, see stream.
 	/// </summary>
 	/// <param name="delta_time">The time since the last frame in milliseconds</param>
 	void step(float delta_time);
 
+	/// <summary>
+	/// Activates the chunks within active_radius of the chunk under focus and deactivates the others, handing their
+	/// meshes to and taking them from the renderer. Then evicts the chunks furthest away once more than
+	/// max_resident_chunks are in memory, writing the changed ones to a page file they are read back from.
+	/// Does nothing but the eviction check while focus stays in the same chunk.
+	/// </summary>
+	/// <param name="focus">World position to stream around</param>
+	void stream(vec2 focus);
+
+	/// <summary>
+	/// Goes up by one every time the set of active chunks changes, see PhysicsSystem::initStaticBVH
+	/// </summary>
+	unsigned int get_active_version() const { return active_version; }
+
+	/// <summary>
+	/// Returns true if the cell is in an active chunk: drawn and collidable
+	/// </summary>
+	/// <param name="cell">The index of the cell in the world grid</param>
+	bool is_active(int cell) {
+		int local;
+		TerrainChunk* chunk = chunks[chunk_of(cell, local)].load(std::memory_order_acquire);
+		return chunk != nullptr && chunk->active;
+	}
+
+	/// <summary>
+	/// Appends the collidable cells of all active chunks, in cell order
+	/// </summary>
+	/// <param name="cells">The buffer to append to</param>
+	void get_active_colliders(std::vector<int>& cells);
+
+	// Number of chunks in memory, active or not
+	int get_resident_chunk_count() const { return (int)resident_chunks.size(); }
+
 	/// <summary>
 	/// Rounds a given float into the nearest integer.
 	/// </summary>
@@ -130,33 +185,47 @@ public:
 	}
 
 	/// <summary>
-	/// Returns the entity associated with the cell at the given position
+	/// Returns the cell at the given position. Cells are not entities, a cell is its index in the world grid.
 	/// </summary>
 	/// <param name="position">The position of the cell</param>
-	/// <returns>The terrain cell's entity</returns>
-	Entity get_cell(vec2 position);
+	/// <returns>The index of the cell in the world grid</returns>
+	int get_cell(vec2 position);
 
 	/// <summary>
-	/// Returns the entity associated with the cell at the given position
+	/// Returns the cell at the given position
 	/// </summary>
 	/// <param name="x">The x position of the cell</param>
 	/// <param name="y">The y position of the cell</param>
-	/// <returns>The terrain cell's entity</returns>
-	Entity get_cell(int x, int y);
+	/// <returns>The index of the cell in the world grid</returns>
+	int get_cell(int x, int y);
 
 	/// <summary>
-	/// Returns the entity associated with the cell at the given index
+	/// Returns the world position of a cell, the centre of its 1x1 square
 	/// </summary>
-	/// <param name="index">The index of the cell in the world grid</param>
-	/// <returns>The terrain cell's entity</returns>
-	Entity get_cell(int index);
+	/// <param name="cell">The index of the cell in the world grid</param>
+	vec2 get_cell_position(int cell) {
+		return to_world_coordinates(cell);
+	}
 
 	/// <summary>
-	/// Returns the index in the grid for the given cell
+	/// Returns the terrain type and flags of a cell
 	/// </summary>
-	/// <param name="cell">The cell</param>
-	/// <returns>The index of the cell in the grid</returns>
-	int get_cell_index(Entity cell);
+	/// <param name="cell">The index of the cell in the world grid</param>
+	TerrainCell get_cell_data(int cell) {
+		assert(cell >= 0 && cell < size_x * size_y);
+		return cell_at(cell);
+	}
+
+	/// <summary>
+	/// Returns the cell nearest to a position, which may be outside of the map
+	/// </summary>
+	/// <param name="position">Any position</param>
+	/// <returns>The index of the cell in the world grid</returns>
+	int get_nearest_cell(vec2 position) {
+		ivec2 half_size = { size_x / 2, size_y / 2 };
+		ivec2 last = ivec2(size_x - 1, size_y - 1) - half_size;
+		return get_cell(glm::clamp(quantize_vec2(position), -half_size, last));
+	}
 
 	/// @brief Get a valid random terrain location anywhere on the map that is not used
 	/// @param @overload zone: The zone to get the random terrain location.
@@ -169,30 +238,31 @@ public:
 	/// <summary>
 	/// Gets the speed ratio of the terrain of a cell
 	/// </summary>
-	/// <param name="cell">The cell entity</param>
+	/// <param name="cell">The index of the cell</param>
     /// <returns>Returns the terrain speed ratio of the cell</returns>
-    float get_terrain_speed_ratio(Entity cell);
+    float get_terrain_speed_ratio(int cell);
 
 	/// <summary>
 	/// Return true if the tile should have a collider
 	/// </summary>
-	bool is_impassable(Entity tile) {
-		assert(registry.terrainCells.has(tile));
-		return terraincell_grid[tile - entityStart] & TERRAIN_FLAGS::COLLIDABLE; 
+	bool is_impassable(int tile) {
+		assert(tile >= 0 && tile < size_x * size_y);
+		int local;
+		const TerrainChunk& chunk = this->chunk(chunk_of(tile, local));
+		return TerrainChunk::bit(chunk.collidable, local);
 	}
 	bool is_impassable(vec2 position) { return is_impassable((int)std::round(position.x), (int)std::round(position.y)); };
-	bool is_impassable(int x, int y) { return terraincell_grid[to_array_index(x, y)] & TERRAIN_FLAGS::COLLIDABLE; }
+	bool is_impassable(int x, int y) { return is_impassable((int)to_array_index(x, y)); }
 
 	/// <summary>
 	/// Returns true if the tile should not be spawnable to items or mobs
 	/// </summary>
-	/// <param name="tile">The tile entity</param>
-	bool is_invalid_spawn(Entity tile) {
-		assert(registry.terrainCells.has(tile));
-		uint32_t flag = terraincell_grid[tile - entityStart] & (COLLIDABLE | ALLOW_SPAWNS);
-		if (flag & TERRAIN_FLAGS::COLLIDABLE)
-			return true;
-		return flag ^ TERRAIN_FLAGS::ALLOW_SPAWNS;
+	/// <param name="tile">The index of the tile</param>
+	bool is_invalid_spawn(int tile) {
+		assert(tile >= 0 && tile < size_x * size_y);
+		int local;
+		const TerrainChunk& chunk = this->chunk(chunk_of(tile, local));
+		return !TerrainChunk::bit(chunk.spawnable, local);
 	}
 
 	/// <summary>
@@ -203,10 +273,7 @@ public:
 	bool is_invalid_spawn(int x, int y) {
 		if (abs(x) > size_x / 2 || abs(x) > size_y / 2)
 			return true;
-		uint32_t flag = terraincell_grid[to_array_index(x, y)] & (COLLIDABLE | ALLOW_SPAWNS);
-		if (flag & TERRAIN_FLAGS::COLLIDABLE)
-			return true;
-		return flag ^ TERRAIN_FLAGS::ALLOW_SPAWNS;
+		return is_invalid_spawn((int)to_array_index(x, y));
 	}
 
 	/// <summary>
@@ -220,44 +287,55 @@ public:
 	/// <summary>
 	/// Returns valid, non-collidable neighbours.
 	/// </summary>
-	/// <param name="cell">The origin cell.</param>
-	/// <param name="buffer">A vector buffer</param>
-	void get_accessible_neighbours(Entity cell, std::vector<Entity>& buffer, bool ignoreColliders, bool checkPathfind = false);
+	/// <param name="cell">The index of the origin cell.</param>
+	/// <param name="buffer">A vector buffer for the indices of the neighbours</param>
+	void get_accessible_neighbours(int cell, std::vector<int>& buffer, bool ignoreColliders, bool checkPathfind = false);
 
 	/// <summary>
 	/// Checks each orientations_n_indices indices of cell_index's adjacent tiles. Sets them to -1 if they are out of range.
 	/// </summary>
 	/// <param name="cell_index">The index of the middle tile</param>
 	/// <param name="indices">The indices of all orientations_n_indices adjacent tiles. See ori_index for order.</param>
-	inline void filter_neighbouring_indices(int cell_index, int indices[orientations_n_indices]);
-
-	/// <summary>
-	/// Generates a map of type {cell_index, ORIENTATIONS} where:
-	///		The key is the index (for terraincell_grid) of a tile with directional terrain type.
-	///		The value is its tile orientation.
-	/// </summary>
-	/// <param name="map">Map to write to</param>
-	void generate_orientation_map(std::unordered_map<unsigned int, RenderSystem::ORIENTATIONS>& map);
+	void filter_neighbouring_indices(int cell_index, int indices[orientations_n_indices]);
 
 	/// <summary>
-	/// Updates the values for a tile. This includes rendering data and TerrainCell data.
+	/// Updates the rendering data of a tile from its current grid data.
 	/// </summary>
-	/// <param name="tile">The tile's entity</param>
+	/// <param name="tile">The index of the tile</param>
 	/// <param name="also_update_neighbours">Set to True if this tile's neighbours should also be updated</param>
-	void update_tile(Entity tile, bool also_update_neighbours = false) {
-		TerrainCell& cell = registry.terrainCells.get(tile);
-		return update_tile(tile, cell, also_update_neighbours);
+	void update_tile(int tile, bool also_update_neighbours = false) {
+		return update_tile(tile, TerrainCell(cell_at(tile)), also_update_neighbours);
 	}
 
 	/// <summary>
-	/// Updates the values for a tile. This includes rendering data and TerrainCell data.
+	/// Updates the values for a tile. This includes rendering data and the grid data.
 	/// </summary>
-	/// <param name="tile">The tile's entity</param>
-	/// <param name="cell">The tile's TerrainCell component</param>
+	/// <param name="tile">The index of the tile</param>
+	/// <param name="cell">The tile's new type and flags</param>
 	/// <param name="also_update_neighbours">Set to True if this tile's neighbours should also be updated</param>
-	void update_tile(Entity tile, TerrainCell& cell, bool also_update_neighbours = false) {
-		int i = tile - entityStart;		
-		terraincell_grid[i] = cell;
+	void update_tile(int tile, TerrainCell cell, bool also_update_neighbours = false) {
+		int i = tile;
+		int local;
+		const int chunk_index = chunk_of(i, local);
+		TerrainChunk& chunk = this->chunk(chunk_index);
+		const uint32_t old_cell = chunk.cells[local];
+		if (old_cell != (uint32_t)cell) {
+			writable_cells(chunk)[local] = cell;
+			update_layers(chunk, chunk_index, local);
+		}
+
+		// Only the active chunks are drawn and collidable, the others pick the change up when they are activated
+		if (!chunk.active)
+			return;
+
+		if ((old_cell ^ (uint32_t)cell) & TERRAIN_FLAGS::COLLIDABLE) {
+			auto it = std::lower_bound(chunk.colliders.begin(), chunk.colliders.end(), i);
+			if (cell.flag & TERRAIN_FLAGS::COLLIDABLE)
+				chunk.colliders.insert(it, i);
+			else
+				chunk.colliders.erase(it);
+		}
+
 		uint8_t frame_value = 0;
 
 		// Evaluate a direction if the terrain type is directional.
@@ -265,40 +343,39 @@ public:
 			frame_value = find_tile_orientation(i);
 		}
 
-		// We may have tiles changed during world_system.init() at startup so we need to check!
-		if (renderer->is_terrain_mesh_loaded) {
-			renderer->changeTerrainData(tile, tile - entityStart, cell, frame_value);
-			if (also_update_neighbours) {
-				// We also need to update the adjacent cells
-				int indices[orientations_n_indices] = {
-				i - size_x,		// Top cell
-				i + 1,			// Right cell
-				i + size_x,		// Bottom cell
-				i - 1,			// Left cell
-				i - size_x + 1,	// Top-right cell
-				i + size_x + 1,	// Bottom-right cell
-				i + size_x - 1,	// Bottom-left cell
-				i - size_x - 1,	// Top-left cell
-				};
-				filter_neighbouring_indices(i, indices);
-
-				for (int j : indices) {
-					if (j < 0)
-						continue;
-					update_tile(entity_grid[j]);
-				}
+		renderer->changeTerrainData(chunk_index, local, to_world_coordinates(i), cell, frame_value);
+		if (also_update_neighbours) {
+			// We also need to update the adjacent cells
+			int indices[orientations_n_indices] = {
+			i - size_x,		// Top cell
+			i + 1,			// Right cell
+			i + size_x,		// Bottom cell
+			i - 1,			// Left cell
+			i - size_x + 1,	// Top-right cell
+			i + size_x + 1,	// Bottom-right cell
+			i + size_x - 1,	// Bottom-left cell
+			i - size_x - 1,	// Top-left cell
+			};
+			filter_neighbouring_indices(i, indices);
+
+			for (int j : indices) {
+				if (j < 0)
+					continue;
+				update_tile(j);
 			}
 		}
 	}
 
 	/// <summary>
-	/// Saves the current contents of terraincell_grid into a .smap file.
+	/// Saves the current contents of the terrain into a .smap file, chunk by chunk, compressed if
+	/// compress_saved_maps is set.
 	/// </summary>
 	/// <param name="name">The name of the map</param>
 	void save_grid(const std::string& name);
 
 	/// <summary>
-	/// Loads the named map from PROJECT_SOURCE_DIR/data/maps.
+	/// Loads the named map from PROJECT_SOURCE_DIR/data/maps. Only reads the header, the chunks are read (or decoded)
+	/// as they are needed.
 	/// </summary>
 	/// <param name="name">The name of the map to be loaded</param>
 	void load_grid(const std::string& name);
@@ -320,8 +397,8 @@ public:
 	/// Checks every tile and sets their flags appropriately. Useful after messing with the map editor.
 	/// </summary>
 	void clean_map_tiles() {
-		for (unsigned i = 0; i < size_x * size_y; i++) {
-			uint32_t& cell = terraincell_grid[i];
+		for (int i = 0; i < size_x * size_y; i++) {
+			uint32_t cell = cell_at(i);
 			TERRAIN_TYPE type = static_cast<TERRAIN_TYPE>(cell >> 16);
 			if (type == ROCK || type == SHALLOW_WATER || type == DEEP_WATER)
 				cell &= ~(ALLOW_SPAWNS);
@@ -332,24 +409,128 @@ public:
 			if (type == GRASS || type == MUD || type == SAND || type == SHALLOW_WATER || type == DEEP_WATER) {
 				cell &= ~(COLLIDABLE);
 			}
+			if (cell != cell_at(i))
+				update_tile(i, cell);
 		}
 	}
 
 private:
 	// PLEASE DO NOT EXPOSE THESE UNLESS YOU KNOW WHAT YOU ARE DOING
 
-	// Massive bag of entities that will hold every tile.
-	Entity* entity_grid;
+	// Compressed data of every cell, see TerrainCell, in chunks of TERRAIN_CHUNK_SIZE x TERRAIN_CHUNK_SIZE cells
+	// row by row. A chunk that is not in memory is null, it is read back by chunk() the first time a cell of it is.
+	// Tiles have no entities, this is the only copy of the terrain.
+	std::unique_ptr<std::atomic<TerrainChunk*>[]> chunks;
+	int chunks_x = 0, chunks_y = 0;
+
+	std::vector<int> resident_chunks;	// the chunks in memory, in the order they were loaded
+	std::vector<int> active_chunks;		// in chunk order
+	ivec2 focus_chunk = { -1, -1 };
+	unsigned int active_version = 0;
+
+	// Guards the loading of chunks, which path searches on job threads can trigger
+	std::mutex chunk_mutex;
+
+	// Where chunks that were never changed are read from: the .smap file of init(map_name), mapped into memory
+	// (version 2 on) or read row by row (version 1). Cells of a generated map (init(x, y)) are generated again instead.
+	std::unique_ptr<MappedFile> mapped_map{ new MappedFile() };
+	const SmapHeader* mapped_header = nullptr;
+	std::ifstream map_file;
+	std::streamoff map_cells_offset = 0;
+
+	// Chunks that were changed and evicted, at page_offsets[chunk] (-1 if never paged out)
+	std::FILE* page_file = nullptr;
+	std::vector<long> page_offsets;
+	long page_file_size = 0;
+
+	ECSRegistry& registry;
+	RenderSystem* renderer = nullptr;
+
+	/// <summary>
+	/// Returns the chunk that holds a cell
+	/// </summary>
+	/// <param name="cell">The index of the cell in the world grid</param>
+	/// <param name="local">Set to the index of the cell in TerrainChunk::cells</param>
+	int chunk_of(int cell, int& local) const {
+		assert(cell >= 0 && cell < size_x * size_y);
+		int x = cell % size_x;
+		int y = cell / size_x;
+		local = (y % TERRAIN_CHUNK_SIZE) * TERRAIN_CHUNK_SIZE + x % TERRAIN_CHUNK_SIZE;
+		return (y / TERRAIN_CHUNK_SIZE) * chunks_x + x / TERRAIN_CHUNK_SIZE;
+	}
+
+	// Returns a chunk, reading it back if it is not in memory
+	TerrainChunk& chunk(int index) {
+		TerrainChunk* chunk = chunks[index].load(std::memory_order_acquire);
+		return chunk != nullptr ? *chunk : load_chunk(index);
+	}
+
+	// Returns the packed data of a cell, see TerrainCell
+	uint32_t cell_at(int cell) {
+		int local;
+		const int index = chunk_of(cell, local);
+		return chunk(index).cells[local];
+	}
+
+	// Reads a chunk back into memory
+	TerrainChunk& load_chunk(int index);
+
+	// Per TERRAIN_TYPE and per ZONE_NUMBER copies of terrain_type_to_speed_ratio and zone_radius_map, that can be
+	// read from any thread. Filled by allocate_chunks.
+	float speed_ratios[TERRAIN_COUNT] = {};
+	int64_t zone_radii_squared[ZONE_COUNT] = {};
+
+	// Set in TerrainChunk::zones on the cells exactly on the outer circle of their zone, which count for the next
+	// zone as well
+	static const uint8_t ZONE_OUTER_EDGE = 0x80;
+
+	// Builds the layers of a chunk from its cells
+	void build_layers(TerrainChunk& chunk, int index);
+
+	// Brings the layers of a chunk up to date with a changed cell
+	void update_layers(TerrainChunk& chunk, int index, int local);
+
+	// TerrainChunk::passable of a cell of a chunk
+	uint8_t passable_neighbours(const TerrainChunk& chunk, int index, int local) const;
+
+	// A bit per ori_index: the neighbour of (x, y) is inside a width x height rectangle
+	static uint8_t neighbours_within(int x, int y, int width, int height) {
+		const int top = y > 0, right = x < width - 1, bottom = y < height - 1, left = x > 0;
+		return (uint8_t)(top << TOP | right << RIGHT | bottom << BOTTOM | left << LEFT |
+			(top & right) << TR | (bottom & right) << BR | (bottom & left) << BL | (top & left) << TL);
+	}
+
+	// Returns true if a cell counts as part of a zone, see get_random_terrain_location
+	bool in_zone(int cell, ZONE_NUMBER zone);
+
+	// The cells of a chunk in the mapped map file, or nullptr if they have to be copied (or the chunk is damaged)
+	const uint32_t* mapped_chunk(int index);
+
+	// The cells of a chunk for changing, copied out of the mapped map file first if need be. Marks the chunk dirty.
+	uint32_t* writable_cells(TerrainChunk& chunk);
+
+	// Copies the current cells of a chunk that is not in memory from the page file, the map file or the generator
+	void read_chunk(int index, uint32_t cells[TERRAIN_CHUNK_CELLS]);
+
+	// Decodes the compressed chunks among indices that are not in memory yet on registry.jobs, in parallel
+	void prefetch_chunks(const std::vector<int>& indices);
+
+	// Copies the current cells of any chunk without bringing it into memory
+	void copy_chunk(int index, uint32_t cells[TERRAIN_CHUNK_CELLS]);
+
+	// Frees a chunk, paging it out first if it was changed. Returns false if it has to stay in memory.
+	bool evict_chunk(int index);
 
-	// Compressed data of every TerrainCell instance. Used for backend calculations.
-	uint32_t* terraincell_grid;
+	// Makes the active chunks the ones within active_radius of a chunk
+	void activate_chunks(ivec2 centre);
+	void activate_chunk(int index);
+	void deactivate_chunk(int index);
 
-	RenderSystem* renderer;
+	// Allocates the chunk table for size_x by size_y cells, all of them not in memory yet
+	void allocate_chunks();
 
-	// The id of the first entity made in this iteration
-	// IMPORTANT: this assumes no other entities can be made
-	// between the call to init() and when init() goes out of scope!!
-	unsigned int entityStart;
+	// Frees every chunk and closes the map and page files
+	void release();
 
 	/// <summary>
 	/// Returns the index used for 'grid' with the given x and y world coordinates
@@ -1,5 +1,113 @@
 // internal
 #include "tiny_ecs.hpp"
 
-// All we need to store besides the containers is the id of every entity and callbacks to be able to remove entities across containers
-unsigned int Entity::id_count = 1;
\ No newline at end of file
+// Besides the containers, all we need is to hand out entity ids and recycle the indices of destroyed entities
+unsigned int EntityAllocator::allocate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return allocate_unlocked();
+}
+
+void EntityAllocator::allocate_n(unsigned int n, std::vector<unsigned int>& ids)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (unsigned int i = 0; i < n; i++)
+		ids.push_back(allocate_unlocked());
+}
+
+unsigned int EntityAllocator::allocate_unlocked()
+{
+	unsigned int index;
+	if (free_indices.size() > ENTITY_MIN_FREE_INDICES) {
+		index = free_indices.front();
+		free_indices.pop_front();
+	}
+	else {
+		index = (unsigned int)generations.size();
+		assert(index <= ENTITY_INDEX_MASK && "Ran out of entity indices");
+		generations.push_back(0);
+	}
+	return id_of(index);
+}
+
+unsigned int EntityAllocator::allocate_range(unsigned int n)
+{
+	if (n == 0)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Look for n consecutive released indices, e.g. the terrain grid of the previous game
+	if (free_indices.size() >= n) {
+		std::vector<unsigned int> sorted(free_indices.begin(), free_indices.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		unsigned int run_start = 0;
+		for (unsigned int i = 1; i <= sorted.size(); i++) {
+			if (i < sorted.size() && sorted[i] == sorted[i - 1] + 1)
+				continue;
+			if (i - run_start >= n) {
+				unsigned int first = sorted[run_start];
+				free_indices.erase(
+					std::remove_if(free_indices.begin(), free_indices.end(),
+						[&](unsigned int index) { return index >= first && index < first + n; }),
+					free_indices.end());
+				return first;
+			}
+			run_start = i;
+		}
+	}
+
+	// Otherwise append fresh indices
+	unsigned int first = (unsigned int)generations.size();
+	assert(first + n - 1 <= ENTITY_INDEX_MASK && "Ran out of entity indices");
+	generations.resize(first + n, 0);
+	return first;
+}
+
+void EntityAllocator::release(unsigned int id)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!is_alive(id))
+		return;
+
+	unsigned int index = id & ENTITY_INDEX_MASK;
+	generations[index] = (generations[index] + 1) & ENTITY_GENERATION_MASK;
+	free_indices.push_back(index);
+}
+
+std::vector<Entity> CommandBuffer::apply()
+{
+	std::vector<std::function<void()>> to_add;
+	std::vector<std::pair<ContainerInterface*, Entity>> to_remove;
+	std::vector<Entity> to_destroy;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		to_add.swap(added);
+		to_remove.swap(removed);
+		to_destroy.swap(destroyed);
+	}
+
+	for (auto& add : to_add)
+		add();
+
+	// Component removes, grouped by container
+	std::sort(to_remove.begin(), to_remove.end(),
+		[](const std::pair<ContainerInterface*, Entity>& a, const std::pair<ContainerInterface*, Entity>& b) {
+			return a.first != b.first ? std::less<ContainerInterface*>()(a.first, b.first) : a.second < b.second;
+		});
+	to_remove.erase(std::unique(to_remove.begin(), to_remove.end()), to_remove.end());
+	std::vector<Entity> batch;
+	for (size_t i = 0; i < to_remove.size(); i++) {
+		batch.push_back(to_remove[i].second);
+		if (i + 1 == to_remove.size() || to_remove[i + 1].first != to_remove[i].first) {
+			to_remove[i].first->remove_sorted(batch);
+			batch.clear();
+		}
+	}
+
+	std::sort(to_destroy.begin(), to_destroy.end());
+	to_destroy.erase(std::unique(to_destroy.begin(), to_destroy.end()), to_destroy.end());
+	to_destroy.erase(std::remove_if(to_destroy.begin(), to_destroy.end(), [](Entity e) { return !e.is_alive(); }), to_destroy.end());
+	return to_destroy;
+}
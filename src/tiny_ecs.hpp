@@ -2,32 +2,177 @@
 
 #include <algorithm>
 #include <vector>
-#include <unordered_map>
+#include <deque>
+#include <bitset>
+#include <tuple>
+#include <memory>
 #include <set>
 #include <functional>
+#include <mutex>
 #include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <type_traits>
+#include <cstdio>
 #include <assert.h>
 
+#include "job_system.hpp"
+
+// An entity id packs a slot index (low bits) and a generation (high bits).
+// The generation is bumped whenever an index is released, so handles to destroyed entities can be detected in O(1).
+static constexpr unsigned int ENTITY_INDEX_BITS = 22;
+static constexpr unsigned int ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+static constexpr unsigned int ENTITY_GENERATION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+
+// Released indices are only handed out again once this many are queued, so a stale handle
+// needs many destroy/create cycles on the same index before its generation can wrap around
+static constexpr unsigned int ENTITY_MIN_FREE_INDICES = 1024;
+
+// Hands out entity ids and recycles the indices of destroyed entities
+// allocate, allocate_range and release are locked, so entities can be created from several threads (see CommandBuffer).
+// The lookups are not, they must not run while another thread creates entities.
+class EntityAllocator
+{
+	std::vector<unsigned int> generations;	// current generation of every index handed out so far
+	std::deque<unsigned int> free_indices;	// released indices, oldest first
+	std::mutex mutex;
+
+	unsigned int allocate_unlocked();
+public:
+	EntityAllocator()
+	{
+		generations.push_back(0); // index 0 is never handed out, id 0 is the null entity
+	}
+
+	// Returns the id of a new entity
+	unsigned int allocate();
+
+	// Appends the ids of n new entities to ids, taking the lock once
+	void allocate_n(unsigned int n, std::vector<unsigned int>& ids);
+
+	// Reserves n consecutive indices and returns the first one, re-using a run of released indices if there is one
+	unsigned int allocate_range(unsigned int n);
+
+	// Releases the index of a live entity id. Stale or null ids are ignored.
+	void release(unsigned int id);
+
+	// Returns the current id of an index, i.e. the id of the entity living at that index
+	unsigned int id_of(unsigned int index) const
+	{
+		return index | (generations[index] << ENTITY_INDEX_BITS);
+	}
+
+	// Check if the id refers to an entity that has not been released
+	bool is_alive(unsigned int id) const
+	{
+		unsigned int index = id & ENTITY_INDEX_MASK;
+		return index != 0 && index < generations.size() && generations[index] == (id >> ENTITY_INDEX_BITS);
+	}
+
+	// Number of live entities
+	size_t alive_count() const { return generations.size() - 1 - free_indices.size(); }
+
+	// Number of indices handed out so far, i.e. the size any index-keyed array has to cover
+	size_t capacity() const { return generations.size(); }
+
+	// The allocator bound to the calling thread by a Binding, nullptr if there is none
+	static EntityAllocator*& bound()
+	{
+		static thread_local EntityAllocator* allocator = nullptr;
+		return allocator;
+	}
+
+	// Makes Entity use the given allocator on the calling thread for as long as the binding lives,
+	// so that every world of a WorldBatch hands out its own ids (see Entity::allocator)
+	class Binding
+	{
+		EntityAllocator* previous;
+	public:
+		explicit Binding(EntityAllocator& allocator) : previous(bound()) { bound() = &allocator; }
+		~Binding() { bound() = previous; }
+		Binding(const Binding&) = delete;
+		Binding& operator=(const Binding&) = delete;
+	};
+};
+
 // Unique identifyer for all entities
 class Entity
 {
 	unsigned int id;
-	static unsigned int id_count; // starts from 1, entit 0 is the default initialization
+
+	// Wraps an id that was already allocated
+	explicit Entity(unsigned int raw_id) : id(raw_id) {}
 public:
+	// Allocates ids for the entities of the calling thread: the allocator bound with EntityAllocator::Binding if there
+	// is one, otherwise the process-wide one (a function-local static, so it is ready before any global is constructed)
+	static EntityAllocator& allocator()
+	{
+		EntityAllocator* bound = EntityAllocator::bound();
+		if (bound)
+			return *bound;
+		static EntityAllocator instance;
+		return instance;
+	}
+
 	Entity()
 	{
-		id = id_count++;
-		// Note, indices of already deleted entities arent re-used in this simple implementation.
+		id = allocator().allocate();
+		// Note, the index is re-used once the entity is destroyed, see ECSRegistry::remove_all_components_of
 	}
 
+	// A handle that refers to no entity (id 0), for fields that are assigned later
+	static Entity null() { return Entity(0u); }
+
+	// Creates n entities at once, their indices are not necessarily consecutive
+	static std::vector<Entity> create_n(unsigned int n)
+	{
+		std::vector<unsigned int> ids;
+		ids.reserve(n);
+		allocator().allocate_n(n, ids);
+		std::vector<Entity> result;
+		result.reserve(n);
+		for (unsigned int id : ids)
+			result.push_back(Entity(id));
+		return result;
+	}
+
+	// Creates n entities with consecutive indices, see TerrainSystem::init
+	static std::vector<Entity> create_range(unsigned int n)
+	{
+		unsigned int first = allocator().allocate_range(n);
+		std::vector<Entity> result;
+		result.reserve(n);
+		for (unsigned int i = 0; i < n; i++)
+			result.push_back(Entity(allocator().id_of(first + i)));
+		return result;
+	}
+
+	// The slot index of the entity, used to address index-keyed arrays
+	unsigned int index() const { return id & ENTITY_INDEX_MASK; }
+
+	// How many times the index was re-used before this entity
+	unsigned int generation() const { return id >> ENTITY_INDEX_BITS; }
+
+	// False once the entity is destroyed, i.e. the handle is stale
+	bool is_alive() const { return allocator().is_alive(id); }
+
+	bool operator==(const Entity& e) const { return id == e.id; }
+	bool operator!=(const Entity& e) const { return id != e.id; }
+
 	// overload for std::set usage
 	bool operator<(const Entity& e) const 
 	{
 	return id < e.id;
 	}
-	operator unsigned int() { return id; } // this enables automatic casting to int
+	operator unsigned int() const { return id; } // this enables automatic casting to int
 };
 
+// Maximum number of component types in a registry, one bit each in a ComponentSignature
+static constexpr unsigned int MAX_COMPONENT_TYPES = 64;
+
+// The set of component types an entity has, one bit per container (see ContainerInterface::type_id)
+typedef std::bitset<MAX_COMPONENT_TYPES> ComponentSignature;
+
 // Common interface to refer to all containers in the ECS registry
 struct ContainerInterface
 {
@@ -35,19 +180,205 @@ struct ContainerInterface
 	virtual size_t size() = 0;
 	virtual void remove(Entity e) = 0;
 	virtual bool has(Entity entity) = 0;
+
+	// Removes all components of the given entities, which have to be sorted (see CommandBuffer::flush)
+	virtual void remove_sorted(const std::vector<Entity>& sorted_entities)
+	{
+		for (Entity e : sorted_entities)
+			remove(e);
+	}
+
+	// The bit of this container in every ComponentSignature
+	unsigned int type_id = 0;
+
+	// Called by the registry owning this container, so that inserts and removes keep its entity signatures up to date
+	void register_type(unsigned int id, std::vector<ComponentSignature>* registry_signatures)
+	{
+		assert(id < MAX_COMPONENT_TYPES && "Too many component types for ComponentSignature");
+		type_id = id;
+		signatures = registry_signatures;
+	}
+
+protected:
+	// Per-entity signatures indexed by Entity::index(), nullptr for containers outside of a registry
+	std::vector<ComponentSignature>* signatures = nullptr;
+
+	inline void set_signature_bit(Entity e)
+	{
+		if (!signatures)
+			return;
+		if (e.index() >= signatures->size())
+			signatures->resize(std::max((size_t)e.index() + 1, Entity::allocator().capacity()));
+		(*signatures)[e.index()].set(type_id);
+	}
+
+	inline void reset_signature_bit(Entity e)
+	{
+		if (signatures && e.index() < signatures->size())
+			(*signatures)[e.index()].reset(type_id);
+	}
+};
+
+// Number of entity indices covered by one page of the sparse index in ComponentContainer
+static constexpr unsigned int SPARSE_PAGE_BITS = 12;
+static constexpr unsigned int SPARSE_PAGE_SIZE = 1u << SPARSE_PAGE_BITS;
+static constexpr unsigned int SPARSE_PAGE_MASK = SPARSE_PAGE_SIZE - 1;
+
+// Marks an entity id that has no component in a container
+static constexpr unsigned int INVALID_COMPONENT_ID = 0xFFFFFFFF;
+
+// Opt-in struct-of-arrays storage for hot components. By default a ComponentContainer stores whole structs in one array.
+// Specializing SoALayout for a component type stores each of its fields in a separate contiguous array instead, see Motion in components.hpp.
+// A specialization provides:
+//		enabled = true
+//		fields: std::tuple of the field types, in declaration order
+//		reference: a proxy holding one reference per field (brace-initialized in field order) that is used like a Component&,
+//			i.e. it is assignable from a reference or a Component and converts to a Component
+//		split(Component&&): moves the fields of a component into a 'fields' tuple
+template <typename Component>
+struct SoALayout
+{
+	static constexpr bool enabled = false;
+};
+
+// One std::vector per field of 'Component', indexed like ComponentContainer::entities
+template <typename Component, typename Fields = typename SoALayout<Component>::fields>
+class SoAStorage;
+
+template <typename Component, typename... Fields>
+class SoAStorage<Component, std::tuple<Fields...>>
+{
+	typedef SoALayout<Component> Layout;
+	std::tuple<std::vector<Fields>...> arrays;
+
+	template <size_t... I>
+	typename Layout::reference at(size_t i, std::index_sequence<I...>) {
+		return typename Layout::reference{ std::get<I>(arrays)[i]... };
+	}
+
+	template <size_t... I>
+	void push_back(std::tuple<Fields...>&& fields, std::index_sequence<I...>) {
+		int expand[] = { 0, ((void)std::get<I>(arrays).push_back(std::move(std::get<I>(fields))), 0)... };
+		(void)expand;
+	}
+
+	template <typename F, size_t... I>
+	void for_each_array(F f, std::index_sequence<I...>) {
+		int expand[] = { 0, ((void)f(std::get<I>(arrays)), 0)... };
+		(void)expand;
+	}
+
+public:
+	typedef typename Layout::reference reference;
+
+	// The contiguous array of one field, e.g. registry.motions.components.field<SoALayout<Motion>::VELOCITY>()
+	template <size_t Field>
+	std::vector<typename std::tuple_element<Field, std::tuple<Fields...>>::type>& field() {
+		return std::get<Field>(arrays);
+	}
+
+	size_t size() const { return std::get<0>(arrays).size(); }
+	reference operator[](size_t i) { return at(i, std::index_sequence_for<Fields...>()); }
+	reference back() { return (*this)[size() - 1]; }
+	void push_back(Component c) { push_back(Layout::split(std::move(c)), std::index_sequence_for<Fields...>()); }
+	void pop_back() { for_each_array([](auto& array) { array.pop_back(); }, std::index_sequence_for<Fields...>()); }
+	void clear() { for_each_array([](auto& array) { array.clear(); }, std::index_sequence_for<Fields...>()); }
+	void reserve(size_t n) { for_each_array([n](auto& array) { array.reserve(n); }, std::index_sequence_for<Fields...>()); }
+	void swap_elements(size_t a, size_t b) { for_each_array([a, b](auto& array) { std::swap(array[a], array[b]); }, std::index_sequence_for<Fields...>()); }
+};
+
+// Swaps two components in place, for either storage of a ComponentContainer
+template <typename Component>
+inline void swap_elements(std::vector<Component>& components, size_t a, size_t b)
+{
+	std::swap(components[a], components[b]);
+}
+
+template <typename Component, typename Fields>
+inline void swap_elements(SoAStorage<Component, Fields>& components, size_t a, size_t b)
+{
+	components.swap_elements(a, b);
+}
+
+// Picks the storage of a ComponentContainer: a plain array of structs unless SoALayout is specialized
+template <typename Component, bool = SoALayout<Component>::enabled>
+struct ComponentStorage
+{
+	typedef std::vector<Component> type;
+};
+
+template <typename Component>
+struct ComponentStorage<Component, true>
+{
+	typedef SoAStorage<Component> type;
 };
 
 // A container that stores components of type 'Component' and associated entities
+// Lookups go through a paged sparse set: the entity index selects a page and a slot in it, and the slot holds the index
+// into the dense components/entities arrays. Pages are allocated lazily, so no hashing or per-insert allocation happens.
 template <typename Component> // A component can be any class
-class ComponentContainer : public ContainerInterface
+class ComponentContainer final : public ContainerInterface
 {
 private:
-	// The hash map from Entity -> array index.
-	std::unordered_map<unsigned int, unsigned int> map_entity_componentID; // the entity is cast to uint to be hashable.
-	bool registered = false;
+	// The paged sparse array from Entity index -> array index (INVALID_COMPONENT_ID if absent).
+	std::vector<std::unique_ptr<unsigned int[]>> sparse_pages;
+
+	// Returns the sparse slot of an entity index, or nullptr if its page was never allocated
+	inline unsigned int* find_slot(unsigned int index) const
+	{
+		unsigned int page = index >> SPARSE_PAGE_BITS;
+		if (page >= sparse_pages.size() || !sparse_pages[page])
+			return nullptr;
+		return &sparse_pages[page][index & SPARSE_PAGE_MASK];
+	}
+
+	// Returns the sparse slot of an entity index, allocating its page if needed
+	inline unsigned int& slot(unsigned int index)
+	{
+		unsigned int page = index >> SPARSE_PAGE_BITS;
+		if (page >= sparse_pages.size())
+			sparse_pages.resize(page + 1);
+		if (!sparse_pages[page]) {
+			sparse_pages[page].reset(new unsigned int[SPARSE_PAGE_SIZE]);
+			std::fill_n(sparse_pages[page].get(), SPARSE_PAGE_SIZE, INVALID_COMPONENT_ID);
+		}
+		return sparse_pages[page][index & SPARSE_PAGE_MASK];
+	}
+
+	// Change tracking, see track_changes()
+	static constexpr uint8_t CHANGED_THIS_FRAME = 1;
+	static constexpr uint8_t CHANGED_LAST_FRAME = 2;
+	bool tracking_changes = false;
+	std::vector<uint8_t> change_flags;			// by entity index
+	std::vector<Entity> changed_this_frame;
+	std::vector<Entity> changed_last_frame;
+
+	// Drops the change flags of a removed component, so that a later entity with the same index starts clean
+	inline void forget_changes(unsigned int index)
+	{
+		if (index < change_flags.size())
+			change_flags[index] = 0;
+	}
+
+	// Structural observers, see on_add() and on_remove()
+	std::vector<std::function<void(const Entity*, size_t)>> add_observers;
+	std::vector<std::function<void(const Entity*, size_t)>> remove_observers;
+
+	inline void notify(std::vector<std::function<void(const Entity*, size_t)>>& observers, const Entity* batch, size_t count)
+	{
+		for (auto& observer : observers)
+			observer(batch, count);
+	}
+
 public:
+	// A std::vector<Component>, or a SoAStorage if SoALayout<Component> is specialized
+	typedef typename ComponentStorage<Component>::type storage_type;
+
+	// Component& for array-of-structs storage, the proxy from SoALayout otherwise
+	typedef typename storage_type::reference reference;
+
 	// Container of all components of type 'Component'
-	std::vector<Component> components;
+	storage_type components;
 
 	// The corresponding entities
 	std::vector<Entity> entities;
@@ -58,66 +389,120 @@ public:
 	}
 
 	// Inserting a component c associated to entity e
-	inline Component& insert(Entity e, Component c, bool check_for_duplicates = true)
+	inline reference insert(Entity e, Component c, bool check_for_duplicates = true)
 	{
-		// Usually, every entity should only have one instance of each component type
-		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
-
-		map_entity_componentID[e] = (unsigned int)components.size();
-		components.push_back(std::move(c)); // the move enforces move instead of copy constructor
-		entities.push_back(e);
-		return components.back();
+		reference inserted = push(e, std::move(c), check_for_duplicates);
+		if (!add_observers.empty())
+			notify(add_observers, &e, 1);
+		return inserted;
 	};
 
 	// The emplace function takes the the provided arguments Args, creates a new object of type Component, and inserts it into the ECS system
 	template<typename... Args>
-	Component& emplace(Entity e, Args &&... args) {
+	reference emplace(Entity e, Args &&... args) {
 		return insert(e, Component(std::forward<Args>(args)...));
 	};
 	template<typename... Args>
-	Component& emplace_with_duplicates(Entity e, Args &&... args) {
+	reference emplace_with_duplicates(Entity e, Args &&... args) {
 		return insert(e, Component(std::forward<Args>(args)...), false);
 	};
 
 	// A wrapper to return the component of an entity
-	Component& get(Entity e) {
+	reference get(Entity e) {
 		assert(has(e) && "Entity not contained in ECS registry");
-		return components[map_entity_componentID[e]];
+		return components[*find_slot(e.index())];
+	}
+
+	// Same as get, but records the component as changed, see track_changes()
+	reference get_mut(Entity e) {
+		mark_changed(e);
+		return get(e);
 	}
 
 	// Check if entity has a component of type 'Component'
+	// The stored handle must match, so stale handles whose index was re-used report false
 	bool has(Entity entity) {
-		return map_entity_componentID.count(entity) > 0;
+		const unsigned int* cID = find_slot(entity.index());
+		return cID && *cID != INVALID_COMPONENT_ID && entities[*cID] == entity;
 	}
 
 	// Remove an component and pack the container to re-use the empty space
 	void remove(Entity e)
 	{
-		if (has(e))
-		{
-			// Get the current position
-			int cID = map_entity_componentID[e];
+		if (!remove_observers.empty() && has(e))
+			notify(remove_observers, &e, 1);
+		erase(e);
+	};
 
-			// Move the last element to position cID using the move operator
-			// Note, components[cID] = components.back() would trigger the copy instead of move operator
-			components[cID] = std::move(components.back());
-			entities[cID] = entities.back(); // the entity is only a single index, copy it.
-			map_entity_componentID[entities.back()] = cID;
+	// Inserts a copy of prototype for each of the new entities, growing the arrays at most once, see Registry::spawn_n
+	void insert_n(const std::vector<Entity>& new_entities, const Component& prototype)
+	{
+		size_t needed = entities.size() + new_entities.size();
+		if (needed > entities.capacity())
+			reserve(std::max(needed, 2 * entities.capacity()));
+		for (Entity e : new_entities)
+			push(e, prototype, true);
+		if (!add_observers.empty() && !new_entities.empty())
+			notify(add_observers, new_entities.data(), new_entities.size());
+	}
 
-			// Erase the old component and free its memory
-			map_entity_componentID.erase(e);
-			components.pop_back();
-			entities.pop_back();
-			// Note, one could mark the id for re-use
+	// Remove the components of many entities at once, sorted_entities has to be sorted
+	// Few removals are swapped out one by one, otherwise the container is compacted in a single pass that keeps the order of the remaining components
+	void remove_sorted(const std::vector<Entity>& sorted_entities)
+	{
+		if (!remove_observers.empty()) {
+			std::vector<Entity> removed;
+			for (Entity e : sorted_entities) {
+				if (has(e))
+					removed.push_back(e);
+			}
+			if (!removed.empty())
+				notify(remove_observers, removed.data(), removed.size());
+		}
+
+		if (sorted_entities.size() * 8 < entities.size()) {
+			for (Entity e : sorted_entities)
+				erase(e);
+			return;
 		}
-	};
+
+		size_t write = 0;
+		for (size_t read = 0; read < entities.size(); read++) {
+			Entity e = entities[read];
+			if (std::binary_search(sorted_entities.begin(), sorted_entities.end(), e)) {
+				slot(e.index()) = INVALID_COMPONENT_ID;
+				reset_signature_bit(e);
+				forget_changes(e.index());
+				continue;
+			}
+			if (write != read) {
+				components[write] = std::move(components[read]);
+				entities[write] = e;
+				slot(e.index()) = (unsigned int)write;
+			}
+			write++;
+		}
+		while (components.size() > write)
+			components.pop_back();
+		entities.erase(entities.begin() + write, entities.end());
+	}
 
 	// Remove all components of type 'Component'
 	void clear()
 	{
-		map_entity_componentID.clear();
+		if (!remove_observers.empty() && !entities.empty())
+			notify(remove_observers, entities.data(), entities.size());
+
+		// Only reset the slots in use, so clearing costs O(size) rather than O(pages)
+		for (Entity e : entities) {
+			slot(e.index()) = INVALID_COMPONENT_ID;
+			reset_signature_bit(e);
+			forget_changes(e.index());
+		}
 		components.clear();
 		entities.clear();
+		changed_this_frame.clear();
+		changed_last_frame.clear();
 	}
 
 	// Report the number of components of type 'Component'
@@ -126,18 +511,612 @@ public:
 		return components.size();
 	}
 
+	// Reserve memory for n components, e.g. before spawning many entities
+	void reserve(size_t n)
+	{
+		components.reserve(n);
+		entities.reserve(n);
+	}
+
+	// Calls f(entities, count) after components were inserted, once per batch: insert() reports one entity,
+	// insert_n() and Registry::spawn_n the whole batch. The new components are already in place.
+	// Observers keep secondary indexes up to date (e.g. the render-layer buckets of RenderSystem), they must not
+	// insert into or remove from this container.
+	void on_add(std::function<void(const Entity* batch, size_t count)> f)
+	{
+		add_observers.push_back(std::move(f));
+	}
+
+	// Calls f(entities, count) before components are removed, once per batch: remove() reports one entity,
+	// remove_sorted() (used by Registry::flush_commands) and clear() all of theirs. The components can still be read.
+	void on_remove(std::function<void(const Entity* batch, size_t count)> f)
+	{
+		remove_observers.push_back(std::move(f));
+	}
+
+	// Opt-in change tracking. Once enabled, insert(), get_mut() and mark_changed() record the entity as changed.
+	// A change stays visible until the end of the next frame (see Registry::clear_changes), so a system sees every
+	// change made since it last ran, no matter where in the frame the change happened.
+	// Writes through get() or the components array are not recorded.
+	void track_changes()
+	{
+		tracking_changes = true;
+	}
+
+	// Records the component of e as changed, does nothing unless track_changes() was called
+	inline void mark_changed(Entity e)
+	{
+		if (!tracking_changes)
+			return;
+		unsigned int index = e.index();
+		if (index >= change_flags.size())
+			change_flags.resize(std::max((size_t)index + 1, Entity::allocator().capacity()), 0);
+		if (!(change_flags[index] & CHANGED_THIS_FRAME)) {
+			change_flags[index] |= CHANGED_THIS_FRAME;
+			changed_this_frame.push_back(e);
+		}
+	}
+
+	// Check if the component of e changed during this or the last frame
+	bool is_changed(Entity e)
+	{
+		return e.index() < change_flags.size() && change_flags[e.index()] != 0 && has(e);
+	}
+
+	// Calls f(entity) once for each entity whose component changed during this or the last frame and still exists
+	template <typename F>
+	void each_changed(F f)
+	{
+		// Skip last frame's changes that are listed again for this frame
+		for (size_t i = 0; i < changed_last_frame.size(); i++) {
+			Entity e = changed_last_frame[i];
+			if (has(e) && !(change_flags[e.index()] & CHANGED_THIS_FRAME))
+				f(e);
+		}
+		for (size_t i = 0; i < changed_this_frame.size(); i++) {
+			Entity e = changed_this_frame[i];
+			if (has(e))
+				f(e);
+		}
+	}
+
+	// Components one chunk of parallel_for covers, about JOB_CHUNK_BYTES worth
+	static constexpr size_t chunk_size()
+	{
+		return std::max<size_t>(1, JOB_CHUNK_BYTES / sizeof(Component));
+	}
+
+	// Calls f(begin, end) for consecutive ranges of positions in components and entities on the threads of jobs.
+	// The ranges depend on size() only, so a loop that only writes the components in its range (or records
+	// through CommandBuffer) gives the same result with any thread count. The container must not change meanwhile.
+	template <typename F>
+	void parallel_for(JobSystem& jobs, F f)
+	{
+		jobs.parallel_for(size(), chunk_size(), f);
+	}
+
+	// Ends the frame for change tracking: last frame's changes are dropped and this frame's become last frame's
+	void clear_changes()
+	{
+		for (Entity e : changed_last_frame) {
+			if (e.index() < change_flags.size())
+				change_flags[e.index()] &= ~CHANGED_LAST_FRAME;
+		}
+		for (Entity e : changed_this_frame) {
+			if (change_flags[e.index()] & CHANGED_THIS_FRAME)
+				change_flags[e.index()] = CHANGED_LAST_FRAME;
+		}
+		std::swap(changed_last_frame, changed_this_frame);
+		changed_this_frame.clear();
+	}
+
 	// Sort the components and associated entity assignment structures by the comparisonFunction, see std::sort
 	template <class Compare>
 	void sort(Compare comparisonFunction)
 	{
-		// First sort the entity list as desired
-		std::sort(entities.begin(), entities.end(), comparisonFunction);
-		// Now re-arrange the components (Note, creates a new vector, which may be slow! Not sure if in-place could be faster: https://stackoverflow.com/questions/63703637/how-to-efficiently-permute-an-array-in-place-using-stdswap)
-		std::vector<Component> components_new; components_new.reserve(components.size());
-		std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) { return std::move(get(e)); }); // note, the get still uses the old hash map (on purpose!)
-		components = std::move(components_new); // note, we use move operations to not create unneccesary copies of objects, but memory is still allocated for the new vector
-		// Fill the new hashmap
+		// First sort the positions of the components by their entities. Positions rather than entities, so that the
+		// duplicates of containers like collisions (see emplace_with_duplicates) each keep their own component.
+		std::vector<unsigned int> order(entities.size());
+		for (unsigned int i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+			return comparisonFunction(entities[a], entities[b]);
+		});
+		// Then move the components to their new position in place
+		permute(order);
+	}
+
+	// Sort by a key per entity, smallest first, e.g. registry.motions.sort_by_key([](Entity e) { return ...; })
+	// Entities with equal keys keep their order.
+	template <class Key>
+	void sort_by_key(Key key_of)
+	{
+		std::vector<std::pair<decltype(key_of(Entity::null())), unsigned int>> keyed;
+		keyed.reserve(entities.size());
+		for (unsigned int i = 0; i < entities.size(); i++)
+			keyed.emplace_back(key_of(entities[i]), i);
+		std::sort(keyed.begin(), keyed.end());
+		std::vector<unsigned int> order(keyed.size());
+		for (unsigned int i = 0; i < keyed.size(); i++)
+			order[i] = keyed[i].second;
+		permute(order);
+	}
+
+	// Resumable insertion sort by key that does at most 'budget' comparisons, e.g. every frame to keep a container
+	// ordered while its keys drift without a hitch. Returns true when the pass reached the end, i.e. all was in order.
+	template <class Key>
+	bool sort_by_key_step(Key key_of, size_t budget)
+	{
+		for (; budget > 0; budget--) {
+			if (sort_cursor >= entities.size()) {
+				sort_cursor = 0;
+				return true;
+			}
+			if (sort_cursor == 0 || !(key_of(entities[sort_cursor]) < key_of(entities[sort_cursor - 1]))) {
+				sort_cursor++;
+			}
+			else {
+				swap_positions(sort_cursor - 1, sort_cursor);
+				sort_cursor--;
+			}
+		}
+		return false;
+	}
+
+private:
+	// Position of sort_by_key_step in the dense arrays
+	size_t sort_cursor = 0;
+
+	// Moves the component at position order[i] to position i for every i. The cycles of the permutation are
+	// followed with swaps, so no component is copied. Overwrites order.
+	void permute(std::vector<unsigned int>& order)
+	{
+		for (unsigned int i = 0; i < order.size(); i++) {
+			unsigned int j = i;
+			while (order[j] != i) {
+				unsigned int k = order[j];
+				swap_elements(components, j, k);
+				std::swap(entities[j], entities[k]);
+				order[j] = j;
+				j = k;
+			}
+			order[j] = j;
+		}
+		// Fill the new sparse index
+		for (unsigned int i = 0; i < entities.size(); i++)
+			slot(entities[i].index()) = i;
+	}
+
+	// Swaps two components and their entities, keeping the sparse index up to date
+	void swap_positions(size_t a, size_t b)
+	{
+		swap_elements(components, a, b);
+		std::swap(entities[a], entities[b]);
+		slot(entities[a].index()) = (unsigned int)a;
+		slot(entities[b].index()) = (unsigned int)b;
+	}
+
+	// Inserts without notifying the observers
+	inline reference push(Entity e, Component c, bool check_for_duplicates)
+	{
+		// Usually, every entity should only have one instance of each component type
+		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
+		assert(e.is_alive() && "Entity was already destroyed");
+
+		slot(e.index()) = (unsigned int)components.size();
+		components.push_back(std::move(c)); // the move enforces move instead of copy constructor
+		entities.push_back(e);
+		set_signature_bit(e);
+		mark_changed(e);
+		return components.back();
+	}
+
+	// Removes without notifying the observers
+	void erase(Entity e)
+	{
+		unsigned int* e_slot = find_slot(e.index());
+		if (e_slot && *e_slot != INVALID_COMPONENT_ID && entities[*e_slot] == e)
+		{
+			// Get the current position
+			unsigned int cID = *e_slot;
+
+			// Move the last element to position cID using the move operator
+			// Note, components[cID] = components.back() would trigger the copy instead of move operator
+			components[cID] = std::move(components.back());
+			entities[cID] = entities.back(); // the entity is only a single index, copy it.
+			slot(entities.back().index()) = cID;
+
+			// Erase the old component and free its memory
+			*e_slot = INVALID_COMPONENT_ID;
+			components.pop_back();
+			entities.pop_back();
+			reset_signature_bit(e);
+			forget_changes(e.index());
+		}
+	}
+};
+
+// An empty component, only the membership of the entity counts
+struct EntityTag {};
+
+// A set of entities with constant time insert, remove and lookup, densely stored in 'entities'.
+// Used for indexes that observers keep up to date, e.g. the render-layer buckets of RenderSystem.
+typedef ComponentContainer<EntityTag> EntitySet;
+
+// Lists component types that a View skips, e.g. registry.view<Motion, Collider>(Exclude<Player>())
+template <typename... Excluded>
+struct Exclude {};
+
+// Iterates the entities that have every component type in 'Components' and none of the excluded ones.
+// Iteration is driven by the smallest of the containers and the other ones are only probed for entities
+// whose signature matches, so no has() call is needed per container.
+// Usage:
+//		registry.view<Motion, Player>().each([&](Entity e, MotionRef motion, Player& player) { ... });
+//		for (auto t : registry.view<Motion, Player>()) { MotionRef motion = std::get<1>(t); ... }
+// Note, entities inserted with duplicates (e.g. collisions) are visited once per duplicate, so iterate those containers directly.
+template <typename... Components>
+class View
+{
+	std::tuple<ComponentContainer<Components>*...> containers;
+	const std::vector<Entity>* driver;						// entities of the smallest container
+	const std::vector<ComponentSignature>* signatures;
+	ComponentSignature include_mask;
+	ComponentSignature exclude_mask;
+
+public:
+	View(const std::vector<ComponentSignature>& registry_signatures, ComponentSignature excluded, ComponentContainer<Components>&... component_containers)
+		: containers(&component_containers...), signatures(&registry_signatures), exclude_mask(excluded)
+	{
+		driver = nullptr;
+		int expand[] = { 0, ((void)add_container(component_containers), 0)... };
+		(void)expand;
+	}
+
+	// Check if the entity is part of this view
+	bool contains(Entity e) const
+	{
+		if (!e.is_alive() || e.index() >= signatures->size())
+			return false;
+		const ComponentSignature& signature = (*signatures)[e.index()];
+		return (signature & include_mask) == include_mask && (signature & exclude_mask).none();
+	}
+
+	// Returns the entity and references to all of its components in the view (proxies for struct-of-arrays components)
+	std::tuple<Entity, typename ComponentContainer<Components>::reference...> get(Entity e)
+	{
+		return std::tuple<Entity, typename ComponentContainer<Components>::reference...>(e, std::get<ComponentContainer<Components>*>(containers)->get(e)...);
+	}
+
+	// Calls f(entity, components&...) for every entity in the view
+	template <typename F>
+	void each(F f)
+	{
+		// Re-check the size every iteration, f may remove entities
+		for (size_t i = 0; i < driver->size(); i++) {
+			Entity e = (*driver)[i];
+			if (contains(e))
+				f(e, std::get<ComponentContainer<Components>*>(containers)->get(e)...);
+		}
+	}
+
+	// Upper bound on the number of entities in the view
+	size_t size_hint() const { return driver->size(); }
+
+	class iterator
+	{
+		View* view;
+		size_t i;
+
+		void skip_unmatched()
+		{
+			while (i < view->driver->size() && !view->contains((*view->driver)[i]))
+				i++;
+		}
+	public:
+		iterator(View* view, size_t i) : view(view), i(i) { skip_unmatched(); }
+		std::tuple<Entity, typename ComponentContainer<Components>::reference...> operator*() { return view->get((*view->driver)[i]); }
+		iterator& operator++() { i++; skip_unmatched(); return *this; }
+		// Iteration ends when the driving container is exhausted, even if it shrank in the meantime
+		bool operator!=(const iterator&) const { return i < view->driver->size(); }
+	};
+
+	iterator begin() { return iterator(this, 0); }
+	iterator end() { return iterator(this, driver->size()); }
+
+private:
+	template <typename Component>
+	void add_container(ComponentContainer<Component>& container)
+	{
+		include_mask.set(container.type_id);
+		if (!driver || container.entities.size() < driver->size())
+			driver = &container.entities;
+	}
+};
+
+// Records structural changes (create, destroy, add and remove components) so that they can be applied at a sync point,
+// instead of changing containers while a system iterates over them. Recording is locked, so several threads can fill the same buffer.
+// Usage:
+//		registry.commands.destroy(entity);					// the entity stays valid until the next flush
+//		registry.commands.add(registry.colors, entity, vec4(1.f));
+//		registry.flush_commands();							// once per frame, see main.cpp
+class CommandBuffer
+{
+	std::mutex mutex;
+	std::vector<std::function<void()>> added;
+	std::vector<std::pair<ContainerInterface*, Entity>> removed;
+	std::vector<Entity> destroyed;
+public:
+	// Creates an entity right away, so that components can be added to it. It has no components until the next flush.
+	Entity create()
+	{
+		return Entity();
+	}
+
+	// Destroys the entity and all of its components at the next flush
+	void destroy(Entity e)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		destroyed.push_back(e);
+	}
+
+	// Adds a component at the next flush, unless the entity was destroyed by then
+	template <typename Component>
+	void add(ComponentContainer<Component>& container, Entity e, Component c)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ComponentContainer<Component>* target = &container;
+		added.push_back([target, e, c]() mutable {
+			if (e.is_alive())
+				target->insert(e, std::move(c));
+		});
+	}
+
+	// Removes a component at the next flush
+	void remove(ContainerInterface& container, Entity e)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		removed.push_back(std::make_pair(&container, e));
+	}
+
+	// Check if the entity is going to be destroyed at the next flush, e.g. to not let a projectile hit twice
+	bool is_destroy_pending(Entity e)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return std::find(destroyed.begin(), destroyed.end(), e) != destroyed.end();
+	}
+
+	// Applies the recorded adds, then the component removes (sorted and batched per container).
+	// Returns the entities to destroy, sorted, unique and still alive, see Registry::flush_commands.
+	// Changes recorded while applying wait for the next flush.
+	std::vector<Entity> apply();
+};
+
+// The component set of entities made by Registry::spawn_n, holding the initial value of each component
+template <typename... Components>
+struct Prefab
+{
+	std::tuple<Components...> components;
+
+	explicit Prefab(Components... initial) : components(std::move(initial)...) {}
+};
+
+// Deduces the component types from the initial values, e.g. make_prefab(Motion(), Path())
+template <typename... Components>
+Prefab<Components...> make_prefab(Components... initial)
+{
+	return Prefab<Components...>(std::move(initial)...);
+}
+
+// Compile-time position of type T in a type list, used as the component type id
+template <typename T, typename... List>
+struct type_index;
+template <typename T, typename... Rest>
+struct type_index<T, T, Rest...> : std::integral_constant<unsigned int, 0> {};
+template <typename T, typename First, typename... Rest>
+struct type_index<T, First, Rest...> : std::integral_constant<unsigned int, 1 + type_index<T, Rest...>::value> {};
+
+// A registry holding one ComponentContainer per type in 'Components'.
+// The type ids (and so the signature bits) are the positions in the type list and known at compile time.
+// Bulk operations fold over the containers with their concrete types, so no virtual call is made.
+template <typename... Components>
+class Registry
+{
+	std::tuple<ComponentContainer<Components>...> containers;
+
+	// The component signature of every entity, indexed by Entity::index()
+	std::vector<ComponentSignature> signatures;
+
+	template <typename F, size_t... I>
+	void for_each_container(F& f, std::index_sequence<I...>) {
+		int expand[] = { 0, ((void)f(std::get<I>(containers)), 0)... };
+		(void)expand;
+	}
+
+	template <size_t... I>
+	void register_types(std::index_sequence<I...>) {
+		int expand[] = { 0, ((void)std::get<I>(containers).register_type((unsigned int)I, &signatures), 0)... };
+		(void)expand;
+	}
+
+	template <typename... Types, size_t... I>
+	void insert_prefab(const std::vector<Entity>& entities, const Prefab<Types...>& prefab, std::index_sequence<I...>) {
+		int expand[] = { 0, ((void)container<Types>().insert_n(entities, std::get<I>(prefab.components)), 0)... };
+		(void)expand;
+	}
+
+	template <typename... Types, typename F>
+	std::vector<Entity> spawn(std::vector<Entity> entities, const Prefab<Types...>& prefab, F init) {
+		size_t first[] = { 0, container<Types>().size()... };
+		insert_prefab(entities, prefab, std::index_sequence_for<Types...>());
+		init_spawned(entities, prefab, first + 1, init, std::index_sequence_for<Types...>());
+		return entities;
+	}
+
+	template <typename... Types, typename F, size_t... I>
+	void init_spawned(const std::vector<Entity>& entities, const Prefab<Types...>&, const size_t* first, F& init, std::index_sequence<I...>) {
 		for (unsigned int i = 0; i < entities.size(); i++)
-			map_entity_componentID[entities[i]] = i;
+			init(i, entities[i], container<Types>().components[first[I] + i]...);
+	}
+
+	// Removes all components of the given entities and releases them, one batch per container
+	void destroy_sorted(const std::vector<Entity>& sorted_entities) {
+		if (sorted_entities.empty())
+			return;
+		std::vector<Entity> per_type[sizeof...(Components)];
+		for (Entity e : sorted_entities) {
+			ComponentSignature owned = signature_of(e);
+			for (unsigned int i = 0; owned.any(); i++) {
+				if (owned.test(i)) {
+					per_type[i].push_back(e);
+					owned.reset(i);
+				}
+			}
+		}
+		for_each_container([&](auto& container) {
+			if (!per_type[container.type_id].empty())
+				container.remove_sorted(per_type[container.type_id]);
+		});
+		for (Entity e : sorted_entities)
+			Entity::allocator().release(e);
+	}
+
+public:
+	static_assert(sizeof...(Components) <= MAX_COMPONENT_TYPES, "Too many component types for ComponentSignature");
+
+	static constexpr unsigned int component_count = sizeof...(Components);
+
+	Registry()
+	{
+		// Each container owns one bit of the entity signatures
+		register_types(std::index_sequence_for<Components...>());
+	}
+
+	// The id of a component type, i.e. its bit in every ComponentSignature
+	template <typename Component>
+	static constexpr unsigned int type_id() {
+		return type_index<Component, Components...>::value;
+	}
+
+	// Returns the signature made of the given component types, e.g. signature_mask<Motion, Collider>()
+	template <typename... Types>
+	static ComponentSignature signature_mask() {
+		unsigned long long bits[] = { 0ull, (1ull << type_id<Types>())... };
+		unsigned long long mask = 0;
+		for (unsigned long long bit : bits)
+			mask |= bit;
+		return ComponentSignature(mask);
+	}
+
+	// Returns the container holding components of type Component
+	template <typename Component>
+	ComponentContainer<Component>& container() {
+		return std::get<type_id<Component>()>(containers);
+	}
+
+	// Makes room for n more components in the containers of the given types, e.g. before a burst of single spawns
+	template <typename... Types>
+	void reserve(size_t n) {
+		int expand[] = { 0, ((void)container<Types>().reserve(container<Types>().size() + n), 0)... };
+		(void)expand;
+	}
+
+	// Creates n entities, each with a copy of every component in the prefab, and returns them.
+	// Every container grows once per batch. Afterwards init(i, entity, components...) is called for the i-th entity,
+	// with references to its new components in prefab order, e.g.
+	//		registry.spawn_n(n, make_prefab(Motion(), Item()), [&](unsigned int i, Entity e, MotionRef motion, Item& item) { ... });
+	// init must not add components of the prefab's types to any entity, as that would invalidate the references.
+	template <typename... Types, typename F>
+	std::vector<Entity> spawn_n(unsigned int n, const Prefab<Types...>& prefab, F init) {
+		return spawn(Entity::create_n(n), prefab, init);
+	}
+
+	// Same as above, every entity gets exact copies of the prefab's components
+	template <typename... Types>
+	std::vector<Entity> spawn_n(unsigned int n, const Prefab<Types...>& prefab) {
+		return spawn(Entity::create_n(n), prefab, [](unsigned int, Entity, auto&&...) {});
+	}
+
+	// Same as spawn_n, but the entities have consecutive indices, see Entity::create_range
+	template <typename... Types, typename F>
+	std::vector<Entity> spawn_range(unsigned int n, const Prefab<Types...>& prefab, F init) {
+		return spawn(Entity::create_range(n), prefab, init);
+	}
+
+	// Calls f on every container with its concrete type, so f can be a generic lambda, e.g. [](auto& container) { ... }
+	template <typename F>
+	void for_each_container(F f) {
+		for_each_container(f, std::index_sequence_for<Components...>());
+	}
+
+	void clear_all_components() {
+		for_each_container([](auto& container) { container.clear(); });
+	}
+
+	// Ends the frame for the change tracking of every container, see ComponentContainer::track_changes
+	void clear_changes() {
+		for_each_container([](auto& container) { container.clear_changes(); });
+	}
+
+	void list_all_components() {
+		printf("Debug info on all registry entries:\n");
+		for_each_container([](auto& container) {
+			if (container.size() > 0)
+				printf("%4d components of type %s\n", (int)container.size(), typeid(container).name());
+		});
+	}
+
+	void list_all_components_of(Entity e) {
+		printf("Debug info on components of entity %u:\n", (unsigned int)e);
+		ComponentSignature owned = signature_of(e);
+		for_each_container([&](auto& container) {
+			if (owned.test(container.type_id))
+				printf("type %s\n", typeid(container).name());
+		});
+	}
+
+	// Removes every component of the entity and releases its index for re-use.
+	// Only the containers in the entity's signature are touched.
+	// Any handle to e that is kept around becomes stale, see Entity::is_alive
+	void remove_all_components_of(Entity e) {
+		if (!e.is_alive())
+			return;
+		ComponentSignature owned = signature_of(e);
+		for_each_container([&](auto& container) {
+			if (owned.test(container.type_id))
+				container.remove(e);
+		});
+		Entity::allocator().release(e);
+	}
+
+	// Returns the set of component types the entity has (empty for stale handles)
+	ComponentSignature signature_of(Entity e) {
+		if (!e.is_alive() || e.index() >= signatures.size())
+			return ComponentSignature();
+		return signatures[e.index()];
+	}
+
+	// Check if the entity has every component type in the mask, e.g. from signature_mask
+	bool has_all(Entity e, const ComponentSignature& mask) {
+		return (signature_of(e) & mask) == mask;
+	}
+
+	// Returns a view over the entities that have all of the given component types, see View
+	template <typename... Include>
+	View<Include...> view() {
+		return View<Include...>(signatures, ComponentSignature(), container<Include>()...);
+	}
+
+	// Same as above, skipping entities that have any of the excluded component types
+	template <typename... Include, typename... Excluded>
+	View<Include...> view(Exclude<Excluded...>) {
+		return View<Include...>(signatures, signature_mask<Excluded...>(), container<Include>()...);
+	}
+
+	// Structural changes that are deferred to the next flush_commands(), for systems that iterate the containers they change
+	CommandBuffer commands;
+
+	// Applies the recorded commands, called once per frame at a point where no system iterates the registry
+	void flush_commands() {
+		destroy_sorted(commands.apply());
 	}
 };
@@ -3,133 +3,194 @@
 
 #include "tiny_ecs.hpp"
 #include "components.hpp"
-
-class ECSRegistry
+#include "random.hpp"
+#include "metrics.hpp"
+
+// All components this game has. The position in the list is the component type id.
+// Adding a type here is all that is needed to get a container for it, see ECSRegistry for the named accessors.
+typedef Registry<
+	DeathTimer,
+	Tutorial,
+	Motion,
+	Collision,
+	Player,
+	Powerup,
+	PlayerKnockbackEffect,
+	PlayerInaccuracyEffect,
+	Weapon,
+	Projectile,
+	Inventory,
+	Mob,
+	SpaceshipHome,
+	Spaceship,
+	MobSlowEffect,
+	Path,
+	Item,
+	QuestItemIndicator,
+	PointingArrow,
+	Particle,
+	vec2,
+	Mesh*,
+	RenderRequest,
+	InstancedRenderRequest,
+	Text,
+	ScreenState,
+	DebugComponent,
+	vec4,
+	Collider,
+	Animation,
+	Camera
+> GameRegistry;
+
+// The name of the container of a component type, as in the named references of ECSRegistry, e.g. "motions".
+// Tied to the type rather than to its place in GameRegistry, every type there needs one.
+template <typename Component>
+struct ContainerName;
+
+#define CONTAINER_NAME(Component, name) \
+	template <> struct ContainerName<Component> { static const char* get() { return #name; } };
+
+CONTAINER_NAME(DeathTimer, deathTimers)
+CONTAINER_NAME(Tutorial, tutorials)
+CONTAINER_NAME(Motion, motions)
+CONTAINER_NAME(Collision, collisions)
+CONTAINER_NAME(Player, players)
+CONTAINER_NAME(Powerup, powerups)
+CONTAINER_NAME(PlayerKnockbackEffect, playerKnockbackEffects)
+CONTAINER_NAME(PlayerInaccuracyEffect, playerInaccuracyEffects)
+CONTAINER_NAME(Weapon, weapons)
+CONTAINER_NAME(Projectile, projectiles)
+CONTAINER_NAME(Inventory, inventories)
+CONTAINER_NAME(Mob, mobs)
+CONTAINER_NAME(SpaceshipHome, spaceshipHomes)
+CONTAINER_NAME(Spaceship, spaceships)
+CONTAINER_NAME(MobSlowEffect, mobSlowEffects)
+CONTAINER_NAME(Path, paths)
+CONTAINER_NAME(Item, items)
+CONTAINER_NAME(QuestItemIndicator, questItemIndicators)
+CONTAINER_NAME(PointingArrow, pointingArrows)
+CONTAINER_NAME(Particle, particles)
+CONTAINER_NAME(vec2, screenUI)
+CONTAINER_NAME(Mesh*, meshPtrs)
+CONTAINER_NAME(RenderRequest, renderRequests)
+CONTAINER_NAME(InstancedRenderRequest, instancedRenderRequests)
+CONTAINER_NAME(Text, texts)
+CONTAINER_NAME(ScreenState, screenStates)
+CONTAINER_NAME(DebugComponent, debugComponents)
+CONTAINER_NAME(vec4, colors)
+CONTAINER_NAME(Collider, colliders)
+CONTAINER_NAME(Animation, animations)
+CONTAINER_NAME(Camera, cameras)
+
+#undef CONTAINER_NAME
+
+class ECSRegistry : public GameRegistry
 {
-	// Callbacks to remove a particular or all entities in the system
-	std::vector<ContainerInterface*> registry_list;
-
 public:
-	// Manually created list of all components this game has
-	ComponentContainer<DeathTimer> deathTimers;
-	ComponentContainer<Tutorial> tutorials;
-	ComponentContainer<Motion> motions;
-	ComponentContainer<Collision> collisions;
-
-	ComponentContainer<Player> players;
-	ComponentContainer<Powerup> powerups;
-
-
-
-	ComponentContainer<PlayerKnockbackEffect> playerKnockbackEffects;
-	ComponentContainer<PlayerInaccuracyEffect> playerInaccuracyEffects;
-	ComponentContainer<Weapon> weapons;
-	ComponentContainer<Projectile> projectiles;
-	ComponentContainer<Inventory> inventories;
-
-	ComponentContainer<Mob> mobs;
-	ComponentContainer<SpaceshipHome> spaceshipHomes; 
-	ComponentContainer<Spaceship> spaceships; 
-	ComponentContainer<MobSlowEffect> mobSlowEffects;
-	ComponentContainer<Path> paths;
-	ComponentContainer<Item> items;
-
-	ComponentContainer<Particle> particles;
-
-	ComponentContainer<vec2> screenUI;
-	ComponentContainer<QuestItemIndicator> questItemIndicators;
-	ComponentContainer<PointingArrow> pointingArrows;
+	// Named references into the registry, e.g. registry.motions is container<Motion>()
+	ComponentContainer<DeathTimer>& deathTimers = container<DeathTimer>();
+	ComponentContainer<Tutorial>& tutorials = container<Tutorial>();
+	ComponentContainer<Motion>& motions = container<Motion>();
+	ComponentContainer<Collision>& collisions = container<Collision>();
+
+	ComponentContainer<Player>& players = container<Player>();
+	ComponentContainer<Powerup>& powerups = container<Powerup>();
+
+	ComponentContainer<PlayerKnockbackEffect>& playerKnockbackEffects = container<PlayerKnockbackEffect>();
+	ComponentContainer<PlayerInaccuracyEffect>& playerInaccuracyEffects = container<PlayerInaccuracyEffect>();
+	ComponentContainer<Weapon>& weapons = container<Weapon>();
+	ComponentContainer<Projectile>& projectiles = container<Projectile>();
+	ComponentContainer<Inventory>& inventories = container<Inventory>();
+
+	ComponentContainer<Mob>& mobs = container<Mob>();
+	ComponentContainer<SpaceshipHome>& spaceshipHomes = container<SpaceshipHome>();
+	ComponentContainer<Spaceship>& spaceships = container<Spaceship>();
+	ComponentContainer<MobSlowEffect>& mobSlowEffects = container<MobSlowEffect>();
+	ComponentContainer<Path>& paths = container<Path>();
+	ComponentContainer<Item>& items = container<Item>();
+
+	ComponentContainer<Particle>& particles = container<Particle>();
+
+	ComponentContainer<vec2>& screenUI = container<vec2>();
+	ComponentContainer<QuestItemIndicator>& questItemIndicators = container<QuestItemIndicator>();
+	ComponentContainer<PointingArrow>& pointingArrows = container<PointingArrow>();
 
 	// Rendering related
-	ComponentContainer<Mesh*> meshPtrs;
-	ComponentContainer<RenderRequest> renderRequests;
-	ComponentContainer<InstancedRenderRequest> instancedRenderRequests;
-
-	ComponentContainer<Text> texts;
+	ComponentContainer<Mesh*>& meshPtrs = container<Mesh*>();
+	ComponentContainer<RenderRequest>& renderRequests = container<RenderRequest>();
+	ComponentContainer<InstancedRenderRequest>& instancedRenderRequests = container<InstancedRenderRequest>();
 
-	ComponentContainer<Camera> cameras;
+	ComponentContainer<Text>& texts = container<Text>();
 
-	ComponentContainer<ScreenState> screenStates;
-	ComponentContainer<DebugComponent> debugComponents;
-	ComponentContainer<vec4> colors;
-	ComponentContainer<Collider> colliders;
-	ComponentContainer<Animation> animations;
+	ComponentContainer<Camera>& cameras = container<Camera>();
 
+	ComponentContainer<ScreenState>& screenStates = container<ScreenState>();
+	ComponentContainer<DebugComponent>& debugComponents = container<DebugComponent>();
+	ComponentContainer<vec4>& colors = container<vec4>();
+	ComponentContainer<Collider>& colliders = container<Collider>();
+	ComponentContainer<Animation>& animations = container<Animation>();
 
-	// Terrain-related
-	ComponentContainer<TerrainCell> terrainCells;
-
-	// constructor that adds all containers for looping over them
-	// IMPORTANT: Don't forget to add any newly added containers!
+	// The registry owns references into itself, so it can not be copied
 	ECSRegistry()
 	{
-		registry_list.push_back(&deathTimers);
-		registry_list.push_back(&tutorials);
-		registry_list.push_back(&motions);
-		registry_list.push_back(&collisions);
-
-		registry_list.push_back(&players);
-		registry_list.push_back(&powerups);
-
-
-		registry_list.push_back(&playerKnockbackEffects);
-		registry_list.push_back(&playerInaccuracyEffects);
-		registry_list.push_back(&weapons);
-		registry_list.push_back(&projectiles);
-
-		registry_list.push_back(&mobs);
-		registry_list.push_back(&spaceshipHomes);
-		registry_list.push_back(&spaceships);
-		registry_list.push_back(&mobSlowEffects);
-		registry_list.push_back(&paths);
-		registry_list.push_back(&items);
-		registry_list.push_back(&questItemIndicators);
-		registry_list.push_back(&pointingArrows);
-
-		registry_list.push_back(&particles);
-
-		registry_list.push_back(&screenUI);
-
-		registry_list.push_back(&meshPtrs);
-		registry_list.push_back(&renderRequests);
-    
-		registry_list.push_back(&instancedRenderRequests);
-		registry_list.push_back(&texts);
+		// Motions drive the collider sync in PhysicsSystem::step, screen UI the UI movement in WorldSystem::step
+		motions.track_changes();
+		screenUI.track_changes();
+	}
+	ECSRegistry(const ECSRegistry&) = delete;
+	ECSRegistry& operator=(const ECSRegistry&) = delete;
 
-		registry_list.push_back(&screenStates);
-		
-		registry_list.push_back(&debugComponents);
-		registry_list.push_back(&colors);
-		registry_list.push_back(&colliders);
-		registry_list.push_back(&animations);
+	// The threads the systems split their hot loops over, see ComponentContainer::parallel_for.
+	// Only the calling thread by default, main.cpp hands the game its own JobSystem.
+	JobSystem* jobs = &JobSystem::serial();
 
+	// The random number streams of the systems, everything random in this world follows from its seed
+	RandomService random;
 
-		registry_list.push_back(&cameras);
-		registry_list.push_back(&terrainCells);
+	// The name of a container, see ContainerName
+	template <typename Component>
+	static const char* container_name(const ComponentContainer<Component>&)
+	{
+		return ContainerName<Component>::get();
 	}
 
-	void clear_all_components() {
-		for (ContainerInterface* reg : registry_list)
-			reg->clear();
+	// Sets the gauge "containers.<name>" to the size of every container and "entities.alive" to the live
+	// entities, e.g. before a metrics report
+	void sample_metrics()
+	{
+		for_each_container([](auto& container) {
+			Metrics::gauge(std::string("containers.") + container_name(container)).set((double)container.size());
+		});
+		Metrics::gauge("entities.alive").set((double)Entity::allocator().alive_count());
 	}
 
-	void list_all_components() {
-		printf("Debug info on all registry entries:\n");
-		for (ContainerInterface* reg : registry_list)
-			if (reg->size() > 0)
-				printf("%4d components of type %s\n", (int)reg->size(), typeid(*reg).name());
+	// Comparisons per container and frame for sort_spatially_step
+	static constexpr size_t SPATIAL_SORT_BUDGET = 2048;
+
+	// Interleaves the bits of the tile coordinates of a position (the Morton code), so that positions that are
+	// close in the world mostly get close codes
+	static uint32_t morton_code(vec2 position)
+	{
+		uint32_t x = (uint32_t)std::min(std::max(position.x + 32768.f, 0.f), 65535.f);
+		uint32_t y = (uint32_t)std::min(std::max(position.y + 32768.f, 0.f), 65535.f);
+		return spread_bits(x) | (spread_bits(y) << 1);
 	}
 
-	void list_all_components_of(Entity e) {
-		printf("Debug info on components of entity %u:\n", (unsigned int)e);
-		for (ContainerInterface* reg : registry_list)
-			if (reg->has(e))
-				printf("type %s\n", typeid(*reg).name());
+	// Orders motions, colliders and mobs by the Morton code of their position, so that entities that are close
+	// in the world are close in memory for the physics, pathfinding and render loops. Done once the world is built.
+	void sort_spatially()
+	{
+		motions.sort_by_key([this](Entity e) { return morton_code(motions.get(e).position); });
+		colliders.sort_by_key([this](Entity e) { return morton_code(colliders.get(e).position); });
+		mobs.sort_by_key([this](Entity e) { return morton_code(motions.get(e).position); });
 	}
 
-	void remove_all_components_of(Entity e) {
-		for (ContainerInterface* reg : registry_list)
-			reg->remove(e);
+	// Same as sort_spatially, but with at most 'budget' comparisons per container, so it can run every frame
+	void sort_spatially_step(size_t budget)
+	{
+		motions.sort_by_key_step([this](Entity e) { return morton_code(motions.get(e).position); }, budget);
+		colliders.sort_by_key_step([this](Entity e) { return morton_code(colliders.get(e).position); }, budget);
+		mobs.sort_by_key_step([this](Entity e) { return morton_code(motions.get(e).position); }, budget);
 	}
 
 	Entity get_main_camera() {
@@ -141,7 +202,15 @@ public:
 	}
 
 private:
-	Entity main_camera;
-};
+	Entity main_camera = Entity::null();
 
-extern ECSRegistry registry;
\ No newline at end of file
+	// Moves bit i of a 16-bit value to bit 2i
+	static uint32_t spread_bits(uint32_t v)
+	{
+		v = (v | (v << 8)) & 0x00FF00FFu;
+		v = (v | (v << 4)) & 0x0F0F0F0Fu;
+		v = (v | (v << 2)) & 0x33333333u;
+		v = (v | (v << 1)) & 0x55555555u;
+		return v;
+	}
+};
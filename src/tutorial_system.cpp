@@ -11,16 +11,16 @@ void TutorialSystem::step(float elapsed_ms) {
 
         // Remove tutorial if timer expired
         if (tutorial.timer_ms < 0) {
-            registry.remove_all_components_of(entity);
+            registry.commands.destroy(entity);
         }
     }
 
     // Show/hide enter spaceship text
     Entity player = registry.players.entities[0];
     Entity spaceship = registry.spaceships.entities[0];
-    Motion& player_motion = registry.motions.get(player);
+    MotionRef player_motion = registry.motions.get(player);
     Player& player_info = registry.players.get(player);
-    Motion& spaceship_motion = registry.motions.get(spaceship);
+    MotionRef spaceship_motion = registry.motions.get(spaceship);
     
     if (isPlayerNearSpaceship(player_motion.position, spaceship_motion.position) && !player_info.is_home && !registry.deathTimers.has(player) && !isEnterSpaceshipTextShown()) {
         showEnterSpaceshipText();
@@ -56,7 +56,7 @@ bool TutorialSystem::isHelpDialogOpen() {
 
 bool TutorialSystem::isMouseOverHelpButton(vec2 mouse_pos) {
     // Help button is a circle so check if the distance between the mouse and button is less than the radius of the button
-    Motion& motion = registry.motions.get(help_button);
+    MotionRef motion = registry.motions.get(help_button);
     float radius = HELP_BUTTON_SCALE.x / 2;
     float dist = distance(mouse_pos, motion.position);
 
@@ -79,7 +79,7 @@ Entity TutorialSystem::createTutorialText(TUTORIAL_TYPE type) {
             break;
     }
 
-    Entity tutorial_text = createText(renderer, position, str, TUTORIAL_TEXT_SCALE);
+    Entity tutorial_text = createText(registry, renderer, position, str, TUTORIAL_TEXT_SCALE);
 
     // Add entity to tutorial registry
     registry.tutorials.emplace(tutorial_text);
@@ -96,7 +96,7 @@ Entity TutorialSystem::createTutorialDialog(TUTORIAL_TYPE type) {
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = TUTORIAL_DIALOG_POSITION;
@@ -138,7 +138,7 @@ Entity TutorialSystem::createHelpButton() {
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = HELP_BUTTON_POSITION;
@@ -167,7 +167,7 @@ Entity TutorialSystem::createHelpDialog() {
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = HELP_DIALOG_POSITION;
@@ -191,10 +191,10 @@ Entity TutorialSystem::createHelpDialog() {
 
 void TutorialSystem::showEnterSpaceshipText() {
     Entity spaceship = registry.spaceships.entities[0];
-    Motion& spaceship_motion = registry.motions.get(spaceship);
+    MotionRef spaceship_motion = registry.motions.get(spaceship);
     const vec2 ENTER_SPACESHIP_TEXT_POSITION = { spaceship_motion.position.x - 2.0f, spaceship_motion.position.y - 2.0f };
 
-    enter_spaceship_text = createText(renderer, ENTER_SPACESHIP_TEXT_POSITION, ENTER_SPACESHIP_TEXT, TUTORIAL_TEXT_SCALE);
+    enter_spaceship_text = createText(registry, renderer, ENTER_SPACESHIP_TEXT_POSITION, ENTER_SPACESHIP_TEXT, TUTORIAL_TEXT_SCALE);
     registry.screenUI.remove(enter_spaceship_text);    // Remove from screen ui registry so text does not move with camera
 
     is_enter_spaceship_text_shown = true;
@@ -214,7 +214,7 @@ bool TutorialSystem::isPlayerNearSpaceship(vec2 player_pos, vec2 spaceship_pos)
 };
 
 void TutorialSystem::removeDisplayedTutorials() {
-    for (Entity entity : registry.tutorials.entities) {
-        registry.remove_all_components_of(entity);
+    while (registry.tutorials.entities.size() > 0) {
+        registry.remove_all_components_of(registry.tutorials.entities.back());
     }
 };
@@ -12,7 +12,8 @@ class TutorialSystem
 {
     public:
         /// @brief TutorialSystem constructor
-        TutorialSystem()
+        explicit TutorialSystem(ECSRegistry& registry_arg)
+            : registry(registry_arg)
         {
         }
 
@@ -71,6 +72,7 @@ class TutorialSystem
         const vec2 HELP_DIALOG_SCALE = { target_resolution.x / tile_size_px * 0.5f, target_resolution.y / tile_size_px * 0.5f }; 
         const vec2 TUTORIAL_DIALOG_SCALE = { target_resolution.x / tile_size_px * 0.3f, target_resolution.y / tile_size_px * 0.45f };
 
+        ECSRegistry& registry;
         RenderSystem* renderer;
         Entity help_dialog;
         Entity help_button;
@@ -332,6 +332,10 @@ void WeaponsSystem::fireMachineGun(float player_x, float player_y, float angle)
 void WeaponsSystem::applyWeaponEffects(Entity proj, Entity mob) {
 	// Determine the weapon (and upgrade level) that the projectile came from
 	Projectile& projectile = registry.projectiles.get(proj);
+
+	// The weapon handle is stale if the weapons were reset after the projectile was fired
+	if (!projectile.weapon.is_alive())
+		return;
 	Weapon& weapon = registry.weapons.get(projectile.weapon);
 
 
@@ -368,13 +372,11 @@ void WeaponsSystem::applyProjectileInaccuracy(float& angle, float inaccuracy_per
 
 	// The following approximates recoil
 	// It is based on a gaussian distribution about the current angle
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::normal_distribution<float> distribution(angle, stddev);
+	Rng& rng = registry.random.stream(RANDOM_STREAM::WEAPONS);
 
 	float angle_with_inaccuracy;
 	do {
-        angle_with_inaccuracy = distribution(gen);
+        angle_with_inaccuracy = rng.normal(angle, stddev);
     } while (angle_with_inaccuracy < range_min || angle_with_inaccuracy > range_max);
 
 	angle = angle_with_inaccuracy;
@@ -395,7 +397,7 @@ Entity WeaponsSystem::createProjectile(RenderSystem* renderer, PhysicsSystem* ph
 	}
 	
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = angle;
 	motion.velocity = weapon_projectile_velocity_map[active_weapon_type] * vec2(cos(angle), sin(angle));;
 	motion.position = pos;
@@ -438,7 +440,7 @@ Entity WeaponsSystem::createAmmoBar(RenderSystem* renderer, vec2 position, vec2
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -469,7 +471,7 @@ Entity WeaponsSystem::createWeaponIndicator(RenderSystem* renderer, TEXTURE_ASSE
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -508,7 +510,7 @@ void WeaponsSystem::updateAmmoBar() {
 	if (!active_weapon_component)
 		return;
 	
-	Motion& ammo_motion = registry.motions.get(ammo_indicator);
+	MotionRef ammo_motion = registry.motions.get(ammo_indicator);
 	ammo_motion.scale = vec2(
 		(
 			(float)active_weapon_component->ammo_count / 
@@ -519,7 +521,7 @@ void WeaponsSystem::updateAmmoBar() {
 
 
 bool WeaponsSystem::updateSideIndicatorHelper(Entity weapon_indicator, Entity ammo_indicator, Weapon& weapon) {
-	Motion& ammo_motion = registry.motions.get(ammo_indicator);
+	MotionRef ammo_motion = registry.motions.get(ammo_indicator);
 	
 	ammo_motion.scale = vec2(((float)weapon.ammo_count / (float)weapon_ammo_capacity_map[weapon.weapon_type]) * 1.3f, 0.2f);
 
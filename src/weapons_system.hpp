@@ -14,7 +14,8 @@ class WeaponsSystem
 {
     public:
         /// @brief WeaponsSystem constructor
-        WeaponsSystem()
+        explicit WeaponsSystem(ECSRegistry& registry_arg)
+            : registry(registry_arg)
         {
         }
 
@@ -107,6 +108,7 @@ class WeaponsSystem
 
 
         // Pointer to rendering system for projectiles
+        ECSRegistry& registry;
         RenderSystem* renderer;
 
         // Pointer to physics system for projectiles
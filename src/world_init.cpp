@@ -6,7 +6,7 @@
 #include "render_system.hpp"
 #include "physics_system.hpp"
 
-Entity createPlayer(RenderSystem* renderer, PhysicsSystem* physics, vec2 pos)
+Entity createPlayer(ECSRegistry& registry, RenderSystem* renderer, PhysicsSystem* physics, vec2 pos)
 	{
 	auto entity = Entity();
 
@@ -15,7 +15,7 @@ Entity createPlayer(RenderSystem* renderer, PhysicsSystem* physics, vec2 pos)
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Setting initial motion values
-	Motion& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.position = pos;
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
@@ -49,7 +49,7 @@ Entity createPlayer(RenderSystem* renderer, PhysicsSystem* physics, vec2 pos)
 	return entity;
 }
 
-Entity createItem(RenderSystem* renderer, PhysicsSystem* physics, vec2 position, ITEM_TYPE type)
+Entity createItem(ECSRegistry& registry, RenderSystem* renderer, PhysicsSystem* physics, vec2 position, ITEM_TYPE type)
 {
 	// Reserve en entity
 	auto entity = Entity();
@@ -59,7 +59,7 @@ Entity createItem(RenderSystem* renderer, PhysicsSystem* physics, vec2 position,
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -128,7 +128,7 @@ Entity createItem(RenderSystem* renderer, PhysicsSystem* physics, vec2 position,
 }
 
 
-Entity createSpaceship(RenderSystem* renderer, vec2 position) {
+Entity createSpaceship(ECSRegistry& registry, RenderSystem* renderer, vec2 position) {
 	auto entity = Entity();
 
 	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
@@ -136,7 +136,7 @@ Entity createSpaceship(RenderSystem* renderer, vec2 position) {
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the motion
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -156,7 +156,7 @@ Entity createSpaceship(RenderSystem* renderer, vec2 position) {
 	return entity;
 }
 
-Entity createLine(vec2 position, vec2 scale)
+Entity createLine(ECSRegistry& registry, vec2 position, vec2 scale)
 {
 	Entity entity = Entity();
 
@@ -168,7 +168,7 @@ Entity createLine(vec2 position, vec2 scale)
 		 GEOMETRY_BUFFER_ID::DEBUG_LINE });
 
 	// Create motion
-	Motion& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -178,14 +178,14 @@ Entity createLine(vec2 position, vec2 scale)
 	return entity;
 }
 
-Entity createBar(RenderSystem* renderer, vec2 position, int amount, BAR_TYPE type) {
+Entity createBar(ECSRegistry& registry, RenderSystem* renderer, vec2 position, int amount, BAR_TYPE type) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -233,14 +233,14 @@ Entity createBar(RenderSystem* renderer, vec2 position, int amount, BAR_TYPE typ
 	return entity;
 }
 
-Entity createFrame(RenderSystem* renderer, vec2 position, FRAME_TYPE type) {
+Entity createFrame(ECSRegistry& registry, RenderSystem* renderer, vec2 position, FRAME_TYPE type) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position; 
@@ -274,14 +274,14 @@ Entity createFrame(RenderSystem* renderer, vec2 position, FRAME_TYPE type) {
 	return entity;
 	}
 
-Entity createHelp(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture) {
+Entity createHelp(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -299,14 +299,14 @@ Entity createHelp(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID textur
 	return entity;
 }
 
-Entity createQuestItem(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture) {
+Entity createQuestItem(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -322,14 +322,14 @@ Entity createQuestItem(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID t
 	return entity;
 }
 
-Entity createWeaponIndicator(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID weapon_texture) {
+Entity createWeaponIndicator(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID weapon_texture) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -345,14 +345,14 @@ Entity createWeaponIndicator(RenderSystem* renderer, vec2 position, TEXTURE_ASSE
 	return entity;
 }
 
-Entity createPowerupIndicator(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID powerup_texture) {
+Entity createPowerupIndicator(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID powerup_texture) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -368,11 +368,11 @@ Entity createPowerupIndicator(RenderSystem* renderer, vec2 position, TEXTURE_ASS
 	return entity;
 }
 
-Entity createPointingArrow(RenderSystem* renderer, Entity player, Entity target)
+Entity createPointingArrow(ECSRegistry& registry, RenderSystem* renderer, Entity player, Entity target)
 {
 	auto arrow = Entity();
 	PointingArrow& pa = registry.pointingArrows.emplace(arrow, target);
-	Motion& motion = registry.motions.emplace(arrow);
+	MotionRef motion = registry.motions.emplace(arrow);
 
 	motion.angle = 0.0f;
 	motion.velocity = { 0.f, 0.f };
@@ -389,12 +389,12 @@ Entity createPointingArrow(RenderSystem* renderer, Entity player, Entity target)
 	return arrow;
 }
 
-Entity createCamera(vec2 pos)
+Entity createCamera(ECSRegistry& registry, vec2 pos)
 {
 	auto entity = Entity();
 	registry.set_main_camera(entity);
 
-	Motion& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	Camera& camera = registry.cameras.emplace(entity);
 
 	camera.mode_follow = true;
@@ -406,14 +406,14 @@ Entity createCamera(vec2 pos)
 	return entity;
 }
 
-Entity createText(RenderSystem* renderer, vec2 position, std::string str, float scale, vec3 color) {
+Entity createText(ECSRegistry& registry, RenderSystem* renderer, vec2 position, std::string str, float scale, vec3 color) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
@@ -432,14 +432,14 @@ Entity createText(RenderSystem* renderer, vec2 position, std::string str, float
 }
 
 
-Entity createMuzzleFlash(RenderSystem* renderer, vec2 position) {
+Entity createMuzzleFlash(ECSRegistry& registry, RenderSystem* renderer, vec2 position) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::MUZZLEFLASH_SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.position = position;
 	motion.scale = { 1.f, 1.f };
@@ -469,7 +469,7 @@ Entity createMuzzleFlash(RenderSystem* renderer, vec2 position) {
 	return entity;
 }
 
-Entity createSpaceshipDepart(RenderSystem* renderer) {
+Entity createSpaceshipDepart(ECSRegistry& registry, RenderSystem* renderer) {
 	auto entity = Entity();
 
 	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
@@ -477,7 +477,7 @@ Entity createSpaceshipDepart(RenderSystem* renderer) {
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the motion
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = { 0, -1.5f };
@@ -507,14 +507,14 @@ Entity createSpaceshipDepart(RenderSystem* renderer) {
 }
 
 
-Entity createEndingTextPopUp(RenderSystem * renderer, vec2 position, TEXTURE_ASSET_ID texture) {
+Entity createEndingTextPopUp(ECSRegistry& registry, RenderSystem * renderer, vec2 position, TEXTURE_ASSET_ID texture) {
 	auto entity = Entity();
 
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
 	registry.meshPtrs.emplace(entity, &mesh);
 
 	// Initialize the position, scale, and physics components
-	auto& motion = registry.motions.emplace(entity);
+	MotionRef motion = registry.motions.emplace(entity);
 	motion.angle = 0.f;
 	motion.velocity = { 0.f, 0.f };
 	motion.position = position;
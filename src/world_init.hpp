@@ -24,45 +24,46 @@ const vec2 FOOD_BAR_FRAME_POS = vec2{ 5.f, 6.5f };
 
 
 // the player
-Entity createPlayer(RenderSystem* renderer, PhysicsSystem* physics, vec2 pos);
+Entity createPlayer(ECSRegistry& registry, RenderSystem* renderer, PhysicsSystem* physics, vec2 pos);
 
 // the prey
-Entity createItem(RenderSystem* renderer, PhysicsSystem* physics, vec2 position, ITEM_TYPE type);
+Entity createItem(ECSRegistry& registry, RenderSystem* renderer, PhysicsSystem* physics, vec2 position, ITEM_TYPE type);
 
 // the spaceship 
-Entity createSpaceship(RenderSystem* renderer, vec2 position);
+Entity createSpaceship(ECSRegistry& registry, RenderSystem* renderer, vec2 position);
 
 // a red line for debugging purposes
-Entity createLine(vec2 position, vec2 size);
+Entity createLine(ECSRegistry& registry, vec2 position, vec2 size);
 
 // UI Elements
-Entity createBar(RenderSystem* renderer, vec2 position, int amount, BAR_TYPE type);
-Entity createFrame(RenderSystem* renderer, vec2 position, FRAME_TYPE type);
-Entity createWeaponIndicator(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID weapon_texture);
-Entity createPowerupIndicator(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID powerup_texture);
-Entity createPointingArrow(RenderSystem* renderer, Entity player, Entity target);
+Entity createBar(ECSRegistry& registry, RenderSystem* renderer, vec2 position, int amount, BAR_TYPE type);
+Entity createFrame(ECSRegistry& registry, RenderSystem* renderer, vec2 position, FRAME_TYPE type);
+Entity createWeaponIndicator(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID weapon_texture);
+Entity createPowerupIndicator(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID powerup_texture);
+Entity createPointingArrow(ECSRegistry& registry, RenderSystem* renderer, Entity player, Entity target);
 
 // the spaceship departing 
-Entity createSpaceshipDepart(RenderSystem* renderer); 
+Entity createSpaceshipDepart(ECSRegistry& registry, RenderSystem* renderer); 
 // Tool tips for ease of use 
-Entity createHelp(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture);
+Entity createHelp(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture);
 
-Entity createQuestItem(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture);
+Entity createQuestItem(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture);
 
 /// <summary>
 /// Creates a camera pointed at the given spot.
 /// </summary>
+/// <param name="registry">The world to create the camera in</param>
 /// <param name="pos">Position of the camera in world space</param>
 /// <returns>The camera entity</returns>
-Entity createCamera(vec2 pos);
+Entity createCamera(ECSRegistry& registry, vec2 pos);
 
-Entity createText(RenderSystem* renderer, vec2 position, std::string str, float scale=1.f, vec3 color={1.f, 1.f, 1.f});
+Entity createText(ECSRegistry& registry, RenderSystem* renderer, vec2 position, std::string str, float scale=1.f, vec3 color={1.f, 1.f, 1.f});
 
 
 // Muzzle flash 
-Entity createMuzzleFlash(RenderSystem* renderer, vec2 position);
+Entity createMuzzleFlash(ECSRegistry& registry, RenderSystem* renderer, vec2 position);
 
 
 // the ending screen text 
-Entity createEndingTextPopUp(RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture);
+Entity createEndingTextPopUp(ECSRegistry& registry, RenderSystem* renderer, vec2 position, TEXTURE_ASSET_ID texture);
 
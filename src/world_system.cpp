@@ -1,6 +1,7 @@
 // Header
 #include "world_system.hpp"
 #include "world_init.hpp"
+#include "profiler.hpp"
 
 // stlib
 #include <cassert>
@@ -12,23 +13,16 @@
 // Game configuration
 const float IFRAMES = 1500;
 const int FOOD_PICKUP_AMOUNT = 20;
-float PLAYER_TOTAL_DISTANCE = 0;
 const float FOOD_DECREASE_THRESHOLD  = 5.0f; // Adjust this value as needed
 const float FOOD_DECREASE_RATE = 7.f;	// Decreases by 10 units per second (when moving)
-float CURSOR_ANGLE = 0;
-int PLAYER_DIRECTION = 2;  // Default to facing up
-float ELAPSED_TIME = 0;
-bool PLAYER_DEATH_FROM_FOOD = false; 
 
 
 // Create the fish world
-WorldSystem::WorldSystem()
-	: points(0)
+WorldSystem::WorldSystem(ECSRegistry& registry_arg)
+	: registry(registry_arg)
+	, points(0)
 	, next_turtle_spawn(0.f)
 	, next_fish_spawn(0.f) {
-	// Seeding rng with random device
-	rng = std::default_random_engine(std::random_device()());
-
 	}
 
 WorldSystem::~WorldSystem() {
@@ -36,68 +30,9 @@ WorldSystem::~WorldSystem() {
 	registry.clear_all_components();
 
 	// Close the window
-	glfwDestroyWindow(window);
+	destroy_window();
 }
 
-// Debugging
-namespace {
-	void glfw_err_cb(int error, const char* desc) {
-		fprintf(stderr, "%d: %s", error, desc);
-	}
-}
-
-// World initialization
-// Note, this has a lot of OpenGL specific things, could be moved to the renderer
-GLFWwindow* WorldSystem::create_window(ivec2& window_size) {
-	///////////////////////////////////////
-	// Initialize GLFW
-	glfwSetErrorCallback(glfw_err_cb);
-	if (!glfwInit()) {
-		fprintf(stderr, "Failed to initialize GLFW");
-		return nullptr;
-	}
-
-	//-------------------------------------------------------------------------
-	// If you are on Linux or Windows, you can change these 2 numbers to 4 and 3 and
-	// enable the glDebugMessageCallback to have OpenGL catch your mistakes for you.
-	// GLFW / OGL Initialization
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
-#if __APPLE__
-	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-	glfwWindowHint(GLFW_RESIZABLE, 0);
-
-	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-	int y = mode->height;
-	int s = y / aspect_ratio.y;	// scale factor such that s * aspect_ratio = {mode->width, mode->height}. 
-	int x = aspect_ratio.x * s;
-	// Remember: aspect_ratio.y * s = y, aspect_ratio.x * s = x
-
-	GLFWmonitor* monitor_ptr = glfwGetPrimaryMonitor();
-
-	if (windowed_mode) {
-		monitor_ptr = nullptr;
-		x = target_resolution.x;
-		y = target_resolution.y;
-	}
-
-	// Create the main window (for rendering, keyboard, and mouse input)
-	window = glfwCreateWindow(x, y, "Stranded", monitor_ptr, nullptr);
-	if (window == nullptr) {
-		fprintf(stderr, "Failed to glfwCreateWindow");
-		return nullptr;
-	}
-
-	window_size = { x, y };
-
-	return window;
-}
-
-
-
 void WorldSystem::init(
 	RenderSystem* renderer_arg, 
 	TerrainSystem* terrain_arg, 
@@ -123,19 +58,67 @@ void WorldSystem::init(
 	this->particle_system = particle_system_arg;
 	this->powerup_system = powerup_system_arg;
 
-	// Setting callbacks to member functions (that's why the redirect is needed)
-	// Input is handled using GLFW, for more info see
-	// http://www.glfw.org/docs/latest/input_guide.html
-	glfwSetWindowUserPointer(window, this);
-	auto key_redirect = [](GLFWwindow* wnd, int _0, int _1, int _2, int _3) { ((WorldSystem*)glfwGetWindowUserPointer(wnd))->on_key(_0, _1, _2, _3); };
-	auto cursor_pos_redirect = [](GLFWwindow* wnd, double _0, double _1) { ((WorldSystem*)glfwGetWindowUserPointer(wnd))->on_mouse_move({ _0, _1 }); };
-	auto cursor_button_redirect = [](GLFWwindow* wnd, int _0, int _1, int _2) { ((WorldSystem*)glfwGetWindowUserPointer(wnd))->on_mouse_click(_0, _1, _2); };
-	glfwSetKeyCallback(window, key_redirect);
-	glfwSetCursorPosCallback(window, cursor_pos_redirect);
-	glfwSetMouseButtonCallback(window, cursor_button_redirect);
-
 	// Set all states to default
 	restart_game();
+
+	attach_window();
+}
+
+bool WorldSystem::replay_frame(float& elapsed_ms)
+{
+	InputEvent event;
+	while (input_log->read(event)) {
+		if (event.type == InputEvent::FRAME) {
+			elapsed_ms = event.elapsed_ms;
+			return true;
+		}
+		play_input(event);
+	}
+	return false;
+}
+
+void WorldSystem::play_input(const InputEvent& event)
+{
+	switch (event.type) {
+	case InputEvent::FRAME:
+		break;
+	case InputEvent::KEY:
+		on_key(event.key, event.scancode, event.action, event.mods);
+		break;
+	case InputEvent::MOUSE_MOVE:
+		on_mouse_move(event.position);
+		break;
+	case InputEvent::MOUSE_CLICK:
+		on_mouse_click(event.key, event.action, event.mods);
+		break;
+	}
+}
+
+void WorldSystem::receive_key(int key, int scancode, int action, int mod)
+{
+	if (input_log && input_log->replaying())
+		return;
+	if (input_log)
+		input_log->record_key(key, scancode, action, mod);
+	on_key(key, scancode, action, mod);
+}
+
+void WorldSystem::receive_mouse_move(vec2 pos)
+{
+	if (input_log && input_log->replaying())
+		return;
+	if (input_log)
+		input_log->record_mouse_move(pos);
+	on_mouse_move(pos);
+}
+
+void WorldSystem::receive_mouse_click(int button, int action, int mods)
+{
+	if (input_log && input_log->replaying())
+		return;
+	if (input_log)
+		input_log->record_mouse_click(button, action, mods);
+	on_mouse_click(button, action, mods);
 }
 
 // Update our game world
@@ -147,7 +130,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	
 	// Removing out of screen entities
 	auto& motion_container = registry.motions;
-	Motion& camera_motion = registry.motions.get(main_camera);
+	MotionRef camera_motion = registry.motions.get(main_camera);
 
 	// Processing the player state
 	assert(registry.screenStates.components.size() <= 1);
@@ -169,14 +152,14 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 		if (timer.timer_ms < 0) {
 			if (spaceship_home_system->ALL_ITEMS_SUBMITTED){
 				// pop up for victory 
-				pop_up_text = createEndingTextPopUp(renderer, { 0,0 }, TEXTURE_ASSET_ID::VICTORY_TEXT); 
+				pop_up_text = createEndingTextPopUp(registry, renderer, { 0,0 }, TEXTURE_ASSET_ID::VICTORY_TEXT); 
 			}
 			else {
-				if (PLAYER_DEATH_FROM_FOOD) {
-					pop_up_text = createEndingTextPopUp(renderer, { camera_motion.position.x,camera_motion.position.y }, TEXTURE_ASSET_ID::DEATH_TEXT_F);
+				if (player_death_from_food) {
+					pop_up_text = createEndingTextPopUp(registry, renderer, { camera_motion.position.x,camera_motion.position.y }, TEXTURE_ASSET_ID::DEATH_TEXT_F);
 				}
 				else {
-					pop_up_text = createEndingTextPopUp(renderer, { camera_motion.position.x,camera_motion.position.y}, TEXTURE_ASSET_ID::DEATH_TEXT_H);
+					pop_up_text = createEndingTextPopUp(registry, renderer, { camera_motion.position.x,camera_motion.position.y}, TEXTURE_ASSET_ID::DEATH_TEXT_H);
 
 				}
 			}
@@ -212,8 +195,8 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 			
 		// Screen shake, for feedback to the player that they have been hit.
-		int direction = rand() % 8;
-		Motion& camera_motion = registry.motions.get(main_camera);
+		int direction = registry.random.stream(RANDOM_STREAM::WORLD).uniform_int(0, 7);
+		MotionRef camera_motion = registry.motions.get(main_camera);
 		switch (direction) {
 			case 0:
 				camera_motion.angle += 0.01;
@@ -233,14 +216,14 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	if (player_component.food_decrease_time > 0) {
 		player_component.food_decrease_time -= elapsed_ms_since_last_update;
 
-		Motion& food = registry.motions.get(food_bar);
+		MotionRef food = registry.motions.get(food_bar);
 		vec2 new_food_scale = vec2(((float)player_component.food / (float)PLAYER_MAX_FOOD) * FOOD_BAR_SCALE[0], FOOD_BAR_SCALE[1]);
 		food.scale = interpolate(food.scale, new_food_scale, 1 - (player_component.food_decrease_time / IFRAMES));
 	}
 	
 
 
-	ELAPSED_TIME += elapsed_ms_since_last_update;
+	elapsed_time += elapsed_ms_since_last_update;
 
 	remaing_time_for_next_hunger_sound -= elapsed_ms_since_last_update;
 	
@@ -252,30 +235,30 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 	
 	
-	Motion& m = registry.motions.get(player_salmon);
+	MotionRef m = registry.motions.get(player_salmon);
 
 	// Apply food decreasing the more you travel. 
 	if (player_component.food > 0) {
-		if (PLAYER_TOTAL_DISTANCE >= FOOD_DECREASE_THRESHOLD && !debugging.in_debug_mode) {
+		if (player_total_distance >= FOOD_DECREASE_THRESHOLD && !debugging.in_debug_mode) {
 			// Decrease player's food by 1
 			player_component.food -= 1;
 			// Shrink the food bar
 			player_component.food_decrease_time = IFRAMES;
 
 			// Reset the total movement distance
-			PLAYER_TOTAL_DISTANCE = 0;
+			player_total_distance = 0;
 
 		}
 	}
 	// else the food is below 0, player dies
 	else if (!registry.deathTimers.has(player_salmon)) {
 		registry.deathTimers.emplace(player_salmon);
-		PLAYER_DEATH_FROM_FOOD = true;
+		player_death_from_food = true;
 	}
 
 
 	// HEALTH BAR UI UPDATES
-	Motion& health = registry.motions.get(health_bar);
+	MotionRef health = registry.motions.get(health_bar);
 	vec2 new_health_scale = vec2(((float)player_component.health / (float)PLAYER_MAX_HEALTH) * HEALTH_BAR_SCALE[0], HEALTH_BAR_SCALE[1]);
 	health.scale = interpolate(health.scale, new_health_scale, 1 - (player_component.health_decrease_time / IFRAMES));
 		
@@ -285,7 +268,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	screen.screen_darken_factor = 1 - min_timer_ms / 3000;
 
 	vec2 player_p = m.position;
-	//Motion& f = registry.motions.get(fow);
+	//MotionRef f = registry.motions.get(fow);
 	//f.position = m.position;
 
 
@@ -295,26 +278,40 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	// Player Movement code, build the velocity resulting from player movement
 	handlePlayerMovement(elapsed_ms_since_last_update);
 
+	// The movement may splash water, whose particles add motions and move the ones fetched above
+	MotionRef camera = registry.motions.get(main_camera);
+	MotionRef player_motion = registry.motions.get(player_salmon);
+
 	// Camera movement mode
 	Camera& c = registry.cameras.get(main_camera);
 	if (c.mode_follow) {
 		/*
 		if (debugging.in_debug_mode)
-			camera_motion.velocity = { 0,0 };
+			camera.velocity = { 0,0 };
 		else
 		*/
-		camera_motion.position = m.position;
+		if (camera.position != player_motion.position) {
+			registry.motions.mark_changed(main_camera);
+			camera.position = player_motion.position;
+		}
 	}
 	else {
-		handle_movement(camera_motion, CAMERA_LEFT);
+		handle_movement(camera, CAMERA_LEFT);
 	}
-	// UI Movement
-	for (Entity e : registry.screenUI.entities) {
+	// UI Movement, all of it when the camera moved, otherwise only the UI that was just added
+	auto move_ui = [&](Entity e) {
 		if (registry.motions.has(e)) {
 			vec2& ui_inital_position = registry.screenUI.get(e);
-			Motion& ui_motion = registry.motions.get(e);
-			ui_motion.position = ui_inital_position + camera_motion.position;
+			MotionRef ui_motion = registry.motions.get(e);
+			ui_motion.position = ui_inital_position + camera.position;
 		}
+	};
+	if (registry.motions.is_changed(main_camera)) {
+		for (Entity e : registry.screenUI.entities)
+			move_ui(e);
+	}
+	else {
+		registry.screenUI.each_changed(move_ui);
 	}
 
 	// Update pointing arrows
@@ -322,9 +319,9 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 		Entity e = registry.pointingArrows.entities[i];
 		PointingArrow& arrow = registry.pointingArrows.components[i];
 
-		Motion& arrow_m = registry.motions.get(e);
+		MotionRef arrow_m = registry.motions.get(e);
 		vec2 local_space = arrow.radius_offset;
-		Motion& target_m = registry.motions.get(arrow.target);
+		MotionRef target_m = registry.motions.get(arrow.target);
 		vec2 target_p = target_m.position;
 		vec2 delta_p = target_p - player_p;
 
@@ -358,11 +355,15 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	for (Entity entity : registry.mobs.entities) {
 		// set the health bars to be below the mob
 		Mob& mob = registry.mobs.get(entity);
-		Motion& motion = registry.motions.get(entity);
-		Motion& health = registry.motions.get(mob.health_bar);
-		vec2& mob_position = motion.position;
-		vec2 health_position = { mob_position.x, mob_position.y - 0.8 };
-		health.position = health_position;
+		MotionRef motion = registry.motions.get(entity);
+
+		// The health bar handle is stale if the bar was destroyed without its mob
+		if (mob.health_bar.is_alive()) {
+			MotionRef health = registry.motions.get(mob.health_bar);
+			vec2& mob_position = motion.position;
+			vec2 health_position = { mob_position.x, mob_position.y - 0.8 };
+			health.position = health_position;
+		}
 
 		// slow updates
 		if (registry.mobSlowEffects.has(entity)) {
@@ -390,7 +391,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 	// Player updates
 	
-	Motion& motion = registry.motions.get(player_salmon);
+	MotionRef motion = registry.motions.get(player_salmon);
 
 	// Knockback updates
 	if (registry.playerKnockbackEffects.has(player_salmon)) {
@@ -452,18 +453,18 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 }
 
 void WorldSystem::updatePlayerDirection() {
-	if (CURSOR_ANGLE >= -M_PI / 4 && CURSOR_ANGLE < M_PI / 4) 
-		PLAYER_DIRECTION = 0;  // Weapom, Right
-	else if (CURSOR_ANGLE >= M_PI / 4 && CURSOR_ANGLE < 3 * M_PI / 4) 
-		PLAYER_DIRECTION = 1;  // Weapom, Down
-	else if (CURSOR_ANGLE >= -3 * M_PI / 4 && CURSOR_ANGLE < -M_PI / 4) 
-		PLAYER_DIRECTION = 2;  // Weapom, UP
+	if (cursor_angle >= -M_PI / 4 && cursor_angle < M_PI / 4) 
+		player_direction = 0;  // Weapom, Right
+	else if (cursor_angle >= M_PI / 4 && cursor_angle < 3 * M_PI / 4) 
+		player_direction = 1;  // Weapom, Down
+	else if (cursor_angle >= -3 * M_PI / 4 && cursor_angle < -M_PI / 4) 
+		player_direction = 2;  // Weapom, UP
 	else 
-		PLAYER_DIRECTION = 4;  // Weapom, left
+		player_direction = 4;  // Weapom, left
 
 
 	// Update player's direction
-	registry.animations.get(player_salmon).framey = PLAYER_DIRECTION;
+	registry.animations.get(player_salmon).framey = player_direction;
 	
 	}
 
@@ -476,7 +477,7 @@ void WorldSystem::handlePlayerMovement(float elapsed_ms_since_last_update) {
 	// Allow movement if player is not dead 
 	// Movement code, build the velocity resulting from player movement
 	if (!registry.deathTimers.has(player_salmon) && !registry.playerKnockbackEffects.has(player_salmon)) {
-		Motion& m = registry.motions.get(player_salmon);
+		MotionRef m = registry.motions.get(player_salmon);
 		m.velocity = { 0, 0 };
 
 		handle_movement(m, LEFT);
@@ -484,21 +485,21 @@ void WorldSystem::handlePlayerMovement(float elapsed_ms_since_last_update) {
 		if (length(m.velocity) > 0) {
 
 			float speedRatio = terrain->get_terrain_speed_ratio(terrain->get_cell(m.position));
+			m.velocity *= speedRatio;
 
+			// After the last use of m: the splash adds motions, which may move the one m refers to
 			if (speedRatio == 0.25f || speedRatio == 0.40f) {
 				particle_system->createWaterSplash(player_salmon,1, speedRatio);
 			}
-
-			m.velocity *= speedRatio;
 		}
 
 		if (anyMovementKeysPressed) {
-			PLAYER_TOTAL_DISTANCE += FOOD_DECREASE_RATE * elapsed_ms_since_last_update / 1000.f;
+			player_total_distance += FOOD_DECREASE_RATE * elapsed_ms_since_last_update / 1000.f;
 
-			if (ELAPSED_TIME > 100) {
+			if (elapsed_time > 100) {
 				// Update walking animation
 				player_animation.framex = (player_animation.framex + 1) % 4;
-				ELAPSED_TIME = 0.0f; // Reset the timer
+				elapsed_time = 0.0f; // Reset the timer
 				}
 		} else {
 			// No movement keys pressed, set back to the first frame
@@ -507,7 +508,7 @@ void WorldSystem::handlePlayerMovement(float elapsed_ms_since_last_update) {
 		}
 	else if (registry.deathTimers.has(player_salmon)) {
 		// Player is dead, do not allow movement
-		Motion& m = registry.motions.get(player_salmon);
+		MotionRef m = registry.motions.get(player_salmon);
 		Player& player = registry.players.get(player_salmon);
 		m.velocity = { 0, 0 };
 
@@ -515,14 +516,14 @@ void WorldSystem::handlePlayerMovement(float elapsed_ms_since_last_update) {
 
 	
 		if (player.health <=  0) {
-			Motion& health = registry.motions.get(health_bar);
+			MotionRef health = registry.motions.get(health_bar);
 			health.scale = { 0,0 };
 		}
 
 	}
 }
 
-void WorldSystem::handle_movement(Motion& motion, InputKeyIndex indexStart, bool invertDirection, bool useAbsoluteVelocity)
+void WorldSystem::handle_movement(MotionRef motion, InputKeyIndex indexStart, bool invertDirection, bool useAbsoluteVelocity)
 {
 	float invert = invertDirection ? -1 : 1;	// shorthand that inverts the results if invertDirection.
 	vec2 moveVelocity = { 0, 0 };
@@ -566,7 +567,7 @@ void WorldSystem::restart_game() {
 	// Reset the items submmited 
 	spaceship_home_system->ALL_ITEMS_SUBMITTED = false;
 	
-	bool PLAYER_DEATH_FROM_FOOD = false;
+	player_death_from_food = false;
 	renderer->enableFow = 1;
 	renderer->fow_radius = 4.5f;
 
@@ -594,36 +595,27 @@ void WorldSystem::restart_game() {
 	registry.list_all_components();
 
 	// Re-initialize the terrain
-	terrain->init(loaded_map_name, renderer);
-
-	// PRESSURE TESTING FOR BVH, can remove later
-	//terrain->init(512, 512, renderer);
-
-	// Add wall of stone around the map
-	for (unsigned int i = 0; i < registry.terrainCells.entities.size(); i++) {
-		Entity e = registry.terrainCells.entities[i];
-		TerrainCell& cell = registry.terrainCells.components[i];
-
-		if (cell.flag & TERRAIN_FLAGS::COLLIDABLE)
-			physics_system->createDefaultCollider(e);
-	}
+	if (map_size > 0)
+		terrain->init(map_size, map_size, renderer);
+	else
+		terrain->init(loaded_map_name, renderer);
 
-	// THIS MUST BE CALL AFTER TERRAIN COLLIDER CREATION AND BEFORE ALL OTHER ENTITY CREATION
-	// build the static BVH with all terrain colliders.
-	physics_system->initStaticBVH(registry.colliders.size());
+	// THIS MUST BE CALLED AFTER THE TERRAIN IS INITIALIZED
+	// build the static BVH with all collidable tiles, tiles are not entities.
+	physics_system->initStaticBVH(terrain);
 
 	// Create Spaceship
-	spaceship = createSpaceship(renderer, { 0,-2.5 });
+	spaceship = createSpaceship(registry, renderer, { 0,-2.5 });
 
 	// Create a new salmon
-	player_salmon = createPlayer(renderer, physics_system, { 0, 0 });
+	player_salmon = createPlayer(registry, renderer, physics_system, { 0, 0 });
 	registry.colors.insert(player_salmon, { 1, 0.8f, 0.8f , 1.f});
 
 	// Create the main camera
-	main_camera = createCamera({ 0,0 });
+	main_camera = createCamera(registry, { 0,0 });
 
 	// Create arrow pointing back to the ship
-	ship_arrow = createPointingArrow(renderer, player_salmon, spaceship);
+	ship_arrow = createPointingArrow(registry, renderer, player_salmon, spaceship);
 
 	// Reset the spaceship home system
 	spaceship_home_system->resetSpaceshipHomeSystem(SPACESHIP_MAX_HEALTH_STORAGE, SPACESHIP_MAX_FOOD_STORAGE, SPACESHIP_MAX_AMMO_STORAGE);
@@ -632,15 +624,15 @@ void WorldSystem::restart_game() {
 	//fow = createFOW(renderer, { 0,0 });
 
 	// Create player health bar
-	health_bar = createBar(renderer, HEALTH_BAR_FRAME_POS, PLAYER_MAX_HEALTH, BAR_TYPE::HEALTH_BAR);
+	health_bar = createBar(registry, renderer, HEALTH_BAR_FRAME_POS, PLAYER_MAX_HEALTH, BAR_TYPE::HEALTH_BAR);
 
 
 
-	health_frame = createFrame(renderer, HEALTH_BAR_FRAME_POS, FRAME_TYPE::HEALTH_FRAME);
+	health_frame = createFrame(registry, renderer, HEALTH_BAR_FRAME_POS, FRAME_TYPE::HEALTH_FRAME);
 
 	// Create player food bar
-	food_bar = createBar(renderer, FOOD_BAR_FRAME_POS, PLAYER_MAX_FOOD, BAR_TYPE::FOOD_BAR);
-	food_frame = createFrame(renderer, FOOD_BAR_FRAME_POS, FRAME_TYPE::FOOD_FRAME);
+	food_bar = createBar(registry, renderer, FOOD_BAR_FRAME_POS, PLAYER_MAX_FOOD, BAR_TYPE::FOOD_BAR);
+	food_frame = createFrame(registry, renderer, FOOD_BAR_FRAME_POS, FRAME_TYPE::FOOD_FRAME);
 
 	// Reset the weapon indicator
 	user_has_first_weapon = false;
@@ -665,24 +657,29 @@ void WorldSystem::restart_game() {
 	// TODO: uncomment these after messing w/ map editor
 	spawn_items();
 	mob_system->spawn_mobs();
-	//createItem(renderer, physics_system, {5.f, 3.f}, ITEM_TYPE::POWERUP_SPEED);
-	//createItem(renderer, physics_system, {5.f, 5.f}, ITEM_TYPE::POWERUP_HEALTH);
+	//createItem(registry, renderer, physics_system, {5.f, 3.f}, ITEM_TYPE::POWERUP_SPEED);
+	//createItem(registry, renderer, physics_system, {5.f, 5.f}, ITEM_TYPE::POWERUP_HEALTH);
 
 	// for movement velocity
 	for (int i = 0; i < KEYS; i++)
 	  keyDown[i] = false;
 
-	muzzleFlash = createMuzzleFlash(renderer, vec2(0.f));
+	muzzleFlash = createMuzzleFlash(registry, renderer, vec2(0.f));
 
 	// Reset powerups system. Must call this after creating player since player entity is stored as a cached in powerup system
 	powerup_system->resetPowerupSystem(player_salmon);
 
+	// Lay out the new world in memory by position, the main loop keeps it that way
+	registry.sort_spatially();
+
 	// Debugging for memory/component leaks
 	registry.list_all_components();
 }
 
 // Compute collisions between entities
 void WorldSystem::handle_collisions() {
+	PROFILE_SCOPE("WorldSystem::handle_collisions");
+
 	// Loop over all collisions detected by the physics system
 	auto& collisionsRegistry = registry.collisions;
 	vec2 hasCorrectedDirection = {0,0};
@@ -702,20 +699,14 @@ void WorldSystem::handle_collisions() {
 				
 				
 				if (player.iframes_timer > 0 || registry.deathTimers.has(entity)) {
-					// discard all player vs mob collision
-					for (int i = 0; i < collisionsRegistry.size(); i++) {
-						if (registry.players.has(collisionsRegistry.entities[i]) && registry.mobs.has(collisionsRegistry.components[i].other_entity))
-							collisionsRegistry.remove(collisionsRegistry.entities[i]);
-						//std::cout << "removed one colliisions." << std::endl;
-
-					}
+					// discard this player vs mob collision, the other ones take the same branch
 
 					// set player to ignore mob collision
 					physics_system->isPlayerInvincible = true;
 					//std::cout << "player is invincible......" << std::endl;
 
 					// skip damage
-					break;
+					continue;
 				}
 
 				Mob& mob = registry.mobs.get(entity_other);
@@ -747,10 +738,10 @@ void WorldSystem::handle_collisions() {
 			}
 
 			// Checking Player - Terrain
-			if (registry.terrainCells.has(entity_other) && registry.collisions.components[i].MTV != hasCorrectedDirection)
+			if (registry.collisions.components[i].terrain_cell >= 0 && registry.collisions.components[i].MTV != hasCorrectedDirection)
 			
 			{
-				Motion& motion = registry.motions.get(player_salmon);
+				MotionRef motion = registry.motions.get_mut(player_salmon);
 				/*
 				std::cout << "MTV x" << registry.collisions.components[i].MTV.x << "  MTV Y: " << registry.collisions.components[i].MTV.y << std::endl;
 				std::cout << "MTV x" << "overlap " << registry.collisions.components[i].overlap << std::endl;
@@ -831,7 +822,7 @@ void WorldSystem::handle_collisions() {
 				}
 
 				// remove item from map
-				registry.remove_all_components_of(entity_other);
+				registry.commands.destroy(entity_other);
 			}
 		}
 
@@ -840,11 +831,12 @@ void WorldSystem::handle_collisions() {
 		// Collisions involving projectiles. 
 		// For now, the projectile will be removed upon any collisions with mobs/terrain
 		// In the future, an idea could be "pass-through weapons", weapons that can collateral?
-		if (registry.projectiles.has(entity)) {
+		// Entities removed by an earlier collision are only destroyed at the next flush, skip them here
+		if (registry.projectiles.has(entity) && !registry.commands.is_destroy_pending(entity)) {
 			Projectile& projectile = registry.projectiles.get(entity);
 
 			// Checking Projectile - Mobs
-			if (registry.mobs.has(entity_other)) {
+			if (registry.mobs.has(entity_other) && !registry.commands.is_destroy_pending(entity_other)) {
 
 				// blood splash particle effects
 				particle_system->createParticleSplash(entity, entity_other, 10, collisionsRegistry.components[i].MTV);
@@ -855,13 +847,13 @@ void WorldSystem::handle_collisions() {
 				mob.health -= projectile.damage;
 				// printf("mob health: %i", mob.health);
 				if (mob.health <= 0) {
-					registry.remove_all_components_of(mob.health_bar);
-					registry.remove_all_components_of(entity_other);
+					registry.commands.destroy(mob.health_bar);
+					registry.commands.destroy(entity_other);
 					audio_system->play_one_shot(AudioSystem::MOB_DEATH);
 				}
 				else {
 					audio_system->play_one_shot(AudioSystem::MOB_HIT);
-					Motion& health = registry.motions.get(mob.health_bar);
+					MotionRef health = registry.motions.get(mob.health_bar);
 					health.scale = vec2(((float)mob.health / (float)mob_system->mob_health_map.at(mob.type)) * 2.5, 0.3);
 				}
 
@@ -869,12 +861,12 @@ void WorldSystem::handle_collisions() {
 				weapons_system->applyWeaponEffects(entity, entity_other);
 
 				// Remove projectile
-				registry.remove_all_components_of(entity);
+				registry.commands.destroy(entity);
 			} 
-			// Checking Projectile - non passable terrain cell
-			else if ((registry.terrainCells.has(entity_other) && (registry.terrainCells.get(entity_other).flag & TERRAIN_FLAGS::COLLIDABLE)))
+			// Checking Projectile - non passable terrain cell, only those have colliders
+			else if (registry.collisions.components[i].terrain_cell >= 0)
 			{
-				registry.remove_all_components_of(entity);
+				registry.commands.destroy(entity);
 			}
 			
 		}
@@ -891,11 +883,6 @@ vec2 WorldSystem::interpolate(vec2 p1, vec2 p2, float param) {
 	return vec2(new_x, new_y);
 }
 
-// Should the game be over ?
-bool WorldSystem::is_over() const {
-	return bool(glfwWindowShouldClose(window));
-}
-
 int WorldSystem::key_to_index(int key) {
 	switch (key) {
 			case GLFW_KEY_W:
@@ -956,22 +943,22 @@ void WorldSystem::update_camera_follow() {
 void WorldSystem::update_spaceship_frame(float elapsed_ms_since_last_update) {
 	auto& a = registry.animations.get(spaceship_depart);
 
-	if (ELAPSED_TIME > 300 || a.framex == 5) {
+	if (elapsed_time > 300 || a.framex == 5) {
 		// Update walking animation
 		if (a.framex != 5) {
 
 			a.framex = (a.framex + 1) % 6;
-			ELAPSED_TIME = 0.0f; // Reset the timer
+			elapsed_time = 0.0f; // Reset the timer
 		}
 		// spaceship departs 
 		if (a.framex == 5) {
-			Motion& spaceship_motion = registry.motions.get(spaceship_depart);
+			MotionRef spaceship_motion = registry.motions.get(spaceship_depart);
 			spaceship_motion.velocity += vec2{ 0,-0.5 };
 			debugging.in_debug_mode = !debugging.in_debug_mode;
 			//renderer->enableFow = 0;
 			if (renderer->fow_radius <= 17)
 				renderer->fow_radius += 0.1;
-			ELAPSED_TIME = 0.0f;
+			elapsed_time = 0.0f;
 		}
 	}
 }
@@ -985,7 +972,7 @@ void WorldSystem::update_spaceship_depart() {
 		registry.pointingArrows.remove(ship_arrow); 
 		registry.renderRequests.remove(ship_arrow);
 		// create depart spaceship
-		spaceship_depart = createSpaceshipDepart(renderer); 
+		spaceship_depart = createSpaceshipDepart(registry, renderer); 
 
 		// Clear powerups
 		registry.powerups.clear();
@@ -998,7 +985,7 @@ void WorldSystem::update_spaceship_depart() {
 
 // On key callback
 void WorldSystem::on_key(int key, int, int action, int mod) {
-	Motion& player_motion = registry.motions.get(player_salmon);
+	MotionRef player_motion = registry.motions.get(player_salmon);
 	Player& player = registry.players.get(player_salmon);
 
 	// Movement with velocity handled in step function  
@@ -1018,7 +1005,7 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 	if (action == GLFW_PRESS && key == GLFW_KEY_K) {
 		// Save the game state (player location, weapon, health, food, mobs & location)
 		Player& player = registry.players.get(player_salmon);
-		Motion& player_motion = registry.motions.get(player_salmon);
+		MotionRef player_motion = registry.motions.get(player_salmon);
 		SpaceshipHome& spaceship_home_info = registry.spaceshipHomes.components[0];
 		Inventory& inventory = registry.inventories.get(player_salmon);
 		ITEM_TYPE active_weapon = weapons_system->getActiveWeapon();
@@ -1028,12 +1015,12 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 			weapons.push_back(registry.weapons.get(weapon_entity));
 		}
 
-		std::vector<std::pair<Mob&, Motion&>> mobs;
+		std::vector<std::pair<Mob&, Motion>> mobs;
 		for (auto& mob : registry.mobs.entities) {
 			mobs.push_back({ registry.mobs.get(mob), registry.motions.get(mob) });
 		}
 
-		std::vector<std::pair<Item&, Motion&>> items;
+		std::vector<std::pair<Item&, Motion>> items;
 		for (auto& item : registry.items.entities) {
 			items.push_back({ registry.items.get(item), registry.motions.get(item) });
 		}
@@ -1071,7 +1058,7 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 			update_spaceship_depart();
 		}
 		else {
-			glfwSetWindowShouldClose(window, true);
+			close_window();
 		}
 	}
 	if (registry.spaceships.has(spaceship)) {
@@ -1096,6 +1083,18 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 	if (key == GLFW_KEY_F1 && action == GLFW_PRESS)
 		debugging.hide_ui = !debugging.hide_ui;
 
+	// Press F10 to show or hide the metrics HUD
+	if (key == GLFW_KEY_F10 && action == GLFW_PRESS)
+		renderer->show_metrics_hud = !renderer->show_metrics_hud;
+
+	// Press F9 to save the last frames the profiler recorded
+	if (key == GLFW_KEY_F9 && action == GLFW_PRESS) {
+		if (Profiler::compiled_in())
+			Profiler::write_chrome_trace(trace_path);
+		else
+			fprintf(stderr, "The profiler is not compiled in, build with -DENABLE_PROFILER=ON\n");
+	}
+
 	// Level editor controls
 	if (debugging.in_debug_mode && action == GLFW_PRESS) {
 		process_editor_controls(action, key);
@@ -1226,22 +1225,10 @@ void WorldSystem::process_editor_controls(int action, int key)
 		assert(registry.items.entities.empty());
 		
 
+		// The terrain hands the meshes of the expanded map's active chunks to the renderer itself
 		terrain->expand_map(world_size_x, world_size_y);
-		renderer->empty_terrain_buffer();
-
-		std::unordered_map<unsigned, RenderSystem::ORIENTATIONS> orientations;
-		terrain->generate_orientation_map(orientations);
-		renderer->initializeTerrainBuffers(orientations);
-
-		for (unsigned int i = 0; i < registry.terrainCells.entities.size(); i++) {
-		Entity e = registry.terrainCells.entities[i];
-		TerrainCell& cell = registry.terrainCells.components[i];
 
-		if (cell.flag & TERRAIN_FLAGS::COLLIDABLE)
-			physics_system->createDefaultCollider(e);
-		}
-
-		physics_system->initStaticBVH(registry.colliders.size());
+		physics_system->initStaticBVH(terrain);
 	}
 }
 /// <summary>
@@ -1249,6 +1236,7 @@ void WorldSystem::process_editor_controls(int action, int key)
 /// </summary>
 /// <param name="mouse_position"> Location of mouse on game screen</param>
 void WorldSystem::on_mouse_move(vec2 mouse_position) {
+	cursor_position = mouse_position;
 	vec2 mouse_pos_clip = screen_to_clip_coords(mouse_position);
 
 	// Disable rotation when the player dies
@@ -1262,19 +1250,13 @@ void WorldSystem::on_mouse_move(vec2 mouse_position) {
 		float screen_centre_y = window_size.y/2;
 
 
-		Motion& motion = registry.motions.get(player_salmon);
-		CURSOR_ANGLE = atan2(cursor.y - screen_centre_y, cursor.x - screen_centre_x);
+		MotionRef motion = registry.motions.get(player_salmon);
+		cursor_angle = atan2(cursor.y - screen_centre_y, cursor.x - screen_centre_x);
 	}
 
 	// Change mouse cursor type if hovering over help button or storage item
-	if (tutorial_system->isMouseOverHelpButton(mouse_pos_clip) || 
-		spaceship_home_system->isHome() && !tutorial_system->isHelpDialogOpen() && spaceship_home_system->isMouseOverAnyStorageItem(mouse_pos_clip)
-	) {
-		GLFWcursor* cursor = glfwCreateStandardCursor(GLFW_HAND_CURSOR);
-		glfwSetCursor(window, cursor);
-	} else {
-		glfwSetCursor(window, NULL);
-	}
+	set_hand_cursor(tutorial_system->isMouseOverHelpButton(mouse_pos_clip) || 
+		spaceship_home_system->isHome() && !tutorial_system->isHelpDialogOpen() && spaceship_home_system->isMouseOverAnyStorageItem(mouse_pos_clip));
 }
 
 
@@ -1282,9 +1264,7 @@ void WorldSystem::on_mouse_move(vec2 mouse_position) {
 /// Function to handle mouse click (weapon fire)
 /// </summary>
 void WorldSystem::on_mouse_click(int button, int action, int mods) {
-	double xpos, ypos;
-	glfwGetCursorPos(window, &xpos, &ypos);
-	vec2 mouse_pos_clip = screen_to_clip_coords({ xpos, ypos });
+	vec2 mouse_pos_clip = screen_to_clip_coords(cursor_position);
 
 	if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
 		// Open/close help dialog when help button is clicked
@@ -1309,17 +1289,18 @@ void WorldSystem::on_mouse_click(int button, int action, int mods) {
 
 		if (!registry.deathTimers.has(player_salmon) && !spaceship_home_system->isHome() && !tutorial_system->isHelpDialogOpen()) {
 			// if theres ammo in current weapon 
-			Motion& player_motion = registry.motions.get(player_salmon);
+			// A copy, firing adds the motions of the projectiles
+			vec2 player_position = registry.motions.get(player_salmon).position;
 
 			float projectileSpawnOffset = 1.4f;
 			// Play appropriate shooting noises if we've just shot
 			// Added offset to spawn projectile a bit outward. 
-			ITEM_TYPE fired_weapon = weapons_system->fireWeapon(player_motion.position.x + projectileSpawnOffset * cos(CURSOR_ANGLE), player_motion.position.y + projectileSpawnOffset * sin(CURSOR_ANGLE), CURSOR_ANGLE);
+			ITEM_TYPE fired_weapon = weapons_system->fireWeapon(player_position.x + projectileSpawnOffset * cos(cursor_angle), player_position.y + projectileSpawnOffset * sin(cursor_angle), cursor_angle);
 			
 			// If we successfully shot...
 			if (fired_weapon != ITEM_TYPE::WEAPON_NONE) {
 
-				emitMuzzleFlash(player_motion.position, PLAYER_DIRECTION);
+				emitMuzzleFlash(player_position, player_direction);
 
 				switch (fired_weapon) {
 				case ITEM_TYPE::WEAPON_SHOTGUN:
@@ -1366,12 +1347,10 @@ void WorldSystem::on_mouse_click(int button, int action, int mods) {
 }
 
 void WorldSystem::map_editor_routine() {
-	double xpos, ypos;
-	glfwGetCursorPos(window, &xpos, &ypos);	// For some reason it only supports doubles!	
-	vec2 mouse_pos = screen_to_clip_coords({ xpos, ypos });
+	vec2 mouse_pos = screen_to_clip_coords(cursor_position);
 
-	Entity tile = terrain->get_cell(mouse_pos);
-	TerrainCell& cell = registry.terrainCells.get(tile);
+	int tile = terrain->get_cell(mouse_pos);
+	TerrainCell cell = terrain->get_cell_data(tile);
 	bool to_collidable = (editor_flag & COLLIDABLE);
 	bool from_collidable = (cell.flag & COLLIDABLE);
 	uint32_t data = ((uint32_t)editor_terrain << 16) | editor_flag;
@@ -1381,19 +1360,17 @@ void WorldSystem::map_editor_routine() {
 
 	if (cell != data) {
 		cell.from_uint32(data);
+		terrain->update_tile(tile, cell, true);	// true because we need to update adjacent cells too
 
-		// Update collisions
+		// Update collisions, the tile's collider lives in the static BVH
 		if (to_collidable != from_collidable) {
 			if (to_collidable) {
-				physics_system->createDefaultCollider(tile);
+				physics_system->addTerrainCollider(tile);
 			}
 			else {
-				registry.colliders.remove(tile);
+				physics_system->removeTerrainCollider(tile);
 			}
-			physics_system->initStaticBVH(registry.colliders.size());
 		}
-
-		terrain->update_tile(tile, cell, true);	// true because we need to update adjacent cells too
 	}
 }
 
@@ -1465,19 +1442,19 @@ void WorldSystem::spawn_items() {
 
 		// spawn the weapon upgrades 
 		for (int i = 0; i < zone_weapon_upgrades[zone]; i++) {
-			createItem(renderer, physics_system, terrain->get_random_terrain_location(zone), ITEM_TYPE::WEAPON_UPGRADE);
+			createItem(registry, renderer, physics_system, terrain->get_random_terrain_location(zone), ITEM_TYPE::WEAPON_UPGRADE);
 		}
 
 		// spawn food
 		for (int i = 0; i < zone_food[zone]; i++) {
-			createItem(renderer, physics_system, terrain->get_random_terrain_location(zone), ITEM_TYPE::FOOD);
+			createItem(registry, renderer, physics_system, terrain->get_random_terrain_location(zone), ITEM_TYPE::FOOD);
 		}
 
 		// spawn ammo
 		std::vector<ITEM_TYPE> weapons = {ITEM_TYPE::WEAPON_SHURIKEN, ITEM_TYPE::WEAPON_CROSSBOW, ITEM_TYPE::WEAPON_SHOTGUN, ITEM_TYPE::WEAPON_MACHINEGUN};
 		for (auto& weapon : weapons) {
 			for (int i = 0; i < zone_ammo[zone]; i++) {
-				createItem(renderer, physics_system, terrain->get_random_terrain_location(zone), weapon);
+				createItem(registry, renderer, physics_system, terrain->get_random_terrain_location(zone), weapon);
 			}
 		}
 
@@ -1485,7 +1462,7 @@ void WorldSystem::spawn_items() {
 		std::vector<ITEM_TYPE> powerups = { ITEM_TYPE::POWERUP_SPEED, ITEM_TYPE::POWERUP_HEALTH, ITEM_TYPE::POWERUP_INVISIBLE, ITEM_TYPE::POWERUP_INFINITE_BULLET};
 		for (auto& powerup : powerups) {
 			for (int i = 0; i < zone_powerup[zone]; i++) {
-				createItem(renderer, physics_system, terrain->get_random_terrain_location(zone), powerup);
+				createItem(registry, renderer, physics_system, terrain->get_random_terrain_location(zone), powerup);
 			}
 		}
 
@@ -1547,10 +1524,10 @@ void WorldSystem::spawn_items() {
 
 
 	// Hardcoded quest items
-	createItem(renderer, physics_system, { -78.f, -84.f }, ITEM_TYPE::QUEST_ONE);
-	createItem(renderer, physics_system, { 55.f, -52.f }, ITEM_TYPE::QUEST_TWO);
-	createItem(renderer, physics_system, { 78.f, 48.f }, ITEM_TYPE::QUEST_THREE);
-	createItem(renderer, physics_system, { -73.f, 62.f }, ITEM_TYPE::QUEST_FOUR);
+	createItem(registry, renderer, physics_system, { -78.f, -84.f }, ITEM_TYPE::QUEST_ONE);
+	createItem(registry, renderer, physics_system, { 55.f, -52.f }, ITEM_TYPE::QUEST_TWO);
+	createItem(registry, renderer, physics_system, { 78.f, 48.f }, ITEM_TYPE::QUEST_THREE);
+	createItem(registry, renderer, physics_system, { -73.f, 62.f }, ITEM_TYPE::QUEST_FOUR);
 
 
 	
@@ -1587,32 +1564,23 @@ void WorldSystem::load_game(json j) {
 	
 
 	// Re-initialize the terrain
-	terrain->init(loaded_map_name, renderer);
-
-	// PRESSURE TESTING FOR BVH, can remove later
-	//terrain->init(512, 512, renderer);
+	if (map_size > 0)
+		terrain->init(map_size, map_size, renderer);
+	else
+		terrain->init(loaded_map_name, renderer);
 	
-	// Add wall of stone around the map
-	for (unsigned int i = 0; i < registry.terrainCells.entities.size(); i++) {
-		Entity e = registry.terrainCells.entities[i];
-		TerrainCell& cell = registry.terrainCells.components[i];
-
-		if (cell.flag & TERRAIN_FLAGS::COLLIDABLE)
-			physics_system->createDefaultCollider(e);
-		}
-
-	// THIS MUST BE CALL AFTER TERRAIN COLLIDER CREATION AND BEFORE ALL OTHER ENTITY CREATION
-	// build the static BVH with all terrain colliders.
-	physics_system->initStaticBVH(registry.colliders.size());
+	// THIS MUST BE CALLED AFTER THE TERRAIN IS INITIALIZED
+	// build the static BVH with all collidable tiles, tiles are not entities.
+	physics_system->initStaticBVH(terrain);
 
 	// Create a Spaceship 
-	spaceship = createSpaceship(renderer, { 0, -2.5 });
+	spaceship = createSpaceship(registry, renderer, { 0, -2.5 });
 
 
 
 
 	// Create a new salmon
-	player_salmon = createPlayer(renderer, physics_system, player_location);
+	player_salmon = createPlayer(registry, renderer, physics_system, player_location);
 	Player& player = registry.players.get(player_salmon);
 	int p_health = j["player"]["health"];
 	int p_food = j["player"]["food"];
@@ -1629,19 +1597,19 @@ void WorldSystem::load_game(json j) {
 	registry.colors.insert(player_salmon, { 1, 0.8f, 0.8f, 1.0f});
 
 	// Create the main camera
-	main_camera = createCamera(player_location);
-	Motion& camera_motion = registry.motions.get(main_camera);
+	main_camera = createCamera(registry, player_location);
+	MotionRef camera_motion = registry.motions.get(main_camera);
 
 	// Create arrow pointing back to the ship
-	ship_arrow = createPointingArrow(renderer, player_salmon, spaceship);
+	ship_arrow = createPointingArrow(registry, renderer, player_salmon, spaceship);
 
 	// Create player health bar
-	health_bar = createBar(renderer, HEALTH_BAR_FRAME_POS, PLAYER_MAX_HEALTH, BAR_TYPE::HEALTH_BAR);
-	health_frame = createFrame(renderer, HEALTH_BAR_FRAME_POS, FRAME_TYPE::HEALTH_FRAME);
+	health_bar = createBar(registry, renderer, HEALTH_BAR_FRAME_POS, PLAYER_MAX_HEALTH, BAR_TYPE::HEALTH_BAR);
+	health_frame = createFrame(registry, renderer, HEALTH_BAR_FRAME_POS, FRAME_TYPE::HEALTH_FRAME);
 
 	// Create player food bar
-	food_bar = createBar(renderer, FOOD_BAR_FRAME_POS, PLAYER_MAX_FOOD, BAR_TYPE::FOOD_BAR);
-	food_frame = createFrame(renderer, FOOD_BAR_FRAME_POS, FRAME_TYPE::FOOD_FRAME);
+	food_bar = createBar(registry, renderer, FOOD_BAR_FRAME_POS, PLAYER_MAX_FOOD, BAR_TYPE::FOOD_BAR);
+	food_frame = createFrame(registry, renderer, FOOD_BAR_FRAME_POS, FRAME_TYPE::FOOD_FRAME);
 
 	// Reset spaceship home system
 	int sh_health_storage = j["spaceshipHome"]["health_storage"];
@@ -1702,12 +1670,15 @@ void WorldSystem::load_game(json j) {
 	for (int i = 0; i < KEYS; i++)
 		keyDown[i] = false;
 
-	muzzleFlash = createMuzzleFlash(renderer, vec2(0.f));
+	muzzleFlash = createMuzzleFlash(registry, renderer, vec2(0.f));
 
 	weapons_system->createNonselectedWeaponIndicators();
 
 	tutorial_system->createTutorialText(TUTORIAL_TYPE::GAME_LOADED);
 
+	// Lay out the loaded world in memory by position, the main loop keeps it that way
+	registry.sort_spatially();
+
 	// Debugging for memory/component leaks
 	registry.list_all_components();
 	printf("FINISHED LOADING \n");
@@ -1716,7 +1687,7 @@ void WorldSystem::load_game(json j) {
 
 void WorldSystem::load_spawned_items_mobs(json& j) {
 	for (auto& item : j["items"]) {
-		createItem(renderer, physics_system, { item[1]["position_x"], item[1]["position_y"] }, item[0]["data"]);
+		createItem(registry, renderer, physics_system, { item[1]["position_x"], item[1]["position_y"] }, item[0]["data"]);
 	}
 
 	for (auto& mob : j["mobs"]) {
@@ -1725,7 +1696,7 @@ void WorldSystem::load_spawned_items_mobs(json& j) {
 }
 
 void WorldSystem::emitMuzzleFlash(vec2 position, int PLAYER_DIRECTION) {
-	auto& m = registry.motions.get(muzzleFlash);
+	MotionRef m = registry.motions.get(muzzleFlash);
 	vec2 offset;
 
 	float horizonatalOffset = 1.75f;
@@ -1773,23 +1744,19 @@ void WorldSystem::emitMuzzleFlash(vec2 position, int PLAYER_DIRECTION) {
 
 void WorldSystem::powerup_spawn_helper(vec2 position){ 
 
-	// set up the random number generator
-	std::random_device rng;
-	std::mt19937 generator(rng());  // Seed the generator
-	std::uniform_int_distribution<> distribution_powerup_type(0, 3);
-
-	switch (distribution_powerup_type(rng)) {
+	// pick a random powerup
+	switch (registry.random.stream(RANDOM_STREAM::WORLD).uniform_int(0, 3)) {
 	case 0:
-		createItem(renderer, physics_system, position, ITEM_TYPE::POWERUP_SPEED);
+		createItem(registry, renderer, physics_system, position, ITEM_TYPE::POWERUP_SPEED);
 		break;
 	case 1:
-		createItem(renderer, physics_system, position, ITEM_TYPE::POWERUP_HEALTH);
+		createItem(registry, renderer, physics_system, position, ITEM_TYPE::POWERUP_HEALTH);
 		break;
 	case 2:
-		createItem(renderer, physics_system, position, ITEM_TYPE::POWERUP_INVISIBLE);
+		createItem(registry, renderer, physics_system, position, ITEM_TYPE::POWERUP_INVISIBLE);
 		break;
 	case 3:
-		createItem(renderer, physics_system, position, ITEM_TYPE::POWERUP_INFINITE_BULLET);
+		createItem(registry, renderer, physics_system, position, ITEM_TYPE::POWERUP_INFINITE_BULLET);
 		break;
 	}
 
@@ -23,6 +23,7 @@
 #include "tutorial_system.hpp"
 #include "particle_system.hpp"
 #include "powerup_system.hpp"
+#include "input_log.hpp"
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -32,7 +33,7 @@ using json = nlohmann::json;
 class WorldSystem
 {
 public:
-	WorldSystem();
+	explicit WorldSystem(ECSRegistry& registry_arg);
 
 	// Movement with velocity 
 	enum InputKeyIndex {
@@ -78,13 +79,43 @@ public:
 	/// <param name="indexStart">The 'InputKeyIndex::XX_LEFT' associated with the left-moving key</param>
 	/// <param name="invertDirection">Should the directions be inverted?</param>
 	/// <param name="useAbsoluteVelocity">Is player velocity dependent on the direction the player is facing?</param>
-	void handle_movement(Motion& motion, InputKeyIndex indexStart, bool invertDirection = false, bool useAbsoluteVelocity = true);
+	void handle_movement(MotionRef motion, InputKeyIndex indexStart, bool invertDirection = false, bool useAbsoluteVelocity = true);
 
 	// Check for collisions
 	void handle_collisions();
 	// Should the game be over ?
 	bool is_over()const;
+
+	// Records the input of the window into log, or, if the log replays, ignores the window and takes the recorded
+	// input from replay_frame instead. Set before init.
+	void set_input_log(InputLog* log) { input_log = log; }
+
+	// Passes the recorded input of the next frame to the input handlers and gets the time the frame took.
+	// Returns false at the end of the replay.
+	bool replay_frame(float& elapsed_ms);
+
+	// Passes input that does not come from the window to the input handlers, e.g. that of a replay or of the
+	// scripted player of a world batch. FRAME events are ignored.
+	void play_input(const InputEvent& event);
+
+	// Plays on a generated map of size x size cells instead of loaded_map_name. Set before init.
+	void set_map_size(unsigned int size) { map_size = size; }
+
+	// Where F9 writes the profiler's trace, see Profiler::write_chrome_trace
+	void set_trace_path(std::string path) { trace_path = std::move(path); }
 private:
+	// Entry points of the window's input: they record it, or ignore it during a replay, and pass it on
+	void receive_key(int key, int scancode, int action, int mod);
+	void receive_mouse_move(vec2 pos);
+	void receive_mouse_click(int button, int action, int mods);
+
+	// The window half of WorldSystem, in world_system_window.cpp. The headless build (src/headless/) has no
+	// window and links stubs for these instead.
+	void attach_window();	// routes the window's input to the receive_ functions
+	void destroy_window();
+	void close_window();
+	void set_hand_cursor(bool hand);
+
 	// Input callback functions
 	void on_key(int key, int, int action, int mod);
 	void process_editor_controls(int action, int key);
@@ -97,8 +128,22 @@ private:
 
 	void load_game(json j);
 
+	// The world this system plays in
+	ECSRegistry& registry;
+
 	// OpenGL window handle
-	GLFWwindow* window;
+	GLFWwindow* window = nullptr;
+
+	// Recording or replaying the input, see set_input_log
+	InputLog* input_log = nullptr;
+
+	std::string trace_path = "trace.json";
+
+	// Side of the generated map, 0 for loaded_map_name
+	unsigned int map_size = 0;
+
+	// Where the cursor was at the last mouse move, so that a click does not depend on the live cursor in a replay
+	vec2 cursor_position = { 0.f, 0.f };
 
 	// Number of fish eaten by the salmon, displayed in the window title
 	unsigned int points;
@@ -120,6 +165,14 @@ private:
 	float next_fish_spawn;
 	float low_hunger_sound_interval = 300.f;
 	float remaing_time_for_next_hunger_sound = 0;
+
+	// Player state of this world
+	float player_total_distance = 0;	// travelled since the food last went down
+	float cursor_angle = 0;
+	int player_direction = 2;			// default to facing up
+	float elapsed_time = 0;				// since the last animation frame
+	bool player_death_from_food = false;
+
 	Entity player_salmon;
 	Entity player_equipped_weapon;
 	Entity main_camera;
@@ -144,10 +197,6 @@ private:
 	bool user_has_first_weapon = false;
 	bool user_has_powerup = false;
 
-	// C++ random number generator
-	std::default_random_engine rng;
-	std::uniform_real_distribution<float> uniform_dist; // number between 0..1
-
 	// Vector to keep track of locations where an item/mob has been spawned
 	std::vector<vec2> used_spawn_locations;
 
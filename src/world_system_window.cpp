@@ -0,0 +1,106 @@
+// Header
+#include "world_system.hpp"
+
+// The parts of WorldSystem that need the GLFW window. The headless build (src/headless/) has no window and links
+// stubs for them instead.
+
+// Debugging
+namespace {
+	void glfw_err_cb(int error, const char* desc) {
+		fprintf(stderr, "%d: %s", error, desc);
+	}
+}
+
+// World initialization
+// Note, this has a lot of OpenGL specific things, could be moved to the renderer
+GLFWwindow* WorldSystem::create_window(ivec2& window_size) {
+	///////////////////////////////////////
+	// Initialize GLFW
+	glfwSetErrorCallback(glfw_err_cb);
+	if (!glfwInit()) {
+		fprintf(stderr, "Failed to initialize GLFW");
+		return nullptr;
+	}
+
+	//-------------------------------------------------------------------------
+	// If you are on Linux or Windows, you can change these 2 numbers to 4 and 3 and
+	// enable the glDebugMessageCallback to have OpenGL catch your mistakes for you.
+	// GLFW / OGL Initialization
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#if __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+	glfwWindowHint(GLFW_RESIZABLE, 0);
+
+	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	int y = mode->height;
+	int s = y / aspect_ratio.y;	// scale factor such that s * aspect_ratio = {mode->width, mode->height}. 
+	int x = aspect_ratio.x * s;
+	// Remember: aspect_ratio.y * s = y, aspect_ratio.x * s = x
+
+	GLFWmonitor* monitor_ptr = glfwGetPrimaryMonitor();
+
+	if (windowed_mode) {
+		monitor_ptr = nullptr;
+		x = target_resolution.x;
+		y = target_resolution.y;
+	}
+
+	// Create the main window (for rendering, keyboard, and mouse input)
+	window = glfwCreateWindow(x, y, "Stranded", monitor_ptr, nullptr);
+	if (window == nullptr) {
+		fprintf(stderr, "Failed to glfwCreateWindow");
+		return nullptr;
+	}
+
+	window_size = { x, y };
+
+	return window;
+}
+
+void WorldSystem::attach_window()
+{
+	// Setting callbacks to member functions (that's why the redirect is needed)
+	// Input is handled using GLFW, for more info see
+	// http://www.glfw.org/docs/latest/input_guide.html
+	glfwSetWindowUserPointer(window, this);
+	auto key_redirect = [](GLFWwindow* wnd, int _0, int _1, int _2, int _3) { ((WorldSystem*)glfwGetWindowUserPointer(wnd))->receive_key(_0, _1, _2, _3); };
+	auto cursor_pos_redirect = [](GLFWwindow* wnd, double _0, double _1) { ((WorldSystem*)glfwGetWindowUserPointer(wnd))->receive_mouse_move({ _0, _1 }); };
+	auto cursor_button_redirect = [](GLFWwindow* wnd, int _0, int _1, int _2) { ((WorldSystem*)glfwGetWindowUserPointer(wnd))->receive_mouse_click(_0, _1, _2); };
+	glfwSetKeyCallback(window, key_redirect);
+	glfwSetCursorPosCallback(window, cursor_pos_redirect);
+	glfwSetMouseButtonCallback(window, cursor_button_redirect);
+
+	// Start from where the cursor is, as if it had just moved there
+	double xpos, ypos;
+	glfwGetCursorPos(window, &xpos, &ypos);
+	receive_mouse_move({ xpos, ypos });
+}
+
+void WorldSystem::destroy_window()
+{
+	glfwDestroyWindow(window);
+}
+
+// Should the game be over ?
+bool WorldSystem::is_over() const {
+	return bool(glfwWindowShouldClose(window));
+}
+
+void WorldSystem::close_window()
+{
+	glfwSetWindowShouldClose(window, true);
+}
+
+void WorldSystem::set_hand_cursor(bool hand)
+{
+	if (hand) {
+		GLFWcursor* cursor = glfwCreateStandardCursor(GLFW_HAND_CURSOR);
+		glfwSetCursor(window, cursor);
+	} else {
+		glfwSetCursor(window, NULL);
+	}
+}